@@ -8,6 +8,7 @@
 
 #include"../include/shader.h"
 #include"../include/mesh.h"
+#include"../include/app.h"
 
 int win_width = 900, win_height = 900;
 
@@ -39,19 +40,19 @@ void glfw_center_window(GLFWwindow *win)
     glfwSetWindowPos(win, centx, centy);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Point light", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Point light", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -61,7 +62,7 @@ int main()
     glfwSetKeyCallback(window, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...");
         return 0;
@@ -120,10 +121,10 @@ int main()
         lamp_shad.set_mat4_uniform("model", model);
         lamp_mesh.draw_triangles();
 
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
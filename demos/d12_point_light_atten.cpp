@@ -1,3 +1,7 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
 #include<GL/glew.h>
 #include<GLFW/glfw3.h>
 #include<glm/glm.hpp>
@@ -6,9 +10,18 @@
 
 #include<cstdio>
 #include<cmath>
+#include<vector>
+#include<memory>
+#include<chrono>
 
 #include"../include/shader.h"
 #include"../include/mesh.h"
+#include"../include/point_shadow_map.h"
+#include"../include/gpu_timer.h"
+#include"../include/app.h"
+
+//Suzanne and a ring of casters around her, lit by a moving point light with attenuation. The point light casts shadows in every direction
+//from a depth cubemap (point_shadow_map.h), rendered either in 1 layered pass or in 6 passes (1 per face), to compare their cost.
 
 int win_width = 1500, win_height = 900;
 
@@ -40,19 +53,19 @@ void glfw_center_window(GLFWwindow *win)
     glfwSetWindowPos(win, centx, centy);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Point light with attenuation", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Point light with attenuation", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -62,7 +75,7 @@ int main()
     glfwSetKeyCallback(window, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...");
         return 0;
@@ -70,15 +83,59 @@ int main()
 
     //Create Meshes.
     meshvfn suzanne("../obj/vfn/suzanne.obj");
+    meshvfn ground("../obj/vfn/plane40x40.obj");
+    meshvfn cube("../obj/vfn/cube2x2x2.obj");
+    meshvfn sphere("../obj/vfn/uv_sphere_rad1_20x20.obj");
+    meshvfn stool("../obj/vfn/stool.obj");
     meshvf lamp("../obj/vf/uv_sphere_rad1_20x20.obj");
 
-    //Create shaders.
+    //Create shaders. The lit shader with and without shadows, and the depth shader of the point shadow map, for 1 layered pass and for
+    //1 pass per face (only the latter where layered rendering from the vertex shader isn't supported).
     shader suzanne_shad("../shaders/vertex/trans_mvpn.vert","../shaders/fragment/point_light_ads_atten.frag");
+    shader suzanne_shadow_shad("../shaders/vertex/trans_mvpn.vert","../shaders/fragment/point_light_ads_atten.frag", {"POINT_SHADOW"});
     shader lamp_shad("../shaders/vertex/trans_mvp.vert","../shaders/fragment/monochromatic.frag");
+    shader face_depth_shad("../shaders/vertex/trans_point_shadow.vert","../shaders/fragment/point_shadow_depth.frag");
+
+    point_shadow_map shadow_map(1024);
+    std::unique_ptr<shader> layered_depth_shad; //Null without layered rendering.
+    if (shadow_map.is_layered())
+        layered_depth_shad = std::make_unique<shader>("../shaders/vertex/trans_point_shadow.vert","../shaders/fragment/point_shadow_depth.frag", std::vector<std::string>{"POINT_SHADOW_LAYERED"});
+
+    //The casters : Suzanne, the ground and a ring of objects around her.
+    std::vector<point_shadow_caster> casters;
+    std::vector<glm::vec3> caster_cols;
+    casters.push_back({&suzanne, glm::mat4(1.0f), suzanne.get_farthest_vertex_distance()});
+    caster_cols.push_back(glm::vec3(0.8f,0.4f,0.0f));
+    casters.push_back({&ground, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,0.0f,-1.5f)), ground.get_farthest_vertex_distance()});
+    caster_cols.push_back(glm::vec3(0.6f,0.6f,0.6f));
+    meshvfn *ring_meshes[3] = {&cube, &sphere, &stool};
+    float ring_radii[3] = {cube.get_farthest_vertex_distance(), sphere.get_farthest_vertex_distance(), stool.get_farthest_vertex_distance()};
+    const int ring_count = 36;
+    for (int i = 0; i < ring_count; i++)
+    {
+        float angle = 2.0f*3.14159265f*i/ring_count, radius = (i%2 == 0) ? 9.0f : 13.0f;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(radius*cos(angle), radius*sin(angle), -0.9f));
+        model = glm::scale(model, glm::vec3(0.6f));
+        casters.push_back({ring_meshes[i%3], model, ring_radii[i%3]});
+        caster_cols.push_back(glm::vec3(0.3f + 0.6f*(i%3 == 0), 0.3f + 0.6f*(i%3 == 1), 0.3f + 0.6f*(i%3 == 2)));
+    }
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(200.0f,200.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
 
     glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
     glm::vec3 lamp_col = glm::vec3(1.0f,1.0f,1.0f);
-    glm::vec3 suzanne_col = glm::vec3(0.8f,0.4f,0.0f);
     glm::vec3 cam_pos = glm::vec3(0.0f,15.0f,9.0f);
     glm::vec3 lamp_pos;
 
@@ -89,28 +146,65 @@ int main()
     lamp_shad.set_vec3_uniform("mesh_col", lamp_col);
     lamp_shad.set_mat4_uniform("view", view);
 
-    suzanne_shad.use();
-    suzanne_shad.set_vec3_uniform("mesh_col", suzanne_col);
-    suzanne_shad.set_vec3_uniform("light_col", light_col);
-    suzanne_shad.set_vec3_uniform("cam_pos", cam_pos);
-    suzanne_shad.set_mat4_uniform("view", view);
+    shader *lit_shaders[2] = {&suzanne_shad, &suzanne_shadow_shad};
+    for (shader *lit : lit_shaders)
+    {
+        lit->use();
+        lit->set_vec3_uniform("light_col", light_col);
+        lit->set_vec3_uniform("cam_pos", cam_pos);
+        lit->set_mat4_uniform("view", view);
+    }
+
+    int shadow_mode = shadow_map.is_layered() ? 1 : 2; //0 : No shadows, 1 : 1 layered pass, 2 : 6 passes.
+    bool face_culling = true;
+    float light_range = 30.0f;
+    gpu_timer shadow_timers[3]; //Gpu time of the shadow map, per mode.
+    float shadow_cpu_ms[3] = {}; //Smoothed cpu time of the shadow map submission, per mode.
 
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.05f,0.05f,0.05f,1.0f);
     while (!glfwWindowShouldClose(window))
     {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
         lamp_pos = glm::vec3(0.0f, 5.0f + 3.0f*sin(glfwGetTime()), 0.0f); //light position in world coordinates
 
+        //Shadow map : The scene as seen from the light, in all directions.
+        if (shadow_mode != 0)
+        {
+            shadow_map.update(lamp_pos, light_range);
+            shadow_map.set_culling(face_culling);
+            auto t0 = std::chrono::steady_clock::now();
+            shadow_timers[shadow_mode].begin();
+            if (shadow_mode == 1)
+                shadow_map.render(*layered_depth_shad, casters.data(), (int)casters.size());
+            else
+                shadow_map.render_six_pass(face_depth_shad, casters.data(), (int)casters.size());
+            shadow_timers[shadow_mode].end();
+            float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            float &smoothed = shadow_cpu_ms[shadow_mode];
+            smoothed = (smoothed == 0.0f) ? ms : 0.95f*smoothed + 0.05f*ms;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0,0, win_width,win_height);
+        }
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
         projection = glm::perspective(glm::radians(45.0f),(float)win_width/(float)win_height, 0.01f,100.0f);
 
-        suzanne_shad.use();
-        model = glm::mat4(1.0f);
-        suzanne_shad.set_mat4_uniform("projection", projection);
-        suzanne_shad.set_mat4_uniform("model", model);
-        suzanne_shad.set_vec3_uniform("light_pos", lamp_pos);
-        suzanne.draw_triangles();
+        shader &lit_shad = *lit_shaders[shadow_mode != 0];
+        lit_shad.use();
+        if (shadow_mode != 0)
+        {
+            shadow_map.bind(0);
+            shadow_map.set_uniforms(lit_shad, 0);
+        }
+        lit_shad.set_mat4_uniform("projection", projection);
+        lit_shad.set_vec3_uniform("light_pos", lamp_pos);
+        for (size_t k = 0; k < casters.size(); k++)
+        {
+            lit_shad.set_mat4_uniform("model", casters[k].model);
+            lit_shad.set_vec3_uniform("mesh_col", caster_cols[k]);
+            casters[k].mesh->draw_triangles();
+        }
 
         lamp_shad.use();
         model = glm::mat4(1.0f);
@@ -121,10 +215,45 @@ int main()
         lamp_shad.set_vec3_uniform("light_pos", lamp_pos);
         lamp.draw_triangles();
 
-        glfwSwapBuffers(window);
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(380.0f, 360.0f), ImGuiCond_FirstUseEver);
+        static bool popen = true;
+        ImGui::Begin("Point light shadows", &popen);
+        if (!popen)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::BulletText("Shadow map");
+        ImGui::RadioButton("Off", &shadow_mode, 0);
+        if (shadow_map.is_layered())
+            ImGui::RadioButton("1 pass (layered, instanced)", &shadow_mode, 1);
+        else
+            ImGui::TextDisabled("1 pass : No layered rendering from the vertex shader");
+        ImGui::RadioButton("6 passes (1 per face)", &shadow_mode, 2);
+        ImGui::Checkbox("Cull the casters per face", &face_culling);
+        ImGui::SliderFloat("light range", &light_range, 5.0f, 60.0f);
+        ImGui::BulletText("Statistics");
+        ImGui::Text("Cubemap : 6 x %d^2, %.1f MB (16 bit distances)", shadow_map.get_resolution(), shadow_map.memory_bytes()/1048576.0);
+        ImGui::Text("Casters : %d, draw calls : %d", (int)casters.size(), shadow_map.draw_count());
+        ImGui::Text("Caster-faces drawn : %d, culled : %d", shadow_map.face_draw_count(), shadow_map.culled_count());
+        ImGui::BulletText("Performance");
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        ImGui::Text("1 pass   : gpu %.3f [ms], cpu %.3f [ms]", shadow_timers[1].last_ms(), shadow_cpu_ms[1]);
+        ImGui::Text("6 passes : gpu %.3f [ms], cpu %.3f [ms]", shadow_timers[2].last_ms(), shadow_cpu_ms[2]);
+        ImGui::End();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    app_terminate();
     return 0;
 }
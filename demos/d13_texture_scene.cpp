@@ -6,9 +6,11 @@
 
 #include<cstdio>
 #include<cmath>
+#include<cstring>
 
 #include"../include/shader.h"
 #include"../include/mesh.h"
+#include"../include/app.h"
 
 int win_width = 1500, win_height = 900;
 
@@ -37,19 +39,19 @@ void glfw_center_window(GLFWwindow *win)
     glfwSetWindowPos(win, centx, centy);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Texture scene", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Texture scene", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -58,19 +60,36 @@ int main()
     glfwSetKeyCallback(window, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
     }
 
+    //Texture storage (--textures bc|bc7|raw) : Block compressed (bc1/bc3, or bc7), or uncompressed. Each texture prints its memory.
+    const char *textures = app_option("--textures");
+    if (textures != NULL)
+    {
+        texture_compression.enabled = (strcmp(textures, "raw") != 0);
+        texture_compression.prefer_bc7 = (strcmp(textures, "bc7") == 0);
+    }
+    //Texture uploads (--upload staged|direct) : Through the staging ring of pixel unpack buffers, or straight from client memory.
+    const char *upload = app_option("--upload");
+    if (upload != NULL)
+        texture_uploader::instance().set_enabled(strcmp(upload, "direct") != 0);
+
     //Load the meshes with the corresponding textures.
+    double load_start = glfwGetTime();
     meshvft ground("../obj/vft/plane10x10.obj", "../images/texture/aerial_grass_rock_diff_4k.jpg");
     meshvft wooden_stool("../obj/vft/wooden_stool.obj", "../images/texture/wooden_stool_diff_2k.jpg");
     meshvft brick_cube("../obj/vft/cube1x1x1_correct_uv.obj", "../images/texture/red_brick_diff_2k.jpg");
     meshvft wooden_container("../obj/vft/cube1x1x1_correct_uv.obj", "../images/texture/wooden_container_diff_512x512.jpg");
     meshvft plant_pot("../obj/vft/plant_pot.obj", "../images/texture/potted_plant_pot_diff_2k.png");
     meshvft plant_leaves("../obj/vft/plant_leaves.obj", "../images/texture/potted_plant_leaves_diff_2k.png");
+    glFinish(); //Include the copies still in flight.
+    texture_uploader::instance().release();
+    printf("Loaded the meshes in %.0f ms (%s uploads), peak memory %.0f MB.\n", 1000.0*(glfwGetTime() - load_start),
+           texture_uploader::instance().is_enabled() ? "staged" : "direct", app_peak_rss_mb());
 
     shader texshad("../shaders/vertex/trans_mvp_texture.vert","../shaders/fragment/texture.frag");
     texshad.use();
@@ -118,10 +137,10 @@ int main()
         plant_pot.draw_triangles();
         plant_leaves.draw_triangles();
 
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
@@ -8,6 +8,7 @@
 #include"../include/shader.h"
 #include"../include/mesh.h"
 #include"../include/camera.h"
+#include"../include/app.h"
 
 //Camera object instantiation. We make it global so that the glfw callback 'cursor_pos_callback()' (see later) can
 //have access to it. This is just for demo. At a bigger project, we would use glfwSetWindowUserPointer(...) to encapsulate
@@ -124,9 +125,9 @@ void framebuffer_size_callback(GLFWwindow *, int w, int h)
     glViewport(0,0,w,h);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -134,11 +135,11 @@ int main()
 
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "First person camera", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "First person camera", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -154,7 +155,7 @@ int main()
     glfwGetWindowSize(window, &win_width, &win_height);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -214,10 +215,10 @@ int main()
         lamp_shad.set_mat4_uniform("model", model);
         sphere_lamp.draw_triangles();
        
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
@@ -4,10 +4,12 @@
 #include<glm/gtc/matrix_transform.hpp>
 #include<glm/gtc/type_ptr.hpp>
 #include<cstdio>
+#include<cstring>
 
 #include"../include/shader.h"
 #include"../include/mesh.h"
 #include"../include/camera.h"
+#include"../include/app.h"
 
 camera cam(glm::vec3(0.0f, -10.0f, 0.0f));
 
@@ -115,9 +117,9 @@ void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
     glViewport(0,0,w,h);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -125,11 +127,11 @@ int main()
 
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Skybox", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Skybox", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -144,7 +146,7 @@ int main()
     glfwGetWindowSize(window, &win_width, &win_height);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -161,13 +163,22 @@ int main()
     shadsuz.set_vec3_uniform("light_col", light_col);
     shadsuz.set_vec3_uniform("mesh_col", mesh_col);
 
+    //How to load the skybox (--skybox cold|parallel|cached) : Decode the 6 jpgs 1 after the other, decode them concurrently, or load the
+    //pre-decoded cubemap from ../cache/ (decoding in parallel and baking it on the first run). The load time is printed for comparison.
+    const char *load_mode = app_option("--skybox");
+    if (load_mode == NULL)
+        load_mode = "cached";
+    bool cold = (strcmp(load_mode, "cold") == 0), cached = (strcmp(load_mode, "cached") == 0);
+
     //Make sure that the images have all the same size in pixels (e.g. 2048x2048, 500x500, etc..) AND channels.
     skybox sb("../images/skyboxes/landscape_2k/right.jpg",
               "../images/skyboxes/landscape_2k/left.jpg",
               "../images/skyboxes/landscape_2k/top.jpg",
               "../images/skyboxes/landscape_2k/bottom.jpg",
               "../images/skyboxes/landscape_2k/front.jpg",
-              "../images/skyboxes/landscape_2k/back.jpg");
+              "../images/skyboxes/landscape_2k/back.jpg",
+              cached ? "../cache/landscape_2k.cube" : NULL, true, !cold);
+    printf("Skybox loaded in %.1f ms (%s).\n", sb.get_load_ms(), sb.get_load_source());
 
     shader shadsb("../shaders/vertex/skybox.vert","../shaders/fragment/skybox.frag");
 
@@ -208,10 +219,10 @@ int main()
         shadsb.set_mat4_uniform("model", model);
         sb.draw_triangles();
 
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
@@ -8,20 +8,22 @@
 
 #include<cstdio>
 
+#include"../include/app.h"
+
 void key_callback(GLFWwindow *window, int key, int, int action, int)
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_RELEASE)
         glfwSetWindowShouldClose(window, true);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	glfwInit();
+	app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    GLFWwindow *window = glfwCreateWindow(800,600, "OpenGL window", NULL, NULL);
+    GLFWwindow *window = app_create_window(800,600, "OpenGL window", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to open a glfw window. Exiting...\n");
@@ -32,7 +34,7 @@ int main()
     glfwSetKeyCallback(window, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -65,7 +67,7 @@ int main()
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
@@ -74,7 +76,7 @@ int main()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    glfwTerminate();
+    app_terminate();
 
 	return 0;
 }
\ No newline at end of file
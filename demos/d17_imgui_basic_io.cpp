@@ -8,6 +8,8 @@
 
 #include<cstdio>
 
+#include"../include/app.h"
+
 void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_RELEASE)
@@ -19,14 +21,14 @@ void framebuffer_size_callback(GLFWwindow */*window*/, int width, int height)
     glViewport(0,0,width,height);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	glfwInit();
+	app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    GLFWwindow *window = glfwCreateWindow(800,700, "Basic imgui io", NULL, NULL);
+    GLFWwindow *window = app_create_window(800,700, "Basic imgui io", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to open a glfw window. Exiting...\n");
@@ -38,7 +40,7 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -170,7 +172,7 @@ int main()
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
@@ -179,7 +181,7 @@ int main()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    glfwTerminate();
+    app_terminate();
 
 	return 0;
 }
\ No newline at end of file
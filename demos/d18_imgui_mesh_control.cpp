@@ -12,6 +12,7 @@
 #include<cmath>
 
 #include"../include/shader.h"
+#include"../include/app.h"
 
 int win_width = 1000, win_height = 800;
 
@@ -39,19 +40,19 @@ void glfw_center_window(GLFWwindow *win)
     glfwSetWindowPos(win, centx, centy);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
     
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Mesh control via GUI", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Mesh control via GUI", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -61,7 +62,7 @@ int main()
     glfwSetKeyCallback(window, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -140,7 +141,7 @@ int main()
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-		glfwSwapBuffers(window);
+		app_swap_buffers(window);
 		glfwPollEvents();
 	}
 
@@ -151,7 +152,7 @@ int main()
 	glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(1, &vbo);
 
-	glfwTerminate();
+	app_terminate();
 
 	return 0;
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include<cmath>
 #include<vector>
 
+#include"../include/app.h"
+
 int win_width = 1000, win_height = 800;
 
 void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
@@ -25,20 +27,20 @@ void framebuffer_size_callback(GLFWwindow */*window*/, int width, int height)
     glViewport(0,0,width,height);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	glfwInit();
+	app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "GUI plots", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "GUI plots", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -47,7 +49,7 @@ int main()
     glfwSetKeyCallback(window, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -194,7 +196,7 @@ int main()
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
 
     }
@@ -204,7 +206,7 @@ int main()
     ImPlot::DestroyContext(); //Strictly BEFORE Imgui::DestroyContext();
     ImGui::DestroyContext();
 
-    glfwTerminate();
+    app_terminate();
 
 	return 0;
 }
\ No newline at end of file
@@ -3,27 +3,29 @@
 
 #include<cstdio>
 
-int main()
+#include"../include/app.h"
+
+int main(int argc, char **argv)
 {
-    glfwInit(); //Always the first glfw function. It initializes glfw.
+    app_init(argc, argv); //Always the first glfw function. It initializes glfw.
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4); //Version 4.x
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5); //Version x.5
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); //Core OpenGL.
 
     //Create window object (pointer to struct) at default position.
-    GLFWwindow *window = glfwCreateWindow(800, 500, "Black window", NULL, NULL);
+    GLFWwindow *window = app_create_window(800, 500, "Black window", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
     
     //Glew validation.
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...");
         return 0;
@@ -38,10 +40,10 @@ int main()
             //break; (play with it)
         }
         
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
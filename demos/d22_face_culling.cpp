@@ -8,10 +8,14 @@
 #include<glm/gtc/matrix_transform.hpp>
 #include<glm/gtc/type_ptr.hpp>
 #include<cstdio>
+#include<memory>
 
 #include"../include/shader.h"
 #include"../include/mesh.h"
 #include"../include/camera.h"
+#include"../include/app.h"
+#include"../include/gpu_timer.h"
+#include"../include/overdraw_counter.h"
 
 //Camera object instantiation. We make it global so that the glfw callback 'cursor_pos_callback()' (see later) can
 //have access to it. This is just for demo. At a bigger project, we would use glfwSetWindowUserPointer(...) to encapsulate
@@ -127,9 +131,9 @@ void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
     glViewport(0,0,w,h);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -137,11 +141,11 @@ int main()
 
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Face culling", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Face culling", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -157,7 +161,7 @@ int main()
     glfwGetWindowSize(window, &win_width, &win_height);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -182,17 +186,71 @@ int main()
     meshvfn sphere("../obj/vfn/uv_sphere_rad1_40x30.obj");
 
     shader shad("../shaders/vertex/trans_mvpn.vert","../shaders/fragment/dir_light_ads.frag");
-    shad.use(); //We only have 1 shader, so we activate it here once and for all.
+    shader overdraw_shad("../shaders/vertex/trans_mvpn.vert","../shaders/fragment/dir_light_ads.frag", {"OVERDRAW"}); //Also counts its fragments.
+    shader depth_shad("../shaders/vertex/trans_mvpn.vert","../shaders/fragment/nothing.frag", {"DEPTH_ONLY"}); //For the depth prepass.
+    overdraw_counter overdraw("../shaders/vertex/trans_nothing_texture.vert","../shaders/fragment/overdraw.frag");
 
     glm::vec3 mesh_col = glm::vec3(0.8f,0.0f,0.0f);
     glm::vec3 light_dir = glm::vec3(1.0f,1.0f,1.0f);
     glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
-    shad.set_vec3_uniform("mesh_col", mesh_col);
-    shad.set_vec3_uniform("light_dir", light_dir);
-    shad.set_vec3_uniform("light_col", light_col);
+    shader *lit_shaders[] = {&shad, &overdraw_shad};
+    for (shader *lit : lit_shaders)
+    {
+        lit->use();
+        lit->set_vec3_uniform("mesh_col", mesh_col);
+        lit->set_vec3_uniform("light_dir", light_dir);
+        lit->set_vec3_uniform("light_col", light_col);
+    }
 
     glm::mat4 projection, view, model;
 
+    //Draw the scene with 'program', from the full (position + normal) vertices or from the position-only streams.
+    auto draw_scene = [&](shader &program, bool positions_only)
+    {
+        model = glm::mat4(1.0f);
+        program.set_mat4_uniform("model", model);
+        if (positions_only)
+            sponza.draw_positions();
+        else
+            sponza.draw_triangles();
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f,0.0f,50.0f));
+        model = glm::scale(model, glm::vec3(5.0f,5.0f,5.0f));
+        program.set_mat4_uniform("model", model);
+        if (positions_only)
+            sphere.draw_positions();
+        else
+            sphere.draw_triangles();
+    };
+
+    //Depth prepass : First the depth of the whole scene, with no color and the cheapest fragment shader. Then the lit pass with
+    //glDepthFunc(GL_EQUAL), which only shades the nearest fragment of each pixel, however many surfaces overlap there. It pays off when the
+    //fragments are expensive and the overdraw is high, and costs the vertex work of a 2nd pass otherwise. 3 modes, to compare :
+    //0 : No prepass (the depth test only rejects what lies behind the surfaces drawn so far).
+    //1 : Prepass from the position-only streams (fewer vertices to fetch and transform, see meshvfn::draw_positions()).
+    //2 : Prepass from the full vertices.
+    const char *mode_names[] = {"No prepass", "Prepass (positions only)", "Prepass (full vertices)"};
+    const int mode_count = 3;
+    int prepass_mode = 1;
+    bool cycle_modes = false; //Switch mode every frame, so that all of them are measured over the same views.
+    bool show_overdraw = false;
+    int overdraw_max = 8;
+
+    gpu_timer prepass_timers[mode_count], color_timers[mode_count];
+    //Vertex and fragment shader invocations of the scene per mode, where the driver counts them (ARB_pipeline_statistics_query).
+    bool has_statistics = GLEW_ARB_pipeline_statistics_query;
+    std::unique_ptr<gpu_query> vertex_stats[mode_count], fragment_stats[mode_count];
+    if (has_statistics)
+    {
+        for (int m = 0; m < mode_count; m++)
+        {
+            vertex_stats[m] = std::make_unique<gpu_query>(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+            fragment_stats[m] = std::make_unique<gpu_query>(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+        }
+    }
+    int frame = 0;
+
     glEnable(GL_DEPTH_TEST);
     
     glEnable(GL_CULL_FACE); //Enable face culling.
@@ -230,25 +288,58 @@ int main()
         projection = glm::perspective(glm::radians(cam.fov), (float)win_width/win_height, 0.01f,500.0f);
         cam.move(time_tick);
         view = cam.view();
-        shad.set_mat4_uniform("projection", projection);
-        shad.set_vec3_uniform("cam_pos", cam.pos);
-        shad.set_mat4_uniform("view", view);
 
-        model = glm::mat4(1.0f);
-        shad.set_mat4_uniform("model", model);
-        sponza.draw_triangles();
+        int mode = cycle_modes ? frame%mode_count : prepass_mode;
+        ++frame;
+        if (show_overdraw)
+            overdraw.begin(win_width, win_height);
+        if (has_statistics)
+        {
+            vertex_stats[mode]->begin();
+            fragment_stats[mode]->begin();
+        }
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f,0.0f,50.0f));
-        model = glm::scale(model, glm::vec3(5.0f,5.0f,5.0f));
-        shad.set_mat4_uniform("model", model);
-        sphere.draw_triangles();
+        if (mode > 0)
+        {
+            prepass_timers[mode].begin();
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            depth_shad.use();
+            depth_shad.set_mat4_uniform("projection", projection);
+            depth_shad.set_mat4_uniform("view", view);
+            draw_scene(depth_shad, mode == 1);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_EQUAL); //Only the nearest fragment of each pixel passes (gl_Position is invariant in trans_mvpn.vert).
+            glDepthMask(GL_FALSE); //The depth is final already.
+            prepass_timers[mode].end();
+        }
+
+        color_timers[mode].begin();
+        shader &lit = show_overdraw ? overdraw_shad : shad;
+        lit.use();
+        lit.set_mat4_uniform("projection", projection);
+        lit.set_vec3_uniform("cam_pos", cam.pos);
+        lit.set_mat4_uniform("view", view);
+        draw_scene(lit, false);
+        color_timers[mode].end();
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+
+        if (has_statistics)
+        {
+            vertex_stats[mode]->end();
+            fragment_stats[mode]->end();
+        }
+        if (show_overdraw)
+        {
+            overdraw.end();
+            overdraw.show(overdraw_max);
+        }
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        ImGui::SetNextWindowSize(ImVec2(300.0f,200.0f), ImGuiCond_FirstUseEver); 
+        ImGui::SetNextWindowSize(ImVec2(500.0f,420.0f), ImGuiCond_FirstUseEver); 
         static bool closable = true;
 		ImGui::Begin("GUI", &closable);
         if (!closable)
@@ -256,13 +347,46 @@ int main()
         ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(0,0,120,255));
         ImGui::Checkbox("Face cull is enabled", &face_cull_is_enabled);
         ImGui::Checkbox("Front face is ccw", &front_face_is_ccw);
+        ImGui::Separator();
+        for (int m = 0; m < mode_count; m++)
+            ImGui::RadioButton(mode_names[m], &prepass_mode, m);
+        ImGui::Checkbox("Cycle the modes every frame", &cycle_modes);
+        ImGui::Checkbox("Show the overdraw (fragments shaded per pixel)", &show_overdraw);
+        if (show_overdraw)
+            ImGui::SliderInt("Red at", &overdraw_max, 2, 32);
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        ImGui::Text("Vertices : %d full (position + normal), %d positions only", sponza.get_vertex_count() + sphere.get_vertex_count(),
+                    sponza.get_position_count() + sphere.get_position_count());
+        for (int m = 0; m < mode_count; m++)
+        {
+            ImGui::Text("%s : %.3f [ms] (prepass %.3f + color pass %.3f)", mode_names[m], prepass_timers[m].average_ms() + color_timers[m].average_ms(),
+                        prepass_timers[m].average_ms(), color_timers[m].average_ms());
+            if (has_statistics)
+                ImGui::Text("   %.0f vertices and %.2f fragments per pixel shaded", vertex_stats[m]->average_value(),
+                            fragment_stats[m]->average_value()/((double)win_width*win_height));
+        }
+        if (!has_statistics)
+            ImGui::Text("No shader invocation counts (needs ARB_pipeline_statistics_query).");
+        if (ImGui::Button("Reset the measurements"))
+        {
+            for (int m = 0; m < mode_count; m++)
+            {
+                prepass_timers[m].reset();
+                color_timers[m].reset();
+                if (has_statistics)
+                {
+                    vertex_stats[m]->reset();
+                    fragment_stats[m]->reset();
+                }
+            }
+        }
         ImGui::PopStyleColor();
         ImGui::End();
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
@@ -270,6 +394,6 @@ int main()
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
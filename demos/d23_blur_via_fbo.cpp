@@ -1,3 +1,7 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
 #include<GL/glew.h>
 #include<GLFW/glfw3.h>
 #include<glm/glm.hpp>
@@ -6,59 +10,33 @@
 
 #include<cstdio>
 #include<cmath>
+#include<algorithm>
 
 #include"../include/shader.h"
 #include"../include/mesh.h"
+#include"../include/image_blur.h"
+#include"../include/gpu_timer.h"
+#include"../include/render_target_pool.h"
+#include"../include/app.h"
 
 int win_width = 1500, win_height = 900;
-unsigned int fbo, fbo_tex, rbo; //Framebuffer object, framebuffer object (attached) textured and renderbuffer object.
 
-void setup_framebuffer(int width, int height)
-{   
-    //If it exists, delete it first. This if statement will NOT run in the first fbo setup, coz the fbo will not exist,
-    //but WILL run every time the framebuffer is resized.
-    if (fbo != 0)
-    {
-        glDeleteFramebuffers(1, &fbo);
-        glDeleteTextures(1, &fbo_tex);
-        glDeleteRenderbuffers(1, &rbo);
-    }
+//The offscreen targets (the scene and the blur's intermediate images) come from a pool : They are created once per size and reused at
+//every frame. Storage is immutable, so a new size means new objects, which the pool creates on demand (and deletes once unused).
+render_target_pool pool;
 
-    //Generate a new framebuffer.
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    //Generate a new texture to store the rendered scene.
-    glGenTextures(1, &fbo_tex);
-    glBindTexture(GL_TEXTURE_2D, fbo_tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    //Attach the generated teture the framebuffer.
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo_tex, 0);
-
-    //Now generate the depth buffer. Remember, we have to do this manually, unlike the default depth buffer, which
-    //is generated either by glfw or the OpenGL kernel. A framebuffer is basically a container that holds multiple
-    //attachments (textures or renderbuffers) for storing the results of rendering operations. The framebuffer itself
-    //doesn’t directly store data. Instead, it holds references to other objects, like textures or renderbuffers, which
-    //are used to store color, depth, and stencil information. Framebuffers seem to work similarly with vaos and vbos.
-    //As I was saying..., You need a bunch of buffers to work. For the default framebuffer, everything is setup for you.
-    //However when you create a new framebuffer, you also have to setup the addtitional-for-rendering buffers (depth buffer in our case).
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
-    //Optional for both depth AND stencil buffer.
-    //glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-    //glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        printf("Framebuffer is not completed. Exiting...\n");
-        exit(EXIT_FAILURE);
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0); //Unbind the fbo.
+//A framebuffer is basically a container that holds multiple attachments (textures or renderbuffers) for storing the results of rendering
+//operations. The framebuffer itself doesn't directly store data. Instead, it holds references to other objects, like textures, which are
+//used to store color, depth, and stencil information. For the default framebuffer, everything is setup for you. However when you create
+//a new framebuffer, you also have to setup the additional-for-rendering buffers (depth buffer in our case).
+render_target_desc scene_target(int width, int height)
+{
+    render_target_desc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.color_format = GL_RGBA8; //The rendered scene.
+    desc.depth_format = GL_DEPTH_COMPONENT24;
+    return desc;
 }
 
 void key_callback(GLFWwindow *window, int key, int, int action, int)
@@ -72,7 +50,6 @@ void framebuffer_size_callback(GLFWwindow *, int w, int h)
     win_width = w;
     win_height = h;
     glViewport(0,0,w,h);
-    setup_framebuffer(win_width, win_height);
 }
 
 void glfw_center_window(GLFWwindow *win)
@@ -85,19 +62,19 @@ void glfw_center_window(GLFWwindow *win)
     glfwSetWindowPos(win, centx, centy);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Blurry scene", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Blurry scene", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -106,12 +83,27 @@ int main()
     glfwSetKeyCallback(window, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
     }
 
+    //Setup ImGui.
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(100.0f,100.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
+
     //Load the meshes with the corresponding textures.
     meshvft ground("../obj/vft/plane10x10.obj", "../images/texture/aerial_grass_rock_diff_4k.jpg");
     meshvft wooden_stool("../obj/vft/wooden_stool.obj", "../images/texture/wooden_stool_diff_2k.jpg");
@@ -119,11 +111,22 @@ int main()
     meshvft wooden_container("../obj/vft/cube1x1x1_correct_uv.obj", "../images/texture/wooden_container_diff_512x512.jpg");
     meshvft plant_pot("../obj/vft/plant_pot.obj", "../images/texture/potted_plant_pot_diff_2k.png");
     meshvft plant_leaves("../obj/vft/plant_leaves.obj", "../images/texture/potted_plant_leaves_diff_2k.png");
+    texture_uploader::instance().release(); //The textures are loaded.
     shader texshad("../shaders/vertex/trans_mvp_texture.vert","../shaders/fragment/texture.frag");
 
+    //The blur stage (its own fbos and shaders) and the shader that shows its result on a fullscreen quad.
     quadtex quad;
-    shader blurshad("../shaders/vertex/trans_nothing_texture.vert", "../shaders/fragment/blur.frag");
-    setup_framebuffer(win_width, win_height);
+    shader quadshad("../shaders/vertex/trans_nothing_texture.vert", "../shaders/fragment/texture.frag");
+    image_blur blur("../shaders/");
+    //While the window border is dragged, keep the old target size (stretched to the window) and only switch once the size settles.
+    resize_debouncer target_size(0.25);
+
+    //Gpu time of the 2 passes of every blur method, for every radius.
+    const int radii[] = { 2, 4, 8, 16, 32 };
+    const char *radius_names[] = { "2", "4", "8", "16", "32" };
+    const char *method_names[] = { "Gaussian (fragment)", "Dual Kawase", "Gaussian (compute)" };
+    const char *pass_names[][2] = { {"horizontal", "vertical"}, {"down", "up"}, {"horizontal", "vertical"} };
+    gpu_timer pass_timers[3][5][2];
 
     glm::mat4 projection, view, model;
 
@@ -134,11 +137,16 @@ int main()
     {
         /* First rendering pass : Render the entire 3D scene in the fbo, which we will never see it in the monitor. */
 
+        pool.begin_frame();
+        target_size.update(win_width, win_height, glfwGetTime());
+        int width = std::max(target_size.get_width(), 1), height = std::max(target_size.get_height(), 1); //Minimized windows are 0x0.
+
         texshad.use();
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo); //Bind the "hidden" framebuffer.
+        render_target &scene = pool.acquire(scene_target(width, height));
+        scene.bind(); //Bind the "hidden" framebuffer (and set the viewport to its size).
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Apply clearance commands (to the "hidden" framebuffer).
 
-        projection = glm::perspective(glm::radians(45.0f), (float)win_width/(float)win_height, 0.01f,100.0f);
+        projection = glm::perspective(glm::radians(45.0f), (float)width/(float)height, 0.01f,100.0f);
         view = glm::lookAt(glm::vec3(5.0f*(float)cos(0.1f*glfwGetTime()),5.0f*(float)sin(0.1f*glfwGetTime()),2.0f), glm::vec3(0.0f,0.0f,0.0f), glm::vec3(0.0f,0.0f,2.0f));
         texshad.set_mat4_uniform("projection", projection);
         texshad.set_mat4_uniform("view", view);
@@ -189,15 +197,74 @@ int main()
         yields global scene effects, which is the desired. Enough for a code comment...
         */
 
-        blurshad.use();
+        //Nowadays the blur takes a few passes of its own (see image_blur.h) : A separable Gaussian is 2 passes of n taps instead of 1 of n*n,
+        //and for large radii the image is shrunk first, so that fewer pixels are blurred by a smaller radius.
+        static int blur_method = image_blur::gaussian, radius_index = 2;
+        static bool blur_enabled = true;
+        render_target *shown = &scene;
+        if (blur_enabled)
+        {
+            shown = &blur.apply(pool, scene.color, width, height, radii[radius_index], (image_blur::method)blur_method, pass_timers[blur_method][radius_index]);
+            pool.release(scene);
+        }
+        for (int m = 0; m < 3; m++)
+            for (int r = 0; r < 5; r++)
+                for (int p = 0; p < 2; p++)
+                    pass_timers[m][r][p].poll();
+
+        quadshad.use();
         glBindFramebuffer(GL_FRAMEBUFFER, 0); //Bind to the default framebuffer (the one we will see in the monitor).
+        glViewport(0,0, win_width,win_height);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Apply clearance commands (to the displayed framebuffer).
-        quad.draw_triangles(fbo_tex); //Draw only the quad.
+        quad.draw_triangles(shown->color.get_id()); //Draw only the quad.
+        pool.release(*shown);
+
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(380.0f,360.0f), ImGuiCond_FirstUseEver);
+        static bool popen = true;
+        ImGui::Begin("Blur", &popen);
+        if (!popen)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::Checkbox("Enabled", &blur_enabled);
+        ImGui::Combo("method", &blur_method, method_names, IM_ARRAYSIZE(method_names));
+        ImGui::Combo("radius [px]", &radius_index, radius_names, IM_ARRAYSIZE(radius_names));
+        if (blur_method == image_blur::dual_kawase)
+            ImGui::Text("Levels : %d", image_blur::kawase_levels(radii[radius_index]));
+        else if (blur_method == image_blur::gaussian && radii[radius_index] > 8)
+            ImGui::Text("Half resolution");
+        ImGui::Separator();
+        ImGui::Text("Gpu time per pass [ms] (averages) :");
+        for (int m = 0; m < 3; m++)
+        {
+            ImGui::BulletText("%s", method_names[m]);
+            for (int r = 0; r < 5; r++)
+                if (pass_timers[m][r][0].sample_count() > 0)
+                    ImGui::Text("    r = %2d : %s %.3f, %s %.3f", radii[r], pass_names[m][0], pass_timers[m][r][0].average_ms(),
+                                                                   pass_names[m][1], pass_timers[m][r][1].average_ms());
+        }
+        ImGui::Separator();
+        ImGui::Text("Render targets : %d (%d created so far)", pool.target_count(), pool.allocation_count());
+        ImGui::Text("Allocated : %.1f MB (peak %.1f MB)", pool.allocated_bytes()/1048576.0, pool.peak_allocated_bytes()/1048576.0);
+        ImGui::Text("Chain : peak %.1f MB in use, %.1f MB requested", pool.frame_peak_bytes()/1048576.0, pool.frame_requested_bytes()/1048576.0);
+        ImGui::End();
 
-        glfwSwapBuffers(window);
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    //Delete the global gl objects while the context still exists.
+    pool.clear();
+
+    app_terminate();
     return 0;
 }
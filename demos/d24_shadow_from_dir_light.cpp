@@ -1,6 +1,7 @@
 #include"../imgui/imgui.h"
 #include"../imgui/imgui_impl_glfw.h"
 #include"../imgui/imgui_impl_opengl3.h"
+#include"../imgui/implot.h"
 
 #include<GL/glew.h>
 #include<GLFW/glfw3.h>
@@ -12,6 +13,12 @@
 #include"../include/shader.h"
 #include"../include/mesh.h"
 #include"../include/camera.h"
+#include"../include/cascaded_shadow_map.h"
+#include"../include/shadow_cache.h"
+#include"../include/gpu_timer.h"
+#include"../include/frame_capture.h"
+#include"../include/profiler.h"
+#include"../include/app.h"
 
 camera cam(glm::vec3(0.0f, -20.0f, 3.0f), glm::vec3(0.0f, 0.0f, 1.0f), 90.0f); //Set the camera.
 
@@ -23,41 +30,14 @@ bool cursor_visible = false;
 
 int win_width = 1200, win_height = 900;
 
-unsigned int fbo_depth, tex_depth; //IDs to hold the fbo and the depth texture (shadow map).
-
-//Resolution of the shadow map texture. The higher, the better the final render of the shadow, but also more memory consumption and poorer performance.
-//Think of it like a classical image creation. 1k, 2k, 4k, etc... The more pixels in the image, the higher its detail. The shadow map-tex (as we will see later),
-//is literally an image creation and each pixel of this image holds some 'special' info (not rgb colors, but depth), that we use. For real time lighting and shadow,
-//this image is recreated at each frame.
-const int shadow_tex_reso_x = 4096, shadow_tex_reso_y = 4096; //4k image resolution.
-
-void setup_fbo_depth()
-{
-    glGenFramebuffers(1, &fbo_depth); //Create fbo and assign ID.
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_depth); //This means that all subsequent fb operations affect the fbo_depth.
-    glGenTextures(1, &tex_depth); //Create tex and assign ID.
-    glBindTexture(GL_TEXTURE_2D, tex_depth); //This means that all subsequent tex operations affect the tex_depth.
-    //Actually create the depth texture with the specified resolution. Stored as floats and initialized as NULL because no data is provided yet.
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, shadow_tex_reso_x, shadow_tex_reso_y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    //The following ensures that when texture coordinates go outside [0,1] range, the border_col is used as depth-color.
-    float border_col[] = {1.0f, 1.0f, 1.0f, 1.0f}; //Pure white that is, coz white color corresponds to maximum depth (remember ex21_depth_buffer.cpp).
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);  
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_col);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, tex_depth, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        printf("Hidden framebuffer not complete!\n");
-
-    //Since shadow mapping only requires depth information and needs no colors, the following commnads make sure that
-    //OpenGL avoids any (unnecessary) color buffer operations.
-    glDrawBuffer(GL_NONE); //Don't draw to any color buffer, because we only care about the depth buffer.
-    glReadBuffer(GL_NONE); //Don't attempt to read from any color buffer, because there isn't one in use.
-    
-    glBindTexture(GL_TEXTURE_2D, 0); //Unbind the tex_depth.
-    glBindFramebuffer(GL_FRAMEBUFFER, 0); //Unbind the fbo_depth, and switch to the default fbo, i.e. the displayed in the monitor.
-}
+//The shadow map. Instead of 1 image over a fixed box around the scene, the camera frustum is split in depth ranges (cascades) and each one
+//gets its own image, fitted around it. Near the camera the shadow is sharp, far away it is coarse, like everything else on the screen.
+//4 cascades of 1024^2 take 16 MB, a quarter of a single 4096^2 map, and still resolve finer details near the camera.
+//The resolution of a shadow map works like the one of any image : More pixels, more detail, but also more memory and more pixels to
+//fill at every frame. Each pixel of the shadow map holds a depth (as seen from the light), not a color.
+const int shadow_cascades = 4, shadow_tex_reso = 1024;
+cascaded_shadow_map shadow_map;
+cascaded_shadow_map shadow_map_dynamic; //Same cascades, but only the casters that move (see the shadow caching in main()).
 
 //For 'continuous' events, i.e. at every frame (tick) in the while() loop.
 void event_tick(GLFWwindow *win)
@@ -162,10 +142,10 @@ void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
     glViewport(0,0,w,h);
 }
 
-int main()
+int main(int argc, char **argv)
 {
     //Setup glfw.
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -173,11 +153,11 @@ int main()
 
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Real time shadow", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Real time shadow", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -193,7 +173,7 @@ int main()
     glfwGetWindowSize(window, &win_width, &win_height);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -202,6 +182,7 @@ int main()
     //Setup gui stuff. 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
+    ImPlot::CreateContext(); //For the profiler's plots.
     ImGuiIO &io = ImGui::GetIO();
     io.IniFilename = NULL; //Fucking .ini file!
     io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
@@ -227,140 +208,205 @@ int main()
     
     //Shaders : 1 for the scene as perceived by the directional light and 1 for the scene as perceived by the camera. The first shader is gonna
     //be used to calculate a special info only (depth). The second shader is gonna use that info to compute all the fragment colors (ambient, diffuse, etc... AND shadows).
-    shader shad_depth("../shaders/vertex/trans_dir_light_mvp.vert","../shaders/fragment/nothing.frag");
-    shader shad_dir_light_with_shadow("../shaders/vertex/trans_mvpn_shadow.vert","../shaders/fragment/dir_light_ad_shadow.frag");
+    //The depth shader renders all cascades at once : Its geometry stage sends every triangle to every layer of the shadow map.
+    std::string cascades_define = "SHADOW_CASCADES " + std::to_string(shadow_cascades);
+    shader shad_depth("../shaders/vertex/trans_m.vert","../shaders/fragment/nothing.frag", {cascades_define}, "../shaders/geometry/shadow_cascades.geom");
+    //The second one comes in several variants (permutations) of the same source, built by injecting #defines : Ambient term on/off times the
+    //number of shadow map taps. The variants are ordered in quality tiers, so that a cheaper one can be picked when the frame takes too long.
+    shader_permutations shad_dir_light_with_shadow_variants("../shaders/vertex/trans_mvpn_shadow.vert","../shaders/fragment/dir_light_shadow.frag");
+    shad_dir_light_with_shadow_variants.add_axis({ {}, {"LIGHT_AMBIENT"} });
+    shad_dir_light_with_shadow_variants.add_axis({ {"POISSON_SAMPLES 16"}, {"POISSON_SAMPLES 8"}, {"POISSON_SAMPLES 4"}, {"POISSON_SAMPLES 1"} });
+    shad_dir_light_with_shadow_variants.add_axis({ {cascades_define, "SHADOW_DYNAMIC"} }); //Always on (1 choice, so it adds no permutations).
+    shad_dir_light_with_shadow_variants.set_tiers({ shad_dir_light_with_shadow_variants.key({1,0,0}),
+                                                    shad_dir_light_with_shadow_variants.key({1,1,0}),
+                                                    shad_dir_light_with_shadow_variants.key({1,2,0}),
+                                                    shad_dir_light_with_shadow_variants.key({1,3,0}),
+                                                    shad_dir_light_with_shadow_variants.key({0,3,0}) });
+    const char *shadow_tier_names[] = { "16 taps", "8 taps", "4 taps", "1 tap", "1 tap, no ambient" };
+    shad_dir_light_with_shadow_variants.compile_all(); //Compile the tiers now, so that switching tiers later causes no hitch.
 
     //This shader is only used to render the geometry model of the directional light in our scene.
     meshvf arrows("../obj/vf/dir_light_arrows.obj");
     shader shad_arrows("../shaders/vertex/trans_mvp.vert","../shaders/fragment/monochromatic.frag");
 
-    setup_fbo_depth();
+    shadow_map = cascaded_shadow_map(shadow_cascades, shadow_tex_reso);
+    shadow_map_dynamic = cascaded_shadow_map(shadow_cascades, shadow_tex_reso);
+
+    //The casters that never move. Their shadows go to 'shadow_map', which is cached. Dimorphos orbits, so it can go to 'shadow_map_dynamic' instead.
+    const int static_casters = 8;
+    meshvfn *static_meshes[static_casters] = { &didymain, &ryugu, &gerasimenko, &room, &cube, &sphere, &stool, &suzanne };
+    glm::mat4 static_models[static_casters] = { glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,12.0f,3.0f)),
+                                                glm::translate(glm::mat4(1.0f), glm::vec3(-13.0f,2.0f,2.0f)),
+                                                glm::translate(glm::mat4(1.0f), glm::vec3(6.0f,10.0f,3.0f)),
+                                                glm::mat4(1.0f),
+                                                glm::translate(glm::mat4(1.0f), glm::vec3(-12.0f,12.0f,2.0f)),
+                                                glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f,13.0f,2.0f)),
+                                                glm::translate(glm::mat4(1.0f), glm::vec3(13.0f,13.0f,0.54f)),
+                                                glm::translate(glm::mat4(1.0f), glm::vec3(13.0f,4.0f,2.0f)) };
+    shadow_cache static_cache;
+    gpu_timer static_timer; //Gpu time of the static casters' depth pass.
+    gpu_timer tier_timers[5]; //Gpu time of the lit pass, per shadow quality tier.
+    bool dynamic_map_used = true; //Whether the dynamic casters' map holds anything (it has to be cleared once).
+
+    //Records the frames (without the gui) as an image sequence, e.g. of a light sweep. Toggled in the gui, or on from the start with
+    //--capture <path prefix> (e.g. together with --headless).
+    frame_capture recorder;
+    if (app_option("--capture") != NULL)
+        recorder.start(app_option("--capture"));
 
     //Constant mesh and light colors. We pass them to the shader from now to avoid doing it in the while loop...
     glm::vec3 mesh_col = glm::vec3(0.2f,0.7f,1.0f);
     glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
-    shad_dir_light_with_shadow.use();
-    shad_dir_light_with_shadow.set_vec3_uniform("mesh_col", mesh_col);
-    shad_dir_light_with_shadow.set_vec3_uniform("light_col", light_col);
-
-    glm::mat4 dir_light_projection, dir_light_view, dir_light_pv; //Directional light's matrices.
+    for (int t = 0; t < shad_dir_light_with_shadow_variants.tier_count(); ++t)
+    {
+        shader &variant = shad_dir_light_with_shadow_variants.get(shad_dir_light_with_shadow_variants.tier_key(t));
+        variant.use();
+        variant.set_vec3_uniform("mesh_col", mesh_col);
+        variant.set_vec3_uniform("light_col", light_col);
+    }
 
     glm::mat4 projection, view, model; //Camera's matrices. The 'model' matrix is common.
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glClearColor(0.15f,0.3f,0.6f,1.0f);
+    //Where the frame time goes (shadow maps, lit pass, gui, swap...), on the cpu and the gpu.
+    profiler &prof = profiler::instance();
+    bool show_profiler = false;
+
+    //Gui state.
+    bool popen = true;
+    bool auto_shadow_quality = false; //Drop (or raise) the shadow quality tier to keep the frame time within 'frame_budget_ms'.
+    float frame_budget_ms = 16.6f;
+    bool cycle_shadow_tiers = false;
+    float shadow_dist = 60.0f, split_lambda = 0.75f, caster_margin = 50.0f; //Cascades.
+    bool show_cascades = false;
+    bool cache_shadows = true, split_dynamic = true, animate_dimorphos = true;
+    float dir_light_dist = 40.0f, dir_light_lon = 80.0f, dir_light_lat = 50.0f; //Light's (dummy) position.
+    bool sweep_light = false;
+    int capture_format = frame_capture::png;
+    bool capture_sync = false;
+
     float t0 = 0.0f, tnow;
     while (!glfwWindowShouldClose(window))
     {   
+        prof.begin_frame();
         tnow = (float)glfwGetTime(); //Elapsed time [sec] since glfwInit().
         time_tick = tnow - t0;
         t0 = tnow;
         event_tick(window);
 
+        //Drop (or raise) the shadow quality, based on the frame time.
+        if (auto_shadow_quality)
+            shad_dir_light_with_shadow_variants.update_tier(1000.0f*time_tick, frame_budget_ms);
+        //Or visit every tier in turn, to fill the table of their costs.
+        if (cycle_shadow_tiers)
+            shad_dir_light_with_shadow_variants.set_tier((int)tnow%shad_dir_light_with_shadow_variants.tier_count());
+        shader &shad_dir_light_with_shadow = shad_dir_light_with_shadow_variants.active();
+
         /* Directional light definition in the code. */        
 
         //We want to simulate the shadow effects produced by a hypothetical infinitely far (directional) light. Since the light rays are considered to
-        //be parallel, we define and map the shadows into a fixed size orthographic projection frustum. You can imagine it as cuboid (of fixed size),
-        //geometrically defined with respect to the light's view space. As the light's direction changes over time (due to lookAt() using the light_dir),
-        //the whole frustum rotates along with the light, always 'looking at' any target you set in lookAt() (2nd argument).
-        static float ortho_dx = 40.0f, ortho_dy = 40.0f, ortho_znear = 0.1f, ortho_zfar = 150.0f;
-        static float dir_light_dist = 40.0f, dir_light_lon = 80.0f, dir_light_lat = 50.0f;
+        //be parallel, every cascade maps its shadows with an orthographic projection : A cuboid, aligned with the light's direction, around the
+        //cascade's part of the camera frustum. As the light's direction or the camera changes, the cuboids follow (see cascaded_shadow_map::update()).
+        //Shadows are only computed up to 'shadow_dist' from the camera.
+        if (sweep_light)
+            dir_light_lon = fmod(dir_light_lon + 20.0f*time_tick, 360.0f); //20 [deg/sec] around the scene.
         glm::vec3 light_dir = dir_light_dist*glm::vec3(cos(glm::radians(dir_light_lon))*sin(glm::radians(dir_light_lat)),
                                                        sin(glm::radians(dir_light_lon))*sin(glm::radians(dir_light_lat)),
                                                        cos(glm::radians(dir_light_lat)));
         glm::vec3 norm_light_dir = glm::normalize(light_dir);
-        float dir_light_up_x = 0.0f, dir_light_up_y = 0.0f, dir_light_up_z = 1.0f;
-        if (glm::abs(norm_light_dir.z) > 0.999f)
-        {
-            dir_light_up_y = 1.0f;
-            dir_light_up_z = 0.0f;
-        }
-
-        dir_light_projection = glm::ortho(-ortho_dx,ortho_dx, -ortho_dy,ortho_dy, ortho_znear,ortho_zfar);
-        dir_light_view = glm::lookAt(light_dir, glm::vec3(0.0f), glm::vec3(dir_light_up_x, dir_light_up_y, dir_light_up_z));
-        dir_light_pv = dir_light_projection*dir_light_view; //Directional light's projection*view (total) matrix.
 
         //Camera's updated parameters.
         projection = glm::perspective(glm::radians(cam.fov), (float)win_width/win_height, 0.05f,500.0f);
         view = cam.view(); cam.move(time_tick);
 
-        //Bind the fbo_depth to render the shadow map.
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo_depth);
-        glViewport(0,0, shadow_tex_reso_x,shadow_tex_reso_y);
-        glClear(GL_DEPTH_BUFFER_BIT); //Clear only depth, coz we write only depth in this buffer. There's no color attachment.
-        shad_depth.use();
-        shad_depth.set_mat4_uniform("dir_light_pv", dir_light_pv);
-        //Now transform the models and render to the fbo_depth.
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,12.0f,3.0f));
-            shad_depth.set_mat4_uniform("model", model);
-            didymain.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(1.5f*sin(tnow),11.0f,3.0f));
-            shad_depth.set_mat4_uniform("model", model);
-            dimorphos.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-13.0f,2.0f,2.0f));
-            shad_depth.set_mat4_uniform("model", model);
-            ryugu.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(6.0f,10.0f,3.0f));
-            shad_depth.set_mat4_uniform("model", model);
-            gerasimenko.draw_triangles();
-        model = glm::mat4(1.0f);
-            shad_depth.set_mat4_uniform("model", model);
-            room.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-12.0f,12.0f,2.0f));
-            shad_depth.set_mat4_uniform("model", model);
-            cube.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f,13.0f,2.0f));
-            shad_depth.set_mat4_uniform("model", model);
-            sphere.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(13.0f,13.0f,0.54f));
-            shad_depth.set_mat4_uniform("model", model);
-            stool.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(13.0f,4.0f,2.0f));
-            shad_depth.set_mat4_uniform("model", model);
-            suzanne.draw_triangles();
+        //Fit the cascades to the camera's frustum.
+        shadow_map.set_split_lambda(split_lambda);
+        shadow_map.set_caster_margin(caster_margin);
+        shadow_map.update(view, cam.fov, (float)win_width/win_height, 0.05f, shadow_dist, light_dir);
+
+        //The dynamic casters' map uses the very same cascades, so that the shader can look both maps up with the same coordinates.
+        shadow_map_dynamic.copy_cascades(shadow_map);
+
+        //Render the shadow maps (all the cascades at once). The static casters' map is only rendered again when something it depends on changed :
+        //The cascades (i.e. the light and the camera) and the casters' transforms. Otherwise last frame's depth is still right and is reused.
+        glm::mat4 dimorphos_model = glm::translate(glm::mat4(1.0f), glm::vec3(1.5f*sin(animate_dimorphos ? tnow : 0.0f),11.0f,3.0f));
+        prof.begin_scope("shadow maps", true);
+        static_cache.begin();
+        for (int i = 0; i < shadow_map.get_cascade_count(); i++)
+            static_cache.add(shadow_map.get_matrix(i));
+        for (int i = 0; i < static_casters; i++)
+            static_cache.add(static_models[i]);
+        if (!split_dynamic)
+            static_cache.add(dimorphos_model); //Dimorphos goes to the static map too, so it's part of its state.
+        if (!cache_shadows)
+            static_cache.invalidate();
+        if (static_cache.dirty())
+        {
+            PROFILE_GPU_SCOPE("static casters");
+            static_timer.begin();
+            shadow_map.render_begin(); //Binds its fbo, sets the viewport and clears the depth. There's no color attachment.
+            shadow_map.set_uniforms(shad_depth);
+            for (int i = 0; i < static_casters; i++)
+            {
+                shad_depth.set_mat4_uniform("model", static_models[i]);
+                static_meshes[i]->draw_triangles();
+            }
+            if (!split_dynamic)
+            {
+                shad_depth.set_mat4_uniform("model", dimorphos_model);
+                dimorphos.draw_triangles();
+            }
+            static_timer.end();
+        }
+        static_timer.poll();
+
+        //The dynamic casters' map is cheap (1 mesh) and rendered every frame. Without the split it stays cleared (maximum depth, no shadow).
+        if (split_dynamic || dynamic_map_used)
+        {
+            PROFILE_GPU_SCOPE("dynamic casters");
+            shadow_map_dynamic.render_begin();
+            if (split_dynamic)
+            {
+                shadow_map_dynamic.set_uniforms(shad_depth);
+                shad_depth.set_mat4_uniform("model", dimorphos_model);
+                dimorphos.draw_triangles();
+            }
+            dynamic_map_used = split_dynamic;
+        }
+        prof.end_scope();
 
         //Bind the default fbo to render the scene to the window.
+        prof.begin_scope("lit pass", true);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0,0, win_width, win_height);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Now we have both depth and color (unlike to the fbo_depth).
-        shad_dir_light_with_shadow.use();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //Now we have both depth and color (unlike to the shadow map's fbo).
+        shadow_map.bind(0); //Bind the shadow map to texture unit 0.
+        shadow_map.bind_noise(2); //The Poisson disk rotations to unit 2.
+        shadow_map.set_uniforms(shad_dir_light_with_shadow, 0, 2); //Cascade matrices and splits, and the samplers to use texture units 0 and 2.
+        shadow_map_dynamic.bind(1); //The dynamic casters' map to unit 1. The shader takes the nearest depth of the 2.
+        shad_dir_light_with_shadow.set_int_uniform("sample_shadow_dynamic", 1);
         shad_dir_light_with_shadow.set_mat4_uniform("projection", projection);
         shad_dir_light_with_shadow.set_mat4_uniform("view", view);
         shad_dir_light_with_shadow.set_vec3_uniform("light_dir", light_dir);
-        shad_dir_light_with_shadow.set_mat4_uniform("dir_light_pv", dir_light_pv);
-        glActiveTexture(GL_TEXTURE0); //Activate texture unit 0.
-        glBindTexture(GL_TEXTURE_2D, tex_depth); //Bind tex_depth to texture unit 0.
-        shad_dir_light_with_shadow.set_int_uniform("sample_shadow", 0); //Set sampler to use texture unit 0. This is handled automatically by OpenGL in case only 1 texture unit is used.
-        //Now transform the models and render to the monitor.
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,12.0f,3.0f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            didymain.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(1.5f*sin(tnow),11.0f,3.0f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            dimorphos.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-13.0f,2.0f,2.0f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            ryugu.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(6.0f,10.0f,3.0f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            gerasimenko.draw_triangles();
-        model = glm::mat4(1.0f);
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            room.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-12.0f,12.0f,2.0f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            cube.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f,13.0f,2.0f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            sphere.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(13.0f,13.0f,0.54f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            stool.draw_triangles();
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(13.0f,4.0f,2.0f));
-            shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-            suzanne.draw_triangles();
-        glBindTexture(GL_TEXTURE_2D, 0); //Unbind the tex_depth.
+        shad_dir_light_with_shadow.set_int_uniform("show_cascades", show_cascades);
+        //Now transform the models and render to the monitor. The lit pass is timed per tier, to compare the cost of the shadow taps.
+        gpu_timer &tier_timer = tier_timers[shad_dir_light_with_shadow_variants.get_tier()];
+        tier_timer.begin();
+        for (int i = 0; i < static_casters; i++)
+        {
+            shad_dir_light_with_shadow.set_mat4_uniform("model", static_models[i]);
+            static_meshes[i]->draw_triangles();
+        }
+        shad_dir_light_with_shadow.set_mat4_uniform("model", dimorphos_model);
+        dimorphos.draw_triangles();
+        tier_timer.end();
+        for (int i = 0; i < 5; i++)
+            tier_timers[i].poll();
+        glBindTextureUnit(0, 0); //Unbind the shadow maps and the noise.
+        glBindTextureUnit(1, 0);
+        glBindTextureUnit(2, 0);
 
         model = glm::translate(glm::mat4(1.0f), light_dir);
         //Check if the normalized light direction is almost aligned with the z-axis (north or south pole case).
@@ -376,13 +422,14 @@ int main()
         shad_arrows.set_mat4_uniform("view", view);
         shad_arrows.set_mat4_uniform("model", model);
         arrows.draw_triangles();
+        prof.end_scope();
 
+        prof.begin_scope("gui");
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
         ImGui::SetNextWindowSize(ImVec2(300.0f, 600.0f), ImGuiCond_FirstUseEver);
-        static bool popen = true;
         ImGui::Begin("Controls", &popen); //Imgui window with title and a close button.
         if (!popen)
             glfwSetWindowShouldClose(window, true);
@@ -393,11 +440,24 @@ int main()
 
         ImGui::Dummy(ImVec2(0.0f, 20.0f));
 
-        ImGui::BulletText("Light's orthographic frustum size");
-        ImGui::SliderFloat("dx##ortho_dx", &ortho_dx, 1.0f, 100.0f);
-        ImGui::SliderFloat("dy##ortho_dy", &ortho_dy, 1.0f, 100.0f);
-        ImGui::SliderFloat("z-near##ortho_znear", &ortho_znear, 0.01f, 1.0f);
-        ImGui::SliderFloat("z-far##ortho_zfar", &ortho_zfar, 5.0f, 200.0f);
+        ImGui::BulletText("Shadow cascades");
+        ImGui::SliderFloat("distance##shadow_dist", &shadow_dist, 5.0f, 200.0f);
+        ImGui::SliderFloat("log/uniform##split_lambda", &split_lambda, 0.0f, 1.0f);
+        ImGui::SliderFloat("caster margin##caster_margin", &caster_margin, 0.0f, 100.0f);
+        ImGui::Checkbox("Show cascades", &show_cascades);
+        for (int i = 0; i < shadow_map.get_cascade_count(); i++)
+            ImGui::Text("%d : up to %.1f, texel %.1f [mm]", i, shadow_map.get_split(i), 1000.0f*shadow_map.get_texel_size(i));
+        ImGui::Text("Memory : %.0f MB", (shadow_map.memory_bytes() + shadow_map_dynamic.memory_bytes())/1048576.0);
+
+        ImGui::Dummy(ImVec2(0.0f, 20.0f));
+
+        ImGui::BulletText("Shadow caching");
+        ImGui::Checkbox("Cache static shadows", &cache_shadows);
+        ImGui::Checkbox("Split dynamic casters", &split_dynamic);
+        ImGui::Checkbox("Animate dimorphos", &animate_dimorphos);
+        ImGui::Text("Static passes : %d rendered, %d skipped", static_cache.rendered_count(), static_cache.skipped_count());
+        ImGui::Text("Static pass : %.3f [ms] (gpu)", static_timer.average_ms());
+        ImGui::Text("Saved so far : %.1f [ms] (gpu)", static_cache.skipped_count()*static_timer.average_ms());
 
         ImGui::Dummy(ImVec2(0.0f, 20.0f));
 
@@ -405,20 +465,92 @@ int main()
         ImGui::SliderFloat("dist##dir_light_dist", &dir_light_dist, 10.0f, 100.0f);
         ImGui::SliderFloat("lon [deg]##dir_light_lon", &dir_light_lon, 0.0f, 360.0f);
         ImGui::SliderFloat("lat [deg]##dir_light_lat", &dir_light_lat, 0.0f, 180.0f);
+        ImGui::Checkbox("Sweep (lon)", &sweep_light);
+
+        ImGui::Dummy(ImVec2(0.0f, 20.0f));
+
+        ImGui::BulletText("Shadow quality");
+        int shadow_tier = shad_dir_light_with_shadow_variants.get_tier();
+        if (ImGui::Combo("tier##shadow_tier", &shadow_tier, shadow_tier_names, IM_ARRAYSIZE(shadow_tier_names)))
+            shad_dir_light_with_shadow_variants.set_tier(shadow_tier);
+        ImGui::Checkbox("Auto (frame budget)", &auto_shadow_quality);
+        if (ImGui::Checkbox("Cycle tiers (1 sec each)", &cycle_shadow_tiers))
+            auto_shadow_quality = false;
+        for (int i = 0; i < 5; i++)
+            ImGui::Text("%-18s : %.3f [ms] (gpu, lit pass)", shadow_tier_names[i], tier_timers[i].average_ms());
+        ImGui::SliderFloat("budget [ms]##frame_budget_ms", &frame_budget_ms, 4.0f, 50.0f);
+        ImGui::Text("Frame : %.2f [ms] (FPS : %.0f)", 1000.0f*time_tick, ImGui::GetIO().Framerate);
+        ImGui::Checkbox("Profiler", &show_profiler);
+        bool tracing = trace_recorder::instance().is_enabled();
+        if (ImGui::Checkbox("Record trace", &tracing))
+        {
+            trace_recorder::instance().set_thread_name("main");
+            trace_recorder::instance().set_enabled(tracing);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Write d24_trace.json"))
+            trace_recorder::instance().write("d24_trace.json"); //Open it in chrome://tracing or ui.perfetto.dev.
+        if (trace_recorder::instance().written_count() > 0)
+            ImGui::Text("Trace : %d events written", trace_recorder::instance().written_count());
+
+        ImGui::Dummy(ImVec2(0.0f, 20.0f));
+
+        ImGui::BulletText("Capture");
+        bool recording = recorder.is_recording();
+        if (ImGui::Checkbox("Record to ../capture/d24_*", &recording))
+        {
+            if (recording)
+                recorder.start("../capture/d24_", (frame_capture::format)capture_format);
+            else
+                recorder.stop();
+        }
+        ImGui::Combo("format##capture_format", &capture_format, "png\0raw rgba\0");
+        if (ImGui::Checkbox("Synchronous readback (to compare)", &capture_sync))
+            recorder.set_synchronous(capture_sync);
+        ImGui::Text("Frames : %d captured, %d written", recorder.captured_count(), recorder.written_count());
+        ImGui::Text("Dropped : %d (gpu busy), %d (encoders behind)", recorder.dropped_gpu_count(), recorder.dropped_encoder_count());
+        ImGui::Text("Capture : %.3f [ms] (cpu, average %.3f)", recorder.last_ms(), recorder.average_ms());
+        ImGui::Text("Memory : %.0f MB", recorder.memory_bytes()/1048576.0);
 
         ImGui::End();
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-       
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (show_profiler)
+            prof.draw_overlay(&show_profiler);
+        prof.end_scope();
+
+        //Capture the scene before the gui is drawn over it.
+        int fb_width, fb_height;
+        glfwGetFramebufferSize(window, &fb_width, &fb_height);
+        {
+            PROFILE_SCOPE("capture");
+            recorder.capture(fb_width, fb_height);
+        }
+
+        {
+            PROFILE_GPU_SCOPE("gui render");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+
+        {
+            PROFILE_SCOPE("swap + events");
+            app_swap_buffers(window);
+            glfwPollEvents();
+        }
     }
 
+    recorder.stop(); //The frames in flight need the context.
+    prof.release();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
+    ImPlot::DestroyContext();
     ImGui::DestroyContext();
 
-    glfwTerminate();
+    //Delete the global gl objects while the context still exists.
+    shadow_map = cascaded_shadow_map();
+    shadow_map_dynamic = cascaded_shadow_map();
+
+    app_terminate();
     return 0;
 }
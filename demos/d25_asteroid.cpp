@@ -12,37 +12,21 @@
 
 #include"../include/shader.h"
 #include"../include/mesh.h"
+#include"../include/shader_watcher.h"
+#include"../include/cascaded_shadow_map.h"
+#include"../include/evsm_filter.h"
+#include"../include/gpu_timer.h"
+#include"../include/app.h"
 
 const float PI = glm::pi<float>();
 
 int win_width = 1920, win_height = 1080;
 
-const int shadow_tex_reso_x = 4096, shadow_tex_reso_y = 4096; //Shadow image resolution.
-
-unsigned int fbo_depth, tex_depth; //IDs to hold the depth fbo and the depth texture (shadow map).
-
-void setup_fbo_depth()
-{
-    glGenFramebuffers(1, &fbo_depth);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_depth);
-    glGenTextures(1, &tex_depth);
-    glBindTexture(GL_TEXTURE_2D, tex_depth);
-    //Shadow mapping is highly sensitive to depth precision, hence the 32 bits.
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, shadow_tex_reso_x, shadow_tex_reso_y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL); //NULL because no texture data is provided yet.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    float border_col[] = {1.0f, 1.0f, 1.0f, 1.0f}; //Pure white that is, coz white color corresponds to maximum depth.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);  
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_col);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, tex_depth, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        fprintf(stderr, "Depth framebuffer is not completed!\n");
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
+//Cascaded shadow map : The visible depth range of the asteroid is split in 3 parts, each with its own 2048^2 map fitted around it (48 MB,
+//instead of 64 MB for the single 4096^2 map over a fixed box). The resolution can be changed at runtime, to compare the filtering paths.
+const int shadow_cascades = 3;
+int shadow_tex_reso = 2048;
+cascaded_shadow_map shadow_map;
 
 void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
 {
@@ -59,20 +43,20 @@ void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
     glViewport(0,0,w,h);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
     glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Asteroid rendering", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Asteroid rendering", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -81,17 +65,29 @@ int main()
     //glfwGetWindowSize(window, &win_width, &win_height);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
     }
 
     meshvfn asteroid("../obj/vfn/asteroids/gerasimenko256k.obj");
-    shader shad_depth("../shaders/vertex/trans_dir_light_mvp.vert","../shaders/fragment/nothing.frag");
-    shader shad_dir_light_with_shadow("../shaders/vertex/trans_mvpn_shadow.vert","../shaders/fragment/dir_light_d_shadow.frag");
-
-    setup_fbo_depth();
+    std::string cascades_define = "SHADOW_CASCADES " + std::to_string(shadow_cascades);
+    shader shad_depth("../shaders/vertex/trans_m.vert","../shaders/fragment/nothing.frag", {cascades_define}, "../shaders/geometry/shadow_cascades.geom");
+    shader shad_dir_light_with_shadow("../shaders/vertex/trans_mvpn_shadow.vert","../shaders/fragment/dir_light_d_shadow.frag", {cascades_define});
+    //Same lighting, but the soft shadow comes prefiltered (EVSM) : 1 fetch per fragment instead of 16 depth comparisons.
+    shader shad_dir_light_with_evsm("../shaders/vertex/trans_mvpn_shadow.vert","../shaders/fragment/dir_light_d_shadow.frag", {cascades_define, "SHADOW_EVSM"});
+
+    //Recompile the shaders in the background whenever their files are saved, so that shading can be tuned without re-loading the mesh.
+    shader_watcher watcher;
+    watcher.add(shad_depth);
+    watcher.add(shad_dir_light_with_shadow);
+    watcher.add(shad_dir_light_with_evsm);
+
+    shadow_map = cascaded_shadow_map(shadow_cascades, shadow_tex_reso);
+    evsm_filter evsm("../shaders/compute/evsm.comp");
+    evsm.allocate(shadow_map);
+    gpu_timer shadow_timer, lit_timer; //Gpu time of the shadow pass (depth + EVSM filtering) and of the lit pass.
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -112,36 +108,30 @@ int main()
     shad_dir_light_with_shadow.use();
     shad_dir_light_with_shadow.set_vec3_uniform("mesh_col", mesh_col);
     shad_dir_light_with_shadow.set_vec3_uniform("light_col", light_col);
+    shad_dir_light_with_evsm.use();
+    shad_dir_light_with_evsm.set_vec3_uniform("mesh_col", mesh_col);
+    shad_dir_light_with_evsm.set_vec3_uniform("light_col", light_col);
 
-    float fc = 1.1f, fl = 1.2; //Scale factors : fc is for the ortho cube size and fl for the directional light dummy distance.
+    float fc = 1.1f, fl = 1.2; //Scale factors : fc is for the shadowed sphere around the asteroid and fl for the directional light dummy distance.
     float rmax = asteroid.get_farthest_vertex_distance(); //[km]
     float dir_light_dist = fl*rmax; //[km]
     float fov = 45.0f; //[deg]
     float t = 0.0f, dt = 1.0f; //[sec]
 
-    glm::mat4 dir_light_projection = glm::ortho(-fc*rmax,fc*rmax, -fc*rmax,fc*rmax, (fl-fc)*rmax, 2.0f*fc*rmax); //Precomputed.
-
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glClearColor(0.0f,0.0f,0.0f,1.0f);
 
     while (!glfwWindowShouldClose(window))
     {
+        watcher.update(); //Swap in any shader that finished recompiling.
+
         //Essential calculation needed for rendering :
 
         static float dir_light_lon = 0.0f, dir_light_lat = 90.0f;
         glm::vec3 light_dir = dir_light_dist*glm::vec3(cos(glm::radians(dir_light_lon))*sin(glm::radians(dir_light_lat)),
                                                        sin(glm::radians(dir_light_lon))*sin(glm::radians(dir_light_lat)),
                                                        cos(glm::radians(dir_light_lat)));
-        float dir_light_up_x = 0.0f, dir_light_up_y = 0.0f, dir_light_up_z = 1.0f;
-        if (glm::abs(glm::normalize(light_dir).z) > 0.999f)
-        {
-            dir_light_up_y = 1.0f;
-            dir_light_up_z = 0.0f;
-        }
-        glm::mat4 dir_light_view = glm::lookAt(light_dir, glm::vec3(0.0f), glm::vec3(dir_light_up_x, dir_light_up_y, dir_light_up_z));
-        glm::mat4 dir_light_pv = dir_light_projection*dir_light_view; //Directional light's projection*view (total) matrix.
-
         glm::mat4 projection = glm::infinitePerspective(glm::radians(fov), (float)win_width/win_height, 0.05f);
         static float cam_dist = 5.0f*rmax, cam_lon = 270.0f, cam_lat = 90.0f;
         glm::vec3 cam_pos = cam_dist*glm::vec3(cos(glm::radians(cam_lon))*sin(glm::radians(cam_lat)),
@@ -155,17 +145,25 @@ int main()
 
         glm::mat4 model = glm::rotate(glm::mat4(1.0f), 0.1f*(float)glfwGetTime(), glm::vec3(0.0f,0.0f,1.0f));
 
+        //The asteroid is all there is : No cascade has to be larger than its bounding sphere, and every caster is within its diameter.
+        shadow_map.set_scene_bounds(glm::vec3(0.0f), fc*rmax);
+        shadow_map.set_caster_margin(2.0f*fc*rmax);
+        //Fit the cascades to the part of the view that the asteroid can occupy.
+        shadow_map.update(view, fov, (float)win_width/win_height, glm::max(0.05f, cam_dist - fc*rmax), cam_dist + fc*rmax, light_dir);
+
         //Now we render :
 
-        //1) Render to the depth framebuffer (used later for shadowing).
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo_depth);
-        glViewport(0,0, shadow_tex_reso_x,shadow_tex_reso_y);
+        //1) Render to the depth framebuffer (used later for shadowing). With EVSM, turn the depth to blurred and mipmapped moments.
+        static int shadow_filter = 0; //0 : pcf, 1 : evsm.
         glDisable(GL_FRAMEBUFFER_SRGB);
-        glClear(GL_DEPTH_BUFFER_BIT); //Only depth values exist in this framebuffer.
-        shad_depth.use();
-        shad_depth.set_mat4_uniform("dir_light_pv", dir_light_pv);
+        shadow_timer.begin();
+        shadow_map.render_begin(); //Only depth values exist in this framebuffer.
+        shadow_map.set_uniforms(shad_depth);
         shad_depth.set_mat4_uniform("model", model);
         asteroid.draw_triangles();
+        if (shadow_filter == 1)
+            evsm.filter(shadow_map);
+        shadow_timer.end();
 
         //2) Render to the default framebuffer (monitor).
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -174,17 +172,24 @@ int main()
         if (apply_gamma_correction)
             glEnable(GL_FRAMEBUFFER_SRGB);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shad_dir_light_with_shadow.use();
-        shad_dir_light_with_shadow.set_mat4_uniform("projection", projection);
-        shad_dir_light_with_shadow.set_mat4_uniform("view", view);
-        shad_dir_light_with_shadow.set_mat4_uniform("model", model);
-        shad_dir_light_with_shadow.set_mat4_uniform("dir_light_pv", dir_light_pv);
-        shad_dir_light_with_shadow.set_vec3_uniform("light_dir", light_dir);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tex_depth);
-        shad_dir_light_with_shadow.set_int_uniform("sample_shadow", 0);
+        shader &shad_lit = (shadow_filter == 1) ? shad_dir_light_with_evsm : shad_dir_light_with_shadow;
+        shadow_map.set_uniforms(shad_lit, 0, 1);
+        shad_lit.set_mat4_uniform("projection", projection);
+        shad_lit.set_mat4_uniform("view", view);
+        shad_lit.set_mat4_uniform("model", model);
+        shad_lit.set_vec3_uniform("light_dir", light_dir);
+        if (shadow_filter == 1)
+            evsm.bind(0);
+        else
+            shadow_map.bind(0);
+        shadow_map.bind_noise(1);
+        lit_timer.begin();
         asteroid.draw_triangles();   
-        glBindTexture(GL_TEXTURE_2D, 0);
+        lit_timer.end();
+        glBindTextureUnit(0, 0);
+        glBindTextureUnit(1, 0);
+        shadow_timer.poll();
+        lit_timer.poll();
 
         t += dt; //[sec]
 
@@ -206,16 +211,49 @@ int main()
         ImGui::SliderFloat("dist [km]##cam_dist", &cam_dist, 2.0f*rmax, 50.0f*rmax); //The camera distance ranges from 2 to 50 times the distance of the farthest vertex of the mesh.
         ImGui::SliderFloat("lon [deg]##cam_lon", &cam_lon, 0.0f, 360.0f);
         ImGui::SliderFloat("lat [deg]##cam_lat", &cam_lat, 0.0f, 180.0f);
+        ImGui::BulletText("Shadow filtering");
+        const char *shadow_filter_names[] = { "PCF (16 taps)", "EVSM (prefiltered)" };
+        const char *shadow_reso_names[] = { "1024", "2048", "4096" };
+        static int shadow_reso_index = 1;
+        bool shadow_changed = ImGui::Combo("filter##shadow_filter", &shadow_filter, shadow_filter_names, IM_ARRAYSIZE(shadow_filter_names));
+        if (ImGui::Combo("map size##shadow_reso", &shadow_reso_index, shadow_reso_names, IM_ARRAYSIZE(shadow_reso_names)))
+        {
+            shadow_tex_reso = 1024 << shadow_reso_index;
+            shadow_map = cascaded_shadow_map(shadow_cascades, shadow_tex_reso);
+            evsm.allocate(shadow_map);
+            shadow_changed = true;
+        }
+        int blur_radius = evsm.get_blur_radius();
+        if (ImGui::SliderInt("EVSM blur [texels]##blur_radius", &blur_radius, 0, 8))
+        {
+            evsm.set_blur_radius(blur_radius);
+            shadow_changed = true;
+        }
+        if (shadow_changed)
+        {
+            shadow_timer.reset();
+            lit_timer.reset();
+        }
+        ImGui::Text("Shadow pass : %.3f [ms] (gpu)", shadow_timer.average_ms());
+        ImGui::Text("Lit pass : %.3f [ms] (gpu)", lit_timer.average_ms());
+        long long shadow_bytes = shadow_map.memory_bytes() + ((shadow_filter == 1) ? evsm.memory_bytes() : 0);
+        ImGui::Text("Memory : %.0f MB", shadow_bytes/1048576.0);
         ImGui::BulletText("Gamma correction");
         ImGui::Checkbox("Apply", &apply_gamma_correction);
         ImGui::BulletText("Performance");
         ImGui::Text("FPS : [%.0f] ",ImGui::GetIO().Framerate);
+        ImGui::BulletText("Shader hot-reload");
+        ImGui::Text("Reloads : %d, failed : %d", watcher.reload_count(), watcher.failure_count());
+        if (!watcher.get_last_changed().empty())
+            ImGui::Text("Last change : %s", watcher.get_last_changed().c_str());
+        if (!watcher.get_last_error().empty())
+            ImGui::TextColored(ImVec4(1.0f,0.3f,0.3f,1.0f), "%s", watcher.get_last_error().c_str());
         ImGui::End();
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
        
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
@@ -223,6 +261,8 @@ int main()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    glfwTerminate();
+    shadow_map = cascaded_shadow_map();
+
+    app_terminate();
     return 0;
 }
@@ -18,6 +18,10 @@
 #include"../include/shader.h"
 #include"../include/mesh.h"
 #include"../include/camera.h"
+#include"../include/shader_watcher.h"
+#include"../include/frame_capture.h"
+#include"../include/profiler.h"
+#include"../include/app.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -676,7 +680,7 @@ void common_plot(const char *plot_label, const char *yaxis_label, bool &bool_plo
     ImGui::End();
 }
 
-int main()
+int main(int argc, char **argv)
 {
     //Set physical parameters and initial conditions.
     G = 6.67430e-20;
@@ -715,7 +719,7 @@ int main()
     dvec2 ener0_mom0 = ener_mom(state);
 
     //Setup glfw.
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -723,11 +727,11 @@ int main()
 
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
 
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "65803 Didymos dynamics", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "65803 Didymos dynamics", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -743,7 +747,7 @@ int main()
     glfwGetWindowSize(window, &win_width, &win_height);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -786,6 +790,16 @@ int main()
     shader shad("../shaders/vertex/trans_mvpn.vert","../shaders/fragment/dir_light_ad.frag");
     shad.use();
 
+    //Recompile the shader in the background whenever its files are saved, so that the shading can be tuned during a long run.
+    shader_watcher watcher;
+    watcher.add(shad);
+
+    //Records the frames (without the gui) as an image sequence, e.g. of a long run. Toggled in the gui, or on from the start with
+    //--capture <path prefix> (e.g. together with --headless).
+    frame_capture recorder;
+    if (app_option("--capture") != NULL)
+        recorder.start(app_option("--capture"));
+
     glm::vec3 light_dir = glm::vec3(0.0f,-1.0f,0.5f);
     glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
     glm::vec3 aster_col = glm::vec3(0.5f,0.5f,0.5f);
@@ -801,12 +815,18 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.1f,0.1f,0.1f,1.0f);
 
+    //Where the frame time goes (physics, scene, gui, swap...), on the cpu and the gpu.
+    profiler &prof = profiler::instance();
+    bool show_profiler = false;
+
     double t0 = 0.0, tfps = 0.0, ms_per_frame = 1000.0;
     double tnow;
     int frame = 0, frames_per_sec;
     while (!glfwWindowShouldClose(window))
     {
+        prof.begin_frame();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        watcher.update(); //Swap in the shader if it finished recompiling.
 
         tnow = glfwGetTime(); //Elapsed time [sec] since glfwInit().
         time_tick = tnow - t0;
@@ -828,6 +848,7 @@ int main()
         cam.move(time_tick);
         view = cam.view();
 
+        prof.begin_scope("scene", true);
         shad.set_mat4_uniform("projection", projection);
         shad.set_mat4_uniform("view", view);
 
@@ -881,8 +902,9 @@ int main()
         shad.set_mat4_uniform("model", model);
         shad.set_vec3_uniform("mesh_col", aster_col);
         ref_ground.draw_triangles();
+        prof.end_scope();
 
-
+        prof.begin_scope("gui + plot data");
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -929,6 +951,26 @@ int main()
             ImGui::Dummy(ImVec2(0.0f, 10.0f));
             ImGui::BulletText("FPS : %.0f (imgui)", ImGui::GetIO().Framerate);
             ImGui::BulletText("FPS : %d (custom)", frames_per_sec);
+            ImGui::Checkbox("Profiler", &show_profiler);
+            bool tracing = trace_recorder::instance().is_enabled();
+            if (ImGui::Checkbox("Record trace", &tracing))
+            {
+                trace_recorder::instance().set_thread_name("main");
+                trace_recorder::instance().set_enabled(tracing);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Write d26_trace.json"))
+                trace_recorder::instance().write("d26_trace.json"); //Open it in chrome://tracing or ui.perfetto.dev.
+            if (trace_recorder::instance().written_count() > 0)
+                ImGui::Text("Trace : %d events written", trace_recorder::instance().written_count());
+            ImGui_ImplOpenGL3_StreamStats ui_stream = ImGui_ImplOpenGL3_GetStreamStats();
+            ImGui::BulletText("GUI submit : %.2f [ms] (fence wait : %.2f [ms], stalls : %d)", ui_stream.SubmitMs, ui_stream.FenceWaitMs, ui_stream.FenceStalls);
+            ImGui::BulletText("GUI stream : %.1f / %.1f [KB] %s", ui_stream.BytesUsed/1024.0f, ui_stream.BytesPerFrame/1024.0f, ui_stream.UsesRingBuffer ? "(ring buffer)" : "(glBufferData)");
+            ImGui::BulletText("Shader reloads : %d (failed : %d)", watcher.reload_count(), watcher.failure_count());
+            if (!watcher.get_last_changed().empty())
+                ImGui::Text("Last change : %s", watcher.get_last_changed().c_str());
+            if (!watcher.get_last_error().empty())
+                ImGui::TextColored(ImVec4(1.0f,0.3f,0.3f,1.0f), "%s", watcher.get_last_error().c_str());
         }
         if (ImGui::CollapsingHeader("Camera"))
         {
@@ -955,6 +997,26 @@ int main()
             ImGui::Checkbox("Pitch 2", &show_pitch2);
             ImGui::Checkbox("Yaw 2", &show_yaw2);
         }
+        if (ImGui::CollapsingHeader("Capture"))
+        {
+            static int capture_format = frame_capture::png;
+            static bool capture_sync = false;
+            bool recording = recorder.is_recording();
+            if (ImGui::Checkbox("Record to ../capture/d26_*", &recording))
+            {
+                if (recording)
+                    recorder.start("../capture/d26_", (frame_capture::format)capture_format);
+                else
+                    recorder.stop();
+            }
+            ImGui::Combo("format", &capture_format, "png\0raw rgba\0");
+            if (ImGui::Checkbox("Synchronous readback (to compare)", &capture_sync))
+                recorder.set_synchronous(capture_sync);
+            ImGui::BulletText("Frames : %d captured, %d written", recorder.captured_count(), recorder.written_count());
+            ImGui::BulletText("Dropped : %d (gpu busy), %d (encoders behind)", recorder.dropped_gpu_count(), recorder.dropped_encoder_count());
+            ImGui::BulletText("Capture : %.3f [ms] (cpu, average %.3f)", recorder.last_ms(), recorder.average_ms());
+            ImGui::BulletText("Memory : %.0f [MB]", recorder.memory_bytes()/1048576.0);
+        }
         ImGui::End();
 
         dvec2 energy_momentum = ener_mom(state); //Calculate energy and momentum for the current state.
@@ -1013,21 +1075,45 @@ int main()
         if (show_yaw2)
             common_plot("Yaw 2",  "Yaw 2 [deg]", show_yaw2, yaw2_data, time_data, simulated_duration);
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if (show_profiler)
+            prof.draw_overlay(&show_profiler);
+        prof.end_scope();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        //Capture the scene before the gui is drawn over it.
+        int fb_width, fb_height;
+        glfwGetFramebufferSize(window, &fb_width, &fb_height);
+        {
+            PROFILE_SCOPE("capture");
+            recorder.capture(fb_width, fb_height);
+        }
 
-        rk4_do_step(state);
+        {
+            PROFILE_GPU_SCOPE("gui render");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+
+        {
+            PROFILE_SCOPE("swap + events");
+            app_swap_buffers(window);
+            glfwPollEvents();
+        }
+
+        {
+            PROFILE_SCOPE("rk4_do_step");
+            rk4_do_step(state);
+        }
         simulated_duration += dt/86400.0;
     }
 
+    recorder.stop(); //The frames in flight need the context.
+    prof.release();
+
     ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
     ImPlot::DestroyContext();
 	ImGui::DestroyContext();
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
\ No newline at end of file
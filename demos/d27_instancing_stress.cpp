@@ -0,0 +1,196 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+
+#include<cstdio>
+#include<cmath>
+#include<vector>
+#include<chrono>
+
+#include"../include/shader.h"
+#include"../include/mesh.h"
+#include"../include/app.h"
+
+//Stress test : Up to 100k spheres, drawn either with 1 draw call (instancing, transforms read from a shader storage buffer) or with 1 draw call
+//per sphere (the classical path : set the model uniform, draw, repeat). The cpu time spent submitting the draw calls is measured for both.
+
+int win_width = 1600, win_height = 900;
+
+const int grid_x = 50, grid_y = 50, grid_z = 40; //50*50*40 = 100k spheres.
+const int max_instances = grid_x*grid_y*grid_z;
+
+void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
+void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
+{
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+    win_width = w;
+    win_height = h;
+    glViewport(0,0,w,h);
+}
+
+int main(int argc, char **argv)
+{
+    app_init(argc, argv);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Instancing stress test", NULL, NULL);
+    if (window == NULL)
+    {
+        printf("Failed to create glfw window. Exiting...\n");
+        app_terminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0); //No vsync, otherwise the frame time hides the submission cost.
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    glewExperimental = GL_TRUE;
+    if (app_glew_init() != GLEW_OK)
+    {
+        printf("Failed to initialize glew. Exiting...\n");
+        return 0;
+    }
+
+    meshvfn sphere("../obj/vfn/uv_sphere_rad1_20x20.obj");
+    shader shad_per_object("../shaders/vertex/trans_mvpn.vert", "../shaders/fragment/dir_light.frag", {"LIGHT_AMBIENT"});
+    shader shad_instanced("../shaders/vertex/trans_mvpn_instanced.vert", "../shaders/fragment/dir_light.frag", {"LIGHT_AMBIENT", "INSTANCE_COLOR"});
+
+    //Lay the spheres on a 3D grid, centered at the origin, and color them by their position.
+    std::vector<mesh_instance> instances;
+    instances.reserve(max_instances);
+    const float spacing = 3.0f;
+    for (int k = 0; k < grid_z; k++)
+        for (int j = 0; j < grid_y; j++)
+            for (int i = 0; i < grid_x; i++)
+            {
+                glm::vec3 pos = spacing*glm::vec3(i - 0.5f*(grid_x - 1), j - 0.5f*(grid_y - 1), k - 0.5f*(grid_z - 1));
+                glm::vec3 col = glm::vec3(0.3f + 0.7f*i/(grid_x - 1), 0.3f + 0.7f*j/(grid_y - 1), 0.3f + 0.7f*k/(grid_z - 1));
+                instances.push_back(make_instance(glm::translate(glm::mat4(1.0f), pos), col));
+            }
+    //The transforms never change, so they are uploaded once, to immutable gpu storage.
+    gl_buffer instance_buffer(instances.size()*sizeof(mesh_instance), instances.data());
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(200.0f,200.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
+
+    glm::vec3 light_dir = glm::vec3(1.0f,-1.0f,2.0f);
+    glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
+    shad_per_object.use();
+    shad_per_object.set_vec3_uniform("light_dir", light_dir);
+    shad_per_object.set_vec3_uniform("light_col", light_col);
+    shad_instanced.use();
+    shad_instanced.set_vec3_uniform("light_dir", light_dir);
+    shad_instanced.set_vec3_uniform("light_col", light_col);
+
+    int instanced = 1; //1 : instanced, 0 : 1 draw call per sphere.
+    int instance_count = max_instances;
+    float submit_ms[2] = {0.0f, 0.0f}; //Smoothed cpu submission time of the per-object [0] and the instanced [1] path.
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glClearColor(0.05f,0.05f,0.05f,1.0f);
+
+    while (!glfwWindowShouldClose(window))
+    {
+        static float cam_dist = 250.0f, cam_lon = 30.0f, cam_lat = 60.0f;
+        static bool rotate = true;
+        if (rotate)
+            cam_lon = fmod(cam_lon + 10.0f*io.DeltaTime, 360.0f);
+        glm::vec3 cam_pos = cam_dist*glm::vec3(cos(glm::radians(cam_lon))*sin(glm::radians(cam_lat)),
+                                               sin(glm::radians(cam_lon))*sin(glm::radians(cam_lat)),
+                                               cos(glm::radians(cam_lat)));
+        glm::mat4 projection = glm::infinitePerspective(glm::radians(45.0f), (float)win_width/win_height, 0.1f);
+        glm::mat4 view = glm::lookAt(cam_pos, glm::vec3(0.0f), glm::vec3(0.0f,0.0f,1.0f));
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        //Only the cpu side is timed : Issuing the commands, not executing them (the gpu works asynchronously).
+        auto t0 = std::chrono::steady_clock::now();
+        if (instanced)
+        {
+            shad_instanced.use();
+            shad_instanced.set_mat4_uniform("projection", projection);
+            shad_instanced.set_mat4_uniform("view", view);
+            sphere.draw_instanced(instance_count, instance_buffer);
+        }
+        else
+        {
+            shad_per_object.use();
+            shad_per_object.set_mat4_uniform("projection", projection);
+            shad_per_object.set_mat4_uniform("view", view);
+            for (int i = 0; i < instance_count; i++)
+            {
+                glm::vec3 mesh_col = glm::vec3(instances[i].col);
+                shad_per_object.set_mat4_uniform("model", instances[i].model);
+                shad_per_object.set_vec3_uniform("mesh_col", mesh_col);
+                sphere.draw_triangles();
+            }
+        }
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        float &smoothed = submit_ms[instanced];
+        smoothed = (smoothed == 0.0f) ? ms : 0.95f*smoothed + 0.05f*ms;
+
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(350.0f, 300.0f), ImGuiCond_FirstUseEver);
+        static bool popen = true;
+        ImGui::Begin("Instancing", &popen);
+        if (!popen)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::BulletText("Draw path");
+        ImGui::RadioButton("Instanced (1 draw call)", &instanced, 1);
+        ImGui::RadioButton("1 draw call per sphere", &instanced, 0);
+        ImGui::SliderInt("Spheres", &instance_count, 1, max_instances);
+        ImGui::BulletText("Camera");
+        ImGui::SliderFloat("dist", &cam_dist, 10.0f, 500.0f);
+        ImGui::SliderFloat("lat [deg]", &cam_lat, 1.0f, 179.0f);
+        ImGui::Checkbox("Rotate", &rotate);
+        ImGui::BulletText("Performance");
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        ImGui::Text("Submission (cpu) : %.3f [ms]", smoothed);
+        ImGui::Text("Last measured : instanced %.3f [ms], per sphere %.3f [ms]", submit_ms[1], submit_ms[0]);
+        ImGui::Text("Triangles : %.1f M", (float)instance_count*sphere.get_triangle_count()/1.0e6f);
+        ImGui::End();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
+        glfwPollEvents();
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    app_terminate();
+    return 0;
+}
@@ -0,0 +1,270 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+
+#include<cstdio>
+#include<cmath>
+#include<vector>
+#include<random>
+#include<algorithm>
+#include<chrono>
+
+#include"../include/shader.h"
+#include"../include/mesh.h"
+#include"../include/render_queue.h"
+#include"../include/app.h"
+
+//Benchmark of the render queue : A few thousand objects (5 different meshes, 2 shading programs), submitted in random order every frame.
+//The immediate path draws them in that order, 1 draw call (and a program switch, when needed) per object. The queued path sorts them
+//by state and depth and issues a handful of glMultiDrawElementsIndirect() calls. Compare the draws submitted with the OpenGL calls issued.
+
+int win_width = 1600, win_height = 900;
+
+const int max_objects = 8000;
+
+void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
+void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
+{
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+    win_width = w;
+    win_height = h;
+    glViewport(0,0,w,h);
+}
+
+//1 object of the scene.
+struct object
+{
+    int mesh; //Index in the mesh arrays below.
+    int program; //0 : diffuse, 1 : diffuse + specular.
+    glm::mat4 model;
+    glm::vec3 col;
+};
+
+int main(int argc, char **argv)
+{
+    app_init(argc, argv);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Render queue", NULL, NULL);
+    if (window == NULL)
+    {
+        printf("Failed to create glfw window. Exiting...\n");
+        app_terminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0); //No vsync, otherwise the frame time hides the submission cost.
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    glewExperimental = GL_TRUE;
+    if (app_glew_init() != GLEW_OK)
+    {
+        printf("Failed to initialize glew. Exiting...\n");
+        return 0;
+    }
+
+    //The standalone meshes are drawn by the immediate path. The queue draws the same meshes out of 1 pool.
+    const char *mesh_files[] = {"../obj/vfn/uv_sphere_rad1_20x20.obj", "../obj/vfn/cube2x2x2.obj", "../obj/vfn/suzanne.obj",
+                                "../obj/vfn/cylinder_rad1_h01.obj", "../obj/vfn/stool.obj"};
+    const int mesh_count = sizeof(mesh_files)/sizeof(mesh_files[0]);
+    std::vector<meshvfn> meshes;
+    meshes.reserve(mesh_count);
+    mesh_pool pool;
+    std::vector<int> pool_ids;
+    std::vector<float> mesh_scale; //To bring every mesh to a radius of about 1.
+    for (int i = 0; i < mesh_count; i++)
+    {
+        meshes.emplace_back(mesh_files[i]);
+        pool_ids.push_back(pool.add(meshes[i]));
+        mesh_scale.push_back(1.0f/meshes[i].get_farthest_vertex_distance());
+    }
+    pool.build();
+
+    shader shad_immediate[2] = {shader("../shaders/vertex/trans_mvpn.vert", "../shaders/fragment/dir_light.frag", {"LIGHT_AMBIENT"}),
+                                shader("../shaders/vertex/trans_mvpn.vert", "../shaders/fragment/dir_light.frag", {"LIGHT_AMBIENT", "LIGHT_SPECULAR"})};
+    shader shad_queued[2] = {shader("../shaders/vertex/trans_mvpn_indirect.vert", "../shaders/fragment/dir_light.frag", {"LIGHT_AMBIENT", "INSTANCE_COLOR"}),
+                             shader("../shaders/vertex/trans_mvpn_indirect.vert", "../shaders/fragment/dir_light.frag", {"LIGHT_AMBIENT", "LIGHT_SPECULAR", "INSTANCE_COLOR"})};
+
+    //Scatter the objects randomly in a box. Their order is random too, i.e. the worst case for the immediate path.
+    std::vector<object> objects(max_objects);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unif(0.0f, 1.0f);
+    for (object &obj : objects)
+    {
+        obj.mesh = (int)(unif(rng)*mesh_count)%mesh_count;
+        obj.program = (unif(rng) < 0.5f) ? 0 : 1;
+        glm::vec3 pos = glm::vec3(unif(rng) - 0.5f, unif(rng) - 0.5f, unif(rng) - 0.5f)*glm::vec3(120.0f, 120.0f, 60.0f);
+        glm::vec3 axis = glm::normalize(glm::vec3(unif(rng) - 0.5f, unif(rng) - 0.5f, unif(rng) - 0.5f) + glm::vec3(0.0f,0.0f,1e-3f));
+        obj.model = glm::translate(glm::mat4(1.0f), pos);
+        obj.model = glm::rotate(obj.model, 6.2832f*unif(rng), axis);
+        obj.model = glm::scale(obj.model, glm::vec3((0.6f + 0.8f*unif(rng))*mesh_scale[obj.mesh]));
+        obj.col = glm::vec3(0.3f + 0.7f*unif(rng), 0.3f + 0.7f*unif(rng), 0.3f + 0.7f*unif(rng));
+    }
+
+    render_queue queue;
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(200.0f,200.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
+
+    glm::vec3 light_dir = glm::vec3(1.0f,-1.0f,2.0f);
+    glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
+    for (int p = 0; p < 2; p++)
+    {
+        shad_immediate[p].use();
+        shad_immediate[p].set_vec3_uniform("light_dir", light_dir);
+        shad_immediate[p].set_vec3_uniform("light_col", light_col);
+        shad_queued[p].use();
+        shad_queued[p].set_vec3_uniform("light_dir", light_dir);
+        shad_queued[p].set_vec3_uniform("light_col", light_col);
+    }
+
+    int queued = 1; //1 : render queue, 0 : immediate.
+    int object_count = 4000;
+    float submit_ms[2] = {0.0f, 0.0f}; //Smoothed cpu time of the immediate [0] and the queued [1] path.
+    int immediate_calls = 0; //OpenGL calls of the last immediate frame.
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glClearColor(0.05f,0.05f,0.05f,1.0f);
+
+    while (!glfwWindowShouldClose(window))
+    {
+        static float cam_dist = 150.0f, cam_lon = 30.0f, cam_lat = 60.0f;
+        static bool rotate = true;
+        if (rotate)
+            cam_lon = fmod(cam_lon + 10.0f*io.DeltaTime, 360.0f);
+        glm::vec3 cam_pos = cam_dist*glm::vec3(cos(glm::radians(cam_lon))*sin(glm::radians(cam_lat)),
+                                               sin(glm::radians(cam_lon))*sin(glm::radians(cam_lat)),
+                                               cos(glm::radians(cam_lat)));
+        glm::mat4 projection = glm::infinitePerspective(glm::radians(45.0f), (float)win_width/win_height, 0.1f);
+        glm::mat4 view = glm::lookAt(cam_pos, glm::vec3(0.0f), glm::vec3(0.0f,0.0f,1.0f));
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        //Only the cpu side is timed (sorting, streaming and issuing the commands, not executing them).
+        auto t0 = std::chrono::steady_clock::now();
+        if (queued)
+        {
+            for (int p = 0; p < 2; p++)
+            {
+                shad_queued[p].use();
+                shad_queued[p].set_mat4_uniform("projection", projection);
+                shad_queued[p].set_mat4_uniform("view", view);
+                shad_queued[p].set_vec3_uniform("cam_pos", cam_pos);
+            }
+            for (int i = 0; i < object_count; i++)
+            {
+                const object &obj = objects[i];
+                queue.submit(pool.get(pool_ids[obj.mesh]), material{&shad_queued[obj.program], 0, obj.col}, obj.model);
+            }
+            queue.flush(cam_pos);
+        }
+        else
+        {
+            for (int p = 0; p < 2; p++)
+            {
+                shad_immediate[p].use();
+                shad_immediate[p].set_mat4_uniform("projection", projection);
+                shad_immediate[p].set_mat4_uniform("view", view);
+                shad_immediate[p].set_vec3_uniform("cam_pos", cam_pos);
+            }
+            immediate_calls = 0;
+            int current = -1;
+            for (int i = 0; i < object_count; i++)
+            {
+                object &obj = objects[i];
+                shader &shad = shad_immediate[obj.program];
+                if (obj.program != current)
+                {
+                    shad.use();
+                    current = obj.program;
+                    ++immediate_calls;
+                }
+                shad.set_mat4_uniform("model", obj.model);
+                shad.set_vec3_uniform("mesh_col", obj.col);
+                meshes[obj.mesh].draw_triangles(); //Binds the vao, draws, unbinds.
+                immediate_calls += 5;
+            }
+        }
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        float &smoothed = submit_ms[queued];
+        smoothed = (smoothed == 0.0f) ? ms : 0.95f*smoothed + 0.05f*ms;
+
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(380.0f, 380.0f), ImGuiCond_FirstUseEver);
+        static bool popen = true;
+        ImGui::Begin("Render queue", &popen);
+        if (!popen)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::BulletText("Draw path");
+        ImGui::RadioButton("Render queue (sorted, multi-draw indirect)", &queued, 1);
+        ImGui::RadioButton("Immediate (submission order)", &queued, 0);
+        ImGui::SliderInt("Objects", &object_count, 1, max_objects);
+        ImGui::BulletText("Camera");
+        ImGui::SliderFloat("dist", &cam_dist, 10.0f, 400.0f);
+        ImGui::SliderFloat("lat [deg]", &cam_lat, 1.0f, 179.0f);
+        ImGui::Checkbox("Rotate", &rotate);
+        ImGui::BulletText("Statistics");
+        if (queued)
+        {
+            const render_queue::statistics &stats = queue.get_statistics();
+            ImGui::Text("Draws submitted : %d", stats.items);
+            ImGui::Text("Batches : %d, indirect commands : %d", stats.batches, stats.commands);
+            ImGui::Text("OpenGL calls : %d (%d state changes)", stats.gl_calls, stats.state_changes);
+            ImGui::Text("Draw parameters : %s", queue.uses_draw_parameters() ? "yes (1 multi-draw per batch)" : "no (1 draw per command)");
+            ImGui::Text("Stream : %.0f KB per frame (grew %d times)", queue.get_stream().frame_capacity()/1024.0, queue.get_stream().grow_count());
+        }
+        else
+        {
+            ImGui::Text("Draws submitted : %d", object_count);
+            ImGui::Text("OpenGL calls : %d", immediate_calls);
+        }
+        ImGui::BulletText("Performance");
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        ImGui::Text("Submission (cpu) : %.3f [ms]", smoothed);
+        ImGui::Text("Last measured : queued %.3f [ms], immediate %.3f [ms]", submit_ms[1], submit_ms[0]);
+        ImGui::End();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
+        glfwPollEvents();
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    app_terminate();
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+
+#include<cstdio>
+#include<cmath>
+#include<vector>
+#include<random>
+#include<chrono>
+
+#include"../include/shader.h"
+#include"../include/mesh.h"
+#include"../include/render_queue.h"
+#include"../include/gpu_culling.h"
+#include"../include/app.h"
+
+//Frustum culling of 200k objects. On the gpu, a compute shader tests the bounding spheres and writes the indirect draw commands and the list of
+//visible objects, so the cpu cost does not depend on the object count. On the cpu, the same test runs over every object and the results are
+//uploaded every frame. Either way, the visible objects are drawn with 1 multi-draw.
+
+int win_width = 1600, win_height = 900;
+
+const int object_count = 200000;
+
+void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
+void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
+{
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+    win_width = w;
+    win_height = h;
+    glViewport(0,0,w,h);
+}
+
+int main(int argc, char **argv)
+{
+    app_init(argc, argv);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Gpu culling", NULL, NULL);
+    if (window == NULL)
+    {
+        printf("Failed to create glfw window. Exiting...\n");
+        app_terminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0); //No vsync, otherwise the frame time hides the submission cost.
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    glewExperimental = GL_TRUE;
+    if (app_glew_init() != GLEW_OK)
+    {
+        printf("Failed to initialize glew. Exiting...\n");
+        return 0;
+    }
+
+    //1 pool for all meshes, so that the culled draws of every mesh go to a single multi-draw.
+    const char *mesh_files[] = {"../obj/vfn/uv_sphere_rad1_20x20.obj", "../obj/vfn/cube2x2x2.obj", "../obj/vfn/suzanne.obj",
+                                "../obj/vfn/cylinder_rad1_h01.obj", "../obj/vfn/stool.obj"};
+    const int mesh_count = sizeof(mesh_files)/sizeof(mesh_files[0]);
+    mesh_pool pool;
+    std::vector<float> mesh_radius;
+    {
+        std::vector<meshvfn> meshes;
+        meshes.reserve(mesh_count);
+        for (int i = 0; i < mesh_count; i++)
+        {
+            meshes.emplace_back(mesh_files[i]);
+            pool.add(meshes[i]);
+            mesh_radius.push_back(meshes[i].get_farthest_vertex_distance());
+        }
+        pool.build(); //The standalone meshes are no longer needed.
+    }
+
+    gpu_culling culling("../shaders/compute/frustum_cull.comp");
+    for (int i = 0; i < mesh_count; i++)
+        culling.add_mesh(pool.get(i), mesh_radius[i]);
+
+    //Scatter the objects in a wide, flat field around the camera. Only the ones in front of it are visible.
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unif(0.0f, 1.0f);
+    for (int i = 0; i < object_count; i++)
+    {
+        int mesh = (int)(unif(rng)*mesh_count)%mesh_count;
+        glm::vec3 pos = glm::vec3(unif(rng) - 0.5f, unif(rng) - 0.5f, 0.1f*(unif(rng) - 0.5f))*800.0f;
+        glm::vec3 axis = glm::normalize(glm::vec3(unif(rng) - 0.5f, unif(rng) - 0.5f, unif(rng) - 0.5f) + glm::vec3(0.0f,0.0f,1e-3f));
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+        model = glm::rotate(model, 6.2832f*unif(rng), axis);
+        model = glm::scale(model, glm::vec3((0.6f + 0.8f*unif(rng))/mesh_radius[mesh]));
+        culling.add_object(mesh, model, glm::vec3(0.3f + 0.7f*unif(rng), 0.3f + 0.7f*unif(rng), 0.3f + 0.7f*unif(rng)));
+    }
+    culling.build();
+
+    shader shad("../shaders/vertex/trans_mvpn_indirect.vert", "../shaders/fragment/dir_light.frag", {"LIGHT_AMBIENT", "INSTANCE_COLOR", "VISIBLE_LIST"});
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(200.0f,200.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
+
+    glm::vec3 light_dir = glm::vec3(1.0f,-1.0f,2.0f);
+    glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
+    shad.use();
+    shad.set_vec3_uniform("light_dir", light_dir);
+    shad.set_vec3_uniform("light_col", light_col);
+
+    int on_gpu = 1; //1 : culling in a compute shader, 0 : on the cpu.
+    float cull_ms[2] = {0.0f, 0.0f}; //Smoothed cpu time of the cpu [0] and the gpu [1] culling (the gpu time is not included).
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glClearColor(0.05f,0.05f,0.05f,1.0f);
+
+    while (!glfwWindowShouldClose(window))
+    {
+        //The camera stands in the middle of the field and looks around.
+        static float cam_yaw = 0.0f, cam_pitch = -10.0f, fov = 45.0f, far_plane = 400.0f;
+        static bool rotate = true;
+        if (rotate)
+            cam_yaw = fmod(cam_yaw + 10.0f*io.DeltaTime, 360.0f);
+        glm::vec3 cam_pos = glm::vec3(0.0f,0.0f,30.0f);
+        glm::vec3 cam_dir = glm::vec3(cos(glm::radians(cam_yaw))*cos(glm::radians(cam_pitch)),
+                                      sin(glm::radians(cam_yaw))*cos(glm::radians(cam_pitch)),
+                                      sin(glm::radians(cam_pitch)));
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)win_width/win_height, 0.1f, far_plane);
+        glm::mat4 view = glm::lookAt(cam_pos, cam_pos + cam_dir, glm::vec3(0.0f,0.0f,1.0f));
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        auto t0 = std::chrono::steady_clock::now();
+        if (on_gpu)
+            culling.cull(projection*view);
+        else
+            culling.cull_cpu(projection*view);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        float &smoothed = cull_ms[on_gpu];
+        smoothed = (smoothed == 0.0f) ? ms : 0.95f*smoothed + 0.05f*ms;
+
+        shad.use();
+        shad.set_mat4_uniform("projection", projection);
+        shad.set_mat4_uniform("view", view);
+        culling.draw(shad);
+
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(350.0f, 330.0f), ImGuiCond_FirstUseEver);
+        static bool popen = true;
+        ImGui::Begin("Gpu culling", &popen);
+        if (!popen)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::BulletText("Culling");
+        ImGui::RadioButton("Gpu (compute shader)", &on_gpu, 1);
+        ImGui::RadioButton("Cpu (upload the visible list)", &on_gpu, 0);
+        ImGui::BulletText("Camera");
+        ImGui::SliderFloat("fov [deg]", &fov, 10.0f, 120.0f);
+        ImGui::SliderFloat("far plane", &far_plane, 10.0f, 800.0f);
+        ImGui::SliderFloat("pitch [deg]", &cam_pitch, -89.0f, 89.0f);
+        ImGui::Checkbox("Rotate", &rotate);
+        ImGui::BulletText("Statistics");
+        ImGui::Text("Objects : %d, visible : %d", culling.object_count(), culling.visible_count());
+        ImGui::Text("Draw parameters : %s", culling.uses_draw_parameters() ? "yes (1 multi-draw)" : "no (1 draw per mesh)");
+        ImGui::BulletText("Performance");
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        ImGui::Text("Culling (cpu side) : %.3f [ms]", smoothed);
+        ImGui::Text("Last measured : gpu %.3f [ms], cpu %.3f [ms]", cull_ms[1], cull_ms[0]);
+        ImGui::End();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
+        glfwPollEvents();
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    app_terminate();
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+
+#include<cstdio>
+#include<cmath>
+#include<cstdlib>
+#include<string>
+#include<vector>
+#include<thread>
+#include<chrono>
+
+#include"../include/shader.h"
+#include"../include/mesh.h"
+#include"../include/virtual_texture.h"
+#include"../include/app.h"
+
+//Virtual texturing of a 8k x 8k (by default) ground texture : Only the pages that the view needs live in video memory, in a fixed size
+//page cache, whatever the size of the texture. The texture is baked once into a page file (../cache/vt/), either from an image
+//(--image file, square with a power of 2 size) or procedurally (--vt-size N). Every frame the scene is first drawn into the small feedback
+//target, which tells which pages are needed, and the pages that the loader threads have read are uploaded before the main pass.
+//Fly low over the ground to see the pages stream in (tint the levels to see the coarser pages that stand in while they load).
+
+int win_width = 1600, win_height = 900;
+
+void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
+void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
+{
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+    win_width = w;
+    win_height = h;
+    glViewport(0,0,w,h);
+}
+
+//Smooth value noise in [0,1], repeating every 'period' units.
+float value_noise(float x, float y, int period)
+{
+    auto hash = [period](int i, int j)
+    {
+        i = ((i%period) + period)%period;
+        j = ((j%period) + period)%period;
+        unsigned int h = (unsigned int)i*73856093u ^ (unsigned int)j*19349663u;
+        h = (h ^ (h >> 13))*1274126177u;
+        return (float)((h ^ (h >> 16)) & 0xffff)/65535.0f;
+    };
+    int i = (int)floor(x), j = (int)floor(y);
+    float fx = x - i, fy = y - j;
+    fx = fx*fx*(3.0f - 2.0f*fx);
+    fy = fy*fy*(3.0f - 2.0f*fy);
+    float a = hash(i, j) + (hash(i + 1, j) - hash(i, j))*fx;
+    float b = hash(i, j + 1) + (hash(i + 1, j + 1) - hash(i, j + 1))*fx;
+    return a + (b - a)*fy;
+}
+
+//A ground texture with detail at every scale (so that every level of the pyramid looks different) : fBm terrain colors, a grid of
+//lines every 256 texels and a thinner one every 32 texels. Rows are generated on all hardware threads.
+std::vector<unsigned char> procedural_ground(int size)
+{
+    std::vector<unsigned char> rgba((size_t)size*size*4);
+    auto fill_rows = [&](int first, int last)
+    {
+        for (int y = first; y < last; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                float h = 0.0f, amp = 0.5f;
+                for (int octave = 0, period = 8; octave < 8 && period <= size; octave++, period *= 2, amp *= 0.5f)
+                    h += amp*value_noise((float)x*period/size, (float)y*period/size, period);
+                glm::vec3 col = (h < 0.45f) ? glm::mix(glm::vec3(0.25f,0.35f,0.15f), glm::vec3(0.45f,0.55f,0.25f), h/0.45f)
+                                            : glm::mix(glm::vec3(0.55f,0.5f,0.4f), glm::vec3(0.9f,0.88f,0.85f), (h - 0.45f)/0.55f);
+                if (x%256 < 3 || y%256 < 3)
+                    col = glm::vec3(0.8f,0.2f,0.1f);
+                else if (x%32 == 0 || y%32 == 0)
+                    col *= 0.6f;
+                unsigned char *texel = &rgba[((size_t)y*size + x)*4];
+                for (int c = 0; c < 3; c++)
+                    texel[c] = (unsigned char)glm::clamp(255.0f*col[c], 0.0f, 255.0f);
+                texel[3] = 255;
+            }
+        }
+    };
+    int threads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.push_back(std::thread(fill_rows, t*size/threads, (t + 1)*size/threads));
+    fill_rows(0, size/threads);
+    for (std::thread &w : workers)
+        w.join();
+    return rgba;
+}
+
+int main(int argc, char **argv)
+{
+    app_init(argc, argv);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Virtual texture", NULL, NULL);
+    if (window == NULL)
+    {
+        printf("Failed to create glfw window. Exiting...\n");
+        app_terminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    glewExperimental = GL_TRUE;
+    if (app_glew_init() != GLEW_OK)
+    {
+        printf("Failed to initialize glew. Exiting...\n");
+        return 0;
+    }
+
+    //Bake the page file on the first run (bc1 pages, if the driver can sample them).
+    const char *image = app_option("--image");
+    const char *size_option = app_option("--vt-size");
+    int vt_size = (size_option != NULL) ? atoi(size_option) : 8192;
+    bool compress = bc_format_supported(bc1);
+    std::string page_path = std::string("../cache/vt/") + ((image != NULL) ? std::filesystem::path(image).filename().string()
+                                                                          : "procedural_" + std::to_string(vt_size)) +
+                            (compress ? ".bc1.vtp" : ".rgba.vtp");
+    std::string source = (image != NULL) ? image : "";
+    if (!cache_is_fresh(page_path, &source, 1))
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        bool ok;
+        if (image != NULL)
+        {
+            int w, h, channels;
+            stbi_set_flip_vertically_on_load(true);
+            unsigned char *pixels = stbi_load(image, &w, &h, &channels, 4);
+            if (pixels == NULL || w != h)
+            {
+                fprintf(stderr, "Error : Failed to load '%s' as a square image. Exiting...\n", image);
+                exit(EXIT_FAILURE);
+            }
+            ok = virtual_texture::bake(page_path.c_str(), pixels, w, compress);
+            stbi_image_free(pixels);
+        }
+        else
+        {
+            std::vector<unsigned char> pixels = procedural_ground(vt_size);
+            ok = virtual_texture::bake(page_path.c_str(), pixels.data(), vt_size, compress);
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "Error : Failed to bake the virtual texture. Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+        printf("Baked '%s' in %.0f ms.\n", page_path.c_str(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+
+    //The page cache : 16x16 pages of 128x128 texels (+ borders), 4.6 MB in bc1, 18.5 MB in rgba8.
+    virtual_texture vt(page_path.c_str(), 16);
+    virtual_texture_feedback feedback;
+
+    meshvft ground("../obj/vft/plane10x10.obj");
+    meshvft asteroid("../obj/vft/didymain2019.obj");
+
+    shader shad("../shaders/vertex/trans_mvp_texture.vert", "../shaders/fragment/virtual_texture.frag");
+    shader feedback_shad("../shaders/vertex/trans_mvp_texture.vert", "../shaders/fragment/virtual_texture.frag", {"VT_FEEDBACK"});
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(200.0f,200.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
+
+    glm::mat4 ground_model = glm::scale(glm::mat4(1.0f), glm::vec3(20.0f)); //200 x 200 units, 1 repetition of the texture.
+    glm::mat4 asteroid_model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,0.0f,3.0f));
+    asteroid_model = glm::scale(asteroid_model, glm::vec3(4.0f));
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.55f,0.7f,0.9f,1.0f);
+
+    while (!glfwWindowShouldClose(window))
+    {
+        //The camera flies in circles, low over the ground.
+        static float cam_height = 2.0f, cam_radius = 30.0f, cam_speed = 0.05f, cam_pitch = -8.0f, fov = 60.0f;
+        static bool show_levels = false, stream = true;
+        static int max_uploads = 32;
+        static float angle = 0.0f;
+        angle += cam_speed*io.DeltaTime;
+        glm::vec3 cam_pos = glm::vec3(cam_radius*cos(angle), cam_radius*sin(angle), cam_height);
+        glm::vec3 cam_dir = glm::vec3(-sin(angle)*cos(glm::radians(cam_pitch)), cos(angle)*cos(glm::radians(cam_pitch)), sin(glm::radians(cam_pitch)));
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)win_width/win_height, 0.05f, 400.0f);
+        glm::mat4 view = glm::lookAt(cam_pos, cam_pos + cam_dir, glm::vec3(0.0f,0.0f,1.0f));
+
+        //Feedback pass : Which pages the view needs (read back a few frames later).
+        if (stream)
+        {
+            feedback.begin(win_width, win_height);
+            feedback_shad.use();
+            feedback.bind(feedback_shad);
+            vt.bind(feedback_shad);
+            feedback_shad.set_mat4_uniform("projection", projection);
+            feedback_shad.set_mat4_uniform("view", view);
+            feedback_shad.set_mat4_uniform("model", ground_model);
+            ground.draw_triangles();
+            feedback_shad.set_mat4_uniform("model", asteroid_model);
+            asteroid.draw_triangles();
+            feedback.end(vt);
+            glViewport(0,0, win_width,win_height);
+        }
+        vt.update(max_uploads);
+
+        //Main pass.
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shad.use();
+        vt.bind(shad);
+        shad.set_int_uniform("show_levels", show_levels);
+        shad.set_mat4_uniform("projection", projection);
+        shad.set_mat4_uniform("view", view);
+        shad.set_mat4_uniform("model", ground_model);
+        ground.draw_triangles();
+        shad.set_mat4_uniform("model", asteroid_model);
+        asteroid.draw_triangles();
+
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(380.0f, 640.0f), ImGuiCond_FirstUseEver);
+        static bool popen = true;
+        ImGui::Begin("Virtual texture", &popen);
+        if (!popen)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::BulletText("Camera");
+        ImGui::SliderFloat("height", &cam_height, 0.3f, 50.0f);
+        ImGui::SliderFloat("radius", &cam_radius, 0.0f, 90.0f);
+        ImGui::SliderFloat("speed [rad/s]", &cam_speed, 0.0f, 0.5f);
+        ImGui::SliderFloat("pitch [deg]", &cam_pitch, -89.0f, 30.0f);
+        ImGui::SliderFloat("fov [deg]", &fov, 10.0f, 120.0f);
+        ImGui::BulletText("Streaming");
+        ImGui::Checkbox("Stream pages", &stream);
+        ImGui::Checkbox("Tint the levels", &show_levels);
+        ImGui::SliderInt("uploads per frame", &max_uploads, 1, 128);
+        ImGui::BulletText("Statistics");
+        ImGui::Text("Texture : %d x %d, %d levels, %d pages (%s)", vt.get_size(), vt.get_size(), vt.level_count(), vt.page_count(),
+                    vt.is_compressed() ? "bc1" : "rgba8");
+        ImGui::Text("Video memory : %.1f MB (the whole texture : %.1f MB)", vt.memory_bytes()/1048576.0, vt.full_texture_bytes()/1048576.0);
+        ImGui::Text("Resident : %d / %d pages", vt.resident_count(), vt.slot_count());
+        ImGui::Text("Needed : %d, loading : %d", vt.requested_count(), vt.missing_count());
+        ImGui::Text("Uploads : %d this frame, %lld in total", vt.uploads_last_frame(), vt.upload_count());
+        ImGui::Text("Evictions : %d, dropped : %d", vt.eviction_count(), vt.drop_count());
+        ImGui::BulletText("Performance");
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        ImGui::BulletText("Page cache");
+        float side = ImGui::GetContentRegionAvail().x;
+        ImGui::Image((ImTextureID)(intptr_t)vt.get_cache_id(), ImVec2(side, side));
+        ImGui::End();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
+        glfwPollEvents();
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    app_terminate();
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+
+#include<cstdio>
+#include<cmath>
+#include<cstdlib>
+#include<vector>
+#include<random>
+#include<chrono>
+#include<algorithm>
+
+#include"../include/shader.h"
+#include"../include/mesh.h"
+#include"../include/clustered_lights.h"
+#include"../include/gpu_timer.h"
+#include"../include/app.h"
+
+//Thousands of moving point lights in a room, shaded in 1 forward pass : A compute pass sorts the lights into the clusters of the view
+//frustum every frame, and every fragment only shades with the lights of its cluster (clustered_lights.h). The gui shows the gpu time of
+//the cluster build and of the lit pass, and can switch to looping over all lights in every fragment, for comparison (keep the count low).
+//    ./d31_clustered_lights --lights 8192
+
+int win_width = 1600, win_height = 900;
+
+const glm::vec3 room_min = glm::vec3(-15.0f,-15.0f,0.0f), room_max = glm::vec3(15.0f,15.0f,5.0f);
+
+void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
+void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
+{
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+    win_width = w;
+    win_height = h;
+    glViewport(0,0,w,h);
+}
+
+//How a light moves : In a circle around 'center', bobbing up and down. And its color, before the intensity.
+struct light_orbit
+{
+    glm::vec3 center, col;
+    float radius, speed, phase;
+};
+
+void scatter_lights(int count, std::vector<light_orbit> &orbits, std::vector<point_light> &lights)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unif(0.0f, 1.0f);
+    orbits.resize(count);
+    lights.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        orbits[i].center = room_min + glm::vec3(unif(rng), unif(rng), unif(rng))*(room_max - room_min);
+        orbits[i].radius = 0.3f + 1.5f*unif(rng);
+        orbits[i].speed = (0.3f + 0.7f*unif(rng))*((unif(rng) < 0.5f) ? -1.0f : 1.0f);
+        orbits[i].phase = 6.2832f*unif(rng);
+        //Saturated colors : 1 hue per light.
+        float h = 6.0f*unif(rng);
+        orbits[i].col = glm::clamp(glm::vec3(std::fabs(h - 3.0f) - 1.0f, 2.0f - std::fabs(h - 2.0f), 2.0f - std::fabs(h - 4.0f)), 0.0f, 1.0f);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    app_init(argc, argv);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Clustered lights", NULL, NULL);
+    if (window == NULL)
+    {
+        printf("Failed to create glfw window. Exiting...\n");
+        app_terminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0); //No vsync, otherwise the frame time hides the cost of the lights.
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    glewExperimental = GL_TRUE;
+    if (app_glew_init() != GLEW_OK)
+    {
+        printf("Failed to initialize glew. Exiting...\n");
+        return 0;
+    }
+
+    //The room, with rows of pillars, spheres and Suzannes to catch the light.
+    meshvfn room("../obj/vfn/open_room30x30x5.obj");
+    meshvfn cube("../obj/vfn/cube2x2x2.obj");
+    meshvfn sphere("../obj/vfn/uv_sphere_rad1_20x20.obj");
+    meshvfn suzanne("../obj/vfn/suzanne.obj");
+    std::vector<meshvfn*> object_meshes;
+    std::vector<glm::mat4> object_models;
+    object_meshes.push_back(&room);
+    object_models.push_back(glm::mat4(1.0f));
+    for (int y = 0; y < 5; y++)
+    {
+        for (int x = 0; x < 5; x++)
+        {
+            glm::vec3 pos = glm::vec3(-10.0f + 5.0f*x, -10.0f + 5.0f*y, 0.0f);
+            if ((x + y)%2 == 0)
+            {
+                object_meshes.push_back(&cube);
+                object_models.push_back(glm::scale(glm::translate(glm::mat4(1.0f), pos + glm::vec3(0.0f,0.0f,2.5f)), glm::vec3(0.4f,0.4f,2.5f)));
+            }
+            else
+            {
+                object_meshes.push_back(((x + y)%4 == 1) ? &sphere : &suzanne);
+                object_models.push_back(glm::translate(glm::mat4(1.0f), pos + glm::vec3(0.0f,0.0f,1.0f)));
+            }
+        }
+    }
+
+    const char *lights_option = app_option("--lights");
+    int light_count = (lights_option != NULL) ? atoi(lights_option) : 4096;
+    const int max_lights = 16384;
+    light_count = std::max(1, std::min(light_count, max_lights));
+
+    clustered_lights clusters("../shaders/compute/cluster_lights.comp", max_lights);
+    shader clustered_shad("../shaders/vertex/trans_mvpn.vert", "../shaders/fragment/point_light_clustered.frag");
+    shader all_lights_shad("../shaders/vertex/trans_mvpn.vert", "../shaders/fragment/point_light_clustered.frag", {"ALL_LIGHTS"});
+
+    std::vector<light_orbit> orbits;
+    std::vector<point_light> lights;
+    scatter_lights(light_count, orbits, lights);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(200.0f,200.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
+
+    glm::vec3 mesh_col = glm::vec3(0.9f,0.9f,0.9f);
+    gpu_timer cluster_timer, shade_timers[2]; //Gpu time of the cluster build, and of the lit pass (clustered [0], all lights [1]).
+    float animate_ms = 0.0f; //Smoothed cpu time of moving and uploading the lights.
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glClearColor(0.0f,0.0f,0.0f,1.0f);
+
+    while (!glfwWindowShouldClose(window))
+    {
+        static int mode = 0; //0 : Clustered, 1 : All lights in every fragment.
+        static int requested_count = light_count;
+        static float overlap = 24.0f, intensity = 0.3f;
+        static bool animate = true, rotate = true, show_clusters = false;
+        static float cam_yaw = 0.0f, cam_pitch = -20.0f, fov = 60.0f, light_time = 0.0f;
+
+        if (requested_count != light_count)
+        {
+            light_count = requested_count;
+            scatter_lights(light_count, orbits, lights);
+        }
+
+        //The radius of the lights is chosen so that about 'overlap' lights reach every point of the room, whatever their count.
+        glm::vec3 room_size = room_max - room_min;
+        float light_radius = std::cbrt(3.0f*overlap*room_size.x*room_size.y*room_size.z/(4.0f*3.14159265f*light_count));
+
+        //Move the lights and upload them.
+        auto t0 = std::chrono::steady_clock::now();
+        if (animate)
+            light_time += io.DeltaTime;
+        for (int i = 0; i < light_count; i++)
+        {
+            const light_orbit &o = orbits[i];
+            float a = o.speed*light_time + o.phase;
+            glm::vec3 pos = o.center + o.radius*glm::vec3(std::cos(a), std::sin(a), 0.3f*std::sin(2.0f*a));
+            lights[i].pos_radius = glm::vec4(glm::clamp(pos, room_min + 0.1f, room_max - 0.1f), light_radius);
+            lights[i].col = glm::vec4(intensity*o.col, 1.0f);
+        }
+        clusters.set_lights(lights);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        animate_ms = (animate_ms == 0.0f) ? ms : 0.95f*animate_ms + 0.05f*ms;
+
+        //The camera circles inside the room, looking around.
+        if (rotate)
+            cam_yaw = fmod(cam_yaw + 8.0f*io.DeltaTime, 360.0f);
+        glm::vec3 cam_pos = glm::vec3(11.0f*cos(glm::radians(cam_yaw + 180.0f)), 11.0f*sin(glm::radians(cam_yaw + 180.0f)), 3.5f);
+        glm::vec3 cam_dir = glm::vec3(cos(glm::radians(cam_yaw))*cos(glm::radians(cam_pitch)),
+                                      sin(glm::radians(cam_yaw))*cos(glm::radians(cam_pitch)),
+                                      sin(glm::radians(cam_pitch)));
+        const float near_plane = 0.1f, far_plane = 60.0f;
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)win_width/win_height, near_plane, far_plane);
+        glm::mat4 view = glm::lookAt(cam_pos, cam_pos + cam_dir, glm::vec3(0.0f,0.0f,1.0f));
+
+        //Sort the lights into the clusters.
+        cluster_timer.begin();
+        clusters.build(view, projection, near_plane, far_plane);
+        cluster_timer.end();
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader &shad = (mode == 0) ? clustered_shad : all_lights_shad;
+        shade_timers[mode].begin();
+        clusters.bind(shad, win_width, win_height);
+        shad.set_mat4_uniform("projection", projection);
+        shad.set_mat4_uniform("view", view);
+        shad.set_vec3_uniform("cam_pos", cam_pos);
+        shad.set_vec3_uniform("mesh_col", mesh_col);
+        shad.set_int_uniform("show_clusters", show_clusters);
+        for (size_t k = 0; k < object_meshes.size(); k++)
+        {
+            shad.set_mat4_uniform("model", object_models[k]);
+            object_meshes[k]->draw_triangles();
+        }
+        shade_timers[mode].end();
+
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(380.0f, 480.0f), ImGuiCond_FirstUseEver);
+        static bool popen = true;
+        ImGui::Begin("Clustered lights", &popen);
+        if (!popen)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::BulletText("Lights");
+        ImGui::SliderInt("count", &requested_count, 1, max_lights);
+        ImGui::SliderFloat("lights per point", &overlap, 1.0f, 100.0f);
+        ImGui::SliderFloat("intensity", &intensity, 0.0f, 2.0f);
+        ImGui::Checkbox("Animate", &animate);
+        ImGui::BulletText("Shading");
+        ImGui::RadioButton("Clustered", &mode, 0);
+        ImGui::RadioButton("All lights in every fragment", &mode, 1);
+        ImGui::Checkbox("Show the lights per cluster", &show_clusters);
+        ImGui::BulletText("Camera");
+        ImGui::SliderFloat("fov [deg]", &fov, 20.0f, 120.0f);
+        ImGui::SliderFloat("pitch [deg]", &cam_pitch, -89.0f, 89.0f);
+        ImGui::Checkbox("Rotate", &rotate);
+        ImGui::BulletText("Statistics");
+        ImGui::Text("Lights : %d, radius %.2f", clusters.light_count(), light_radius);
+        ImGui::Text("Clusters : %d x %d x %d, %.1f MB", clustered_lights::grid_x, clustered_lights::grid_y, clustered_lights::grid_z,
+                    clusters.memory_bytes()/1048576.0);
+        ImGui::Text("Lights per cluster : %.1f on average, %d at most", clusters.get_total_count()/(float)clustered_lights::cluster_count,
+                    clusters.get_max_count());
+        if (clusters.get_saturated_count() > 0)
+            ImGui::TextColored(ImVec4(1.0f,0.4f,0.3f,1.0f), "%d clusters lost lights (the lists are full)", clusters.get_saturated_count());
+        ImGui::BulletText("Performance");
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        ImGui::Text("Move + upload the lights (cpu) : %.3f [ms]", animate_ms);
+        ImGui::Text("Cluster build (gpu) : %.3f [ms]", cluster_timer.last_ms());
+        ImGui::Text("Lit pass (gpu) : clustered %.3f [ms], all lights %.3f [ms]", shade_timers[0].last_ms(), shade_timers[1].last_ms());
+        ImGui::End();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
+        glfwPollEvents();
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    app_terminate();
+    return 0;
+}
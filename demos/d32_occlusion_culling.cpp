@@ -0,0 +1,333 @@
+#include"../imgui/imgui.h"
+#include"../imgui/imgui_impl_glfw.h"
+#include"../imgui/imgui_impl_opengl3.h"
+
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<cstdio>
+#include<algorithm>
+#include<memory>
+
+#include"../include/shader.h"
+#include"../include/mesh.h"
+#include"../include/camera.h"
+#include"../include/occlusion_culling.h"
+#include"../include/render_target_pool.h"
+#include"../include/gpu_timer.h"
+#include"../include/app.h"
+
+//Occlusion culling in the Sponza palace, where walls and columns hide most of the building from any point of view. The merged mesh is cut
+//into clusters of a few hundred triangles, and every frame the gpu draws the clusters that were visible last frame, builds a Hi-Z pyramid
+//from their depth, tests all clusters against it and draws the newly visible ones (occlusion_culling.h). The gui compares no culling,
+//frustum culling and frustum + occlusion culling, with the draws (clusters) and triangles rejected per frame and the gpu time.
+
+//Camera object instantiation. We make it global so that the glfw callback 'cursor_pos_callback()' (see later) can
+//have access to it. This is just for demo. At a bigger project, we would use glfwSetWindowUserPointer(...) to encapsulate
+//any variable within the specific context of the window.
+camera cam(glm::vec3(-15.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.0f);
+
+float time_tick; //Elapsed time per frame update.
+
+float xpos_previous, ypos_previous;
+bool first_time_entered_the_window = true;
+
+bool cursor_visible = false;
+
+int win_width = 1200, win_height = 900;
+
+//For 'continuous' events, i.e. at every frame in the while() loop.
+void event_tick(GLFWwindow *win)
+{
+    bool move_key_pressed = false;
+    if (glfwGetKey(win, GLFW_KEY_W) == GLFW_PRESS)
+    {
+        cam.accelerate(time_tick, cam.front);
+        move_key_pressed = true;
+    }
+    if (glfwGetKey(win, GLFW_KEY_S) == GLFW_PRESS)
+    {
+        cam.accelerate(time_tick, -cam.front);
+        move_key_pressed = true;
+    }
+    if (glfwGetKey(win, GLFW_KEY_D) == GLFW_PRESS)
+    {
+        cam.accelerate(time_tick, cam.right);
+        move_key_pressed = true;
+    }
+    if (glfwGetKey(win, GLFW_KEY_A) == GLFW_PRESS)
+    {
+        cam.accelerate(time_tick, -cam.right);
+        move_key_pressed = true;
+    }
+    if (glfwGetKey(win, GLFW_KEY_E) == GLFW_PRESS)
+    {
+        cam.accelerate(time_tick, cam.world_up);
+        move_key_pressed = true;
+    }
+    if (glfwGetKey(win, GLFW_KEY_Q) == GLFW_PRESS)
+    {
+        cam.accelerate(time_tick, -cam.world_up);
+        move_key_pressed = true;
+    }
+
+    //If no keys are pressed, decelerate.
+    if (!move_key_pressed)
+        cam.decelerate(time_tick);
+}
+
+//For discrete keyboard events.
+void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_RELEASE)
+        glfwSetWindowShouldClose(window, true);
+}
+
+//When a mouse button is pressed, do the following :
+void mouse_button_callback(GLFWwindow *window, int button, int action, int /*mods*/)
+{
+    //Toggle cursor visibility via the mouse right click.
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_RELEASE)
+    {
+        cursor_visible = !cursor_visible;
+        if (cursor_visible)
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        else
+        {
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            first_time_entered_the_window = true;
+        }
+    }
+}
+
+//When the mouse moves, do the following :
+void cursor_pos_callback(GLFWwindow */*win*/, double xpos, double ypos)
+{
+    if (cursor_visible)
+        return;
+
+    if (first_time_entered_the_window)
+    {
+        xpos_previous = xpos;
+        ypos_previous = ypos;
+        first_time_entered_the_window = false;
+    }
+
+    float xoffset = xpos - xpos_previous;
+    float yoffset = ypos - ypos_previous;
+
+    xpos_previous = xpos;
+    ypos_previous = ypos;
+
+    cam.rotate(xoffset, yoffset);
+}
+
+void scroll_callback(GLFWwindow */*win*/, double /*xoffset*/, double yoffset)
+{
+    cam.zoom((float)yoffset);
+}
+
+void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
+{
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+    win_width = w;
+    win_height = h;
+    glViewport(0,0,w,h);
+}
+
+int main(int argc, char **argv)
+{
+    app_init(argc, argv);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
+
+    GLFWwindow *window = app_create_window(win_width, win_height, "Occlusion culling", NULL, NULL);
+    if (window == NULL)
+    {
+        printf("Failed to create glfw window. Exiting...\n");
+        app_terminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0); //No vsync, so that the frame time shows the savings.
+    glfwSetWindowSizeLimits(window, 400, 400, GLFW_DONT_CARE, GLFW_DONT_CARE);
+
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetCursorPosCallback(window, cursor_pos_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); //Hide the mouse initially.
+
+    glfwGetFramebufferSize(window, &win_width, &win_height);
+
+    glewExperimental = GL_TRUE;
+    if (app_glew_init() != GLEW_OK)
+    {
+        printf("Failed to initialize glew. Exiting...\n");
+        return 0;
+    }
+
+    //Setup ImGui.
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.Fonts->AddFontFromFileTTF("../fonts/Arial.ttf", 15.0f);
+    (void)io;
+    ImGui::StyleColorsLight();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 450");
+    ImGuiStyle &imstyle = ImGui::GetStyle();
+    imstyle.WindowMinSize = ImVec2(100.0f,100.0f);
+    imstyle.FrameRounding = 5.0f;
+    imstyle.WindowRounding = 5.0f;
+
+    //The clusters keep their own copy of the mesh on the gpu, so the mesh itself is only needed while they are built.
+    std::unique_ptr<meshvfn> sponza = std::make_unique<meshvfn>("../obj/vfn/sponza_merged.obj");
+    occlusion_culling culling("../shaders/compute/occlusion_cull.comp", "../shaders/compute/hiz_build.comp", *sponza);
+    sponza.reset();
+
+    shader shad("../shaders/vertex/trans_mvpn.vert","../shaders/fragment/dir_light_ads.frag");
+    glm::vec3 mesh_col = glm::vec3(0.8f,0.8f,0.8f);
+    glm::vec3 light_dir = glm::vec3(1.0f,1.0f,1.0f);
+    glm::vec3 light_col = glm::vec3(1.0f,1.0f,1.0f);
+    glm::mat4 model = glm::mat4(1.0f);
+    shad.use();
+    shad.set_vec3_uniform("mesh_col", mesh_col);
+    shad.set_vec3_uniform("light_dir", light_dir);
+    shad.set_vec3_uniform("light_col", light_col);
+    shad.set_mat4_uniform("model", model);
+
+    //The scene is rendered to a texture target, whose depth the Hi-Z pyramid is built from, then copied to the window.
+    render_target_pool pool;
+    render_target_desc scene_desc;
+    scene_desc.color_format = GL_RGBA8;
+    scene_desc.depth_format = GL_DEPTH_COMPONENT32F;
+
+    gpu_timer all_timer, early_timer, late_timer; //The whole mesh (no culling), the early pass (cull + draw), the late pass (Hi-Z + cull + draw).
+
+    glm::mat4 projection, view;
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glClearColor(0.1f,0.1f,0.1f,1.0f);
+
+    float t0 = 0.0f, tnow;
+
+    while (!glfwWindowShouldClose(window)) //Game loop.
+    {
+        static int mode = 2; //0 : No culling, 1 : Frustum culling, 2 : Frustum + occlusion culling.
+
+        tnow = (float)glfwGetTime(); //Elapsed time [sec] since glfwInit().
+        time_tick = tnow - t0;
+        t0 = tnow;
+
+        event_tick(window);
+
+        projection = glm::perspective(glm::radians(cam.fov), (float)win_width/win_height, 0.05f,500.0f);
+        cam.move(time_tick);
+        view = cam.view();
+        glm::mat4 view_projection = projection*view;
+        shad.use();
+        shad.set_mat4_uniform("projection", projection);
+        shad.set_vec3_uniform("cam_pos", cam.pos);
+        shad.set_mat4_uniform("view", view);
+
+        pool.begin_frame();
+        scene_desc.width = win_width;
+        scene_desc.height = win_height;
+        render_target &scene = pool.acquire(scene_desc);
+        scene.bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (mode == 0)
+        {
+            all_timer.begin();
+            culling.draw_all(shad);
+            all_timer.end();
+        }
+        else
+        {
+            early_timer.begin();
+            culling.cull_early(view_projection, mode == 2);
+            culling.draw(shad);
+            early_timer.end();
+            if (mode == 2)
+            {
+                late_timer.begin();
+                culling.cull_late(view_projection, scene.depth, win_width, win_height);
+                scene.bind();
+                culling.draw(shad);
+                late_timer.end();
+            }
+        }
+
+        glBlitNamedFramebuffer(scene.fbo.get_id(), 0, 0,0, win_width,win_height, 0,0, win_width,win_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        pool.release(scene);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0,0, win_width,win_height);
+
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowSize(ImVec2(420.0f,400.0f), ImGuiCond_FirstUseEver);
+        static bool closable = true;
+        ImGui::Begin("GUI", &closable);
+        if (!closable)
+            glfwSetWindowShouldClose(window, true);
+        ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(0,100,0,255));
+        ImGui::Text("Right click to toggle the cursor.");
+        ImGui::PopStyleColor();
+        ImGui::RadioButton("No culling", &mode, 0);
+        ImGui::RadioButton("Frustum culling", &mode, 1);
+        ImGui::RadioButton("Frustum + occlusion culling", &mode, 2);
+        ImGui::Separator();
+        int clusters = culling.cluster_count(), triangles = culling.triangle_count();
+        ImGui::Text("Mesh : %d triangles in %d clusters", triangles, clusters);
+        if (mode > 0 && culling.has_stats())
+        {
+            int drawn = culling.early_draw_count() + culling.late_draw_count();
+            int drawn_triangles = culling.early_triangle_count() + culling.late_triangle_count();
+            ImGui::Text("Drawn : %d clusters, %d triangles (%.1f %%)", drawn, drawn_triangles, 100.0f*drawn_triangles/triangles);
+            if (mode == 2)
+                ImGui::Text("   early %d + late (newly visible) %d clusters", culling.early_draw_count(), culling.late_draw_count());
+            ImGui::Text("Rejected by the frustum : %d clusters, %d triangles", culling.frustum_culled_count(), culling.frustum_culled_triangle_count());
+            if (mode == 2)
+                ImGui::Text("Rejected as occluded : %d clusters, %d triangles", culling.occluded_count(), culling.occluded_triangle_count());
+        }
+        ImGui::Separator();
+        ImGui::Text("FPS : %.0f (%.2f [ms])", io.Framerate, 1000.0f/io.Framerate);
+        if (mode == 0)
+            ImGui::Text("Scene (gpu) : %.3f [ms]", all_timer.average_ms());
+        else if (mode == 1)
+            ImGui::Text("Scene (gpu) : %.3f [ms]", early_timer.average_ms());
+        else
+            ImGui::Text("Scene (gpu) : %.3f [ms] = early pass %.3f + Hi-Z and late pass %.3f", early_timer.average_ms() + late_timer.average_ms(),
+                        early_timer.average_ms(), late_timer.average_ms());
+        ImGui::Text("Culling memory : %.1f MB (Hi-Z %d levels)", culling.memory_bytes()/1048576.0, culling.get_hiz().get_levels());
+        ImGui::End();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        app_swap_buffers(window);
+        glfwPollEvents();
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    pool.clear();
+
+    app_terminate();
+    return 0;
+}
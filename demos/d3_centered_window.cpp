@@ -2,6 +2,8 @@
 #include<GLFW/glfw3.h>
 #include<cstdio>
 
+#include"../include/app.h"
+
 void key_callback(GLFWwindow *win, int key, int /*scancode*/, int action, int /*mods*/)
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_RELEASE)
@@ -10,19 +12,19 @@ void key_callback(GLFWwindow *win, int key, int /*scancode*/, int action, int /*
     }
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     int win_width = 1000, win_height = 700;
-    GLFWwindow *window = glfwCreateWindow(win_width, win_height, "Centered window", NULL, NULL);
+    GLFWwindow *window = app_create_window(win_width, win_height, "Centered window", NULL, NULL);
     if (window == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(window);
@@ -40,7 +42,7 @@ int main()
 
     //validate glew
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...");
         return 0;
@@ -50,10 +52,10 @@ int main()
     while (!glfwWindowShouldClose(window))
     {
         glClear(GL_COLOR_BUFFER_BIT);
-        glfwSwapBuffers(window);
+        app_swap_buffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
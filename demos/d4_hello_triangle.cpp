@@ -2,6 +2,8 @@
 #include<GLFW/glfw3.h>
 #include<cstdio>
 
+#include"../include/app.h"
+
 //Vertex shader source code.
 const char *vsource = "#version 450 core\n"
                       "layout (location = 0) in vec3 pos;\n"
@@ -32,9 +34,9 @@ void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
     glViewport(0,0,w,h); //Set the viewport to cover the new window dimensions (entire window).
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -42,11 +44,11 @@ int main()
     const int x_top_left = 100, y_top_left = 100;
     const int win_width = 800, win_height = 700;
     const char *win_label = "First triangle";
-    GLFWwindow *win = glfwCreateWindow(win_width, win_height, win_label, NULL, NULL);
+    GLFWwindow *win = app_create_window(win_width, win_height, win_label, NULL, NULL);
     if (win == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(win);
@@ -55,7 +57,7 @@ int main()
     glfwSetFramebufferSizeCallback(win, framebuffer_size_callback); //Register the framebuffer size callback.
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -133,7 +135,7 @@ int main()
         //Actually plot the mesh.
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
-        glfwSwapBuffers(win);
+        app_swap_buffers(win);
         glfwPollEvents();
     }
 
@@ -145,6 +147,6 @@ int main()
     glDeleteShader(vshader);
     glDeleteShader(fshader);
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
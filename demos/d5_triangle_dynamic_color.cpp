@@ -3,6 +3,8 @@
 #include<cstdio>
 #include<cmath>
 
+#include"../include/app.h"
+
 int win_width = 1200, win_height = 750;
 
 //Vertex shader source code.
@@ -38,20 +40,20 @@ void framebuffer_size_callback(GLFWwindow *, int w, int h)
     glViewport(0,0,w,h);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4); //Anti aliasing.
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE); //Windowed fullscreen.
 
-    GLFWwindow *win = glfwCreateWindow(win_width, win_height, "Triangle dynamic color", NULL, NULL);
+    GLFWwindow *win = app_create_window(win_width, win_height, "Triangle dynamic color", NULL, NULL);
     if (win == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(win);
@@ -63,7 +65,7 @@ int main()
     glfwSetWindowSizeLimits(win, 400, 400, GLFW_DONT_CARE, GLFW_DONT_CARE);
     
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -132,7 +134,7 @@ int main()
         glUniform1f(intensity_location, intensity);
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
-        glfwSwapBuffers(win);
+        app_swap_buffers(win);
         glfwPollEvents();
     }
 
@@ -142,6 +144,6 @@ int main()
     glDeleteShader(vshader);
     glDeleteShader(fshader);
     
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
@@ -3,6 +3,7 @@
 #include<cstdio>
 
 #include"../include/shader.h"
+#include"../include/app.h"
 
 const int win_width = 800, win_height = 700;
 const char *win_label = "Triangle shader class";
@@ -24,19 +25,19 @@ void framebuffer_size_callback(GLFWwindow *, int w, int h)
     printf("\n");
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4); //Anti aliasing.
     
-    GLFWwindow *win = glfwCreateWindow(win_width, win_height, win_label, NULL, NULL);
+    GLFWwindow *win = app_create_window(win_width, win_height, win_label, NULL, NULL);
     if (win == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(win);
@@ -44,7 +45,7 @@ int main()
     glfwSetKeyCallback(win, key_callback);
     
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -80,7 +81,7 @@ int main()
         glDrawArrays(GL_TRIANGLES, 0, 3);
         glBindVertexArray(0); //Now unbind.
         
-        glfwSwapBuffers(win);
+        app_swap_buffers(win);
         glfwPollEvents();
     }
     
@@ -89,6 +90,6 @@ int main()
     
     //Shader resources are deleted in the class destructror.
     
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
@@ -8,6 +8,7 @@
 #include<cmath>
 
 #include"../include/shader.h"
+#include"../include/app.h"
 
 void key_callback(GLFWwindow *win, int key, int /*scancode*/, int action, int /*mods*/)
 {
@@ -26,9 +27,9 @@ void framebuffer_size_callback(GLFWwindow */*win*/, int w, int h)
     printf("\n");
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    glfwInit();
+    app_init(argc, argv);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -36,11 +37,11 @@ int main()
 
 
     int width = 800, height = 800;
-    GLFWwindow *win = glfwCreateWindow(width, height, "Rotating square", NULL, NULL);
+    GLFWwindow *win = app_create_window(width, height, "Rotating square", NULL, NULL);
     if (win == NULL)
     {
         printf("Failed to create glfw window. Exiting...\n");
-        glfwTerminate();
+        app_terminate();
         return 0;
     }
     glfwMakeContextCurrent(win);
@@ -53,7 +54,7 @@ int main()
     glfwSetKeyCallback(win, key_callback);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    if (app_glew_init() != GLEW_OK)
     {
         printf("Failed to initialize glew. Exiting...\n");
         return 0;
@@ -102,13 +103,13 @@ int main()
         glBindVertexArray(vao);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        glfwSwapBuffers(win);
+        app_swap_buffers(win);
         glfwPollEvents();
     }
 
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(1, &vbo);
 
-    glfwTerminate();
+    app_terminate();
     return 0;
 }
@@ -93,6 +93,10 @@
 // The only purpose of this define is if you want force compilation of the stb_truetype backend ALONG with the FreeType backend.
 //#define IMGUI_ENABLE_STB_TRUETYPE
 
+//---- [OpenGL_demos] The demos load OpenGL with GLEW, so the opengl3 backend uses GLEW too instead of its bundled gl3w loader.
+// This gives it GL 4.4+ entry points (persistent mapping, fences) for streaming its vertices through include/ring_buffer.h.
+#define IMGUI_IMPL_OPENGL_LOADER_CUSTOM
+
 //---- Define constructor and implicit cast operators to convert back<>forth between your math types and ImVec2/ImVec4.
 // This will be inlined as part of ImVec2 and ImVec4 class declarations.
 /*
@@ -167,6 +167,13 @@
 // Changes to this backend using new APIs should be accompanied by a regenerated stripped loader version.
 #define IMGL3W_IMPL
 #include "imgui_impl_opengl3_loader.h"
+#else
+// [OpenGL_demos] The demos load OpenGL with GLEW (see imconfig.h), which also gives us GL 4.4+ persistent mapping and fences.
+// Vertex/index data is then streamed through the persistently mapped ring buffer of include/ring_buffer.h.
+#include <GL/glew.h>
+#include "../include/ring_buffer.h"
+#include <chrono>
+#define IMGUI_IMPL_OPENGL_USE_RING_BUFFER
 #endif
 
 // Vertex arrays are not supported on ES2/WebGL1 unless Emscripten which uses an extension
@@ -238,6 +245,10 @@ struct ImGui_ImplOpenGL3_Data
     bool            HasPolygonMode;
     bool            HasClipOrigin;
     bool            UseBufferSubData;
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+    ring_buffer*    Stream;                  // Persistently mapped vertex/index stream (GL 4.5+, nullptr otherwise)
+#endif
+    float           SubmitMs;                // CPU time of the last ImGui_ImplOpenGL3_RenderDrawData()
 
     ImGui_ImplOpenGL3_Data() { memset((void*)this, 0, sizeof(*this)); }
 };
@@ -482,6 +493,19 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
     GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)offsetof(ImDrawVert, col)));
 }
 
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+// Point the vertex attributes and the index buffer to the data of a draw list in the ring buffer.
+static void ImGui_ImplOpenGL3_BindStream(const ring_allocation& vtx, const ring_allocation& idx)
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vtx.buffer));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idx.buffer));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxPos,   2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(intptr_t)(vtx.offset + offsetof(ImDrawVert, pos))));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxUV,    2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(intptr_t)(vtx.offset + offsetof(ImDrawVert, uv))));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)(intptr_t)(vtx.offset + offsetof(ImDrawVert, col))));
+}
+#endif
+
 // OpenGL3 Render function.
 // Note that this implementation is little overcomplicated because we are saving/setting up/restoring every OpenGL state explicitly.
 // This is in order to be able to run within an OpenGL engine that doesn't do so.
@@ -494,6 +518,11 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         return;
 
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+    const auto submit_start = std::chrono::steady_clock::now();
+    if (bd->Stream)
+        bd->Stream->begin_frame(); // Waits (rarely) until the GPU is done with the region written 3 frames ago.
+#endif
 
     // Backup GL state
     GLenum last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
@@ -562,6 +591,23 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         // - See https://github.com/ocornut/imgui/issues/4468 and please report any corruption issues.
         const GLsizeiptr vtx_buffer_size = (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert);
         const GLsizeiptr idx_buffer_size = (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx);
+        intptr_t idx_buffer_offset = 0;
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+        // [OpenGL_demos] Persistent ring buffer: plain memcpy() into mapped memory, no re-specification and no driver-side copies.
+        ring_allocation vtx_alloc = {}, idx_alloc = {};
+        if (bd->Stream)
+        {
+            vtx_alloc = bd->Stream->allocate(vtx_buffer_size, 4);
+            idx_alloc = bd->Stream->allocate(idx_buffer_size, 4);
+            if (vtx_alloc.buffer != idx_alloc.buffer) // The ring grew in between
+                vtx_alloc = bd->Stream->allocate(vtx_buffer_size, 4);
+            memcpy(vtx_alloc.ptr, cmd_list->VtxBuffer.Data, (size_t)vtx_buffer_size);
+            memcpy(idx_alloc.ptr, cmd_list->IdxBuffer.Data, (size_t)idx_buffer_size);
+            ImGui_ImplOpenGL3_BindStream(vtx_alloc, idx_alloc);
+            idx_buffer_offset = (intptr_t)idx_alloc.offset;
+        }
+        else
+#endif
         if (bd->UseBufferSubData)
         {
             if (bd->VertexBufferSize < vtx_buffer_size)
@@ -591,7 +637,13 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 // User callback, registered via ImDrawList::AddCallback()
                 // (ImDrawCallback_ResetRenderState is a special callback value used by the user to request the renderer to reset render state.)
                 if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
+                {
                     ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+                    if (bd->Stream)
+                        ImGui_ImplOpenGL3_BindStream(vtx_alloc, idx_alloc);
+#endif
+                }
                 else
                     pcmd->UserCallback(cmd_list, pcmd);
             }
@@ -610,10 +662,10 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 GL_CALL(glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->GetTexID()));
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
                 if (bd->GlVersion >= 320)
-                    GL_CALL(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset));
+                    GL_CALL(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(idx_buffer_offset + pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset));
                 else
 #endif
-                GL_CALL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx))));
+                GL_CALL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(idx_buffer_offset + pcmd->IdxOffset * sizeof(ImDrawIdx))));
             }
         }
     }
@@ -622,6 +674,10 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
 #ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
     GL_CALL(glDeleteVertexArrays(1, &vertex_array_object));
 #endif
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+    if (bd->Stream)
+        bd->Stream->end_frame(); // Fence this frame's region
+#endif
 
     // Restore modified GL state
     // This "glIsProgram()" check is required because if the program is "pending deletion" at the time of binding backup, it will have been deleted by now and will cause an OpenGL error. See #6220.
@@ -660,6 +716,9 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
 
     glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
     glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+    bd->SubmitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submit_start).count();
+#endif
     (void)bd; // Not all compilation paths use this
 }
 
@@ -924,6 +983,10 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
     // Create buffers
     glGenBuffers(1, &bd->VboHandle);
     glGenBuffers(1, &bd->ElementsHandle);
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+    if (bd->GlVersion >= 450)
+        bd->Stream = IM_NEW(ring_buffer)(256 * 1024, "imgui stream"); // Per frame, grows if needed
+#endif
 
     ImGui_ImplOpenGL3_CreateFontsTexture();
 
@@ -945,10 +1008,33 @@ void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
     if (bd->VboHandle)      { glDeleteBuffers(1, &bd->VboHandle); bd->VboHandle = 0; }
     if (bd->ElementsHandle) { glDeleteBuffers(1, &bd->ElementsHandle); bd->ElementsHandle = 0; }
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+    if (bd->Stream)         { IM_DELETE(bd->Stream); bd->Stream = nullptr; }
+#endif
     if (bd->ShaderHandle)   { glDeleteProgram(bd->ShaderHandle); bd->ShaderHandle = 0; }
     ImGui_ImplOpenGL3_DestroyFontsTexture();
 }
 
+ImGui_ImplOpenGL3_StreamStats ImGui_ImplOpenGL3_GetStreamStats()
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    ImGui_ImplOpenGL3_StreamStats stats = {};
+    if (bd == nullptr)
+        return stats;
+    stats.SubmitMs = bd->SubmitMs;
+#ifdef IMGUI_IMPL_OPENGL_USE_RING_BUFFER
+    if (bd->Stream)
+    {
+        stats.UsesRingBuffer = true;
+        stats.FenceWaitMs = (float)bd->Stream->last_wait_ms();
+        stats.FenceStalls = bd->Stream->stall_count();
+        stats.BytesUsed = (size_t)bd->Stream->bytes_used();
+        stats.BytesPerFrame = (size_t)bd->Stream->frame_capacity();
+    }
+#endif
+    return stats;
+}
+
 //-----------------------------------------------------------------------------
 
 #if defined(__GNUC__)
@@ -41,6 +41,18 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateDeviceObjects();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyDeviceObjects();
 
+// [OpenGL_demos] Statistics of the vertex/index streaming (persistently mapped ring buffer, when the GLEW loader and GL 4.5+ are used).
+struct ImGui_ImplOpenGL3_StreamStats
+{
+    bool    UsesRingBuffer;     // False: fallback to glBufferData() every frame
+    float   SubmitMs;           // CPU time of the last ImGui_ImplOpenGL3_RenderDrawData()
+    float   FenceWaitMs;        // Part of it spent waiting on the GPU (fence of the reused region)
+    int     FenceStalls;        // Frames that had to wait so far
+    size_t  BytesUsed;          // Streamed in the last frame
+    size_t  BytesPerFrame;      // Capacity of a ring region
+};
+IMGUI_IMPL_API ImGui_ImplOpenGL3_StreamStats ImGui_ImplOpenGL3_GetStreamStats();
+
 // Configuration flags to add in your imconfig file:
 //#define IMGUI_IMPL_OPENGL_ES2     // Enable ES 2 (Auto-detected on Emscripten)
 //#define IMGUI_IMPL_OPENGL_ES3     // Enable ES 3 (Auto-detected on iOS/Android)
@@ -0,0 +1,220 @@
+#ifndef APP_H
+#define APP_H
+
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<chrono>
+
+#include"trace.h"
+
+#if defined(__linux__)
+#include<sys/resource.h>
+#endif
+//The headless path is compiled in with -DAPP_HAS_EGL (and linked with -lEGL). CMake defines it when it finds EGL.
+#ifdef APP_HAS_EGL
+#include<EGL/egl.h>
+#include<EGL/eglext.h>
+#endif
+
+//Startup layer of the demos, so that every demo can also run without a display (CI, remote machines, benchmarks) :
+//    ./d24_shadow_from_dir_light --headless [--frames N]
+//Each demo calls the app_* functions where it used to call glfwInit(), glfwCreateWindow(), glewInit(), glfwSwapBuffers() and
+//glfwTerminate(). Without --headless they do exactly that. With --headless :
+//- glfw runs on its null platform (GLFW 3.4), so windows, monitors, input and callbacks exist but nothing is shown.
+//- The OpenGL 4.5 core context comes from EGL on a surfaceless display (EGL_MESA_platform_surfaceless, e.g. Mesa's llvmpipe), with an
+//  offscreen pbuffer of the window's framebuffer size as the default framebuffer. Every draw to fbo 0 lands there.
+//- Every app_swap_buffers() finishes the frame and advances glfwGetTime() by 1/60 sec, so the animations don't depend on the speed
+//  of the machine. After N frames (default 300) the window is told to close, and the demo exits normally through its own clean up.
+//With --trace <file.json> the trace recorder (trace.h) is on from the start and its events are written to the file at app_terminate().
+struct app_state
+{
+    bool headless = false;
+    int frames = 300; //Frames to render in headless mode.
+    int frame = 0;
+    int argc = 0;
+    char **argv = nullptr;
+    const char *trace_path = nullptr;
+    std::chrono::steady_clock::time_point start;
+#ifdef APP_HAS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+};
+
+inline app_state app;
+
+//Parse the command line and initialize glfw (on its null platform in headless mode). Returns what glfwInit() returns.
+inline int app_init(int argc, char **argv)
+{
+    app.argc = argc;
+    app.argv = argv;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+            app.headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            app.frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            app.trace_path = argv[++i];
+    }
+    if (app.trace_path != nullptr)
+    {
+        trace_recorder::instance().set_thread_name("main");
+        trace_recorder::instance().set_enabled(true);
+    }
+    if (!app.headless)
+        return glfwInit();
+
+#if !defined(APP_HAS_EGL) || GLFW_VERSION_MAJOR < 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR < 4)
+#ifndef APP_HAS_EGL
+    fprintf(stderr, "Error : --headless needs a build with EGL (APP_HAS_EGL, which CMake defines when it finds EGL). Exiting...\n");
+#else
+    fprintf(stderr, "Error : --headless needs GLFW 3.4 or newer. Exiting...\n");
+#endif
+    exit(EXIT_FAILURE);
+#else
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    int ok = glfwInit();
+    app.start = std::chrono::steady_clock::now();
+    return ok;
+#endif
+}
+
+inline bool app_is_headless()
+{
+    return app.headless;
+}
+
+//The argument after 'name' on the command line (e.g. "--capture out/d26_"), or NULL if the option wasn't given.
+inline const char *app_option(const char *name)
+{
+    for (int i = 1; i + 1 < app.argc; i++)
+        if (strcmp(app.argv[i], name) == 0)
+            return app.argv[i + 1];
+    return NULL;
+}
+
+//Peak resident memory of the process so far [MB] (-1 where it isn't available).
+inline double app_peak_rss_mb()
+{
+#if defined(__linux__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss/1024.0; //[KB] on Linux.
+#endif
+    return -1.0;
+}
+
+#ifdef APP_HAS_EGL
+//Surfaceless EGL display, a pbuffer of 'width' x 'height' and a 4.5 core context, made current. False on failure.
+inline bool app_create_egl_context(int width, int height)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display == NULL)
+        return false;
+    app.display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (app.display == EGL_NO_DISPLAY || !eglInitialize(app.display, NULL, NULL))
+        return false;
+
+    const EGLint config_attribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                      EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+                                      EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8, EGL_NONE };
+    EGLConfig config;
+    EGLint configs = 0;
+    if (!eglChooseConfig(app.display, config_attribs, &config, 1, &configs) || configs == 0)
+        return false;
+
+    const EGLint surface_attribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    app.surface = eglCreatePbufferSurface(app.display, config, surface_attribs);
+    if (app.surface == EGL_NO_SURFACE || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    const EGLint context_attribs[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+                                       EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    app.context = eglCreateContext(app.display, config, EGL_NO_CONTEXT, context_attribs);
+    if (app.context == EGL_NO_CONTEXT)
+        return false;
+    return eglMakeCurrent(app.display, app.surface, app.surface, app.context);
+}
+#endif
+
+//glfwCreateWindow(). In headless mode the window has no context of its own : The EGL context (current on return) renders offscreen.
+inline GLFWwindow *app_create_window(int width, int height, const char *title, GLFWmonitor *monitor, GLFWwindow *share)
+{
+    if (!app.headless)
+        return glfwCreateWindow(width, height, title, monitor, share);
+
+#ifdef APP_HAS_EGL
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    GLFWwindow *window = glfwCreateWindow(width, height, title, monitor, share);
+    if (window == NULL)
+        return NULL;
+    int fb_width, fb_height;
+    glfwGetFramebufferSize(window, &fb_width, &fb_height);
+    if (!app_create_egl_context(fb_width, fb_height))
+    {
+        fprintf(stderr, "Error : Failed to create a surfaceless EGL context (0x%x).\n", eglGetError());
+        glfwDestroyWindow(window);
+        return NULL;
+    }
+    return window;
+#else
+    return NULL;
+#endif
+}
+
+//glewInit(). In headless mode there is no glfw context to query, so glew loads the entry points of the current (EGL) context.
+inline GLenum app_glew_init()
+{
+    if (!app.headless)
+        return glewInit();
+    return glewContextInit();
+}
+
+//glfwSwapBuffers(). In headless mode : Finish the frame, step the clock and close the window after the requested frames.
+inline void app_swap_buffers(GLFWwindow *window)
+{
+    if (!app.headless)
+    {
+        glfwSwapBuffers(window);
+        return;
+    }
+    glFinish();
+    ++app.frame;
+    glfwSetTime(app.frame/60.0);
+    if (app.frame >= app.frames)
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+}
+
+//glfwTerminate(), after releasing the EGL context in headless mode (and writing the trace, with --trace).
+inline void app_terminate()
+{
+    if (app.trace_path != nullptr)
+        trace_recorder::instance().write(app.trace_path);
+#ifdef APP_HAS_EGL
+    if (app.display != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(app.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (app.context != EGL_NO_CONTEXT)
+            eglDestroyContext(app.display, app.context);
+        if (app.surface != EGL_NO_SURFACE)
+            eglDestroySurface(app.display, app.surface);
+        eglTerminate(app.display);
+        app.display = EGL_NO_DISPLAY;
+        app.context = EGL_NO_CONTEXT;
+        app.surface = EGL_NO_SURFACE;
+    }
+#endif
+    if (app.headless && app.frame > 0)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - app.start).count();
+        printf("Rendered %d frames in %.2f sec (%.2f ms per frame).\n", app.frame, seconds, 1000.0*seconds/app.frame);
+    }
+    glfwTerminate();
+}
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include<GL/glew.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<cstdio>
+#include<cmath>
+#include<string>
+#include<algorithm>
+#include<random>
+
+#include"gl_objects.h"
+#include"shader.h"
+
+//Cascaded shadow map of a directional light. Instead of 1 huge map over a fixed box, the camera frustum is split in depth ranges (cascades)
+//and each range gets its own small orthographic map, fitted around it. Near the camera a texel then covers a few millimeters, far away
+//a lot more, which is what the eye can tell apart anyway. All cascades live in the layers of 1 depth array texture and are rendered in
+//a single pass (../shaders/geometry/shadow_cascades.geom sends every triangle to every layer).
+//Every cascade is fitted with a bounding sphere of its frustum slice, so its size doesn't change as the camera turns, and its origin is
+//snapped to whole texels, so moving the camera doesn't make the shadow edges crawl.
+//The depth texture is sampled with hardware comparison (a sampler2DArrayShadow) and linear filtering, so every tap of the lit shader
+//already returns the lit fraction of a 2x2 texel footprint (bilinear pcf). A small tiled noise texture rotates the shader's Poisson disk
+//per pixel, which turns the banding of few taps into fine noise.
+//Usage per frame : update(), render_begin() + draw the casters with the depth shader + set_uniforms() on it, then bind(), bind_noise() and
+//set_uniforms() for the lit pass (shaders compiled with SHADOW_CASCADES defined as get_cascade_count()).
+class cascaded_shadow_map
+{
+public:
+    static const int max_cascades = 4;
+
+private:
+    gl_texture tex;
+    gl_texture noise; //(cos, sin) of a random rotation angle per texel, tiled over the screen.
+    gl_framebuffer fbo;
+    int cascades = 0;
+    int resolution = 0;
+
+    float split_lambda = 0.75f; //0 : uniform splits, 1 : logarithmic splits.
+    float caster_margin = 50.0f; //How far behind a cascade (towards the light) casters are still caught.
+    glm::vec3 scene_center = glm::vec3(0.0f);
+    float scene_radius = 0.0f; //Bounding sphere of everything that can cast or receive shadows (0 : unknown).
+    float splits[max_cascades] = {}; //View depth where each cascade ends.
+    float radii[max_cascades] = {}; //Radius of each cascade's bounding sphere.
+    glm::mat4 pv[max_cascades]; //Light's projection*view of each cascade.
+
+public:
+    cascaded_shadow_map() {}
+
+    //'cascades' layers of 'resolution'^2 texels each (32 bit float depth).
+    cascaded_shadow_map(int cascades, int resolution) : tex(GL_TEXTURE_2D_ARRAY), noise(GL_TEXTURE_2D), fbo("cascaded shadow map"), cascades(cascades), resolution(resolution)
+    {
+        if (cascades < 1 || cascades > max_cascades)
+        {
+            fprintf(stderr, "Error : A cascaded shadow map needs 1 to %d cascades, not %d. Exiting...\n", max_cascades, cascades);
+            exit(EXIT_FAILURE);
+        }
+        tex.storage_3d(1, GL_DEPTH_COMPONENT32F, resolution, resolution, cascades);
+        tex.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR); //With comparison, linear filtering blends the 4 nearest comparison results.
+        tex.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        tex.parameter(GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        tex.parameter(GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL); //1 (lit) if the reference depth is not behind the stored one.
+        float border_col[] = {1.0f, 1.0f, 1.0f, 1.0f}; //Maximum depth : Outside of a cascade nothing casts a shadow.
+        tex.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        tex.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        tex.parameter(GL_TEXTURE_BORDER_COLOR, border_col);
+        fbo.attach(GL_DEPTH_ATTACHMENT, tex); //All layers, for layered rendering.
+        fbo.no_color_buffer();
+        fbo.check();
+
+        //Random rotations. Fixed seed, so that the noise pattern is the same at every run.
+        const int noise_reso = 32;
+        signed char rotations[2*noise_reso*noise_reso];
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> angle(0.0f, 2.0f*3.14159265f);
+        for (int i = 0; i < noise_reso*noise_reso; i++)
+        {
+            float a = angle(rng);
+            rotations[2*i + 0] = (signed char)std::lround(127.0f*std::cos(a));
+            rotations[2*i + 1] = (signed char)std::lround(127.0f*std::sin(a));
+        }
+        noise.storage_2d(1, GL_RG8_SNORM, noise_reso, noise_reso);
+        glTextureSubImage2D(noise.get_id(), 0, 0,0, noise_reso,noise_reso, GL_RG, GL_BYTE, rotations);
+        noise.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        noise.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        noise.parameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+        noise.parameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+
+    //Fit the cascades to the part [near_dist, far_dist] of the camera frustum ('fov' is vertical, in degrees). 'light_dir' points towards the light.
+    void update(const glm::mat4 &view, float fov, float aspect, float near_dist, float far_dist, const glm::vec3 &light_dir)
+    {
+        //Practical split scheme : A blend of logarithmic splits (constant ratio, ideal for perspective aliasing) and uniform splits.
+        for (int i = 0; i < cascades; i++)
+        {
+            float p = (float)(i + 1)/cascades;
+            float log_split = near_dist*std::pow(far_dist/near_dist, p);
+            float uni_split = near_dist + (far_dist - near_dist)*p;
+            splits[i] = split_lambda*log_split + (1.0f - split_lambda)*uni_split;
+        }
+
+        glm::mat4 inv_view = glm::inverse(view);
+        float tan_y = std::tan(0.5f*glm::radians(fov)), tan_x = aspect*tan_y;
+        glm::vec3 dir = glm::normalize(light_dir);
+        glm::vec3 up = (std::fabs(dir.z) > 0.999f) ? glm::vec3(0.0f,1.0f,0.0f) : glm::vec3(0.0f,0.0f,1.0f);
+        for (int i = 0; i < cascades; i++)
+        {
+            //The 8 corners of the frustum slice, in world coordinates.
+            float d[2] = {(i == 0) ? near_dist : splits[i - 1], splits[i]};
+            glm::vec3 corners[8];
+            glm::vec3 center = glm::vec3(0.0f);
+            for (int k = 0; k < 8; k++)
+            {
+                float z = d[k/4];
+                glm::vec4 corner = glm::vec4(((k & 1) ? 1.0f : -1.0f)*tan_x*z, ((k & 2) ? 1.0f : -1.0f)*tan_y*z, -z, 1.0f);
+                corners[k] = glm::vec3(inv_view*corner);
+                center += corners[k]/8.0f;
+            }
+            float radius = 0.0f;
+            for (int k = 0; k < 8; k++)
+                radius = std::max(radius, glm::length(corners[k] - center));
+            radius = std::ceil(radius*16.0f)/16.0f; //Round, so that float noise doesn't change the size from frame to frame.
+            if (scene_radius > 0.0f && scene_radius < radius) //The whole scene is smaller than the slice : Fit the scene instead.
+            {
+                center = scene_center;
+                radius = scene_radius;
+            }
+            radii[i] = radius;
+
+            //Look at the sphere from the light, far enough back to catch the casters in front of it.
+            glm::mat4 light_view = glm::lookAt(center + (radius + caster_margin)*dir, center, up);
+            glm::mat4 light_projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f*radius + caster_margin);
+
+            //Snap to whole texels : Shift the projection so that the world origin lands on a texel corner.
+            glm::vec4 origin = light_projection*light_view*glm::vec4(0.0f,0.0f,0.0f,1.0f);
+            glm::vec2 texel_origin = glm::vec2(origin)*(0.5f*resolution);
+            glm::vec2 offset = (glm::round(texel_origin) - texel_origin)*(2.0f/resolution);
+            light_projection[3][0] += offset.x;
+            light_projection[3][1] += offset.y;
+            pv[i] = light_projection*light_view;
+        }
+    }
+
+    //Take over the cascades of another map (of the same resolution), instead of fitting them again. E.g. for a second map with the dynamic
+    //casters only, next to a cached one with the static casters.
+    void copy_cascades(const cascaded_shadow_map &other)
+    {
+        for (int i = 0; i < cascades; i++)
+        {
+            splits[i] = other.splits[i];
+            radii[i] = other.radii[i];
+            pv[i] = other.pv[i];
+        }
+    }
+
+    //Bind the fbo, set the viewport and clear every cascade. Then draw the shadow casters with the layered depth shader.
+    void render_begin()
+    {
+        fbo.bind();
+        glViewport(0,0, resolution,resolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    //Bind the depth array texture for sampling (through a sampler2DArrayShadow).
+    void bind(unsigned int unit) const
+    {
+        tex.bind(unit);
+    }
+
+    //Bind the rotation noise texture (a sampler2D).
+    void bind_noise(unsigned int unit) const
+    {
+        noise.bind(unit);
+    }
+
+    //Upload the cascade matrices and splits (and the sampler units, if given) to a program. The program is made current.
+    void set_uniforms(shader &program, int unit = -1, int noise_unit = -1)
+    {
+        program.use();
+        for (int i = 0; i < cascades; i++)
+        {
+            std::string index = "[" + std::to_string(i) + "]";
+            program.set_mat4_uniform("cascade_pv" + index, pv[i]);
+            program.set_float_uniform("cascade_splits" + index, splits[i]);
+        }
+        if (unit >= 0)
+            program.set_int_uniform("sample_shadow", unit);
+        if (noise_unit >= 0)
+            program.set_int_uniform("shadow_noise", noise_unit);
+    }
+
+    //Bounding sphere of the scene. Cascades never get larger than it (for small scenes seen from afar).
+    void set_scene_bounds(const glm::vec3 &center, float radius)
+    {
+        scene_center = center;
+        scene_radius = radius;
+    }
+
+    void set_split_lambda(float lambda)
+    {
+        split_lambda = lambda;
+    }
+
+    void set_caster_margin(float margin)
+    {
+        caster_margin = margin;
+    }
+
+    int get_cascade_count() const
+    {
+        return cascades;
+    }
+
+    int get_resolution() const
+    {
+        return resolution;
+    }
+
+    float get_split(int cascade) const
+    {
+        return splits[cascade];
+    }
+
+    const glm::mat4 &get_matrix(int cascade) const
+    {
+        return pv[cascade];
+    }
+
+    //World size of a texel of a cascade (the shadow resolution there).
+    float get_texel_size(int cascade) const
+    {
+        return 2.0f*radii[cascade]/resolution;
+    }
+
+    long long memory_bytes() const
+    {
+        return 4LL*resolution*resolution*cascades;
+    }
+};
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include<GL/glew.h>
+#include<glm/glm.hpp>
+#include<cstdio>
+#include<cstdlib>
+#include<cstdint>
+#include<cmath>
+#include<vector>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"shader.h"
+
+//A point light of clustered_lights (std430 layout of 'light' in the shaders).
+struct point_light
+{
+    glm::vec4 pos_radius; //World position (xyz) and radius of influence (w) : The light fades to 0 there.
+    glm::vec4 col; //Color times intensity (rgb).
+};
+
+//Clustered forward shading of many point lights. The view frustum is cut into a grid of clusters ("froxels") : grid_x x grid_y tiles on the
+//screen, times grid_z slices of view depth (exponentially spaced, so that clusters are about as deep as they are wide). Every frame a
+//compute shader (../shaders/compute/cluster_lights.comp) lists for every cluster the lights whose sphere of influence touches it, and the
+//fragment shader (../shaders/fragment/point_light_clustered.frag) finds its cluster from its screen position and depth and shades with
+//those lights only. So the cost of a fragment depends on the lights near it, not on the total : Thousands of lights in 1 forward pass.
+//The lights live in a shader storage buffer, uploaded by the application whenever they change (e.g. every frame, if they move). The build
+//takes 2 dispatches : The lights are moved to view space, then 1 work group per cluster tests all of them against the cluster's bounds
+//(an axis aligned box in view space, computed on the cpu when the projection changes) and gathers the touching ones in shared memory,
+//then copies them into 1 index buffer for all clusters. So the lists are packed : Far clusters (which are large) can hold many lights
+//without every cluster reserving room for as many. A list holds up to max_per_cluster lights and all lists up to max_index_count.
+//Lights past either are dropped, which get_saturated_count() reports.
+//Usage per frame : set_lights(), build(), then bind() on the lit program (before drawing).
+class clustered_lights
+{
+public:
+    static constexpr int grid_x = 16, grid_y = 9, grid_z = 24;
+    static constexpr int cluster_count = grid_x*grid_y*grid_z;
+    static constexpr int max_per_cluster = 1024; //The gathering list of a work group, in shared memory.
+    static constexpr int max_index_count = 128*cluster_count;
+
+private:
+    //Shader storage bindings. 0 to 3 are taken by the instances and the gpu culling.
+    static constexpr int lights_binding = 4, view_lights_binding = 5, bounds_binding = 6, lists_binding = 7, indices_binding = 8, stats_binding = 9;
+    static const int readback_frames = 3; //The statistics are read this many frames late, so the cpu never waits for them.
+
+    compute_shader transform_program, cluster_program;
+    gl_buffer light_buffer, view_light_buffer, bounds_buffer, list_buffer, index_buffer, stats_buffer, readback_buffer;
+    const uint32_t *readback = nullptr; //Persistent mapping of readback_buffer.
+    GLsync readback_fences[readback_frames] = {};
+    int frame = 0;
+    int capacity = 0, lights = 0;
+
+    //The projection the bounds were computed for.
+    glm::mat4 bounds_projection = glm::mat4(0.0f);
+    float near_plane = 0.0f, far_plane = 0.0f;
+
+    //Statistics, readback_frames frames late (-1 : Not known yet).
+    int max_count = -1, total_count = -1, saturated = -1;
+
+    //View space bounds of every cluster, as (min, max) pairs.
+    void compute_bounds(const glm::mat4 &projection)
+    {
+        std::vector<glm::vec4> bounds(2*cluster_count);
+        glm::mat4 inv_projection = glm::inverse(projection);
+        for (int z = 0; z < grid_z; z++)
+        {
+            //The slice's depth range. Slices are spaced exponentially between the near and the far plane.
+            float d0 = near_plane*std::pow(far_plane/near_plane, (float)z/grid_z);
+            float d1 = near_plane*std::pow(far_plane/near_plane, (float)(z + 1)/grid_z);
+            for (int y = 0; y < grid_y; y++)
+            {
+                for (int x = 0; x < grid_x; x++)
+                {
+                    glm::vec3 lo = glm::vec3(1e30f), hi = glm::vec3(-1e30f);
+                    for (int k = 0; k < 4; k++)
+                    {
+                        //A corner of the tile on the near plane, in view space : The ray through it, scaled to the slice's depths.
+                        glm::vec2 ndc = glm::vec2(2.0f*(x + (k & 1))/grid_x - 1.0f, 2.0f*(y + (k >> 1))/grid_y - 1.0f);
+                        glm::vec4 p = inv_projection*glm::vec4(ndc, -1.0f, 1.0f);
+                        glm::vec3 ray = glm::vec3(p)/p.w;
+                        ray /= -ray.z; //At depth 1.
+                        lo = glm::min(lo, glm::min(ray*d0, ray*d1));
+                        hi = glm::max(hi, glm::max(ray*d0, ray*d1));
+                    }
+                    int c = (z*grid_y + y)*grid_x + x;
+                    bounds[2*c + 0] = glm::vec4(lo, 0.0f);
+                    bounds[2*c + 1] = glm::vec4(hi, 0.0f);
+                }
+            }
+        }
+        bounds_buffer.upload(0, bounds.size()*sizeof(glm::vec4), bounds.data());
+        bounds_projection = projection;
+    }
+
+    //Queue a copy of this frame's statistics, and pick up the copy made readback_frames frames ago if it has landed.
+    void queue_readback()
+    {
+        int slot = frame%readback_frames;
+        if (readback_fences[slot] != nullptr)
+        {
+            if (glClientWaitSync(readback_fences[slot], 0, 0) != GL_TIMEOUT_EXPIRED)
+            {
+                const uint32_t *s = readback + 4*slot;
+                max_count = (int)s[0];
+                total_count = std::min((int)s[1], max_index_count);
+                saturated = (int)s[2];
+            }
+            glDeleteSync(readback_fences[slot]);
+        }
+        glCopyNamedBufferSubData(stats_buffer.get_id(), readback_buffer.get_id(), 0, (GLintptr)(16*slot), 16);
+        readback_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++frame;
+    }
+
+public:
+    //'cluster_shader_path' is the path of cluster_lights.comp. Up to 'max_lights' lights.
+    clustered_lights(const char *cluster_shader_path, int max_lights) :
+        transform_program(cluster_shader_path, {"TRANSFORM_LIGHTS"}), cluster_program(cluster_shader_path), capacity(max_lights)
+    {
+        light_buffer = gl_buffer((long long)capacity*sizeof(point_light), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        view_light_buffer = gl_buffer((long long)capacity*sizeof(glm::vec4), nullptr);
+        bounds_buffer = gl_buffer(2LL*cluster_count*sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        list_buffer = gl_buffer(2LL*cluster_count*sizeof(uint32_t), nullptr);
+        index_buffer = gl_buffer((long long)max_index_count*sizeof(uint32_t), nullptr);
+        stats_buffer = gl_buffer(16, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        readback_buffer = gl_buffer(16*readback_frames, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        readback = (const uint32_t*)glMapNamedBufferRange(readback_buffer.get_id(), 0, 16*readback_frames, flags);
+        if (readback == nullptr)
+        {
+            fprintf(stderr, "Error : Failed to map the light cluster readback buffer. Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ~clustered_lights()
+    {
+        for (int i = 0; i < readback_frames; i++)
+            if (readback_fences[i] != nullptr)
+                glDeleteSync(readback_fences[i]);
+    }
+
+    clustered_lights(const clustered_lights &) = delete;
+    clustered_lights &operator=(const clustered_lights &) = delete;
+
+    //Upload the lights (at most the capacity given to the constructor).
+    void set_lights(const point_light *data, int count)
+    {
+        lights = std::min(count, capacity);
+        if (lights > 0)
+            light_buffer.upload(0, (long long)lights*sizeof(point_light), data);
+    }
+
+    void set_lights(const std::vector<point_light> &data)
+    {
+        set_lights(data.data(), (int)data.size());
+    }
+
+    //Assign the lights to the clusters of the view frustum ('near_dist' and 'far_dist' are the planes of the perspective 'projection').
+    //Nothing waits : The lists are ready for the lit pass once the compute passes have run.
+    void build(const glm::mat4 &view, const glm::mat4 &projection, float near_dist, float far_dist)
+    {
+        if (projection != bounds_projection || near_dist != near_plane || far_dist != far_plane)
+        {
+            near_plane = near_dist;
+            far_plane = far_dist;
+            compute_bounds(projection);
+        }
+        const uint32_t zero[4] = {0, 0, 0, 0};
+        stats_buffer.upload(0, sizeof(zero), zero);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, lights_binding, light_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, view_lights_binding, view_light_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bounds_binding, bounds_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, lists_binding, list_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indices_binding, index_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, stats_binding, stats_buffer.get_id());
+
+        unsigned int program = transform_program.get_id();
+        glProgramUniformMatrix4fv(program, glGetUniformLocation(program, "view"), 1, GL_FALSE, &view[0][0]);
+        glProgramUniform1ui(program, glGetUniformLocation(program, "light_count"), (unsigned int)lights);
+        transform_program.dispatch(((unsigned int)lights + 63)/64);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        program = cluster_program.get_id();
+        glProgramUniform1ui(program, glGetUniformLocation(program, "light_count"), (unsigned int)lights);
+        glProgramUniform1ui(program, glGetUniformLocation(program, "index_capacity"), (unsigned int)max_index_count);
+        cluster_program.dispatch(cluster_count);
+        //The lists are read by the fragment shader, the statistics by the readback copy.
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        queue_readback();
+    }
+
+    //Bind the lights and the cluster lists, and set the uniforms that locate a fragment's cluster ('width' x 'height' : The viewport).
+    //The program is made current.
+    void bind(shader &program, int width, int height)
+    {
+        program.use();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, lights_binding, light_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, lists_binding, list_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indices_binding, index_buffer.get_id());
+        program.set_vec2_uniform("cluster_tile_size", (float)width/grid_x, (float)height/grid_y);
+        //slice = log(depth/near)*grid_z/log(far/near) = log(depth)*scale + bias.
+        float scale = grid_z/std::log(far_plane/near_plane);
+        program.set_float_uniform("cluster_depth_scale", scale);
+        program.set_float_uniform("cluster_depth_bias", -std::log(near_plane)*scale);
+        program.set_int_uniform("light_count", lights);
+    }
+
+    int light_count() const
+    {
+        return lights;
+    }
+
+    int get_capacity() const
+    {
+        return capacity;
+    }
+
+    //Most lights that touched 1 cluster, cluster-light pairs stored in total and clusters that lost lights (to max_per_cluster or
+    //max_index_count), readback_frames frames ago (-1 until the first result arrives).
+    int get_max_count() const
+    {
+        return max_count;
+    }
+
+    int get_total_count() const
+    {
+        return total_count;
+    }
+
+    int get_saturated_count() const
+    {
+        return saturated;
+    }
+
+    long long memory_bytes() const
+    {
+        return (long long)capacity*(sizeof(point_light) + sizeof(glm::vec4)) + 2LL*cluster_count*sizeof(glm::vec4) +
+               (2LL*cluster_count + max_index_count)*sizeof(uint32_t);
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef EVSM_FILTER_H
+#define EVSM_FILTER_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstdlib>
+
+#include"gl_objects.h"
+#include"shader.h"
+#include"cascaded_shadow_map.h"
+
+//Turns the depth of a cascaded shadow map into an exponential variance shadow map (EVSM, see ../shaders/common/evsm.glsl) : Moments
+//of the warped depth in a 16 bit float array texture, optionally at a lower resolution, blurred with a separable Gaussian and mipmapped.
+//The lit shader (compiled with SHADOW_EVSM) then makes 1 filtered fetch per fragment instead of many depth comparisons. The cost of
+//soft edges moves from every pixel of every frame to every texel of the map, and is only paid when the map was rendered.
+//Usage : allocate() for a map (and again whenever the map is re-created), then filter() after every depth pass and bind() for the lit pass.
+class evsm_filter
+{
+private:
+    compute_shader moments_program, blur_program;
+    gl_texture moments, scratch; //Final moments (mipmapped) and the middle pass of the blur.
+    unsigned int depth_sampler = 0; //Reads the depth without the comparison that the lit pass of the pcf path needs.
+    int cascades = 0, resolution = 0, levels = 0;
+    int downsample = 1;
+    int blur_radius = 2; //[moments texels]
+
+    static int groups(int size)
+    {
+        return (size + 7)/8;
+    }
+
+public:
+    //'shader_path' : ../shaders/compute/evsm.comp (both passes are compiled from it).
+    evsm_filter(const char *shader_path) : moments_program(shader_path), blur_program(shader_path, {"EVSM_BLUR"})
+    {
+        glCreateSamplers(1, &depth_sampler);
+        glSamplerParameteri(depth_sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glSamplerParameteri(depth_sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glSamplerParameteri(depth_sampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    }
+
+    ~evsm_filter()
+    {
+        glDeleteSamplers(1, &depth_sampler);
+    }
+
+    evsm_filter(const evsm_filter &) = delete;
+    evsm_filter &operator=(const evsm_filter &) = delete;
+
+    //Create the moments textures for 'map', at 1/'downsample' of its resolution (blurring a smaller map is cheaper and just as soft).
+    void allocate(const cascaded_shadow_map &map, int downsample = 2)
+    {
+        if (downsample < 1 || map.get_resolution()%downsample != 0)
+        {
+            fprintf(stderr, "Error : The shadow map resolution (%d) must be a multiple of the EVSM downsampling (%d). Exiting...\n", map.get_resolution(), downsample);
+            exit(EXIT_FAILURE);
+        }
+        this->downsample = downsample;
+        cascades = map.get_cascade_count();
+        resolution = map.get_resolution()/downsample;
+        levels = gl_texture::mip_levels(resolution, resolution);
+
+        moments = gl_texture(GL_TEXTURE_2D_ARRAY);
+        moments.storage_3d(levels, GL_RGBA16F, resolution, resolution, cascades);
+        moments.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        moments.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        moments.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        moments.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (GLEW_EXT_texture_filter_anisotropic)
+            moments.parameter(GL_TEXTURE_MAX_ANISOTROPY, 8);
+
+        scratch = gl_texture(GL_TEXTURE_2D_ARRAY);
+        scratch.storage_3d(1, GL_RGBA16F, resolution, resolution, cascades);
+    }
+
+    //Depth to moments, blur (horizontal, then vertical) and mipmaps. Call after rendering the map's depth.
+    void filter(const cascaded_shadow_map &map)
+    {
+        map.bind(0);
+        glBindSampler(0, depth_sampler);
+        glBindImageTexture(0, moments.get_id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        moments_program.use();
+        glUniform1i(glGetUniformLocation(moments_program.get_id(), "downsample"), downsample);
+        moments_program.dispatch(groups(resolution), groups(resolution), cascades);
+        glBindSampler(0, 0);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        if (blur_radius > 0)
+        {
+            blur_program.use();
+            glUniform1i(glGetUniformLocation(blur_program.get_id(), "radius"), blur_radius);
+            int direction = glGetUniformLocation(blur_program.get_id(), "direction");
+
+            moments.bind(0);
+            glBindImageTexture(0, scratch.get_id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+            glUniform2i(direction, 1, 0);
+            blur_program.dispatch(groups(resolution), groups(resolution), cascades);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+            scratch.bind(0);
+            glBindImageTexture(0, moments.get_id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+            glUniform2i(direction, 0, 1);
+            blur_program.dispatch(groups(resolution), groups(resolution), cascades);
+        }
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT); //The image stores must land before the mipmaps and the lit pass read them.
+        glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glBindTextureUnit(0, 0);
+
+        glGenerateTextureMipmap(moments.get_id());
+    }
+
+    //Bind the moments for the lit pass (its 'sample_shadow' is a sampler2DArray under SHADOW_EVSM).
+    void bind(unsigned int unit) const
+    {
+        moments.bind(unit);
+    }
+
+    //Radius of the Gaussian blur, in moments texels (0 : no blur, the mipmaps and bilinear filtering only).
+    void set_blur_radius(int radius)
+    {
+        blur_radius = radius;
+    }
+
+    int get_blur_radius() const
+    {
+        return blur_radius;
+    }
+
+    int get_resolution() const
+    {
+        return resolution;
+    }
+
+    //Moments (with mipmaps) and the blur's scratch texture.
+    long long memory_bytes() const
+    {
+        long long texels = 0;
+        for (int size = resolution; size >= 1; size /= 2)
+            texels += (long long)size*size;
+        return 8LL*cascades*(texels + (long long)resolution*resolution);
+    }
+};
+
+#endif
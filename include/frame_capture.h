@@ -0,0 +1,478 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<vector>
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<chrono>
+#include<filesystem>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"trace.h"
+
+//Records the rendered frames as an image sequence (../capture/d26_000000.png, ...), without stalling the pipeline. A plain glReadPixels()
+//into client memory waits until the gpu has finished the frame, every frame. Here the frame is read into a pixel pack buffer instead (the
+//copy is queued like any other command) and a fence is inserted. The buffer is only looked at a few frames later, once its fence has
+//signaled, and copied into a cpu buffer for the encoder threads, which write the files.
+//Memory is bounded : 'slots' pack buffers on the gpu side and at most 'max_buffers' frames waiting for (or in) the encoders. When the gpu is
+//still busy with the slot the next frame needs, or the encoders fall behind and all the cpu buffers are taken, the frame is dropped
+//(and counted) rather than waited for. The frame numbers in the file names keep counting, so drops show up as gaps.
+//Formats : png (uncompressed deflate, i.e. cheap to write but big : recompress offline) or raw (RGBA8, top row first, e.g. for
+//ffmpeg -f rawvideo -pix_fmt rgba -s WxH). The alpha channel of png files is forced to opaque.
+//Usage per frame : capture() after the scene is drawn into fbo 0 (before the ui, if it shouldn't be recorded), between start() and stop().
+class frame_capture
+{
+public:
+    enum format { png = 0, raw = 1 };
+    static const int slots = 4; //Pack buffers in the ring : A frame is mapped about 'slots' - 1 frames after it was read.
+
+private:
+    struct slot
+    {
+        gl_buffer pbo;
+        const unsigned char *mapped = nullptr; //Persistent mapping.
+        GLsync fence = nullptr;
+        long long frame = 0;
+        int width = 0, height = 0;
+    };
+
+    struct job
+    {
+        std::vector<unsigned char> pixels; //RGBA8, bottom row first (as OpenGL reads them).
+        int width = 0, height = 0;
+        std::string path;
+        format fmt = png;
+    };
+
+    slot ring[slots];
+    int head = 0; //Next slot to read into (also the oldest one in flight).
+    long long slot_bytes = 0;
+    bool synchronous = false; //glReadPixels() straight into client memory, for comparison.
+
+    std::string prefix; //Of the file names.
+    format fmt = png;
+    bool recording = false;
+    long long frame = 0; //Frames since start(), captured or dropped.
+
+    std::mutex mtx; //Guards the members below, which are shared with the encoder threads.
+    std::condition_variable wake;
+    std::deque<job> queue;
+    std::vector<std::vector<unsigned char>> spare; //Cpu buffers that are free again.
+    int buffers = 0, max_buffers;
+    long long buffer_bytes = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    //Statistics.
+    std::atomic<int> written{0}, write_errors{0};
+    int captured = 0, dropped_gpu = 0, dropped_encoder = 0;
+    double cpu_ms = 0.0, cpu_total_ms = 0.0; //Time spent in capture() (last frame / total).
+    int samples = 0;
+
+    static void put_u32(std::vector<unsigned char> &out, unsigned int v)
+    {
+        out.push_back((unsigned char)(v >> 24));
+        out.push_back((unsigned char)(v >> 16));
+        out.push_back((unsigned char)(v >> 8));
+        out.push_back((unsigned char)v);
+    }
+
+    static unsigned int crc32(const unsigned char *data, size_t size, unsigned int crc = 0)
+    {
+        static unsigned int table[256];
+        static bool table_ready = false;
+        static std::mutex table_mtx;
+        {
+            std::lock_guard<std::mutex> lock(table_mtx);
+            if (!table_ready)
+            {
+                for (unsigned int n = 0; n < 256; n++)
+                {
+                    unsigned int c = n;
+                    for (int k = 0; k < 8; k++)
+                        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    table[n] = c;
+                }
+                table_ready = true;
+            }
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    //Append a png chunk (length, type, data, crc of type + data).
+    static void put_chunk(std::vector<unsigned char> &out, const char *type, const std::vector<unsigned char> &data)
+    {
+        put_u32(out, (unsigned int)data.size());
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        put_u32(out, crc32(&out[start], out.size() - start));
+    }
+
+    //Png with 1 IDAT of stored (uncompressed) deflate blocks : Writing it is a copy, compressing would be most of the encoder's time.
+    static bool write_png(const std::string &path, const job &j)
+    {
+        const size_t row = 4*(size_t)j.width;
+        std::vector<unsigned char> scanlines; //Filter byte (0 : none) + row, top row first.
+        scanlines.reserve((row + 1)*j.height);
+        for (int y = j.height - 1; y >= 0; y--)
+        {
+            scanlines.push_back(0);
+            const unsigned char *src = &j.pixels[row*y];
+            for (size_t x = 0; x < row; x += 4)
+            {
+                scanlines.insert(scanlines.end(), src + x, src + x + 3);
+                scanlines.push_back(255);
+            }
+        }
+
+        std::vector<unsigned char> zlib = {0x78, 0x01};
+        zlib.reserve(scanlines.size() + scanlines.size()/65535*5 + 16);
+        size_t pos = 0;
+        do
+        {
+            size_t len = std::min<size_t>(65535, scanlines.size() - pos);
+            zlib.push_back(pos + len == scanlines.size() ? 1 : 0); //BFINAL, BTYPE = 00 (stored).
+            zlib.push_back((unsigned char)len);
+            zlib.push_back((unsigned char)(len >> 8));
+            zlib.push_back((unsigned char)~len);
+            zlib.push_back((unsigned char)(~len >> 8));
+            zlib.insert(zlib.end(), scanlines.begin() + pos, scanlines.begin() + pos + len);
+            pos += len;
+        }
+        while (pos < scanlines.size());
+        unsigned int a = 1, b = 0; //Adler-32.
+        for (unsigned char c : scanlines)
+        {
+            a = (a + c)%65521;
+            b = (b + a)%65521;
+        }
+        put_u32(zlib, (b << 16) | a);
+
+        std::vector<unsigned char> ihdr;
+        put_u32(ihdr, j.width);
+        put_u32(ihdr, j.height);
+        ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0}); //8 bits per channel, RGBA, deflate, filter method 0, no interlace.
+
+        std::vector<unsigned char> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        put_chunk(out, "IHDR", ihdr);
+        put_chunk(out, "IDAT", zlib);
+        put_chunk(out, "IEND", {});
+
+        FILE *file = fopen(path.c_str(), "wb");
+        if (file == NULL)
+            return false;
+        bool ok = (fwrite(out.data(), 1, out.size(), file) == out.size());
+        return (fclose(file) == 0) && ok;
+    }
+
+    static bool write_raw(const std::string &path, const job &j)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        if (file == NULL)
+            return false;
+        const size_t row = 4*(size_t)j.width;
+        bool ok = true;
+        for (int y = j.height - 1; y >= 0 && ok; y--)
+            ok = (fwrite(&j.pixels[row*y], 1, row, file) == row);
+        return (fclose(file) == 0) && ok;
+    }
+
+    void encode_loop()
+    {
+        trace_recorder::instance().set_thread_name("frame encoder");
+        while (true)
+        {
+            job j;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this]{ return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return; //Stopping, and everything has been written.
+                j = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            bool ok;
+            {
+                TRACE_SCOPE((j.fmt == png) ? "encode png" : "write raw");
+                ok = (j.fmt == png) ? write_png(j.path, j) : write_raw(j.path, j);
+            }
+            if (ok)
+                ++written;
+            else if (write_errors++ == 0)
+                fprintf(stderr, "Error : Failed to write the captured frame '%s'.\n", j.path.c_str());
+
+            std::lock_guard<std::mutex> lock(mtx);
+            spare.push_back(std::move(j.pixels));
+        }
+    }
+
+    //A cpu buffer of 'bytes' for the encoders, or null if all of them are taken (the encoders are behind).
+    bool take_buffer(std::vector<unsigned char> &out, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!spare.empty())
+        {
+            out = std::move(spare.back());
+            spare.pop_back();
+        }
+        else if (buffers < max_buffers)
+            ++buffers;
+        else
+            return false;
+        long long before = (long long)out.capacity();
+        out.resize(bytes);
+        buffer_bytes += (long long)out.capacity() - before;
+        return true;
+    }
+
+    void submit(job &&j, long long frame_number)
+    {
+        char number[32];
+        snprintf(number, sizeof(number), "%06lld", frame_number);
+        j.path = prefix + number + ((fmt == png) ? ".png" : ".rgba");
+        j.fmt = fmt;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(std::move(j));
+        }
+        wake.notify_one();
+    }
+
+    //Hand the slots whose fences have signaled to the encoders, oldest first. 'wait' : Wait for all of them, however long it takes
+    //(e.g. at stop(), or before the buffers are re-created).
+    void retire(bool wait)
+    {
+        for (int k = 0; k < slots; k++)
+        {
+            slot &s = ring[(head + k)%slots];
+            if (s.fence == nullptr)
+                continue;
+            GLenum status = glClientWaitSync(s.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+            while (wait && status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(s.fence, 0, 1000000000);
+            if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+                break; //The later slots are even less likely to be done.
+            glDeleteSync(s.fence);
+            s.fence = nullptr;
+
+            job j;
+            if (!take_buffer(j.pixels, 4*(size_t)s.width*s.height))
+            {
+                ++dropped_encoder;
+                continue;
+            }
+            memcpy(j.pixels.data(), s.mapped, j.pixels.size());
+            j.width = s.width;
+            j.height = s.height;
+            ++captured;
+            submit(std::move(j), s.frame);
+        }
+    }
+
+    //(Re)create the pack buffers for frames of up to 'bytes'. After retire(true), so that no slot is in flight.
+    void allocate(long long bytes)
+    {
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        slot_bytes = bytes;
+        for (slot &s : ring)
+        {
+            if (s.fence != nullptr) //Only if the wait failed : Its frame is lost, and the fence must not outlive its buffer.
+            {
+                glDeleteSync(s.fence);
+                s.fence = nullptr;
+                ++dropped_gpu;
+            }
+            s.pbo = gl_buffer(bytes, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+            glObjectLabel(GL_BUFFER, s.pbo.get_id(), -1, "frame capture");
+            s.mapped = (const unsigned char*)glMapNamedBufferRange(s.pbo.get_id(), 0, bytes, flags);
+            if (s.mapped == nullptr)
+            {
+                fprintf(stderr, "Error : Failed to map the frame capture buffers (%lld bytes). Exiting...\n", bytes);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+public:
+    //'encoders' : Threads that write the files. 'max_buffers' : Frames that may wait for (or be in) the encoders at once.
+    frame_capture(int encoders = 2, int max_buffers = 8) : max_buffers(max_buffers)
+    {
+        for (int i = 0; i < encoders; i++)
+            workers.push_back(std::thread(&frame_capture::encode_loop, this));
+    }
+
+    //Hands over the frames in flight and waits for the encoders to write everything.
+    ~frame_capture()
+    {
+        stop();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &w : workers)
+            w.join();
+        //The pack buffers are unmapped when they get deleted.
+    }
+
+    frame_capture(const frame_capture &) = delete;
+    frame_capture &operator=(const frame_capture &) = delete;
+
+    //Start recording into files named 'path_prefix' + frame number (its directory is created if needed).
+    void start(const std::string &path_prefix, format f = png)
+    {
+        stop();
+        std::filesystem::path dir = std::filesystem::path(path_prefix).parent_path();
+        std::error_code ec;
+        if (!dir.empty())
+            std::filesystem::create_directories(dir, ec);
+        prefix = path_prefix;
+        fmt = f;
+        frame = 0;
+        recording = true;
+    }
+
+    //Stop recording : The frames still in flight are waited for and handed to the encoders.
+    void stop()
+    {
+        if (!recording)
+            return;
+        retire(true);
+        recording = false;
+    }
+
+    //Capture the frame in fbo 0 ('width' x 'height', its framebuffer size). Does nothing unless recording.
+    void capture(int width, int height)
+    {
+        if (!recording || width < 1 || height < 1)
+            return;
+        auto t0 = std::chrono::steady_clock::now();
+        const long long bytes = 4LL*width*height;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        if (synchronous)
+        {
+            job j;
+            if (take_buffer(j.pixels, (size_t)bytes))
+            {
+                glReadPixels(0,0, width,height, GL_RGBA, GL_UNSIGNED_BYTE, j.pixels.data()); //Waits for the whole frame to finish.
+                j.width = width;
+                j.height = height;
+                ++captured;
+                submit(std::move(j), frame);
+            }
+            else
+                ++dropped_encoder;
+        }
+        else
+        {
+            retire(false);
+            if (bytes > slot_bytes)
+            {
+                retire(true);
+                allocate(bytes);
+            }
+            slot &s = ring[head];
+            if (s.fence != nullptr)
+                ++dropped_gpu; //The gpu hasn't even finished the frame of 'slots' frames ago.
+            else
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo.get_id());
+                glReadPixels(0,0, width,height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); //Into the buffer, asynchronously.
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                s.width = width;
+                s.height = height;
+                s.frame = frame;
+                head = (head + 1)%slots;
+            }
+        }
+        ++frame;
+
+        cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        cpu_total_ms += cpu_ms;
+        ++samples;
+    }
+
+    bool is_recording() const
+    {
+        return recording;
+    }
+
+    //Read straight into client memory (stalls until the gpu has finished the frame). Only to measure what the pack buffers save.
+    void set_synchronous(bool sync)
+    {
+        if (sync == synchronous)
+            return;
+        retire(true);
+        synchronous = sync;
+    }
+
+    bool is_synchronous() const
+    {
+        return synchronous;
+    }
+
+    //Frames handed to the encoders / written to disk.
+    int captured_count() const
+    {
+        return captured;
+    }
+
+    int written_count() const
+    {
+        return written;
+    }
+
+    //Frames dropped because the gpu was still busy with the slot / because all the encoder buffers were taken.
+    int dropped_gpu_count() const
+    {
+        return dropped_gpu;
+    }
+
+    int dropped_encoder_count() const
+    {
+        return dropped_encoder;
+    }
+
+    //Frames waiting for the encoders.
+    int queued_count()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return (int)queue.size();
+    }
+
+    //Cpu time of capture() (the frame time it adds, apart from the gpu's copy) : Last call / average.
+    double last_ms() const
+    {
+        return cpu_ms;
+    }
+
+    double average_ms() const
+    {
+        return (samples > 0) ? cpu_total_ms/samples : 0.0;
+    }
+
+    //Pack buffers and cpu buffers.
+    long long memory_bytes()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return slots*slot_bytes + buffer_bytes;
+    }
+};
+
+#endif
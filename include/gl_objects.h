@@ -0,0 +1,323 @@
+#ifndef GL_OBJECTS_H
+#define GL_OBJECTS_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstdlib>
+#include<algorithm>
+
+//Thin owning wrappers around OpenGL object names, built on direct state access (OpenGL 4.5). Every object is created with glCreate*()
+//and edited through its name (glNamedBufferStorage(), glTextureStorage2D(), glVertexArrayAttribFormat(), ...), so nothing here ever has to
+//bind an object just to set it up, i.e. no binding is left behind for the next piece of code to trip over. Storage is immutable : To resize
+//something, create a new object and move-assign it (the old name is deleted). The wrappers are move-only, so a name is deleted exactly once.
+
+class gl_object
+{
+protected:
+    unsigned int id = 0; //OpenGL object name. 0 means "nothing owned".
+    void (*release)(unsigned int) = nullptr; //How to delete this kind of object.
+
+    gl_object(unsigned int id, void (*release)(unsigned int)) : id(id), release(release) {}
+
+public:
+    gl_object() {}
+
+    ~gl_object()
+    {
+        if (id != 0 && release != nullptr)
+            release(id);
+    }
+
+    gl_object(const gl_object &) = delete;
+    gl_object &operator=(const gl_object &) = delete;
+
+    gl_object(gl_object &&other) noexcept : id(other.id), release(other.release)
+    {
+        other.id = 0;
+    }
+
+    gl_object &operator=(gl_object &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (id != 0 && release != nullptr)
+                release(id);
+            id = other.id;
+            release = other.release;
+            other.id = 0;
+        }
+        return *this;
+    }
+
+    unsigned int get_id() const
+    {
+        return id;
+    }
+};
+
+
+
+class gl_buffer : public gl_object
+{
+private:
+    static unsigned int create()
+    {
+        unsigned int name;
+        glCreateBuffers(1, &name);
+        return name;
+    }
+
+    static void destroy(unsigned int name)
+    {
+        glDeleteBuffers(1, &name);
+    }
+
+    long long bytes = 0;
+
+public:
+    gl_buffer() {}
+
+    //Allocate immutable storage, optionally filled with 'data'. With flags = 0 the buffer can only be written by the gpu (or at creation).
+    //Use GL_DYNAMIC_STORAGE_BIT for upload() and GL_MAP_*_BIT for mapping.
+    gl_buffer(long long size, const void *data, GLbitfield flags = 0) : gl_object(create(), destroy), bytes(size)
+    {
+        glNamedBufferStorage(id, (GLsizeiptr)size, data, flags);
+    }
+
+    //Overwrite a range of the buffer. Needs GL_DYNAMIC_STORAGE_BIT.
+    void upload(long long offset, long long size, const void *data)
+    {
+        glNamedBufferSubData(id, (GLintptr)offset, (GLsizeiptr)size, data);
+    }
+
+    long long size() const
+    {
+        return bytes;
+    }
+};
+
+
+
+class gl_vertex_array : public gl_object
+{
+private:
+    static unsigned int create()
+    {
+        unsigned int name;
+        glCreateVertexArrays(1, &name);
+        return name;
+    }
+
+    static void destroy(unsigned int name)
+    {
+        glDeleteVertexArrays(1, &name);
+    }
+
+public:
+    gl_vertex_array() {}
+
+    //Create the vao. The label shows up in debuggers (RenderDoc, apitrace, ...) and in debug output.
+    explicit gl_vertex_array(const char *label) : gl_object(create(), destroy)
+    {
+        glObjectLabel(GL_VERTEX_ARRAY, id, -1, label);
+    }
+
+    //Attach a vertex buffer to a binding point. 'stride' is the size of 1 vertex in bytes.
+    void vertex_buffer(unsigned int binding, const gl_buffer &buffer, long long offset, int stride)
+    {
+        glVertexArrayVertexBuffer(id, binding, buffer.get_id(), (GLintptr)offset, stride);
+    }
+
+    //Attach the index buffer.
+    void element_buffer(const gl_buffer &buffer)
+    {
+        glVertexArrayElementBuffer(id, buffer.get_id());
+    }
+
+    //Describe (and enable) the float attribute at 'location' : 'count' components, 'offset' bytes into a vertex of the given binding.
+    void attrib(unsigned int location, int count, unsigned int offset, unsigned int binding = 0)
+    {
+        glEnableVertexArrayAttrib(id, location);
+        glVertexArrayAttribFormat(id, location, count, GL_FLOAT, GL_FALSE, offset);
+        glVertexArrayAttribBinding(id, location, binding);
+    }
+
+    void bind() const
+    {
+        glBindVertexArray(id);
+    }
+};
+
+
+
+class gl_texture : public gl_object
+{
+private:
+    static unsigned int create(GLenum target)
+    {
+        unsigned int name;
+        glCreateTextures(target, 1, &name);
+        return name;
+    }
+
+    static void destroy(unsigned int name)
+    {
+        glDeleteTextures(1, &name);
+    }
+
+    GLenum target = GL_TEXTURE_2D;
+
+public:
+    gl_texture() {}
+
+    explicit gl_texture(GLenum target) : gl_object(create(target), destroy), target(target) {}
+
+    //Number of levels of a full mipmap chain for the given size.
+    static int mip_levels(int width, int height)
+    {
+        int levels = 1;
+        for (int size = std::max(width, height); size > 1; size /= 2)
+            ++levels;
+        return levels;
+    }
+
+    //Allocate immutable storage for 2D (or cubemap, 6 faces) textures.
+    void storage_2d(int levels, GLenum internal_format, int width, int height)
+    {
+        glTextureStorage2D(id, levels, internal_format, width, height);
+    }
+
+    //Allocate immutable storage for multisampled 2D textures (target GL_TEXTURE_2D_MULTISAMPLE).
+    void storage_2d_multisample(int samples, GLenum internal_format, int width, int height)
+    {
+        glTextureStorage2DMultisample(id, samples, internal_format, width, height, GL_TRUE);
+    }
+
+    //Allocate immutable storage for array (or 3D) textures.
+    void storage_3d(int levels, GLenum internal_format, int width, int height, int depth)
+    {
+        glTextureStorage3D(id, levels, internal_format, width, height, depth);
+    }
+
+    void parameter(GLenum name, int value)
+    {
+        glTextureParameteri(id, name, value);
+    }
+
+    void parameter(GLenum name, const float *values)
+    {
+        glTextureParameterfv(id, name, values);
+    }
+
+    //Bind to a texture unit for sampling (the only binding a texture ever needs).
+    void bind(unsigned int unit) const
+    {
+        glBindTextureUnit(unit, id);
+    }
+
+    GLenum get_target() const
+    {
+        return target;
+    }
+};
+
+
+
+class gl_renderbuffer : public gl_object
+{
+private:
+    static unsigned int create()
+    {
+        unsigned int name;
+        glCreateRenderbuffers(1, &name);
+        return name;
+    }
+
+    static void destroy(unsigned int name)
+    {
+        glDeleteRenderbuffers(1, &name);
+    }
+
+public:
+    gl_renderbuffer() {}
+
+    gl_renderbuffer(GLenum internal_format, int width, int height, int samples = 0) : gl_object(create(), destroy)
+    {
+        if (samples > 0)
+            glNamedRenderbufferStorageMultisample(id, samples, internal_format, width, height);
+        else
+            glNamedRenderbufferStorage(id, internal_format, width, height);
+    }
+};
+
+
+
+class gl_framebuffer : public gl_object
+{
+private:
+    static unsigned int create()
+    {
+        unsigned int name;
+        glCreateFramebuffers(1, &name);
+        return name;
+    }
+
+    static void destroy(unsigned int name)
+    {
+        glDeleteFramebuffers(1, &name);
+    }
+
+public:
+    gl_framebuffer() {}
+
+    //Create the fbo. The label shows up in debuggers and in the completeness report of check().
+    explicit gl_framebuffer(const char *label) : gl_object(create(), destroy)
+    {
+        glObjectLabel(GL_FRAMEBUFFER, id, -1, label);
+    }
+
+    //Attach a texture level (all layers, in case of arrays/cubemaps, for layered rendering).
+    void attach(GLenum attachment, const gl_texture &tex, int level = 0)
+    {
+        glNamedFramebufferTexture(id, attachment, tex.get_id(), level);
+    }
+
+    //Attach 1 layer of an array texture (or 1 face of a cubemap).
+    void attach_layer(GLenum attachment, const gl_texture &tex, int layer, int level = 0)
+    {
+        glNamedFramebufferTextureLayer(id, attachment, tex.get_id(), level, layer);
+    }
+
+    void attach(GLenum attachment, const gl_renderbuffer &rbo)
+    {
+        glNamedFramebufferRenderbuffer(id, attachment, GL_RENDERBUFFER, rbo.get_id());
+    }
+
+    //For depth-only framebuffers : Don't draw to (or read from) any color buffer.
+    void no_color_buffer()
+    {
+        glNamedFramebufferDrawBuffer(id, GL_NONE);
+        glNamedFramebufferReadBuffer(id, GL_NONE);
+    }
+
+    //Report an incomplete framebuffer. Returns true if it is complete.
+    bool check() const
+    {
+        GLenum status = glCheckNamedFramebufferStatus(id, GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            char label[64] = "";
+            glGetObjectLabel(GL_FRAMEBUFFER, id, sizeof(label), NULL, label);
+            fprintf(stderr, "Error : Framebuffer '%s' is not complete (0x%x).\n", label, status);
+            return false;
+        }
+        return true;
+    }
+
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, id);
+    }
+};
+
+#endif
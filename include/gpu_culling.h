@@ -0,0 +1,271 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include<GL/glew.h>
+#include<glm/glm.hpp>
+#include<cstdio>
+#include<cstdint>
+#include<vector>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"shader.h"
+#include"mesh.h"
+#include"render_queue.h"
+
+//The 6 planes of the frustum of a view-projection matrix (Gribb & Hartmann), as (normal, distance) with the normal pointing inside and of unit
+//length. A point p is inside if dot(normal, p) + distance >= 0 for all 6. The far plane of an infinite projection has no normal : It is
+//replaced by a plane that never rejects anything.
+inline void frustum_planes(const glm::mat4 &view_projection, glm::vec4 planes[6])
+{
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+
+    planes[0] = row[3] + row[0]; //Left.
+    planes[1] = row[3] - row[0]; //Right.
+    planes[2] = row[3] + row[1]; //Bottom.
+    planes[3] = row[3] - row[1]; //Top.
+    planes[4] = row[3] + row[2]; //Near.
+    planes[5] = row[3] - row[2]; //Far.
+    for (int i = 0; i < 6; i++)
+    {
+        float len = glm::length(glm::vec3(planes[i]));
+        planes[i] = (len > 1e-6f) ? planes[i]/len : glm::vec4(0.0f,0.0f,0.0f,1.0f);
+    }
+}
+
+//Frustum culling of many static objects, done by a compute shader (../shaders/compute/frustum_cull.comp) that writes the indirect draw
+//commands itself. The cpu only uploads the frustum planes : It never touches the objects, and nothing is read back before drawing.
+//Every mesh (of a mesh_pool) gets 1 indirect command and a range of the visible list, as large as its object count. Each frame the commands
+//are reset from a template (instance_count = 0, a gpu copy), the compute pass appends the surviving objects, and draw() issues 1
+//glMultiDrawElementsIndirect() over all the meshes. Meshes with no visible object draw nothing.
+//The vertex shader finds its object at visible[gl_BaseInstance + gl_InstanceID] (trans_mvpn_indirect.vert, compiled with VISIBLE_LIST).
+//cull_cpu() does the same work on the cpu and uploads the result, for comparison.
+class gpu_culling
+{
+private:
+    //std430 layout of object_bounds in the compute shader.
+    struct object_bounds
+    {
+        glm::vec4 sphere;
+        uint32_t mesh;
+        uint32_t pad[3];
+    };
+
+    //Same layout as the DrawElementsIndirectCommand of the OpenGL specification.
+    struct indirect_command
+    {
+        unsigned int count;
+        unsigned int instance_count;
+        unsigned int first_index;
+        int base_vertex;
+        unsigned int base_instance;
+    };
+
+    static const int readback_frames = 3; //The visible count is read this many frames late, so the cpu never waits for it.
+
+    compute_shader cull_program;
+    std::vector<draw_mesh> meshes;
+    std::vector<float> mesh_radii; //Bounding sphere radius of each mesh, in its local coordinates.
+    std::vector<int> mesh_objects; //Objects per mesh.
+    std::vector<mesh_instance> instances;
+    std::vector<object_bounds> bounds;
+    std::vector<indirect_command> command_template; //instance_count = 0.
+    std::vector<uint32_t> cpu_list; //Scratch space of cull_cpu().
+    std::vector<indirect_command> cpu_commands;
+
+    gl_buffer instance_buffer, bounds_buffer, template_buffer, command_buffer, visible_buffer, readback_buffer;
+    const indirect_command *readback = nullptr; //Persistent mapping of readback_buffer.
+    GLsync readback_fences[readback_frames] = {};
+    int frame = 0;
+    int visible = -1; //Visible objects, readback_frames frames ago (-1 : not known yet).
+
+    bool has_draw_parameters;
+
+    //Queue a copy of this frame's commands for reading on the cpu, and pick up the copy made readback_frames frames ago if it has landed.
+    void queue_readback()
+    {
+        int slot = frame%readback_frames;
+        long long size = (long long)meshes.size()*sizeof(indirect_command);
+        if (readback_fences[slot] != nullptr)
+        {
+            if (glClientWaitSync(readback_fences[slot], 0, 0) != GL_TIMEOUT_EXPIRED)
+            {
+                const indirect_command *cmd = readback + slot*meshes.size();
+                visible = 0;
+                for (size_t m = 0; m < meshes.size(); m++)
+                    visible += (int)cmd[m].instance_count;
+            }
+            glDeleteSync(readback_fences[slot]);
+        }
+        glCopyNamedBufferSubData(command_buffer.get_id(), readback_buffer.get_id(), 0, (GLintptr)(slot*size), (GLsizeiptr)size);
+        readback_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++frame;
+    }
+
+public:
+    //'cull_shader_path' is the path of frustum_cull.comp.
+    gpu_culling(const char *cull_shader_path) : cull_program(cull_shader_path)
+    {
+        has_draw_parameters = has_shader_draw_parameters(); //The same check as render_queue, for the same vertex shader.
+    }
+
+    ~gpu_culling()
+    {
+        for (int i = 0; i < readback_frames; i++)
+            if (readback_fences[i] != nullptr)
+                glDeleteSync(readback_fences[i]);
+    }
+
+    gpu_culling(const gpu_culling &) = delete;
+    gpu_culling &operator=(const gpu_culling &) = delete;
+
+    //Register a mesh (of a built mesh_pool, all meshes must share its vao) and the radius of its bounding sphere. Returns the mesh index.
+    int add_mesh(const draw_mesh &mesh, float radius)
+    {
+        meshes.push_back(mesh);
+        mesh_radii.push_back(radius);
+        mesh_objects.push_back(0);
+        return (int)meshes.size() - 1;
+    }
+
+    //Add an object. Its bounding sphere is the mesh's, moved and scaled (by the largest axis scale) by the model matrix.
+    void add_object(int mesh, const glm::mat4 &model, const glm::vec3 &col)
+    {
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        object_bounds b;
+        b.sphere = glm::vec4(glm::vec3(model[3]), scale*mesh_radii[mesh]);
+        b.mesh = (uint32_t)mesh;
+        b.pad[0] = b.pad[1] = b.pad[2] = 0;
+        bounds.push_back(b);
+        instances.push_back(make_instance(model, col));
+        ++mesh_objects[mesh];
+    }
+
+    //Upload everything (after the last add_object()). The objects can't change afterwards.
+    void build()
+    {
+        if (meshes.empty() || bounds.empty())
+        {
+            fprintf(stderr, "Error : gpu_culling::build() without meshes or objects. Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+
+        command_template.clear();
+        unsigned int first = 0;
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            indirect_command cmd;
+            cmd.count = (unsigned int)meshes[m].index_count;
+            cmd.instance_count = 0;
+            cmd.first_index = (unsigned int)meshes[m].first_index;
+            cmd.base_vertex = meshes[m].base_vertex;
+            cmd.base_instance = first;
+            command_template.push_back(cmd);
+            first += (unsigned int)mesh_objects[m];
+        }
+
+        long long command_size = (long long)command_template.size()*sizeof(indirect_command);
+        instance_buffer = gl_buffer(instances.size()*sizeof(mesh_instance), instances.data());
+        bounds_buffer = gl_buffer(bounds.size()*sizeof(object_bounds), bounds.data());
+        template_buffer = gl_buffer(command_size, command_template.data());
+        command_buffer = gl_buffer(command_size, command_template.data(), GL_DYNAMIC_STORAGE_BIT);
+        visible_buffer = gl_buffer(bounds.size()*sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        readback_buffer = gl_buffer(readback_frames*command_size, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        readback = (const indirect_command*)glMapNamedBufferRange(readback_buffer.get_id(), 0, readback_frames*command_size, flags);
+        if (readback == nullptr)
+        {
+            fprintf(stderr, "Error : Failed to map the culling readback buffer. Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    //Cull on the gpu. Nothing waits : The commands are ready for draw() once the compute pass has run.
+    void cull(const glm::mat4 &view_projection)
+    {
+        glm::vec4 planes[6];
+        frustum_planes(view_projection, planes);
+        unsigned int program = cull_program.get_id();
+        glProgramUniform4fv(program, glGetUniformLocation(program, "planes"), 6, &planes[0][0]);
+        glProgramUniform1ui(program, glGetUniformLocation(program, "object_count"), (unsigned int)bounds.size());
+
+        glCopyNamedBufferSubData(template_buffer.get_id(), command_buffer.get_id(), 0, 0, (GLsizeiptr)template_buffer.size());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bounds_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visible_buffer.get_id());
+        cull_program.dispatch(((unsigned int)bounds.size() + 63)/64);
+        //The commands are read by the draw (and the readback copy), the visible list by the vertex shader.
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        queue_readback();
+    }
+
+    //The same culling on the cpu, uploading the visible list and the commands (the classical path).
+    void cull_cpu(const glm::mat4 &view_projection)
+    {
+        glm::vec4 planes[6];
+        frustum_planes(view_projection, planes);
+
+        std::vector<uint32_t> &list = cpu_list;
+        std::vector<indirect_command> &commands = cpu_commands;
+        list.resize(bounds.size());
+        commands = command_template;
+        for (size_t i = 0; i < bounds.size(); i++)
+        {
+            const glm::vec4 &s = bounds[i].sphere;
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++)
+                inside = (glm::dot(glm::vec3(planes[p]), glm::vec3(s)) + planes[p].w >= -s.w);
+            if (!inside)
+                continue;
+            indirect_command &cmd = commands[bounds[i].mesh];
+            list[cmd.base_instance + cmd.instance_count++] = (uint32_t)i;
+        }
+        command_buffer.upload(0, commands.size()*sizeof(indirect_command), commands.data());
+        visible_buffer.upload(0, list.size()*sizeof(uint32_t), list.data());
+        queue_readback();
+    }
+
+    //Draw the visible objects with 'program' (trans_mvpn_indirect.vert with VISIBLE_LIST, other uniforms already set).
+    void draw(shader &program)
+    {
+        program.use();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instance_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visible_buffer.get_id());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer.get_id());
+        glBindVertexArray(meshes[0].vao);
+        if (has_draw_parameters)
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (int)meshes.size(), sizeof(indirect_command));
+        else
+        {
+            int location = glGetUniformLocation(program.get_id(), "base_instance");
+            for (size_t m = 0; m < meshes.size(); m++)
+            {
+                glUniform1i(location, (int)command_template[m].base_instance);
+                glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(intptr_t)(m*sizeof(indirect_command)));
+            }
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    int object_count() const
+    {
+        return (int)bounds.size();
+    }
+
+    //Objects that passed the culling a few frames ago (-1 until the first result arrives).
+    int visible_count() const
+    {
+        return visible;
+    }
+
+    bool uses_draw_parameters() const
+    {
+        return has_draw_parameters;
+    }
+};
+
+#endif
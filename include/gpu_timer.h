@@ -0,0 +1,135 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include<GL/glew.h>
+
+//Measures a block of commands with queries of 1 kind (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, or the pipeline statistics of
+//ARB_pipeline_statistics_query such as GL_FRAGMENT_SHADER_INVOCATIONS_ARB). The gpu runs behind the cpu, so a result only arrives a few
+//frames later : Each begin()/end() pair uses the next of several queries, and results are collected once they are available, never by
+//waiting (unless all queries are still in flight, which takes a very slow gpu).
+class gpu_query
+{
+private:
+    static const int latency = 4; //Queries in flight.
+
+    GLenum target;
+    unsigned int queries[latency] = {};
+    bool pending[latency] = {};
+    int current = 0;
+    bool running = false;
+
+    double last = 0.0, total = 0.0;
+    int samples = 0;
+
+    void collect(int i, bool wait)
+    {
+        if (!pending[i])
+            return;
+        if (!wait)
+        {
+            int available = 0;
+            glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+        }
+        GLuint64 value = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &value);
+        pending[i] = false;
+        last = (double)value;
+        total += last;
+        ++samples;
+    }
+
+public:
+    explicit gpu_query(GLenum target) : target(target)
+    {
+        glGenQueries(latency, queries); //The queries are created by their first glBeginQuery() (some drivers don't take every target in glCreateQueries()).
+    }
+
+    ~gpu_query()
+    {
+        glDeleteQueries(latency, queries);
+    }
+
+    gpu_query(const gpu_query &) = delete;
+    gpu_query &operator=(const gpu_query &) = delete;
+
+    //Measure the commands issued between begin() and end(). Queries of the same kind can't be nested (of different kinds they can).
+    void begin()
+    {
+        poll();
+        collect(current, true); //Only blocks if this query is still in flight after 'latency' frames.
+        glBeginQuery(target, queries[current]);
+        running = true;
+    }
+
+    void end()
+    {
+        if (!running)
+            return;
+        glEndQuery(target);
+        pending[current] = true;
+        current = (current + 1)%latency;
+        running = false;
+    }
+
+    //Pick up the results that have arrived (in the order they were issued).
+    void poll()
+    {
+        for (int k = 1; k <= latency; k++)
+        {
+            int i = (current + k)%latency;
+            if (pending[i])
+            {
+                collect(i, false);
+                if (pending[i]) //Later queries can't be done before this one.
+                    break;
+            }
+        }
+    }
+
+    //Forget the results so far (e.g. after changing what is measured). Queries in flight still count when they arrive.
+    void reset()
+    {
+        last = total = 0.0;
+        samples = 0;
+    }
+
+    //The most recent result (nanoseconds for GL_TIME_ELAPSED, a count for the others).
+    double last_value() const
+    {
+        return last;
+    }
+
+    //Average over all results so far.
+    double average_value() const
+    {
+        return (samples > 0) ? total/samples : 0.0;
+    }
+
+    int sample_count() const
+    {
+        return samples;
+    }
+};
+
+//Measures the gpu time of a block of commands (GL_TIME_ELAPSED queries, see gpu_query).
+class gpu_timer : public gpu_query
+{
+public:
+    gpu_timer() : gpu_query(GL_TIME_ELAPSED) {}
+
+    //The most recent result [ms].
+    double last_ms() const
+    {
+        return last_value()/1.0e6;
+    }
+
+    //Average over all results so far [ms].
+    double average_ms() const
+    {
+        return average_value()/1.0e6;
+    }
+};
+
+#endif
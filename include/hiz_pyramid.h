@@ -0,0 +1,95 @@
+#ifndef HIZ_PYRAMID_H
+#define HIZ_PYRAMID_H
+
+#include<GL/glew.h>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"shader.h"
+
+//Hierarchical depth (Hi-Z) pyramid of a depth buffer : A 32 bit float texture with a full mipmap chain, where level 0 is the depth buffer
+//and every texel of a higher level holds the farthest depth of the texels it covers (../shaders/compute/hiz_build.comp). So a few
+//fetches at the right level tell the farthest depth over any rectangle of the screen : What lies entirely behind it is hidden.
+//A texel at level n covers the depth texels [t*2^n, (t+1)*2^n) in x and y, and the last row/column stretches to the edge (the levels are
+//half the size rounded down), so a depth texel p is covered by texel min(p >> n, size(n) - 1).
+class hiz_pyramid
+{
+private:
+    compute_shader copy_program, reduce_program;
+    gl_texture tex;
+    int width = 0, height = 0, levels = 0;
+
+    static int groups(int size)
+    {
+        return (size + 7)/8;
+    }
+
+public:
+    //'shader_path' : ../shaders/compute/hiz_build.comp (both passes are compiled from it).
+    hiz_pyramid(const char *shader_path) : copy_program(shader_path, {"HIZ_FROM_DEPTH"}), reduce_program(shader_path) {}
+
+    hiz_pyramid(const hiz_pyramid &) = delete;
+    hiz_pyramid &operator=(const hiz_pyramid &) = delete;
+
+    //Build the pyramid of a 'w' x 'h' depth texture (not multisampled, without comparison). The texture is re-created when the size changes.
+    void build(const gl_texture &depth, int w, int h)
+    {
+        if (w != width || h != height)
+        {
+            width = w;
+            height = h;
+            levels = gl_texture::mip_levels(width, height);
+            tex = gl_texture(GL_TEXTURE_2D);
+            tex.storage_2d(levels, GL_R32F, width, height);
+            tex.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+            tex.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        depth.bind(0);
+        glBindImageTexture(0, tex.get_id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        copy_program.dispatch(groups(width), groups(height));
+        for (int level = 1; level < levels; level++)
+        {
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); //The previous level must land before it is read.
+            glBindImageTexture(1, tex.get_id(), level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(0, tex.get_id(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            reduce_program.dispatch(groups(std::max(1, width >> level)), groups(std::max(1, height >> level)));
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); //Read with texelFetch() by the culling.
+        glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindTextureUnit(0, 0);
+    }
+
+    //Bind the pyramid for reading (through a sampler2D, with texelFetch()).
+    void bind(unsigned int unit) const
+    {
+        tex.bind(unit);
+    }
+
+    int get_width() const
+    {
+        return width;
+    }
+
+    int get_height() const
+    {
+        return height;
+    }
+
+    int get_levels() const
+    {
+        return levels;
+    }
+
+    //The full chain is about 4/3 of level 0.
+    long long memory_bytes() const
+    {
+        long long bytes = 0;
+        for (int level = 0; level < levels; level++)
+            bytes += 4LL*std::max(1, width >> level)*std::max(1, height >> level);
+        return bytes;
+    }
+};
+
+#endif
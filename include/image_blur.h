@@ -0,0 +1,214 @@
+#ifndef IMAGE_BLUR_H
+#define IMAGE_BLUR_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstdlib>
+#include<cmath>
+#include<string>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"shader.h"
+#include"mesh.h"
+#include"gpu_timer.h"
+#include"render_target_pool.h"
+
+//Blurs a 2D texture (e.g. a rendered scene) by a radius given in pixels of the source, with 1 of 3 methods :
+//gaussian         : Separable Gaussian in 2 fragment passes (horizontal, then vertical), ping-ponging between 2 fbos. The weights are
+//                   folded in pairs for bilinear fetches. Radii over 8 run at half resolution (with half the radius), where the first pass
+//                   also does the downsampling.
+//dual_kawase      : Dual filtering. Downsample by halves with a small kernel, then upsample back. The radius doubles per level, so large
+//                   radii cost about as much as small ones. Only approximately Gaussian.
+//compute_gaussian : The separable Gaussian in compute, with the rows (columns) cached in shared memory. Exact weights, full resolution.
+//Each method has 2 passes (down/up for dual_kawase), which can be timed separately. The intermediate targets come from a render target
+//pool and go back to it as soon as the next pass has read them.
+class image_blur
+{
+public:
+    enum method { gaussian = 0, dual_kawase = 1, compute_gaussian = 2 };
+    static constexpr int max_radius = 32;
+    static constexpr int max_levels = 5; //Of the dual Kawase chain.
+
+private:
+    shader gaussian_program, kawase_down_program, kawase_up_program;
+    compute_shader compute_program;
+    quadtex quad;
+
+    static std::string path(const char *dir, const char *file)
+    {
+        return std::string(dir) + file;
+    }
+
+    static render_target_desc color_target(int width, int height)
+    {
+        render_target_desc desc;
+        desc.width = std::max(width, 1);
+        desc.height = std::max(height, 1);
+        desc.color_format = GL_RGBA8; //Also an image format, for the compute path.
+        return desc;
+    }
+
+    static void begin_pass(gpu_timer *timers, int pass)
+    {
+        if (timers != nullptr)
+            timers[pass].begin();
+    }
+
+    static void end_pass(gpu_timer *timers, int pass)
+    {
+        if (timers != nullptr)
+            timers[pass].end();
+    }
+
+    //Draw a fullscreen quad sampling 'source' into 't'.
+    void draw(const render_target &t, const gl_texture &source)
+    {
+        t.bind();
+        quad.draw_triangles(source.get_id());
+    }
+
+    //Normalized Gaussian weights of the texels 0, 1, ..., radius away from the center (sigma = radius/2).
+    static void gaussian_weights(int radius, float *weights)
+    {
+        float sigma = 0.5f*radius, sum = 0.0f;
+        for (int i = 0; i <= radius; i++)
+        {
+            weights[i] = std::exp(-0.5f*i*i/(sigma*sigma));
+            sum += (i == 0) ? weights[i] : 2.0f*weights[i];
+        }
+        for (int i = 0; i <= radius; i++)
+            weights[i] /= sum;
+    }
+
+    //1 gaussian fragment pass from 'source' into 't' ('radius' in texels of 't').
+    void gaussian_pass(const render_target &t, const gl_texture &source, int radius, bool horizontal)
+    {
+        float weights[max_radius + 1], tap_weights[max_radius/2 + 1], tap_offsets[max_radius/2 + 1];
+        gaussian_weights(radius, weights);
+        //Fold the texels (1,2), (3,4), ... in 1 bilinear fetch each, placed at the center of mass of the 2.
+        int taps = 1;
+        tap_weights[0] = weights[0];
+        tap_offsets[0] = 0.0f;
+        for (int i = 1; i <= radius; i += 2)
+        {
+            float w1 = weights[i], w2 = (i + 1 <= radius) ? weights[i + 1] : 0.0f;
+            tap_weights[taps] = w1 + w2;
+            tap_offsets[taps] = (i*w1 + (i + 1)*w2)/(w1 + w2);
+            ++taps;
+        }
+
+        gaussian_program.use();
+        glm::vec2 texel_step = horizontal ? glm::vec2(1.0f/t.desc.width, 0.0f) : glm::vec2(0.0f, 1.0f/t.desc.height);
+        gaussian_program.set_vec2_uniform("texel_step", texel_step);
+        gaussian_program.set_int_uniform("tap_count", taps);
+        glUniform1fv(glGetUniformLocation(gaussian_program.get_id(), "tap_weights"), taps, tap_weights);
+        glUniform1fv(glGetUniformLocation(gaussian_program.get_id(), "tap_offsets"), taps, tap_offsets);
+        draw(t, source);
+    }
+
+    //1 gaussian compute pass from 'source' into 't' (same size).
+    void compute_pass(const render_target &t, const gl_texture &source, int radius, bool horizontal)
+    {
+        float weights[max_radius + 1];
+        gaussian_weights(radius, weights);
+        compute_program.use();
+        unsigned int id = compute_program.get_id();
+        glUniform2i(glGetUniformLocation(id, "direction"), horizontal ? 1 : 0, horizontal ? 0 : 1);
+        glUniform1i(glGetUniformLocation(id, "radius"), radius);
+        glUniform1fv(glGetUniformLocation(id, "weights"), radius + 1, weights);
+        source.bind(0);
+        glBindImageTexture(0, t.color.get_id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        int length = horizontal ? t.desc.width : t.desc.height, lines = horizontal ? t.desc.height : t.desc.width;
+        compute_program.dispatch((length + 127)/128, lines);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+        glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        glBindTextureUnit(0, 0);
+    }
+
+public:
+    //'shader_dir' : The shaders directory (e.g. "../shaders/"), with vertex/trans_nothing_texture.vert, fragment/blur.frag,
+    //fragment/kawase.frag and compute/blur.comp.
+    image_blur(const char *shader_dir) : gaussian_program(path(shader_dir, "vertex/trans_nothing_texture.vert").c_str(), path(shader_dir, "fragment/blur.frag").c_str()),
+                                         kawase_down_program(path(shader_dir, "vertex/trans_nothing_texture.vert").c_str(), path(shader_dir, "fragment/kawase.frag").c_str()),
+                                         kawase_up_program(path(shader_dir, "vertex/trans_nothing_texture.vert").c_str(), path(shader_dir, "fragment/kawase.frag").c_str(), {"KAWASE_UP"}),
+                                         compute_program(path(shader_dir, "compute/blur.comp").c_str())
+    {}
+
+    //Dual Kawase levels used for a radius. Each level doubles the width of the blur, which is about that of a Gaussian of radius 2.5*2^levels.
+    static int kawase_levels(int radius)
+    {
+        int n = (int)std::lround(std::log2(radius/2.5f));
+        return std::max(1, std::min(n, max_levels));
+    }
+
+    //Blur 'source' ('width' x 'height') by 'radius' pixels. Returns the target with the result, which may be smaller than the source
+    //(sample it with linear filtering to upsample) : Release it to 'pool' once it has been used. 'pass_timers' (optional) : 2 timers,
+    //1 per pass. Leaves the default fbo bound, with the viewport of the source's size.
+    render_target &apply(render_target_pool &pool, const gl_texture &source, int width, int height, int radius, method m, gpu_timer *pass_timers = nullptr)
+    {
+        radius = std::max(1, std::min(radius, max_radius));
+        render_target *result = nullptr;
+        glDisable(GL_DEPTH_TEST);
+        if (m == gaussian)
+        {
+            bool half = (radius > 8);
+            int r = half ? (radius + 1)/2 : radius;
+            render_target_desc desc = half ? color_target(width/2, height/2) : color_target(width, height);
+            begin_pass(pass_timers, 0);
+            render_target &first = pool.acquire(desc);
+            gaussian_pass(first, source, r, true); //Downsamples too, at half resolution (bilinear 2x2 average).
+            end_pass(pass_timers, 0);
+            begin_pass(pass_timers, 1);
+            result = &pool.acquire(desc);
+            gaussian_pass(*result, first.color, r, false);
+            pool.release(first);
+            end_pass(pass_timers, 1);
+        }
+        else if (m == dual_kawase)
+        {
+            int n = kawase_levels(radius);
+            render_target *levels[max_levels + 1] = {}; //levels[i] is 1/2^i of the source size.
+            begin_pass(pass_timers, 0);
+            kawase_down_program.use();
+            kawase_down_program.set_float_uniform("spread", 1.0f);
+            for (int i = 1; i <= n; i++)
+            {
+                levels[i] = &pool.acquire(color_target(width >> i, height >> i));
+                draw(*levels[i], (i == 1) ? source : levels[i - 1]->color);
+            }
+            end_pass(pass_timers, 0);
+            begin_pass(pass_timers, 1);
+            kawase_up_program.use();
+            kawase_up_program.set_float_uniform("spread", 1.0f);
+            for (int i = n - 1; i >= 1; i--)
+            {
+                draw(*levels[i], levels[i + 1]->color); //The downsampled image of this level isn't needed anymore.
+                pool.release(*levels[i + 1]);
+            }
+            result = &pool.acquire(color_target(width, height));
+            draw(*result, levels[1]->color);
+            pool.release(*levels[1]);
+            end_pass(pass_timers, 1);
+        }
+        else
+        {
+            render_target_desc desc = color_target(width, height);
+            begin_pass(pass_timers, 0);
+            render_target &first = pool.acquire(desc);
+            compute_pass(first, source, radius, true);
+            end_pass(pass_timers, 0);
+            begin_pass(pass_timers, 1);
+            result = &pool.acquire(desc);
+            compute_pass(*result, first.color, radius, false);
+            pool.release(first);
+            end_pass(pass_timers, 1);
+        }
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0,0, width,height);
+        return *result;
+    }
+};
+
+#endif
@@ -7,16 +7,206 @@
 #include<fstream>
 #include<vector>
 #include<unordered_map>
+#include<thread>
+#include<chrono>
+#include<filesystem>
+#include<algorithm>
+#include<glm/glm.hpp>
+
+#include"gl_objects.h"
+#include"trace.h"
+#include"texture_compression.h"
 
 #define STB_IMAGE_IMPLEMENTATION //This must happen only once.
 #include"stb_image.h"
 
 
 
+//Upload tightly packed 8-bit pixels into a level (0 by default) of a 2D texture (layer = 0), or of 1 face (layer) of a cubemap. Rows of rgb or
+//single-channel images are not 4-byte aligned in general, so the unpack alignment is set to 1 for the copy and restored afterwards (no state leaks out).
+inline void upload_pixels(gl_texture &tex, int layer, int width, int height, GLenum format, const unsigned char *pixels, int level = 0)
+{
+    int alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (tex.get_target() == GL_TEXTURE_2D)
+        glTextureSubImage2D(tex.get_id(), level, 0,0, width,height, format, GL_UNSIGNED_BYTE, pixels);
+    else
+        glTextureSubImage3D(tex.get_id(), level, 0,0,layer, width,height,1, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+//True if the cache file exists and is newer than each of the 'count' files it was made from (missing sources don't invalidate it).
+inline bool cache_is_fresh(const std::string &cache_path, const std::string *sources, int count)
+{
+    std::error_code ec;
+    std::filesystem::file_time_type cache_time = std::filesystem::last_write_time(cache_path, ec);
+    if (ec)
+        return false;
+    for (int i = 0; i < count; i++)
+    {
+        std::filesystem::file_time_type source_time = std::filesystem::last_write_time(sources[i], ec);
+        if (!ec && source_time > cache_time)
+            return false;
+    }
+    return true;
+}
+
+//A name for the cache entry of a source file : Its file name plus a hash (64-bit FNV-1a) of its full canonical path, so that files with the
+//same name in different directories get their own entries.
+inline std::string cache_name(const char *source_path)
+{
+    std::error_code ec;
+    std::filesystem::path full = std::filesystem::weakly_canonical(source_path, ec);
+    if (ec)
+        full = std::filesystem::absolute(source_path, ec);
+    unsigned long long hash = 14695981039346656037ULL;
+    for (char c : full.generic_string())
+        hash = (hash ^ (unsigned char)c)*1099511628211ULL;
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", hash);
+    return std::filesystem::path(source_path).filename().string() + "." + hex;
+}
+
+//Load an image into a new 2D texture with a full mipmap chain, flipped vertically (OpenGL's uv origin is the bottom left). Unless
+//texture_compression.enabled (texture_compression.h) is false, the mip chain is block compressed on the cpu, kept as a DDS file in
+//texture_compression.cache_dir for the next launches (stamped with the size and modification time of the image, and reused only while
+//they match) and uploaded as it is. If the driver can't sample the format, the image is uploaded uncompressed. Either way the data goes
+//through the staging ring of texture_upload.h (call texture_uploader::instance().release() once the textures are loaded). Prints the size of the texture in video memory, next to its uncompressed size.
+inline gl_texture load_texture_2d(const char *img_path)
+{
+    TRACE_SCOPE_DYNAMIC(std::string("load ") + img_path);
+    int img_width, img_height, img_channels;
+    if (!stbi_info(img_path, &img_width, &img_height, &img_channels))
+    {
+        fprintf(stderr, "Error : File '%s' was not found. Exiting...\n", img_path);
+        exit(EXIT_FAILURE);
+    }
+    double raw_mb = img_width*(double)img_height*img_channels*(4.0/3.0)/(1 << 20); //With the mipmaps.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    bc_format bc = bc_choose_format(img_channels, texture_compression.prefer_bc7);
+    if (texture_compression.enabled && img_channels <= 4 && !bc_format_supported(bc))
+        printf("Texture '%s' : %s is not supported by the driver, so it stays uncompressed.\n", img_path, bc_name(bc));
+    else if (texture_compression.enabled && img_channels <= 4)
+    {
+        bc_texture compressed;
+        std::string cache_path;
+        if (!texture_compression.cache_dir.empty())
+            cache_path = texture_compression.cache_dir + cache_name(img_path) + "." + bc_name(bc) + ".dds";
+        std::error_code size_ec, time_ec;
+        unsigned long long source_size = std::filesystem::file_size(img_path, size_ec);
+        unsigned long long source_time = std::filesystem::last_write_time(img_path, time_ec).time_since_epoch().count();
+        if (size_ec || time_ec)
+            source_size = source_time = 0; //Unknown, so the cache is never trusted.
+        gl_texture tex;
+        bool cached = (!cache_path.empty() && source_size != 0 && bc_load_dds(cache_path.c_str(), compressed, tex) &&
+                       compressed.source_size == source_size && compressed.source_time == source_time &&
+                       compressed.format == bc && compressed.width == img_width && compressed.height == img_height &&
+                       compressed.levels == gl_texture::mip_levels(img_width, img_height));
+        size_t bytes = compressed.level_offset(compressed.levels);
+        if (!cached)
+        {
+            stbi_set_flip_vertically_on_load(true);
+            unsigned char *img_data = stbi_load(img_path, &img_width, &img_height, &img_channels, 0);
+            if (!img_data)
+            {
+                fprintf(stderr, "Error : Failed to load texture '%s'. Exiting...\n", img_path);
+                exit(EXIT_FAILURE);
+            }
+            compressed = bc_compress(img_data, img_width, img_height, img_channels, bc, true);
+            stbi_image_free(img_data);
+            compressed.source_size = source_size;
+            compressed.source_time = source_time;
+            if (!cache_path.empty() && !bc_write_dds(cache_path.c_str(), compressed))
+                fprintf(stderr, "Error : Failed to write the texture cache '%s'.\n", cache_path.c_str());
+            tex = bc_upload(compressed);
+            bytes = compressed.data.size();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("Texture '%s' : %s, %.1f MB instead of %.1f MB (%s in %.0f ms).\n", img_path, bc_name(bc), bytes/(double)(1 << 20),
+               raw_mb, cached ? "cached" : "compressed", ms);
+        return tex;
+    }
+
+    //Uncompressed.
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *img_data = stbi_load(img_path, &img_width, &img_height, &img_channels, 0);
+    if (!img_data)
+    {
+        fprintf(stderr, "Error : File '%s' was not found. Exiting...\n", img_path);
+        exit(EXIT_FAILURE);
+    }
+
+    //Determine the correct format based on the number of channels (img_channels).
+    GLenum format, internal_format;
+    if (img_channels == 1)
+    {
+        format = GL_RED; //Single-channel (grayscale image).
+        internal_format = GL_R8;
+    }
+    else if (img_channels == 3)
+    {
+        format = GL_RGB; //Classical 3-channel image (e.g. jpg).
+        internal_format = GL_RGB8;
+    }
+    else if (img_channels == 4)
+    {
+        format = GL_RGBA; //4-channel image, i.e. RGB + alpha channel for opacity (e.g. png).
+        internal_format = GL_RGBA8;
+    }
+    else
+    {
+        fprintf(stderr, "Error : '%s' has %d channels, which is not supported. Exiting...\n", img_path, img_channels);
+        exit(EXIT_FAILURE);
+    }
+
+    gl_texture tex(GL_TEXTURE_2D);
+    tex.storage_2d(gl_texture::mip_levels(img_width, img_height), internal_format, img_width, img_height);
+    texture_uploader::instance().upload(tex, 0, img_width, img_height, format, img_channels, img_data);
+    stbi_image_free(img_data); //Free image resources (the upload has its own copy in the staging ring).
+    glGenerateTextureMipmap(tex.get_id()); //Runs on the gpu, after the copies from the staging ring.
+    printf("Texture '%s' : Uncompressed, %.1f MB.\n", img_path, raw_mb);
+    return tex;
+}
+
+
+
+//Per-instance data for draw_instanced(). Same layout as the std430 'instance' struct of ../shaders/common/instances.glsl, which the
+//*_instanced.vert shaders index with gl_InstanceID.
+struct mesh_instance
+{
+    glm::mat4 model; //Model matrix.
+    glm::mat4 normal; //Normal matrix, i.e. transpose(inverse(model)), precomputed once here instead of once per vertex. Only its 3x3 part is used.
+    glm::vec4 col; //Color (rgb). The 4th component is padding.
+};
+
+inline mesh_instance make_instance(const glm::mat4 &model, const glm::vec3 &col)
+{
+    mesh_instance inst;
+    inst.model = model;
+    inst.normal = glm::transpose(glm::inverse(model));
+    inst.col = glm::vec4(col, 1.0f);
+    return inst;
+}
+
+//Bind 'count' instances, stored at 'offset' bytes in a buffer, to shader storage binding 0. 'offset' must be a multiple of
+//GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT (e.g. allocate them from a ring_buffer with that alignment). Nothing is bound for 0 instances
+//(an empty range is invalid).
+inline void bind_instances(unsigned int instance_buffer, long long offset, int count)
+{
+    if (count <= 0)
+        return;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, instance_buffer, (GLintptr)offset, (GLsizeiptr)count*sizeof(mesh_instance));
+}
+
+
+
 class meshvf
 {
 private:
-    unsigned int vao, vbo, ebo; //Vertex array object, vertex buffer object, element (index) buffer object.
+    gl_vertex_array vao; //Vertex array object.
+    gl_buffer vbo, ebo; //Vertex buffer object, element (index) buffer object.
     std::vector<float> verts; //Mesh's vertices {x1,y1,z1, x2,y2,z2, ...}.
     std::vector<unsigned int> inds; //Mesh's indices {vi1,vi2,vi3, vi4,vi5,vi6, ...}.
 
@@ -24,6 +214,7 @@ public:
     //Load the obj file, construct the mesh vectors and do the gpu memory setup.
     meshvf(const char *obj_path)
     {
+        TRACE_SCOPE_DYNAMIC(std::string("load ") + obj_path);
         std::ifstream fp;
         fp.open(obj_path);
         if (!fp.is_open())
@@ -54,43 +245,45 @@ public:
             }
         }
 
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, verts.size()*sizeof(float), &verts[0], GL_STATIC_DRAW);
-
-        glGenBuffers(1, &ebo); //OpenGL expects the indices stored in the ebo to reference positions in the verts[] buffer.
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, inds.size()*sizeof(unsigned int), &inds[0], GL_STATIC_DRAW);
-        
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        
-        glBindVertexArray(0);
-    }
+        //Immutable gpu storage, filled once here (direct state access, so nothing gets bound during the setup).
+        vbo = gl_buffer(verts.size()*sizeof(float), verts.data());
+        ebo = gl_buffer(inds.size()*sizeof(unsigned int), inds.data()); //OpenGL expects the indices stored in the ebo to reference positions in the verts[] buffer.
 
-    //Cleanup memory.
-    ~meshvf()
-    {
-        glDeleteVertexArrays(1, &vao);
-        glDeleteBuffers(1, &vbo);
-        glDeleteBuffers(1, &ebo);
+        vao = gl_vertex_array(obj_path);
+        vao.vertex_buffer(0, vbo, 0, 3*sizeof(float));
+        vao.element_buffer(ebo);
+        vao.attrib(0, 3, 0); //For vertices.
     }
 
     //Draw the mesh in the form of individual triangles (filled).
     void draw_triangles()
     {
-        glBindVertexArray(vao); //Bind the mesh's vao.
+        vao.bind(); //Bind the mesh's vao.
         glDrawElements(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0); //Unbind the vao.
     }
 
+    //Draw 'count' copies of the mesh with 1 draw call. Their transforms and colors are read from 'instance_buffer' (an array of mesh_instance)
+    //by the *_instanced.vert shaders.
+    void draw_instanced(int count, unsigned int instance_buffer, long long offset = 0)
+    {
+        if (count <= 0) //E.g. all instances culled.
+            return;
+        bind_instances(instance_buffer, offset, count);
+        vao.bind();
+        glDrawElementsInstanced(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
+    }
+
+    void draw_instanced(int count, const gl_buffer &instance_buffer)
+    {
+        draw_instanced(count, instance_buffer.get_id());
+    }
+
     //Draw the mesh in the form of individual lines (wireframe).
     void draw_lines(const float line_width = 1.0f)
     {
-        glBindVertexArray(vao);
+        vao.bind();
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); //Switch to line mode for wireframe/edge only drawing.
         glLineWidth(line_width);
         glDrawElements(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0);
@@ -101,7 +294,7 @@ public:
     //Draw the mesh in the form of individual points (vertices).
     void draw_points(const float point_size = 2.0f)
     {
-        glBindVertexArray(vao);
+        vao.bind();
         glPointSize(point_size);
         glDrawElements(GL_POINTS, (int)inds.size(), GL_UNSIGNED_INT, 0); //Point mode.
         glBindVertexArray(0);
@@ -113,11 +306,15 @@ public:
 class meshvfn
 {
 private:
-    unsigned int vao, vbo, ebo; //Vertex array object, vertex buffer object, element (index) buffer object.
+    gl_vertex_array vao; //Vertex array object.
+    gl_buffer vbo, ebo; //Vertex buffer object, element (index) buffer object.
     std::vector<std::vector<float>> verts; //Mesh's vertices {{x1,y1,z1}, {x2,y2,z2}, ...}.
     std::vector<std::vector<float>> norms; //Mesh's normals {{nx1,ny1,nz1}, {nx2,ny2,nz2}, ...}.
     std::vector<unsigned int> inds; //Mesh's indices. Every index is used to reference BOTH vertex and normal attributes.
     std::vector<float> interleaved_buffer; //Interleaved buffer that contains vertex and normal coordinates as pairs {x1,y1,z1, nx1,ny1,nz1, x2,y2,z2, nx2,ny2,nz2, ...}.
+    std::vector<unsigned int> pos_inds; //Position index (into verts) of every triangle corner, for the position-only stream.
+    gl_vertex_array pos_vao; //Position-only stream (see draw_positions()), created on first use.
+    gl_buffer pos_vbo, pos_ebo;
 
     void process_inds_and_push_back(unsigned int vindex, unsigned int nindex, std::unordered_map<std::string, unsigned int> &combo_map)
     {
@@ -150,6 +347,7 @@ public:
     //Load the obj file, construct the mesh vectors and do the gpu memory setup.
     meshvfn(const char *obj_path)
     {
+        TRACE_SCOPE_DYNAMIC(std::string("load ") + obj_path);
         std::ifstream fp;
         fp.open(obj_path);
         if (!fp.is_open())
@@ -180,44 +378,70 @@ public:
                 process_inds_and_push_back(vi1-1, ni1-1, combo_map);
                 process_inds_and_push_back(vi2-1, ni2-1, combo_map);
                 process_inds_and_push_back(vi3-1, ni3-1, combo_map);
+                pos_inds.push_back(vi1-1);
+                pos_inds.push_back(vi2-1);
+                pos_inds.push_back(vi3-1);
             }
         }
 
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, interleaved_buffer.size()*sizeof(float), &interleaved_buffer[0], GL_STATIC_DRAW);
-        
-        glGenBuffers(1, &ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, inds.size()*sizeof(unsigned int), &inds[0], GL_STATIC_DRAW);
-        
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0); //For vertices.
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));  //For normals.
-        glEnableVertexAttribArray(1);
-        
-        glBindVertexArray(0);
-    }
+        vbo = gl_buffer(interleaved_buffer.size()*sizeof(float), interleaved_buffer.data());
+        ebo = gl_buffer(inds.size()*sizeof(unsigned int), inds.data());
 
-    //Free resources.
-    ~meshvfn()
-    {
-        glDeleteVertexArrays(1, &vao);
-        glDeleteBuffers(1, &vbo);
-        glDeleteBuffers(1, &ebo);
+        vao = gl_vertex_array(obj_path);
+        vao.vertex_buffer(0, vbo, 0, 6*sizeof(float));
+        vao.element_buffer(ebo);
+        vao.attrib(0, 3, 0); //For vertices.
+        vao.attrib(1, 3, 3*sizeof(float)); //For normals.
     }
 
     void draw_triangles()
     {
         //Remember : glDrawElements() uses 1 index to reference all attributes like positions, normals, UVs, etc...
-        glBindVertexArray(vao);
+        vao.bind();
         glDrawElements(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
     }
 
+    //Draw the triangles from positions only : A compact stream of the obj's vertices (3 floats each, no normals) with their own indices,
+    //for depth-only passes. Corners that only differ by their normal share 1 vertex here, so fewer vertices are fetched and transformed.
+    //The positions are the same floats as in the full stream, so both give the very same depth (e.g. for a GL_EQUAL pass after a depth
+    //prepass, with an invariant gl_Position). The stream is uploaded on the first call.
+    void draw_positions()
+    {
+        if (pos_vao.get_id() == 0)
+        {
+            std::vector<float> positions;
+            positions.reserve(3*verts.size());
+            for (const std::vector<float> &v : verts)
+                positions.insert(positions.end(), v.begin(), v.end());
+            pos_vbo = gl_buffer(positions.size()*sizeof(float), positions.data());
+            pos_ebo = gl_buffer(pos_inds.size()*sizeof(unsigned int), pos_inds.data());
+            pos_vao = gl_vertex_array("position stream");
+            pos_vao.vertex_buffer(0, pos_vbo, 0, 3*sizeof(float));
+            pos_vao.element_buffer(pos_ebo);
+            pos_vao.attrib(0, 3, 0); //For vertices.
+        }
+        pos_vao.bind();
+        glDrawElements(GL_TRIANGLES, (int)pos_inds.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    //Draw 'count' copies of the mesh with 1 draw call (see meshvf::draw_instanced()).
+    void draw_instanced(int count, unsigned int instance_buffer, long long offset = 0)
+    {
+        if (count <= 0) //E.g. all instances culled.
+            return;
+        bind_instances(instance_buffer, offset, count);
+        vao.bind();
+        glDrawElementsInstanced(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
+    }
+
+    void draw_instanced(int count, const gl_buffer &instance_buffer)
+    {
+        draw_instanced(count, instance_buffer.get_id());
+    }
+
     //Farthest vertex distance with respect to the local coordinate system.
     float get_farthest_vertex_distance()
     {
@@ -231,6 +455,43 @@ public:
         return farthest;
     }
 
+    int get_triangle_count() const
+    {
+        return (int)inds.size()/3;
+    }
+
+    //Vertices of the full (position + normal) stream and of the position-only stream.
+    int get_vertex_count() const
+    {
+        return (int)interleaved_buffer.size()/6;
+    }
+
+    int get_position_count() const
+    {
+        return (int)verts.size();
+    }
+
+    unsigned int get_vao_id() const
+    {
+        return vao.get_id();
+    }
+
+    int get_index_count() const
+    {
+        return (int)inds.size();
+    }
+
+    //Cpu copies of the gpu data, e.g. to pack several meshes in 1 vertex/index buffer (see mesh_pool in render_queue.h).
+    const std::vector<float> &get_interleaved_buffer() const
+    {
+        return interleaved_buffer;
+    }
+
+    const std::vector<unsigned int> &get_indices() const
+    {
+        return inds;
+    }
+
     //Nearest vertex distance with respect to the local coordinate system.
     float get_nearest_vertex_distance()
     {
@@ -250,7 +511,9 @@ public:
 class meshvft
 {
 private:
-    unsigned int vao, vbo, ebo, tex; //Vertex array object, vertex buffer object, element (index) buffer object and texture ID.
+    gl_vertex_array vao; //Vertex array object.
+    gl_buffer vbo, ebo; //Vertex buffer object, element (index) buffer object.
+    gl_texture tex; //Texture.
     std::vector<std::vector<float>> verts; //Mesh's vertices {{x1,y1,z1}, {x2,y2,z2}, ...}.
     std::vector<std::vector<float>> uvs; //Mesh's texture coords (u,v) {{u1,v1}, {u2,v2}, ...}.
     std::vector<unsigned int> inds; //Mesh's indices. Every index is used to reference BOTH vertex and uv attributes.
@@ -284,8 +547,10 @@ private:
 
 public:
     //Load the obj file, construct the mesh vectors and do the gpu memory setup regarding both the mesh data and the image attached to the mesh.
-    meshvft(const char *obj_path, const char *img_path)
+    //Without an image (img_path = NULL) the mesh has no texture of its own and the caller binds its textures (e.g. a virtual texture).
+    meshvft(const char *obj_path, const char *img_path = NULL)
     {
+        TRACE_SCOPE_DYNAMIC(std::string("load ") + obj_path);
         std::ifstream fp;
         fp.open(obj_path);
         if (!fp.is_open())
@@ -319,88 +584,280 @@ public:
             }
         }
 
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, interleaved_buffer.size()*sizeof(float), &interleaved_buffer[0], GL_STATIC_DRAW);
-
-        glGenBuffers(1, &ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, inds.size()*sizeof(unsigned int), &inds[0], GL_STATIC_DRAW);
-        
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*)0); //For vertices.
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*)(3*sizeof(float))); //For uvs.
-        glEnableVertexAttribArray(1);
+        vbo = gl_buffer(interleaved_buffer.size()*sizeof(float), interleaved_buffer.data());
+        ebo = gl_buffer(inds.size()*sizeof(unsigned int), inds.data());
+
+        vao = gl_vertex_array(obj_path);
+        vao.vertex_buffer(0, vbo, 0, 5*sizeof(float));
+        vao.element_buffer(ebo);
+        vao.attrib(0, 3, 0); //For vertices.
+        vao.attrib(1, 2, 3*sizeof(float)); //For uvs.
+
+        //Load the image texture (block compressed, see load_texture_2d()). Then tell OpenGL how to apply it on the mesh.
+        if (img_path == NULL)
+            return;
+        tex = load_texture_2d(img_path);
+        tex.parameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+        tex.parameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+        tex.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        tex.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    void draw_triangles()
+    {
+        if (tex.get_id() != 0)
+            tex.bind(0);
+        vao.bind();
+        glDrawElements(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        if (tex.get_id() != 0)
+            glBindTextureUnit(0, 0);
+    }
+
+    //Draw 'count' textured copies of the mesh with 1 draw call (see meshvf::draw_instanced()).
+    void draw_instanced(int count, unsigned int instance_buffer, long long offset = 0)
+    {
+        if (count <= 0) //E.g. all instances culled.
+            return;
+        bind_instances(instance_buffer, offset, count);
+        if (tex.get_id() != 0)
+            tex.bind(0);
+        vao.bind();
+        glDrawElementsInstanced(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0, count);
         glBindVertexArray(0);
+        if (tex.get_id() != 0)
+            glBindTextureUnit(0, 0);
+    }
 
-        //Tell OpenGL how to apply the texture on the mesh.
-        glGenTextures(1, &tex);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //This is useful for textures with non-standard widths or single-channel textures.
-
-        //Load the image texture.
-        int img_width, img_height, img_channels;
-        stbi_set_flip_vertically_on_load(true);
-        unsigned char *img_data = stbi_load(img_path, &img_width, &img_height, &img_channels, 0);
-        if (!img_data)
+    void draw_instanced(int count, const gl_buffer &instance_buffer)
+    {
+        draw_instanced(count, instance_buffer.get_id());
+    }
+};
+
+
+
+class skybox
+{
+private:
+    gl_vertex_array vao; //Vertex array object.
+    gl_buffer vbo, ebo; //Vertex buffer object, element (index) buffer object.
+    gl_texture tex; //Cubemap texture.
+    double load_ms = 0.0; //Time spent on the 6 faces (decoding or reading the cache, plus the upload).
+    const char *load_source = "";
+
+    static constexpr unsigned int cache_magic = 0x45425543; //"CUBE" (little endian).
+    static constexpr unsigned int cache_version = 1;
+
+    //Pixel transfer format and internal format of 8-bit images with 'channels' channels. False if not supported.
+    static bool pixel_format(int channels, GLenum &format, GLenum &internal_format)
+    {
+        if (channels == 1)
         {
-            fprintf(stderr, "Error : File '%s' was not found. Exiting...\n", img_path);
-            exit(EXIT_FAILURE);
+            format = GL_RED; //Single-channel grayscale image.
+            internal_format = GL_R8;
         }
-
-        //Determine the correct format based on the number of channels (img_channels).
-        GLenum format;
-        if (img_channels == 1)
-            format = GL_RED; //Single-channel (grayscale image).
-        else if (img_channels == 3)
+        else if (channels == 3)
+        {
             format = GL_RGB; //Classical 3-channel image (e.g. jpg).
-        else if (img_channels == 4)
+            internal_format = GL_RGB8;
+        }
+        else if (channels == 4)
+        {
             format = GL_RGBA; //4-channel image, i.e. RGB + alpha channel for opacity (e.g. png).
+            internal_format = GL_RGBA8;
+        }
+        else
+            return false;
+        return true;
+    }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, img_width, img_height, 0, format, GL_UNSIGNED_BYTE, img_data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(img_data); //Free image resources.
+    static size_t face_bytes(int width, int height, int channels, int level)
+    {
+        return (size_t)std::max(width >> level, 1)*std::max(height >> level, 1)*channels;
     }
 
-    //Free resources.
-    ~meshvft()
+    //Allocate the cubemap's storage and set its sampling state.
+    void create_texture(int levels, GLenum internal_format, int width, int height)
     {
-        glDeleteVertexArrays(1, &vao);
-        glDeleteBuffers(1, &vbo);
-        glDeleteBuffers(1, &ebo);
-        glDeleteTextures(1, &tex);
+        tex = gl_texture(GL_TEXTURE_CUBE_MAP);
+        tex.storage_2d(levels, internal_format, width, height);
+        tex.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        tex.parameter(GL_TEXTURE_MIN_FILTER, (levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        tex.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        tex.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        tex.parameter(GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     }
 
-    void draw_triangles()
+    //Decode the 6 images (on 6 threads if 'parallel') and upload them. Every face is decoded and checked before the first GL call.
+    void decode_faces(const std::string *paths, bool parallel, bool mipmaps)
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, (int)inds.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        unsigned char *data[6] = {};
+        int img_widths[6], img_heights[6], img_channels[6];
+        const char *reasons[6] = {};
+        auto decode = [&](int i)
+        {
+            TRACE_SCOPE_DYNAMIC(std::string("decode ") + paths[i]);
+            data[i] = stbi_load(paths[i].c_str(), &img_widths[i], &img_heights[i], &img_channels[i], 0);
+            if (data[i] == NULL)
+                reasons[i] = stbi_failure_reason(); //Per thread in stb_image.
+        };
+
+        stbi_set_flip_vertically_on_load(false);
+        if (parallel)
+        {
+            std::thread workers[6];
+            for (int i = 0; i < 6; i++)
+                workers[i] = std::thread(decode, i);
+            for (std::thread &w : workers)
+                w.join();
+        }
+        else
+        {
+            for (int i = 0; i < 6; i++)
+                decode(i);
+        }
+
+        for (int i = 0; i < 6; i++)
+        {
+            if (data[i] == NULL)
+            {
+                fprintf(stderr, "Error : Failed to load texture '%s' (%s). Exiting...\n", paths[i].c_str(), reasons[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        //Check if all images have the same width, height, and channels. Otherwise the skybox cannot be created.
+        for (int i = 1; i < 6; i++)
+        {
+            if (img_widths[i] != img_widths[0] || img_heights[i] != img_heights[0] || img_channels[i] != img_channels[0])
+            {
+                fprintf(stderr, "Error : All 6 images must have the same width, height, and channels ('%s' is %dx%dx%d, '%s' is %dx%dx%d). Exiting...\n",
+                        paths[0].c_str(), img_widths[0], img_heights[0], img_channels[0], paths[i].c_str(), img_widths[i], img_heights[i], img_channels[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        GLenum format, internal_format;
+        if (!pixel_format(img_channels[0], format, internal_format))
+        {
+            fprintf(stderr, "Error : Skybox images with %d channels are not supported. Exiting...\n", img_channels[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        create_texture(mipmaps ? gl_texture::mip_levels(img_widths[0], img_heights[0]) : 1, internal_format, img_widths[0], img_heights[0]);
+        for (int i = 0; i < 6; i++)
+        {
+            upload_pixels(tex, i, img_widths[i], img_heights[i], format, data[i]);
+            stbi_image_free(data[i]);
+        }
+        if (mipmaps)
+            glGenerateTextureMipmap(tex.get_id());
     }
-};
 
+    //Cache file : 6 unsigned ints (magic, version, width, height, channels, levels), then the pixels of level 0 of the faces 0...5,
+    //then of level 1 of the faces 0...5, etc. Rows are tightly packed, in the order OpenGL expects them. False if the file is not a
+    //valid cache with the requested levels (the caller then decodes the images and rewrites it).
+    bool read_cache(const char *cache_path, bool mipmaps)
+    {
+        FILE *file = fopen(cache_path, "rb");
+        if (file == NULL)
+            return false;
+        unsigned int header[6];
+        bool ok = (fread(header, sizeof(header), 1, file) == 1 && header[0] == cache_magic && header[1] == cache_version);
+        int width = ok ? (int)header[2] : 0, height = ok ? (int)header[3] : 0, channels = ok ? (int)header[4] : 0, levels = ok ? (int)header[5] : 0;
+        GLenum format, internal_format;
+        ok = ok && width > 0 && height > 0 && pixel_format(channels, format, internal_format) &&
+             levels == (mipmaps ? gl_texture::mip_levels(width, height) : 1);
+        std::vector<unsigned char> pixels;
+        if (ok)
+        {
+            size_t bytes = 0;
+            for (int level = 0; level < levels; level++)
+                bytes += 6*face_bytes(width, height, channels, level);
+            pixels.resize(bytes);
+            ok = (fread(pixels.data(), 1, bytes, file) == bytes && fgetc(file) == EOF);
+        }
+        fclose(file);
+        if (!ok)
+            return false;
 
+        create_texture(levels, internal_format, width, height);
+        const unsigned char *p = pixels.data();
+        for (int level = 0; level < levels; level++)
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                upload_pixels(tex, i, std::max(width >> level, 1), std::max(height >> level, 1), format, p, level);
+                p += face_bytes(width, height, channels, level);
+            }
+        }
+        return true;
+    }
 
-class skybox
-{
-private:
-    unsigned int vao, vbo, ebo, tex; //Vertex array object, vertex buffer object, element (index) buffer object and texture ID.
+    //Read every level of the uploaded cubemap back and save it as a cache file. It is written under a temporary name first, so that an
+    //interrupted write never leaves a cache behind.
+    void write_cache(const char *cache_path) const
+    {
+        int width, height, levels;
+        glGetTextureLevelParameteriv(tex.get_id(), 0, GL_TEXTURE_WIDTH, &width);
+        glGetTextureLevelParameteriv(tex.get_id(), 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTextureParameteriv(tex.get_id(), GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+        int internal_format;
+        glGetTextureLevelParameteriv(tex.get_id(), 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+        int channels = (internal_format == GL_R8) ? 1 : ((internal_format == GL_RGB8) ? 3 : 4);
+        GLenum format, unused;
+        pixel_format(channels, format, unused);
+
+        std::vector<unsigned char> pixels;
+        int alignment;
+        glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        for (int level = 0; level < levels; level++)
+        {
+            size_t bytes = face_bytes(width, height, channels, level);
+            for (int i = 0; i < 6; i++)
+            {
+                pixels.resize(pixels.size() + bytes);
+                glGetTextureSubImage(tex.get_id(), level, 0,0,i, std::max(width >> level, 1),std::max(height >> level, 1),1, format, GL_UNSIGNED_BYTE,
+                                     (GLsizei)bytes, pixels.data() + pixels.size() - bytes);
+            }
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+
+        std::error_code ec;
+        std::filesystem::path dir = std::filesystem::path(cache_path).parent_path();
+        if (!dir.empty())
+            std::filesystem::create_directories(dir, ec);
+        std::string temp_path = std::string(cache_path) + ".tmp";
+        FILE *file = fopen(temp_path.c_str(), "wb");
+        if (file == NULL)
+        {
+            fprintf(stderr, "Error : Failed to write the skybox cache '%s'.\n", cache_path);
+            return;
+        }
+        unsigned int header[6] = { cache_magic, cache_version, (unsigned int)width, (unsigned int)height, (unsigned int)channels, (unsigned int)levels };
+        bool ok = (fwrite(header, sizeof(header), 1, file) == 1 && fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size());
+        ok = (fclose(file) == 0) && ok;
+        if (ok)
+            std::filesystem::rename(temp_path, cache_path, ec);
+        if (!ok || ec)
+        {
+            fprintf(stderr, "Error : Failed to write the skybox cache '%s'.\n", cache_path);
+            std::filesystem::remove(temp_path, ec);
+        }
+    }
 
 public:
     //Construct the mesh procedurally (i.e. no geometry data like vertices or uvs are read from a file), setup the mesh in the gpu memory, load the 6 images and tell how to wrap them.
     //Note : Make sure that all 6 images have the same size in pixels (e.g. 2048x2048, 500x500, etc...) AND the same type of extensions (e.g. jpg, png, bmp, ...).
-    skybox(const char *right_img_path, const char *left_img_path, const char *top_img_path, const char *bottom_img_path, const char *front_img_path, const char *back_img_path)
-    {   
+    //'cache_path' (optional) : A single file with the 6 faces decoded (and their mipmaps), ready to upload. If it exists and is newer than the
+    //images, it is loaded instead of them. Otherwise the images are decoded and the file is (re)written for the next launch.
+    //'mipmaps' : Give the cubemap a full mipmap chain (trilinear filtering). 'parallel' : Decode the 6 images concurrently, 1 thread each.
+    skybox(const char *right_img_path, const char *left_img_path, const char *top_img_path, const char *bottom_img_path, const char *front_img_path, const char *back_img_path,
+           const char *cache_path = NULL, bool mipmaps = true, bool parallel = true)
+    {
+        TRACE_SCOPE("load skybox");
         //Cube vertices. This is basically the interleaved buffer itself.
         float verts[] = { -1.0f, -1.0f,  1.0f,
                            1.0f, -1.0f,  1.0f,
@@ -432,91 +889,54 @@ public:
                                 5, 4, 0 };
 
         //Setup skybox's data in the memory.
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(verts), &verts, GL_STATIC_DRAW);
-
-        glGenBuffers(1, &ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(inds), &inds, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glBindVertexArray(0);
-
-        //Create the skybox's texture.
-        glGenTextures(1, &tex);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //This is useful for textures with non-standard widths or single-channel textures (e.g. grayscale).
-        //glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        vbo = gl_buffer(sizeof(verts), verts);
+        ebo = gl_buffer(sizeof(inds), inds);
+        vao = gl_vertex_array("skybox");
+        vao.vertex_buffer(0, vbo, 0, 3*sizeof(float));
+        vao.element_buffer(ebo);
+        vao.attrib(0, 3, 0);
 
         //Skybox's expected image names. Do not change their order!
         std::string paths[6] = { right_img_path, left_img_path, top_img_path, bottom_img_path, front_img_path, back_img_path };
-        int img_widths[6], img_heights[6], img_channels[6];
 
-        stbi_set_flip_vertically_on_load(false);
-        for (int i = 0; i < 6; i++)
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool cached = (cache_path != NULL && cache_is_fresh(cache_path, paths, 6) && read_cache(cache_path, mipmaps));
+        if (cached)
+            load_source = "cache";
+        else
         {
-            unsigned char *data = stbi_load(paths[i].c_str(), &img_widths[i], &img_heights[i], &img_channels[i], 0);
-            if (!data)
-                fprintf(stderr, "Error : Failed to load texture '%s'\n", paths[i].c_str());
-
-            //Determine the correct format for glTexImage2D based on the number of channels (img_channels).
-            GLenum format;
-            if (img_channels[i] == 1)
-                format = GL_RED; //Single-channel grayscale image.
-            else if (img_channels[i] == 3)
-                format = GL_RGB; //Classical 3-channel image (e.g. jpg).
-            else if (img_channels[i] == 4)
-                format = GL_RGBA; //4-channel image, i.e. RGB + alpha channel for opacity (e.g. png).
-
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, img_widths[i], img_heights[i], 0, format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+            decode_faces(paths, parallel, mipmaps);
+            load_source = parallel ? "parallel decode" : "serial decode";
         }
+        load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (cache_path != NULL && !cached)
+            write_cache(cache_path); //Not part of the load time : It happens once.
 
-        //Check if all images have the same width, height, and channels. Otherwise the skybox may not render.
-        bool img_consistency = true;
-        for (int i = 1; i < 6; i++)
-        {
-            if (img_widths[i] != img_widths[0] || img_heights[i] != img_heights[0] || img_channels[i] != img_channels[0])
-            {
-                img_consistency = false;
-                break;
-            }
-        }
-        if (!img_consistency)
-            fprintf(stderr, "Error : All 6 images must have the same width, height, and channels.\n");
+        //Filter across the edges of the faces (instead of clamping at each face), so that the seams don't show at the coarser mipmaps.
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    }
 
+    //Time [ms] it took to get the 6 faces into the cubemap, and from where ("cache", "parallel decode" or "serial decode").
+    double get_load_ms() const
+    {
+        return load_ms;
     }
 
-    //Delete the skybox's resources.
-    ~skybox()
+    const char *get_load_source() const
     {
-        glDeleteVertexArrays(1, &vao);
-        glDeleteBuffers(1, &ebo);
-        glDeleteBuffers(1, &vbo);
-        glDeleteTextures(1, &tex);
+        return load_source;
     }
 
     //Draw the skybox.
     void draw_triangles()
     {
-        glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
-        glBindVertexArray(vao);
+        tex.bind(0);
+        vao.bind();
         glDepthFunc(GL_LEQUAL); //Ensures that the skybox fragments will render behind everything else. (A bit dangerous to place it here. Be cautious.)
 		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
         glDepthFunc(GL_LESS); //Restore the default depth test function for rendering the rest of the scene.
 		glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        glBindTextureUnit(0, 0);
     }
 };
 
@@ -525,7 +945,8 @@ public:
 class quadtex
 {
 private:
-    unsigned int vao, vbo;
+    gl_vertex_array vao;
+    gl_buffer vbo;
 
 public:
     quadtex()
@@ -540,36 +961,21 @@ public:
                                          1.0f, -1.0f, 0.0f,  1.0f, 0.0f,
                                          1.0f,  1.0f, 0.0f,  1.0f, 1.0f };
 
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(interleaved_buffer), &interleaved_buffer, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*)0); //Positions.
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*)(3*sizeof(float))); //UVs.
-        glEnableVertexAttribArray(1);
-        glBindVertexArray(0);
-    }
-
-    //Delete the quadtex mesh.
-    ~quadtex()
-    {
-        glDeleteVertexArrays(1, &vao);
-        glDeleteBuffers(1, &vbo);
+        vbo = gl_buffer(sizeof(interleaved_buffer), interleaved_buffer);
+        vao = gl_vertex_array("quadtex");
+        vao.vertex_buffer(0, vbo, 0, 5*sizeof(float));
+        vao.attrib(0, 3, 0); //Positions.
+        vao.attrib(1, 2, 3*sizeof(float)); //UVs.
     }
 
     //Draw the quadtex mesh (2 triangles).
     void draw_triangles(unsigned int fbo_tex)
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, fbo_tex);
-        glBindVertexArray(vao);
+        glBindTextureUnit(0, fbo_tex);
+        vao.bind();
         glDrawArrays(GL_TRIANGLES, 0, 6);
         glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindTextureUnit(0, 0);
     }
 };
 
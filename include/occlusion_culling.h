@@ -0,0 +1,343 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include<GL/glew.h>
+#include<glm/glm.hpp>
+#include<cstdio>
+#include<cstdlib>
+#include<cstdint>
+#include<vector>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"shader.h"
+#include"mesh.h"
+#include"gpu_culling.h"
+#include"hiz_pyramid.h"
+
+//Occlusion culling of a large mesh (e.g. a whole building merged in 1 obj) on the gpu, against a Hi-Z pyramid (hiz_pyramid.h). The mesh
+//is cut into clusters of a few hundred triangles that lie close together (halving the triangles along the longest axis of their centroids
+//until they fit), each with its bounding box and its own indirect draw command. Every frame, in 2 passes
+//(../shaders/compute/occlusion_cull.comp) :
+//- cull_early() + draw() : The clusters that were visible last frame (and are in the frustum) are drawn. For a moving camera they are
+//  nearly the same as this frame's, so their depth is a good occluder, and unlike the previous frame's depth it fits the current view.
+//- cull_late() + draw() : The pyramid is built from that depth and every cluster in the frustum is tested against it. The visible ones
+//  are remembered for the next frame, and those that the early pass skipped are drawn now, in the same frame : Clusters coming into view
+//  never pop in a frame late.
+//The cpu only uploads the frustum planes and the matrix, and reads the statistics a few frames late, without waiting.
+//The vertex shader is the usual trans_mvpn.vert (with the model matrix of the mesh).
+class occlusion_culling
+{
+private:
+    //std430 layout of cluster in the compute shader.
+    struct cluster_bounds
+    {
+        glm::vec4 lo, hi;
+        uint32_t first_index, index_count;
+        uint32_t pad[2];
+    };
+
+    //Same layout as the DrawElementsIndirectCommand of the OpenGL specification.
+    struct indirect_command
+    {
+        unsigned int count;
+        unsigned int instance_count;
+        unsigned int first_index;
+        int base_vertex;
+        unsigned int base_instance;
+    };
+
+    //Shader storage bindings. 0 to 9 are taken by the instances, the gpu culling and the clustered lights.
+    static constexpr int clusters_binding = 10, commands_binding = 11, history_binding = 12, stats_binding = 13;
+    static const int stats_count = 8; //See cull_stats in the compute shader.
+    static const int readback_frames = 3; //The statistics are read this many frames late, so the cpu never waits for them.
+
+    compute_shader early_program, late_program;
+    hiz_pyramid hiz;
+    gl_vertex_array vao;
+    gl_buffer vbo, ebo;
+    gl_buffer cluster_buffer, early_commands, late_commands, history_buffer, stats_buffer, readback_buffer;
+    const gl_buffer *current_commands = nullptr; //Of the last cull pass, for draw().
+    const uint32_t *readback = nullptr; //Persistent mapping of readback_buffer.
+    GLsync readback_fences[readback_frames] = {};
+    int frame = 0;
+    int clusters = 0, triangles = 0;
+    uint32_t stats[stats_count] = {}; //readback_frames frames late.
+    bool stats_known = false;
+
+    //Cut the triangles [begin, end) of 'order' into clusters of up to 'size' triangles : 'order' is rearranged so that every cluster is a
+    //contiguous range, and the end of every range is appended to 'cluster_ends'.
+    static void split(std::vector<int> &order, int begin, int end, int size, const std::vector<glm::vec3> &centroids, std::vector<int> &cluster_ends)
+    {
+        int n = end - begin;
+        if (n <= size)
+        {
+            cluster_ends.push_back(end);
+            return;
+        }
+        glm::vec3 lo = centroids[order[begin]], hi = lo;
+        for (int i = begin + 1; i < end; i++)
+        {
+            lo = glm::min(lo, centroids[order[i]]);
+            hi = glm::max(hi, centroids[order[i]]);
+        }
+        glm::vec3 extent = hi - lo;
+        int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+        //Split at a multiple of 'size', so that the clusters come out full.
+        int chunks = (n + size - 1)/size;
+        int mid = begin + (chunks/2)*size;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        split(order, begin, mid, size, centroids, cluster_ends);
+        split(order, mid, end, size, centroids, cluster_ends);
+    }
+
+    void set_frustum(unsigned int program, const glm::mat4 &view_projection)
+    {
+        glm::vec4 planes[6];
+        frustum_planes(view_projection, planes);
+        glProgramUniform4fv(program, glGetUniformLocation(program, "planes"), 6, &planes[0][0]);
+        glProgramUniform1ui(program, glGetUniformLocation(program, "cluster_count"), (unsigned int)clusters);
+    }
+
+    void bind_buffers(const gl_buffer &commands)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, clusters_binding, cluster_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, commands_binding, commands.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, history_binding, history_buffer.get_id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, stats_binding, stats_buffer.get_id());
+        current_commands = &commands;
+    }
+
+    //Queue a copy of this frame's statistics, and pick up the copy made readback_frames frames ago if it has landed.
+    void queue_readback()
+    {
+        int slot = frame%readback_frames;
+        if (readback_fences[slot] != nullptr)
+        {
+            if (glClientWaitSync(readback_fences[slot], 0, 0) != GL_TIMEOUT_EXPIRED)
+            {
+                std::copy(readback + stats_count*slot, readback + stats_count*(slot + 1), stats);
+                stats_known = true;
+            }
+            glDeleteSync(readback_fences[slot]);
+        }
+        glCopyNamedBufferSubData(stats_buffer.get_id(), readback_buffer.get_id(), 0, (GLintptr)(slot*sizeof(stats)), sizeof(stats));
+        readback_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++frame;
+    }
+
+public:
+    //'cull_shader_path' : ../shaders/compute/occlusion_cull.comp, 'hiz_shader_path' : ../shaders/compute/hiz_build.comp. The mesh is
+    //copied into clusters of up to 'cluster_triangles' triangles (the mesh object itself is not needed afterwards).
+    occlusion_culling(const char *cull_shader_path, const char *hiz_shader_path, const meshvfn &mesh, int cluster_triangles = 256) :
+        early_program(cull_shader_path), late_program(cull_shader_path, {"LATE_PASS"}), hiz(hiz_shader_path), vao("occlusion culling clusters")
+    {
+        const std::vector<float> &verts = mesh.get_interleaved_buffer();
+        const std::vector<unsigned int> &inds = mesh.get_indices();
+        triangles = (int)inds.size()/3;
+        if (triangles == 0 || cluster_triangles < 1)
+        {
+            fprintf(stderr, "Error : occlusion_culling needs a mesh with triangles and clusters of at least 1 triangle. Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+
+        std::vector<glm::vec3> centroids(triangles);
+        std::vector<int> order(triangles);
+        for (int t = 0; t < triangles; t++)
+        {
+            glm::vec3 sum = glm::vec3(0.0f);
+            for (int k = 0; k < 3; k++)
+                sum += glm::vec3(verts[6*inds[3*t + k]], verts[6*inds[3*t + k] + 1], verts[6*inds[3*t + k] + 2]);
+            centroids[t] = sum/3.0f;
+            order[t] = t;
+        }
+        std::vector<int> cluster_ends;
+        split(order, 0, triangles, cluster_triangles, centroids, cluster_ends);
+
+        //The indices, cluster after cluster, and the bounds of every cluster.
+        std::vector<unsigned int> cluster_inds;
+        cluster_inds.reserve(inds.size());
+        std::vector<cluster_bounds> bounds;
+        int begin = 0;
+        for (int end : cluster_ends)
+        {
+            cluster_bounds b;
+            glm::vec3 lo = glm::vec3(1e30f), hi = glm::vec3(-1e30f);
+            b.first_index = (uint32_t)cluster_inds.size();
+            for (int i = begin; i < end; i++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int v = inds[3*order[i] + k];
+                    glm::vec3 p = glm::vec3(verts[6*v], verts[6*v + 1], verts[6*v + 2]);
+                    lo = glm::min(lo, p);
+                    hi = glm::max(hi, p);
+                    cluster_inds.push_back(v);
+                }
+            }
+            b.index_count = (uint32_t)(cluster_inds.size() - b.first_index);
+            b.lo = glm::vec4(lo, 0.0f);
+            b.hi = glm::vec4(hi, 0.0f);
+            b.pad[0] = b.pad[1] = 0;
+            bounds.push_back(b);
+            begin = end;
+        }
+        clusters = (int)bounds.size();
+
+        vbo = gl_buffer(verts.size()*sizeof(float), verts.data());
+        ebo = gl_buffer(cluster_inds.size()*sizeof(unsigned int), cluster_inds.data());
+        vao.vertex_buffer(0, vbo, 0, 6*sizeof(float));
+        vao.element_buffer(ebo);
+        vao.attrib(0, 3, 0); //For vertices.
+        vao.attrib(1, 3, 3*sizeof(float)); //For normals.
+
+        cluster_buffer = gl_buffer(bounds.size()*sizeof(cluster_bounds), bounds.data());
+        early_commands = gl_buffer((long long)clusters*sizeof(indirect_command), nullptr);
+        late_commands = gl_buffer((long long)clusters*sizeof(indirect_command), nullptr);
+        std::vector<uint32_t> history(clusters, 0); //Nothing was visible before the first frame : It is all drawn by the late pass.
+        history_buffer = gl_buffer((long long)clusters*sizeof(uint32_t), history.data());
+        stats_buffer = gl_buffer(sizeof(stats), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        readback_buffer = gl_buffer(readback_frames*sizeof(stats), nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        readback = (const uint32_t*)glMapNamedBufferRange(readback_buffer.get_id(), 0, readback_frames*sizeof(stats), flags);
+        if (readback == nullptr)
+        {
+            fprintf(stderr, "Error : Failed to map the occlusion culling readback buffer. Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ~occlusion_culling()
+    {
+        for (int i = 0; i < readback_frames; i++)
+            if (readback_fences[i] != nullptr)
+                glDeleteSync(readback_fences[i]);
+    }
+
+    occlusion_culling(const occlusion_culling &) = delete;
+    occlusion_culling &operator=(const occlusion_culling &) = delete;
+
+    //Early pass : Pick the clusters in the frustum that were visible last frame, for the next draw(). Without 'occlusion', pick all the
+    //clusters in the frustum and skip cull_late() (frustum culling only).
+    void cull_early(const glm::mat4 &view_projection, bool occlusion = true)
+    {
+        const uint32_t zero[stats_count] = {};
+        stats_buffer.upload(0, sizeof(zero), zero);
+        unsigned int program = early_program.get_id();
+        set_frustum(program, view_projection);
+        glProgramUniform1i(program, glGetUniformLocation(program, "occlusion"), occlusion);
+        bind_buffers(early_commands);
+        early_program.dispatch(((unsigned int)clusters + 63)/64);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        if (!occlusion)
+            queue_readback();
+    }
+
+    //Late pass, after draw() rendered the early clusters into 'depth' ('w' x 'h', a depth texture without comparison) : Build the Hi-Z
+    //pyramid from it, test all clusters and pick the newly visible ones for the next draw().
+    void cull_late(const glm::mat4 &view_projection, const gl_texture &depth, int w, int h)
+    {
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); //The depth was written by the early draw.
+        hiz.build(depth, w, h);
+        unsigned int program = late_program.get_id();
+        set_frustum(program, view_projection);
+        glProgramUniformMatrix4fv(program, glGetUniformLocation(program, "view_projection"), 1, GL_FALSE, &view_projection[0][0]);
+        hiz.bind(0);
+        bind_buffers(late_commands);
+        late_program.dispatch(((unsigned int)clusters + 63)/64);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        glBindTextureUnit(0, 0);
+        queue_readback();
+    }
+
+    //Draw the clusters picked by the last cull pass with 'program' (uniforms already set), in 1 multi-draw.
+    void draw(shader &program)
+    {
+        program.use();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, current_commands->get_id());
+        vao.bind();
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, clusters, sizeof(indirect_command));
+        glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    //Draw the whole mesh, without culling (for comparison).
+    void draw_all(shader &program)
+    {
+        program.use();
+        vao.bind();
+        glDrawElements(GL_TRIANGLES, 3*triangles, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    int cluster_count() const
+    {
+        return clusters;
+    }
+
+    int triangle_count() const
+    {
+        return triangles;
+    }
+
+    //Statistics of the frame readback_frames frames ago (all 0 until the first result arrives) : Clusters (draws of the multi-draw) and
+    //triangles drawn by the early and the late pass, and rejected by the frustum and by the occlusion test.
+    int early_draw_count() const
+    {
+        return (int)stats[0];
+    }
+
+    int early_triangle_count() const
+    {
+        return (int)stats[1];
+    }
+
+    int late_draw_count() const
+    {
+        return (int)stats[2];
+    }
+
+    int late_triangle_count() const
+    {
+        return (int)stats[3];
+    }
+
+    int frustum_culled_count() const
+    {
+        return (int)stats[4];
+    }
+
+    int frustum_culled_triangle_count() const
+    {
+        return (int)stats[5];
+    }
+
+    int occluded_count() const
+    {
+        return (int)stats[6];
+    }
+
+    int occluded_triangle_count() const
+    {
+        return (int)stats[7];
+    }
+
+    bool has_stats() const
+    {
+        return stats_known;
+    }
+
+    const hiz_pyramid &get_hiz() const
+    {
+        return hiz;
+    }
+
+    long long memory_bytes() const
+    {
+        return vbo.size() + ebo.size() + cluster_buffer.size() + early_commands.size() + late_commands.size() + history_buffer.size() + hiz.memory_bytes();
+    }
+};
+
+#endif
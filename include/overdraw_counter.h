@@ -0,0 +1,69 @@
+#ifndef OVERDRAW_COUNTER_H
+#define OVERDRAW_COUNTER_H
+
+#include<GL/glew.h>
+
+#include"gl_objects.h"
+#include"shader.h"
+#include"mesh.h"
+
+//Counts the fragments shaded per pixel (overdraw) : The lit shaders built with OVERDRAW (../shaders/common/dir_light.glsl) add 1 to their
+//pixel in a 32 bit unsigned integer image with an image atomic, and show() paints the counts as a heat map (../shaders/fragment/overdraw.frag).
+//Every fragment that passes the depth test is counted, whether or not a later one covers it, so 1 per covered pixel is the ideal.
+class overdraw_counter
+{
+private:
+    shader view_program;
+    quadtex quad;
+    gl_texture counts;
+    int width = 0, height = 0;
+
+public:
+    //'vertex_path' : ../shaders/vertex/trans_nothing_texture.vert, 'fragment_path' : ../shaders/fragment/overdraw.frag.
+    overdraw_counter(const char *vertex_path, const char *fragment_path) : view_program(vertex_path, fragment_path) {}
+
+    overdraw_counter(const overdraw_counter &) = delete;
+    overdraw_counter &operator=(const overdraw_counter &) = delete;
+
+    //Zero the counts of a 'w' x 'h' framebuffer (the image is re-created when the size changes) and bind them to image unit 0 for the
+    //passes to count into.
+    void begin(int w, int h)
+    {
+        if (w != width || h != height)
+        {
+            width = w;
+            height = h;
+            counts = gl_texture(GL_TEXTURE_2D);
+            counts.storage_2d(1, GL_R32UI, width, height);
+            counts.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST); //Integer textures can't be filtered.
+            counts.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        unsigned int zero = 0;
+        glClearTexImage(counts.get_id(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindImageTexture(0, counts.get_id(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    }
+
+    //After the counted passes.
+    void end()
+    {
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); //Read with texelFetch() by show().
+        glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    }
+
+    //Paint the counts over the bound framebuffer (of the size given to begin()), red from 'max_count' fragments per pixel up.
+    void show(int max_count)
+    {
+        view_program.use();
+        view_program.set_int_uniform("max_count", max_count);
+        glDisable(GL_DEPTH_TEST);
+        quad.draw_triangles(counts.get_id());
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    long long memory_bytes() const
+    {
+        return 4LL*width*height;
+    }
+};
+
+#endif
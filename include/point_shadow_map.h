@@ -0,0 +1,273 @@
+#ifndef POINT_SHADOW_MAP_H
+#define POINT_SHADOW_MAP_H
+
+#include<GL/glew.h>
+#include<glm/glm.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<cstdio>
+#include<cstdlib>
+#include<cmath>
+#include<string>
+#include<vector>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"shader.h"
+#include"mesh.h"
+
+//A shadow caster of a point shadow map : A mesh, its model matrix and the radius of its bounding sphere in local coordinates (e.g.
+//get_farthest_vertex_distance()).
+struct point_shadow_caster
+{
+    meshvfn *mesh;
+    glm::mat4 model;
+    float radius;
+};
+
+//Omnidirectional shadow map of a point light : A depth cubemap, 1 face per axis direction, each seen through a 90 degree frustum from the
+//light. Instead of the depth of the face's projection, every texel holds the distance from the light divided by the light's range
+//(../shaders/fragment/point_shadow_depth.frag), which is linear, the same for all 6 faces and looked up with the very direction from the
+//light. So 16 bits are plenty and the lit shader compares with hardware comparison (a samplerCubeShadow, ../shaders/common/point_shadow.glsl).
+//Every caster is tested against the 6 face frusta on the cpu, so it is only drawn into the faces it can touch. Two ways to render :
+//- render() : 1 pass. Each caster is 1 instanced draw with 1 instance per face it touches, and the vertex shader sends every instance to
+//  its face of the cubemap with gl_Layer (layered rendering). Needs ARB_shader_viewport_layer_array (or AMD_vertex_shader_layer).
+//- render_six_pass() : 1 pass per face (the classic way), with the casters submitted again for every face. For comparison, and where the
+//  extension is missing.
+//Both use ../shaders/vertex/trans_point_shadow.vert, with POINT_SHADOW_LAYERED defined for render().
+class point_shadow_map
+{
+private:
+    gl_texture tex;
+    gl_framebuffer fbo; //All 6 faces, for layered rendering.
+    gl_framebuffer face_fbos[6]; //1 face each, for render_six_pass().
+    int resolution = 0;
+    GLenum format = GL_DEPTH_COMPONENT16;
+    float near_plane = 0.05f, range = 25.0f;
+    glm::vec3 light_pos = glm::vec3(0.0f);
+    glm::mat4 pv[6]; //Projection*view of every face.
+    bool layered = false;
+    bool culling = true;
+
+    //Statistics of the last render.
+    int draws = 0, face_draws = 0, culled_face_draws = 0;
+
+    //Bounding sphere of a caster in world coordinates.
+    static void world_sphere(const point_shadow_caster &caster, glm::vec3 &center, float &radius)
+    {
+        center = glm::vec3(caster.model[3]);
+        float scale = std::max({glm::length(glm::vec3(caster.model[0])), glm::length(glm::vec3(caster.model[1])), glm::length(glm::vec3(caster.model[2]))});
+        radius = caster.radius*scale;
+    }
+
+    void draw(const point_shadow_caster &caster, int instances)
+    {
+        glBindVertexArray(caster.mesh->get_vao_id());
+        glDrawElementsInstanced(GL_TRIANGLES, caster.mesh->get_index_count(), GL_UNSIGNED_INT, 0, instances);
+        glBindVertexArray(0);
+    }
+
+public:
+    point_shadow_map() {}
+
+    //A cubemap of 6 faces of 'resolution'^2 texels. 'depth_format' : GL_DEPTH_COMPONENT16 (enough for linear distances), 24 or 32F.
+    point_shadow_map(int resolution, GLenum depth_format = GL_DEPTH_COMPONENT16) : tex(GL_TEXTURE_CUBE_MAP), fbo("point shadow map"), resolution(resolution), format(depth_format)
+    {
+        tex.storage_2d(1, depth_format, resolution, resolution);
+        tex.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR); //With comparison, linear filtering blends the 4 nearest comparison results.
+        tex.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        tex.parameter(GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        tex.parameter(GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        tex.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        tex.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        tex.parameter(GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS); //Filter across the edges of the faces.
+        fbo.attach(GL_DEPTH_ATTACHMENT, tex); //All faces, for layered rendering.
+        fbo.no_color_buffer();
+        fbo.check();
+        for (int i = 0; i < 6; i++)
+        {
+            face_fbos[i] = gl_framebuffer("point shadow map face");
+            face_fbos[i].attach_layer(GL_DEPTH_ATTACHMENT, tex, i);
+            face_fbos[i].no_color_buffer();
+            face_fbos[i].check();
+        }
+        layered = GLEW_ARB_shader_viewport_layer_array || GLEW_AMD_vertex_shader_layer;
+    }
+
+    //Place the light. Nothing farther than 'light_range' from it casts or receives shadows.
+    void update(const glm::vec3 &position, float light_range)
+    {
+        light_pos = position;
+        range = light_range;
+        //The orientations of the cubemap faces (+x, -x, +y, -y, +z, -z), as the texture lookups expect them.
+        const glm::vec3 dirs[6] = { glm::vec3(1,0,0), glm::vec3(-1,0,0), glm::vec3(0,1,0), glm::vec3(0,-1,0), glm::vec3(0,0,1), glm::vec3(0,0,-1) };
+        const glm::vec3 ups[6] = { glm::vec3(0,-1,0), glm::vec3(0,-1,0), glm::vec3(0,0,1), glm::vec3(0,0,-1), glm::vec3(0,-1,0), glm::vec3(0,-1,0) };
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, near_plane, range);
+        for (int i = 0; i < 6; i++)
+            pv[i] = projection*glm::lookAt(light_pos, light_pos + dirs[i], ups[i]);
+    }
+
+    //Faces (bit i for face i) whose frustum a sphere touches. A face's frustum is the 90 degree pyramid around its axis, so the sphere
+    //is outside of a side plane (e.g. x = y for +x) when it is more than 'radius' behind it.
+    unsigned int face_mask(const glm::vec3 &center, float radius) const
+    {
+        glm::vec3 p = center - light_pos;
+        if (glm::length(p) - radius > range)
+            return 0;
+        if (!culling)
+            return 63;
+        float r = radius*std::sqrt(2.0f);
+        unsigned int mask = 0;
+        for (int i = 0; i < 6; i++)
+        {
+            int a = i/2, u = (a + 1)%3, v = (a + 2)%3;
+            float d = (i%2 == 0) ? p[a] : -p[a];
+            if (d + radius > 0.0f && d - std::fabs(p[u]) >= -r && d - std::fabs(p[v]) >= -r)
+                mask |= 1u << i;
+        }
+        return mask;
+    }
+
+    //Render the casters into all faces in 1 pass (layered). 'program' is the depth shader built with POINT_SHADOW_LAYERED. Only where
+    //is_layered() (the shader doesn't even compile otherwise) : Use render_six_pass() there.
+    void render(shader &program, const point_shadow_caster *casters, int count)
+    {
+        if (!layered)
+        {
+            fprintf(stderr, "Error : Layered point shadows need ARB_shader_viewport_layer_array or AMD_vertex_shader_layer. Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+        fbo.bind();
+        glViewport(0,0, resolution,resolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        set_uniforms(program);
+        int face_list = glGetUniformLocation(program.get_id(), "face_list");
+        draws = face_draws = culled_face_draws = 0;
+        for (int k = 0; k < count; k++)
+        {
+            glm::vec3 center;
+            float radius;
+            world_sphere(casters[k], center, radius);
+            unsigned int mask = face_mask(center, radius);
+            int faces[6], instances = 0;
+            for (int i = 0; i < 6; i++)
+                if (mask & (1u << i))
+                    faces[instances++] = i;
+            culled_face_draws += 6 - instances;
+            if (instances == 0)
+                continue;
+            glUniform1iv(face_list, instances, faces); //Instance i goes to face faces[i].
+            glm::mat4 model = casters[k].model;
+            program.set_mat4_uniform("model", model);
+            draw(casters[k], instances);
+            ++draws;
+            face_draws += instances;
+        }
+    }
+
+    //Render the casters face by face, 6 passes. 'program' is the depth shader built without POINT_SHADOW_LAYERED.
+    void render_six_pass(shader &program, const point_shadow_caster *casters, int count)
+    {
+        set_uniforms(program);
+        draws = face_draws = culled_face_draws = 0;
+        std::vector<unsigned int> masks(count);
+        for (int k = 0; k < count; k++)
+        {
+            glm::vec3 center;
+            float radius;
+            world_sphere(casters[k], center, radius);
+            masks[k] = face_mask(center, radius);
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            face_fbos[i].bind();
+            glViewport(0,0, resolution,resolution);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            program.set_int_uniform("face", i);
+            for (int k = 0; k < count; k++)
+            {
+                if (!(masks[k] & (1u << i)))
+                {
+                    ++culled_face_draws;
+                    continue;
+                }
+                glm::mat4 model = casters[k].model;
+                program.set_mat4_uniform("model", model);
+                draw(casters[k], 1);
+                ++draws;
+                ++face_draws;
+            }
+        }
+    }
+
+    //Bind the cubemap for sampling (through a samplerCubeShadow).
+    void bind(unsigned int unit) const
+    {
+        tex.bind(unit);
+    }
+
+    //Upload the face matrices, the light's position and range, and the resolution (and the sampler unit, if given) to a program. The
+    //program is made current.
+    void set_uniforms(shader &program, int unit = -1)
+    {
+        program.use();
+        for (int i = 0; i < 6; i++)
+            program.set_mat4_uniform("face_pv[" + std::to_string(i) + "]", pv[i]);
+        program.set_vec3_uniform("light_pos", light_pos);
+        program.set_float_uniform("light_range", range);
+        program.set_float_uniform("point_shadow_resolution", (float)resolution);
+        if (unit >= 0)
+            program.set_int_uniform("sample_point_shadow", unit);
+    }
+
+    //Frustum culling of the casters per face. Off : Every caster within range goes to all 6 faces.
+    void set_culling(bool enable)
+    {
+        culling = enable;
+    }
+
+    void set_near_plane(float near_dist)
+    {
+        near_plane = near_dist;
+    }
+
+    //Whether render() draws all faces in 1 pass.
+    bool is_layered() const
+    {
+        return layered;
+    }
+
+    int get_resolution() const
+    {
+        return resolution;
+    }
+
+    float get_range() const
+    {
+        return range;
+    }
+
+    //Draw calls of the last render, caster-face pairs drawn, and caster-face pairs skipped by the culling (or out of range).
+    int draw_count() const
+    {
+        return draws;
+    }
+
+    int face_draw_count() const
+    {
+        return face_draws;
+    }
+
+    int culled_count() const
+    {
+        return culled_face_draws;
+    }
+
+    long long memory_bytes() const
+    {
+        int bytes = (format == GL_DEPTH_COMPONENT16) ? 2 : 4;
+        return 6LL*bytes*resolution*resolution;
+    }
+};
+
+#endif
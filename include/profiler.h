@@ -0,0 +1,461 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<string>
+#include<vector>
+#include<chrono>
+#include<algorithm>
+
+#include"../imgui/imgui.h"
+#include"../imgui/implot.h"
+
+#include"trace.h"
+
+//Frame profiler : Where does the time of a frame go, on the cpu and on the gpu. Scopes are marked with 1 line each :
+//    PROFILE_SCOPE("physics");        //Cpu time until the end of the enclosing block.
+//    PROFILE_GPU_SCOPE("shadow pass"); //Cpu time, and gpu time of the commands issued in the block.
+//Scopes nest (the tree is built from the order they open and close) and a scope that runs several times in a frame adds up. The cpu
+//side uses a monotonic clock. The gpu side puts a GL_TIMESTAMP query at both ends of the scope (unlike GL_TIME_ELAPSED, timestamps
+//nest). The queries of a frame are read back 'latency' frames later, if they are available by then : The cpu never waits for the gpu,
+//a frame whose results are still missing is dropped instead.
+//Every scope keeps its time over the last 'history' frames (averages and maxima for the table, and the plots of draw_overlay()).
+//While tracing is enabled (trace.h), the frames, the scopes and the gpu timestamps also go to the trace recorder's timelines.
+//Usage : profiler::instance().begin_frame() at the top of the main loop, draw_overlay() among the ImGui windows and release() before the
+//context goes away. Code that isn't a block can be timed with begin_scope()/end_scope(). The stacked bars need an ImPlot context, the rest only ImGui.
+class profiler
+{
+public:
+    static const int history = 120; //Frames kept for the statistics.
+    static const int latency = 4; //Frames between issuing the gpu queries and reading them.
+
+private:
+    struct node
+    {
+        std::string name;
+        const char *label; //The name as given (a literal), for the trace recorder.
+        int parent, depth;
+        bool gpu;
+        float cpu_ms[history] = {}, gpu_ms[history] = {}; //Per frame, indexed by frame%history.
+        float cpu_frame = 0.0f, gpu_frame = 0.0f; //Sums of the frame being recorded (gpu : being collected).
+        ImU32 color;
+    };
+
+    //1 scope of a frame, for the flame chart.
+    struct span
+    {
+        int node;
+        double begin, end; //[ms] since the start of the frame.
+    };
+
+    //The gpu queries of a frame in flight.
+    struct frame_queries
+    {
+        long long frame = -1;
+        std::vector<unsigned int> queries; //Grown on demand, reused.
+        int used = 0;
+        std::vector<std::pair<int, int>> scopes; //(node, index of the begin timestamp; the end one follows).
+        bool pending = false;
+    };
+
+    std::vector<node> nodes;
+    std::vector<int> stack; //Open scopes : Node indices.
+    std::vector<int> span_stack; //Open scopes : Indices in 'spans'.
+    std::vector<int> query_stack; //Open scopes : Index of the begin timestamp (-1 for cpu only scopes).
+    std::vector<span> spans, last_cpu_spans, last_gpu_spans; //This frame / the last complete frames.
+    double last_cpu_frame_ms = 0.0, last_gpu_frame_ms = 0.0;
+    frame_queries slots[latency];
+    long long frame = -1;
+    std::chrono::steady_clock::time_point frame_start;
+    int dropped = 0; //Frames whose gpu results weren't ready in time.
+    bool recording = false; //Between 2 begin_frame() calls, unless paused.
+    bool paused = false;
+    long long trace_frame_start = -1; //[ns] on the trace recorder's clock.
+    long long gpu_to_trace = 0; //Gpu timestamp + this = trace recorder's clock [ns].
+    bool gpu_calibrated = false;
+
+    static ImU32 color_of(const std::string &name)
+    {
+        unsigned int h = 2166136261u; //FNV-1a, so that a scope keeps its color from run to run.
+        for (char c : name)
+            h = (h ^ (unsigned char)c)*16777619u;
+        return ImColor::HSV((h%360)/360.0f, 0.55f, 0.85f);
+    }
+
+    int find_node(const char *name, bool gpu)
+    {
+        int parent = stack.empty() ? -1 : stack.back();
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (nodes[i].parent == parent && nodes[i].name == name)
+            {
+                nodes[i].gpu = nodes[i].gpu || gpu;
+                return (int)i;
+            }
+        node n;
+        n.name = name;
+        n.label = name;
+        n.parent = parent;
+        n.depth = (int)stack.size();
+        n.gpu = gpu;
+        n.color = color_of(n.name);
+        nodes.push_back(n);
+        return (int)nodes.size() - 1;
+    }
+
+    double now_ms() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+    }
+
+    unsigned int next_query(frame_queries &q)
+    {
+        if (q.used == (int)q.queries.size())
+        {
+            unsigned int id;
+            glCreateQueries(GL_TIMESTAMP, 1, &id);
+            q.queries.push_back(id);
+        }
+        return q.queries[q.used++];
+    }
+
+    //Read the timestamps of a frame, if they have all arrived. Returns false otherwise.
+    bool collect(frame_queries &q)
+    {
+        if (!q.pending)
+            return true;
+        int available = 0;
+        glGetQueryObjectiv(q.queries[q.used - 1], GL_QUERY_RESULT_AVAILABLE, &available); //Timestamps complete in order.
+        if (!available)
+            return false;
+
+        std::vector<GLuint64> stamps(q.used);
+        for (int i = 0; i < q.used; i++)
+            glGetQueryObjectui64v(q.queries[i], GL_QUERY_RESULT, &stamps[i]);
+        GLuint64 first = stamps[0], last = stamps[0];
+        for (GLuint64 s : stamps)
+        {
+            first = std::min(first, s);
+            last = std::max(last, s);
+        }
+        for (node &n : nodes)
+            n.gpu_frame = 0.0f;
+        last_gpu_spans.clear();
+        trace_recorder &trace = trace_recorder::instance();
+        bool tracing = trace.is_enabled() && gpu_calibrated;
+        for (const std::pair<int, int> &scope : q.scopes)
+        {
+            double begin = (stamps[scope.second] - first)/1.0e6, end = (stamps[scope.second + 1] - first)/1.0e6;
+            nodes[scope.first].gpu_frame += (float)(end - begin);
+            last_gpu_spans.push_back({scope.first, begin, end});
+            if (tracing)
+                trace.record(nodes[scope.first].label, (long long)stamps[scope.second] + gpu_to_trace, (long long)stamps[scope.second + 1] + gpu_to_trace, trace_recorder::gpu_track);
+        }
+        for (node &n : nodes)
+            n.gpu_ms[q.frame%history] = n.gpu_frame;
+        last_gpu_frame_ms = (last - first)/1.0e6;
+        q.pending = false;
+        return true;
+    }
+
+    void end_frame()
+    {
+        while (!stack.empty()) //Scopes left open : Close them at the end of the frame.
+            end_scope();
+        for (node &n : nodes)
+        {
+            n.cpu_ms[frame%history] = n.cpu_frame;
+            n.cpu_frame = 0.0f;
+        }
+        last_cpu_frame_ms = now_ms();
+        last_cpu_spans.swap(spans);
+        spans.clear();
+        frame_queries &q = slots[frame%latency];
+        q.pending = (q.used > 0);
+    }
+
+    //Average and maximum over the frames in the history.
+    void stats(const float *values, float &average, float &maximum) const
+    {
+        int count = (int)std::min<long long>(frame, history);
+        average = maximum = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            average += values[i];
+            maximum = std::max(maximum, values[i]);
+        }
+        if (count > 0)
+            average /= count;
+    }
+
+    //Flame chart of 1 frame : A bar per scope, 1 row per nesting depth, 'total_ms' across the available width.
+    void draw_flame(const char *id, const std::vector<span> &frame_spans, double total_ms)
+    {
+        const float row = ImGui::GetTextLineHeight() + 2.0f;
+        int depth = 0;
+        for (const span &s : frame_spans)
+            depth = std::max(depth, nodes[s.node].depth + 1);
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        float width = std::max(ImGui::GetContentRegionAvail().x, 50.0f);
+        ImGui::InvisibleButton(id, ImVec2(width, std::max(depth, 1)*row));
+        ImDrawList *draw = ImGui::GetWindowDrawList();
+        float scale = (total_ms > 0.0) ? (float)(width/total_ms) : 0.0f;
+        for (const span &s : frame_spans)
+        {
+            const node &n = nodes[s.node];
+            ImVec2 a = ImVec2(origin.x + (float)s.begin*scale, origin.y + n.depth*row);
+            ImVec2 b = ImVec2(origin.x + std::max((float)s.end*scale, (float)s.begin*scale + 1.0f), a.y + row - 1.0f);
+            draw->AddRectFilled(a, b, n.color);
+            if (b.x - a.x > ImGui::CalcTextSize(n.name.c_str()).x + 4.0f)
+                draw->AddText(ImVec2(a.x + 2.0f, a.y + 1.0f), IM_COL32(0,0,0,255), n.name.c_str());
+            if (ImGui::IsMouseHoveringRect(a, b))
+                ImGui::SetTooltip("%s : %.3f [ms]", n.name.c_str(), s.end - s.begin);
+        }
+    }
+
+    profiler() {}
+
+public:
+    profiler(const profiler &) = delete;
+    profiler &operator=(const profiler &) = delete;
+
+    //The profiler that the PROFILE_* macros record into.
+    static profiler &instance()
+    {
+        static profiler p;
+        return p;
+    }
+
+    //Close the previous frame and start a new one. Picks up the gpu results that have arrived.
+    void begin_frame()
+    {
+        if (recording)
+            end_frame();
+        recording = !paused;
+        if (!recording)
+            return;
+        for (frame_queries &q : slots)
+            collect(q);
+
+        ++frame;
+        frame_queries &q = slots[frame%latency];
+        if (!collect(q))
+        {
+            ++dropped; //Still not done after 'latency' frames : Give up on it rather than wait.
+            q.pending = false;
+        }
+        q.frame = frame;
+        q.used = 0;
+        q.scopes.clear();
+        frame_start = std::chrono::steady_clock::now();
+
+        trace_recorder &trace = trace_recorder::instance();
+        long long now = trace.now();
+        if (trace.is_enabled())
+        {
+            if (trace_frame_start >= 0)
+                trace.record("frame", trace_frame_start, now);
+            if (!gpu_calibrated || frame%60 == 0) //Both clocks drift a little : Match them again every 60 frames.
+            {
+                GLint64 gpu_now = 0;
+                glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+                gpu_to_trace = trace.now() - gpu_now;
+                gpu_calibrated = true;
+            }
+        }
+        trace_frame_start = now;
+    }
+
+    //Open a scope (closed by the next end_scope()). For code that isn't a block of its own, otherwise use the PROFILE_* macros.
+    void begin_scope(const char *name, bool gpu = false)
+    {
+        if (!recording)
+            return;
+        int n = find_node(name, gpu);
+        stack.push_back(n);
+        span_stack.push_back((int)spans.size());
+        spans.push_back({n, now_ms(), 0.0});
+        query_stack.push_back(-1);
+        if (gpu)
+        {
+            frame_queries &q = slots[frame%latency];
+            query_stack.back() = q.used;
+            q.scopes.push_back({n, q.used});
+            glQueryCounter(next_query(q), GL_TIMESTAMP);
+            next_query(q); //Reserved for the end.
+        }
+    }
+
+    void end_scope()
+    {
+        if (!recording || stack.empty())
+            return;
+        span &s = spans[span_stack.back()];
+        s.end = now_ms();
+        nodes[stack.back()].cpu_frame += (float)(s.end - s.begin);
+        trace_recorder &trace = trace_recorder::instance();
+        if (trace.is_enabled())
+            trace.record(nodes[stack.back()].label, trace_frame_start + (long long)(1.0e6*s.begin), trace_frame_start + (long long)(1.0e6*s.end));
+        if (query_stack.back() >= 0)
+            glQueryCounter(slots[frame%latency].queries[query_stack.back() + 1], GL_TIMESTAMP);
+        stack.pop_back();
+        span_stack.pop_back();
+        query_stack.pop_back();
+    }
+
+    //Freeze the statistics and the charts (e.g. to look at a spike).
+    void set_paused(bool pause)
+    {
+        paused = pause;
+    }
+
+    //Delete the queries. Call while the context still exists.
+    void release()
+    {
+        for (frame_queries &q : slots)
+        {
+            if (!q.queries.empty())
+                glDeleteQueries((int)q.queries.size(), q.queries.data());
+            q = frame_queries();
+        }
+    }
+
+    //Average cpu and gpu time of a scope [ms], over the history (0 if there is no such scope).
+    float cpu_average_ms(const char *name) const
+    {
+        float average = 0.0f, maximum;
+        for (const node &n : nodes)
+            if (n.name == name)
+                stats(n.cpu_ms, average, maximum);
+        return average;
+    }
+
+    float gpu_average_ms(const char *name) const
+    {
+        float average = 0.0f, maximum;
+        for (const node &n : nodes)
+            if (n.name == name && n.gpu)
+                stats(n.gpu_ms, average, maximum);
+        return average;
+    }
+
+    //ImGui window with the scope tree (average/max cpu and gpu time), flame charts of the last frame and stacked bars of the top level
+    //scopes over the history.
+    void draw_overlay(bool *open = nullptr)
+    {
+        ImGui::SetNextWindowSize(ImVec2(520.0f, 520.0f), ImGuiCond_FirstUseEver);
+        if (!ImGui::Begin("Profiler", open))
+        {
+            ImGui::End();
+            return;
+        }
+        bool pause = paused;
+        if (ImGui::Checkbox("Pause", &pause))
+            set_paused(pause);
+        ImGui::SameLine();
+        ImGui::Text("Frame : %.2f [ms] (cpu), %.2f [ms] (gpu), %d gpu frames dropped", last_cpu_frame_ms, last_gpu_frame_ms, dropped);
+
+        if (ImGui::BeginTable("scopes", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp))
+        {
+            ImGui::TableSetupColumn("scope");
+            ImGui::TableSetupColumn("cpu avg");
+            ImGui::TableSetupColumn("cpu max");
+            ImGui::TableSetupColumn("gpu avg");
+            ImGui::TableSetupColumn("gpu max");
+            ImGui::TableHeadersRow();
+            //Depth first, so that children follow their parent.
+            std::vector<int> order, todo;
+            for (int i = (int)nodes.size() - 1; i >= 0; i--)
+                if (nodes[i].parent == -1)
+                    todo.push_back(i);
+            while (!todo.empty())
+            {
+                int i = todo.back();
+                todo.pop_back();
+                order.push_back(i);
+                for (int k = (int)nodes.size() - 1; k >= 0; k--)
+                    if (nodes[k].parent == i)
+                        todo.push_back(k);
+            }
+            for (int i : order)
+            {
+                const node &n = nodes[i];
+                float cpu_avg, cpu_max, gpu_avg, gpu_max;
+                stats(n.cpu_ms, cpu_avg, cpu_max);
+                stats(n.gpu_ms, gpu_avg, gpu_max);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextColored(ImColor(n.color), "%*s%s", 2*n.depth, "", n.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", cpu_avg);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", cpu_max);
+                ImGui::TableNextColumn();
+                if (n.gpu)
+                    ImGui::Text("%.3f", gpu_avg);
+                ImGui::TableNextColumn();
+                if (n.gpu)
+                    ImGui::Text("%.3f", gpu_max);
+            }
+            ImGui::EndTable();
+        }
+
+        ImGui::Text("Last frame (cpu)");
+        draw_flame("##cpu_flame", last_cpu_spans, last_cpu_frame_ms);
+        ImGui::Text("Last collected frame (gpu)");
+        draw_flame("##gpu_flame", last_gpu_spans, last_gpu_frame_ms);
+
+        //Cpu time of the top level scopes, stacked per frame, oldest frame first.
+        std::vector<int> top;
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (nodes[i].parent == -1)
+                top.push_back((int)i);
+        if (ImPlot::GetCurrentContext() != nullptr && !top.empty() && frame > 0)
+        {
+            long long current = recording ? frame : frame + 1; //The first frame that isn't complete.
+            int count = (int)std::min<long long>(current, history);
+            std::vector<const char*> labels;
+            std::vector<float> values; //[scope][frame]
+            for (int i : top)
+            {
+                labels.push_back(nodes[i].name.c_str());
+                for (int k = 0; k < count; k++)
+                    values.push_back(nodes[i].cpu_ms[(current - count + k)%history]);
+            }
+            if (ImPlot::BeginPlot("##history", ImVec2(-1.0f, 200.0f)))
+            {
+                ImPlot::SetupAxes("frame", "cpu [ms]", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+                ImPlot::SetupLegend(ImPlotLocation_NorthWest);
+                ImPlot::PlotBarGroups(labels.data(), values.data(), (int)top.size(), count, 1.0, 0.0, ImPlotBarGroupsFlags_Stacked);
+                ImPlot::EndPlot();
+            }
+        }
+        ImGui::End();
+    }
+
+};
+
+//Times its own lifetime (see PROFILE_SCOPE and PROFILE_GPU_SCOPE).
+class profile_scope
+{
+public:
+    profile_scope(const char *name, bool gpu)
+    {
+        profiler::instance().begin_scope(name, gpu);
+    }
+
+    ~profile_scope()
+    {
+        profiler::instance().end_scope();
+    }
+
+    profile_scope(const profile_scope &) = delete;
+    profile_scope &operator=(const profile_scope &) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)(name, false)
+#define PROFILE_GPU_SCOPE(name) profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)(name, true)
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include<GL/glew.h>
+#include<glm/glm.hpp>
+#include<cstdio>
+#include<cstring>
+#include<cstdint>
+#include<vector>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"ring_buffer.h"
+#include"shader.h"
+#include"mesh.h"
+
+//Indexed geometry as the render queue sees it : A range of indices in the buffers of a vao.
+struct draw_mesh
+{
+    unsigned int vao;
+    int index_count;
+    int first_index; //In indices, not bytes.
+    int base_vertex;
+};
+
+inline draw_mesh make_draw_mesh(const meshvfn &mesh)
+{
+    return draw_mesh{mesh.get_vao_id(), mesh.get_index_count(), 0, 0};
+}
+
+//Several meshvfn packed in 1 vertex and 1 index buffer behind 1 vao. Draws of different meshes of the pool can then go to the same
+//glMultiDrawElementsIndirect() call, because nothing has to be re-bound in between. Add all the meshes first, then build() (the storage is immutable).
+class mesh_pool
+{
+private:
+    gl_vertex_array vao;
+    gl_buffer vbo, ebo;
+    std::vector<float> verts; //Interleaved {x,y,z, nx,ny,nz, ...} of all meshes.
+    std::vector<unsigned int> inds; //Indices of all meshes, each relative to the first vertex of its mesh.
+    std::vector<draw_mesh> meshes;
+
+public:
+    //Returns the id of the mesh in the pool.
+    int add(const meshvfn &mesh)
+    {
+        draw_mesh m;
+        m.index_count = mesh.get_index_count();
+        m.first_index = (int)inds.size();
+        m.base_vertex = (int)(verts.size()/6);
+        m.vao = 0; //Known after build().
+        verts.insert(verts.end(), mesh.get_interleaved_buffer().begin(), mesh.get_interleaved_buffer().end());
+        inds.insert(inds.end(), mesh.get_indices().begin(), mesh.get_indices().end());
+        meshes.push_back(m);
+        return (int)meshes.size() - 1;
+    }
+
+    void build()
+    {
+        vbo = gl_buffer(verts.size()*sizeof(float), verts.data());
+        ebo = gl_buffer(inds.size()*sizeof(unsigned int), inds.data());
+        vao = gl_vertex_array("mesh pool");
+        vao.vertex_buffer(0, vbo, 0, 6*sizeof(float));
+        vao.element_buffer(ebo);
+        vao.attrib(0, 3, 0); //For vertices.
+        vao.attrib(1, 3, 3*sizeof(float)); //For normals.
+        for (draw_mesh &m : meshes)
+            m.vao = vao.get_id();
+        verts.clear();
+        verts.shrink_to_fit();
+        inds.clear();
+        inds.shrink_to_fit();
+    }
+
+    const draw_mesh &get(int id) const
+    {
+        return meshes[id];
+    }
+};
+
+//Whether trans_mvpn_indirect.vert finds the base instance of a multi-draw command by itself (gl_BaseInstanceARB). The shader keys on the
+//ARB extension (it is #version 450, so core 4.6 gl_BaseInstance doesn't exist there), so this must too : A 4.6 driver without the
+//extension has to get the base instance through the uniform, 1 draw per command.
+inline bool has_shader_draw_parameters()
+{
+    return GLEW_ARB_shader_draw_parameters;
+}
+
+//How to shade a draw. The program has to read its per-draw data like trans_mvpn_indirect.vert does.
+struct material
+{
+    shader *program;
+    unsigned int texture; //Bound to unit 0 (0 for none).
+    glm::vec3 col;
+};
+
+//Collects the draws of a frame (mesh, material, transform) and renders them in a good order instead of the submission order. Each item
+//gets a 64 bit sort key :
+//
+//   | pass (4) | program (12) | texture (12) | vao (12) | depth (24) |
+//
+//so sorting groups the items by the expensive state changes (program > texture > vao) and, inside a group, orders them front to back
+//(less overdraw; back to front for blended passes). Every run of items with the same state becomes 1 glMultiDrawElementsIndirect() call.
+//Model matrix, normal matrix and color of every item go to a shader storage buffer (the mesh_instance layout), where the vertex shader finds
+//them at gl_BaseInstanceARB + gl_InstanceID (ARB_shader_draw_parameters). Without draw parameters, each command is drawn on its own
+//with the base index passed as a uniform. The per-frame data (instances and commands) is streamed through a ring_buffer.
+class render_queue
+{
+public:
+    struct statistics
+    {
+        int items; //Draws submitted.
+        int batches; //Runs of items with the same state.
+        int commands; //Indirect draw commands (adjacent items of the same mesh share 1 instanced command).
+        int gl_calls; //OpenGL calls issued by flush().
+        int state_changes; //Program, texture and vao binds among them.
+    };
+
+private:
+    struct item
+    {
+        uint64_t key;
+        draw_mesh mesh;
+        material mat;
+        glm::mat4 model;
+        bool back_to_front;
+        int pass;
+    };
+
+    //Same layout as the DrawElementsIndirectCommand of the OpenGL specification.
+    struct indirect_command
+    {
+        unsigned int count;
+        unsigned int instance_count;
+        unsigned int first_index;
+        int base_vertex;
+        unsigned int base_instance;
+    };
+
+    std::vector<item> items;
+    std::vector<uint32_t> order; //Indices into items, sorted by key.
+    std::vector<indirect_command> commands;
+    ring_buffer stream;
+    bool has_draw_parameters;
+    int ssbo_alignment;
+    statistics stats = {};
+
+    static uint64_t make_key(const item &it, float depth)
+    {
+        uint32_t depth_bits;
+        std::memcpy(&depth_bits, &depth, sizeof(depth_bits)); //For positive floats the bit patterns sort like the values.
+        uint64_t d = depth_bits >> 8; //Keep the top 24 bits.
+        if (it.back_to_front)
+            d = 0xFFFFFF - d;
+        return ((uint64_t)(it.pass & 0xF) << 60) |
+               ((uint64_t)(it.mat.program->get_id() & 0xFFF) << 48) |
+               ((uint64_t)(it.mat.texture & 0xFFF) << 36) |
+               ((uint64_t)(it.mesh.vao & 0xFFF) << 24) |
+               d;
+    }
+
+    static bool same_state(const item &a, const item &b)
+    {
+        return a.pass == b.pass && a.mat.program->get_id() == b.mat.program->get_id() && a.mat.texture == b.mat.texture && a.mesh.vao == b.mesh.vao;
+    }
+
+public:
+    //'frame_size' is the initial per-flush size of the stream (it grows if needed).
+    render_queue(long long frame_size = 4*1024*1024) : stream(frame_size, "render queue")
+    {
+        has_draw_parameters = has_shader_draw_parameters();
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_alignment);
+    }
+
+    //Queue a draw. Lower passes are drawn first. Only the pointers/ids are stored, so the mesh and the material's shader must live until flush().
+    void submit(const draw_mesh &mesh, const material &mat, const glm::mat4 &model, int pass = 0, bool back_to_front = false)
+    {
+        item it;
+        it.mesh = mesh;
+        it.mat = mat;
+        it.model = model;
+        it.pass = pass;
+        it.back_to_front = back_to_front;
+        items.push_back(it);
+    }
+
+    //Sort and draw everything submitted since the last flush(). 'cam_pos' is needed for the depth order. The programs must already have
+    //their other uniforms (projection, view, lights, ...) set.
+    void flush(const glm::vec3 &cam_pos)
+    {
+        stats = statistics();
+        stats.items = (int)items.size();
+        if (items.empty())
+            return;
+
+        //Sort.
+        for (item &it : items)
+        {
+            glm::vec3 d = glm::vec3(it.model[3]) - cam_pos;
+            it.key = make_key(it, glm::dot(d, d)); //Squared distance : Same order, no sqrt.
+        }
+        order.resize(items.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = (uint32_t)i;
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return items[a].key < items[b].key; });
+
+        //Per-draw data, in sorted order : Item i of the sorted list reads instance i.
+        stream.begin_frame();
+        ring_allocation inst_alloc = stream.allocate(items.size()*sizeof(mesh_instance), ssbo_alignment);
+        mesh_instance *inst = (mesh_instance*)inst_alloc.ptr;
+        for (size_t i = 0; i < order.size(); i++)
+            inst[i] = make_instance(items[order[i]].model, items[order[i]].mat.col);
+
+        //Indirect commands : Adjacent items that draw the same mesh become 1 instanced command.
+        commands.clear();
+        std::vector<int> batch_ends; //1 past the last command of every batch.
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const item &it = items[order[i]];
+            bool new_batch = (i == 0 || !same_state(items[order[i - 1]], it));
+            if (new_batch && i > 0)
+                batch_ends.push_back((int)commands.size());
+            indirect_command *last = commands.empty() ? nullptr : &commands.back();
+            if (!new_batch && last->first_index == (unsigned int)it.mesh.first_index && last->base_vertex == it.mesh.base_vertex &&
+                last->count == (unsigned int)it.mesh.index_count)
+            {
+                ++last->instance_count;
+                continue;
+            }
+            indirect_command cmd;
+            cmd.count = (unsigned int)it.mesh.index_count;
+            cmd.instance_count = 1;
+            cmd.first_index = (unsigned int)it.mesh.first_index;
+            cmd.base_vertex = it.mesh.base_vertex;
+            cmd.base_instance = (unsigned int)i;
+            commands.push_back(cmd);
+        }
+        batch_ends.push_back((int)commands.size());
+        stats.batches = (int)batch_ends.size();
+        stats.commands = (int)commands.size();
+
+        ring_allocation cmd_alloc = stream.allocate(commands.size()*sizeof(indirect_command), 4);
+        std::memcpy(cmd_alloc.ptr, commands.data(), commands.size()*sizeof(indirect_command));
+        if (cmd_alloc.buffer != inst_alloc.buffer) //The stream grew in between : Everything must come from the same buffer.
+        {
+            inst_alloc = stream.allocate(items.size()*sizeof(mesh_instance), ssbo_alignment);
+            inst = (mesh_instance*)inst_alloc.ptr;
+            for (size_t i = 0; i < order.size(); i++)
+                inst[i] = make_instance(items[order[i]].model, items[order[i]].mat.col);
+        }
+
+        //Draw.
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, inst_alloc.buffer, (GLintptr)inst_alloc.offset, (GLsizeiptr)(items.size()*sizeof(mesh_instance)));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cmd_alloc.buffer);
+        stats.gl_calls += 2;
+        unsigned int program = 0, texture = 0, vao = 0;
+        int first = 0;
+        for (int end : batch_ends)
+        {
+            const item &it = items[order[commands[first].base_instance]];
+            if (it.mat.program->get_id() != program)
+            {
+                program = it.mat.program->get_id();
+                glUseProgram(program);
+                ++stats.state_changes;
+            }
+            if (it.mat.texture != texture)
+            {
+                texture = it.mat.texture;
+                glBindTextureUnit(0, texture);
+                ++stats.state_changes;
+            }
+            if (it.mesh.vao != vao)
+            {
+                vao = it.mesh.vao;
+                glBindVertexArray(vao);
+                ++stats.state_changes;
+            }
+
+            intptr_t offset = (intptr_t)(cmd_alloc.offset + first*sizeof(indirect_command)); //Into the bound indirect buffer.
+            if (has_draw_parameters)
+            {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)offset, end - first, sizeof(indirect_command));
+                ++stats.gl_calls;
+            }
+            else
+            {
+                int location = glGetUniformLocation(program, "base_instance");
+                for (int c = first; c < end; c++)
+                {
+                    glUniform1i(location, (int)commands[c].base_instance);
+                    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(offset + (c - first)*sizeof(indirect_command)));
+                }
+                stats.gl_calls += 1 + 2*(end - first);
+            }
+            first = end;
+        }
+        stats.gl_calls += stats.state_changes;
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        stream.end_frame();
+        items.clear();
+    }
+
+    //Statistics of the last flush().
+    const statistics &get_statistics() const
+    {
+        return stats;
+    }
+
+    bool uses_draw_parameters() const
+    {
+        return has_draw_parameters;
+    }
+
+    //The per-frame stream (its size, growth and stalls).
+    const ring_buffer &get_stream() const
+    {
+        return stream;
+    }
+};
+
+#endif
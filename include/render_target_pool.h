@@ -0,0 +1,263 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstdlib>
+#include<vector>
+#include<memory>
+#include<algorithm>
+
+#include"gl_objects.h"
+
+//What a render target is made of. 0 as a format means "no such attachment".
+struct render_target_desc
+{
+    int width = 0, height = 0;
+    GLenum color_format = GL_RGBA8;
+    GLenum depth_format = 0;
+    int samples = 1;
+
+    bool operator==(const render_target_desc &other) const
+    {
+        return width == other.width && height == other.height && color_format == other.color_format &&
+               depth_format == other.depth_format && samples == other.samples;
+    }
+};
+
+//An fbo with its attachments (textures, so that later passes can sample them).
+struct render_target
+{
+    render_target_desc desc;
+    gl_texture color, depth;
+    gl_framebuffer fbo;
+    long long bytes = 0;
+    bool in_use = false;
+    long long last_used = 0; //Frame of the last acquire().
+
+    //Bind the fbo and set the viewport to its size.
+    void bind() const
+    {
+        fbo.bind();
+        glViewport(0,0, desc.width,desc.height);
+    }
+};
+
+//Hands out render targets for the passes of a frame. A pass acquire()s a target, renders to it, and release()s it once the passes that
+//read it are done : Then the same target (same size, formats and samples) goes to the next pass that asks for one, later in the frame
+//or in the next frames. Passes whose lifetimes don't overlap thus share memory, and nothing is allocated in a steady state.
+//Only passes that ask for the very same kind of target share : OpenGL can't alias the storage of textures of different sizes or formats
+//(texture views only reinterpret formats of the same size class), so a target of another kind is allocated separately, even when a
+//free one could have held its bytes.
+//Targets that nobody asked for during 'max_idle_frames' frames (e.g. of the old size, after a resize) are deleted in begin_frame().
+class render_target_pool
+{
+private:
+    std::vector<std::unique_ptr<render_target>> targets; //Pointers, so that handed out references survive new allocations.
+    long long frame = 0;
+    int max_idle_frames = 60;
+
+    long long allocated = 0, peak_allocated = 0; //Bytes of all the targets.
+    long long in_use = 0, frame_peak_in_use = 0, last_frame_peak_in_use = 0; //Bytes of the acquired targets.
+    long long frame_requested = 0, last_frame_requested = 0; //Bytes asked for in a frame (what the passes would take without sharing).
+    int allocations = 0; //Targets created so far.
+
+    //Bytes per texel of the formats in use (drivers may pad 3 channel formats to 4).
+    static int texel_bytes(GLenum format)
+    {
+        switch (format)
+        {
+            case 0 : return 0;
+            case GL_R8 : return 1;
+            case GL_RG8 : return 2;
+            case GL_RGBA16F : return 8;
+            case GL_RGBA32F : return 16;
+            case GL_RG32F : return 8;
+            default : return 4; //RGB(A)8, R32F, RG16F, R11F_G11F_B10F, depth formats, ...
+        }
+    }
+
+    static void make_attachment(gl_texture &tex, GLenum format, const render_target_desc &desc)
+    {
+        if (desc.samples > 1)
+        {
+            tex = gl_texture(GL_TEXTURE_2D_MULTISAMPLE);
+            tex.storage_2d_multisample(desc.samples, format, desc.width, desc.height);
+            return;
+        }
+        tex = gl_texture(GL_TEXTURE_2D);
+        tex.storage_2d(1, format, desc.width, desc.height);
+        tex.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        tex.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        tex.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        tex.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    void destroy(size_t i)
+    {
+        allocated -= targets[i]->bytes;
+        targets.erase(targets.begin() + i);
+    }
+
+public:
+    //Start a new frame : Delete the targets that have been idle for too long and reset the frame statistics.
+    void begin_frame()
+    {
+        ++frame;
+        for (size_t i = targets.size(); i-- > 0; )
+            if (!targets[i]->in_use && frame - targets[i]->last_used > max_idle_frames)
+                destroy(i);
+        last_frame_peak_in_use = frame_peak_in_use;
+        last_frame_requested = frame_requested;
+        frame_peak_in_use = in_use;
+        frame_requested = 0;
+    }
+
+    //A free target matching 'desc' (created if there is none). It stays reserved until release().
+    render_target &acquire(const render_target_desc &desc)
+    {
+        render_target *t = nullptr;
+        for (auto &candidate : targets)
+            if (!candidate->in_use && candidate->desc == desc)
+            {
+                t = candidate.get();
+                break;
+            }
+
+        if (t == nullptr)
+        {
+            if (desc.width < 1 || desc.height < 1 || (desc.color_format == 0 && desc.depth_format == 0))
+            {
+                fprintf(stderr, "Error : Invalid render target (%dx%d, color 0x%x, depth 0x%x). Exiting...\n", desc.width, desc.height, desc.color_format, desc.depth_format);
+                exit(EXIT_FAILURE);
+            }
+            targets.push_back(std::make_unique<render_target>());
+            t = targets.back().get();
+            t->desc = desc;
+            t->fbo = gl_framebuffer("pooled render target");
+            if (desc.color_format != 0)
+            {
+                make_attachment(t->color, desc.color_format, desc);
+                t->fbo.attach(GL_COLOR_ATTACHMENT0, t->color);
+            }
+            else
+                t->fbo.no_color_buffer();
+            if (desc.depth_format != 0)
+            {
+                make_attachment(t->depth, desc.depth_format, desc);
+                bool stencil = (desc.depth_format == GL_DEPTH24_STENCIL8 || desc.depth_format == GL_DEPTH32F_STENCIL8);
+                t->fbo.attach(stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, t->depth);
+            }
+            if (!t->fbo.check())
+                exit(EXIT_FAILURE);
+            t->bytes = (long long)desc.width*desc.height*std::max(desc.samples, 1)*(texel_bytes(desc.color_format) + texel_bytes(desc.depth_format));
+            allocated += t->bytes;
+            peak_allocated = std::max(peak_allocated, allocated);
+            ++allocations;
+        }
+
+        t->in_use = true;
+        t->last_used = frame;
+        in_use += t->bytes;
+        frame_peak_in_use = std::max(frame_peak_in_use, in_use);
+        frame_requested += t->bytes;
+        return *t;
+    }
+
+    //Give a target back. Its contents stay valid until the next acquire() of the same kind.
+    void release(render_target &t)
+    {
+        if (!t.in_use)
+            return;
+        t.in_use = false;
+        in_use -= t.bytes;
+    }
+
+    //Delete every target (e.g. before the context goes away).
+    void clear()
+    {
+        targets.clear();
+        allocated = in_use = 0;
+    }
+
+    void set_max_idle_frames(int frames)
+    {
+        max_idle_frames = frames;
+    }
+
+    int target_count() const
+    {
+        return (int)targets.size();
+    }
+
+    int allocation_count() const
+    {
+        return allocations;
+    }
+
+    long long allocated_bytes() const
+    {
+        return allocated;
+    }
+
+    long long peak_allocated_bytes() const
+    {
+        return peak_allocated;
+    }
+
+    //Most bytes held at once by the passes of the last frame (the memory the chain really needs).
+    long long frame_peak_bytes() const
+    {
+        return last_frame_peak_in_use;
+    }
+
+    //Bytes the passes of the last frame asked for in total (what they would take, each with its own targets).
+    long long frame_requested_bytes() const
+    {
+        return last_frame_requested;
+    }
+};
+
+//Waits until a size has stopped changing for 'delay' seconds before reporting it, so that dragging the window border doesn't create
+//(and drop) a new set of targets at every pixel. Meanwhile the old size keeps being used (and stretched to the window).
+class resize_debouncer
+{
+private:
+    int width = 0, height = 0; //Settled size.
+    int pending_width = 0, pending_height = 0;
+    double changed_at = 0.0;
+    double delay;
+
+public:
+    resize_debouncer(double delay = 0.25) : delay(delay) {}
+
+    //Feed the current size (every frame, or from the resize callback). Returns true when the settled size changes.
+    bool update(int w, int h, double now)
+    {
+        if (w != pending_width || h != pending_height)
+        {
+            pending_width = w;
+            pending_height = h;
+            changed_at = now;
+        }
+        if (pending_width == width && pending_height == height)
+            return false;
+        if (width != 0 && now - changed_at < delay) //The first size is taken at once.
+            return false;
+        width = pending_width;
+        height = pending_height;
+        return true;
+    }
+
+    int get_width() const
+    {
+        return width;
+    }
+
+    int get_height() const
+    {
+        return height;
+    }
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<vector>
+#include<utility>
+#include<chrono>
+
+#include"gl_objects.h"
+
+//A sub-allocation of the ring buffer. Write the data through 'ptr' and point OpenGL to 'offset' in 'buffer'.
+struct ring_allocation
+{
+    void *ptr; //Cpu address (persistently mapped and coherent, so no flush/unmap is ever needed).
+    long long offset; //Byte offset in the buffer (for glBindBufferRange(), vertex/index offsets, etc...).
+    unsigned int buffer; //OpenGL name of the buffer. It only changes when the ring has to grow.
+};
+
+//Streaming of per-frame data (model matrices, particles, ui vertices, ...). One buffer is split in 'frames' regions and is mapped once, for
+//its whole life (GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT). Each frame writes into its own region, while the gpu may still read the regions
+//of the previous frames. At the end of a frame a fence is inserted, and before a region is reused its fence is waited on. With 3 regions the
+//cpu can run 2 frames ahead of the gpu before it ever waits. If a frame needs more than a region, the buffer grows (the old one is kept alive
+//until the gpu is done with it), so the sizes given here are only a starting point.
+class ring_buffer
+{
+private:
+    static const int frames = 3; //Triple buffering.
+
+    gl_buffer buf;
+    unsigned char *mapped = nullptr; //Start of the persistent mapping.
+    long long region_size; //Bytes per frame.
+    GLsync fences[frames] = {}; //1 fence per region, inserted at end_frame().
+    int region = 0; //The region of the current frame.
+    long long head = 0; //Next free byte of the current region.
+    long long frame_counter = 0;
+    std::vector<std::pair<gl_buffer, long long>> retired; //Outgrown buffers and the frame they were last used in.
+    const char *label;
+
+    //Statistics.
+    double wait_ms = 0.0, wait_total_ms = 0.0; //Time spent waiting on fences (last frame / total).
+    int stalls = 0; //Frames that found their region still in use by the gpu.
+    int grows = 0; //Times a frame didn't fit and the buffer grew.
+    long long used_bytes = 0, peak_bytes = 0; //Bytes allocated in the last frame / the most ever in a frame.
+
+    void create(long long size)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        region_size = size;
+        buf = gl_buffer(frames*region_size, nullptr, flags);
+        glObjectLabel(GL_BUFFER, buf.get_id(), -1, label);
+        mapped = (unsigned char*)glMapNamedBufferRange(buf.get_id(), 0, frames*region_size, flags);
+        if (mapped == nullptr)
+        {
+            fprintf(stderr, "Error : Failed to map the ring buffer '%s' (%lld bytes). Exiting...\n", label, frames*region_size);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    //The current frame does not fit : Retire the buffer and continue in a bigger one.
+    void grow(long long needed)
+    {
+        long long size = 2*region_size;
+        while (size < needed)
+            size *= 2;
+
+        retired.push_back(std::make_pair(std::move(buf), frame_counter)); //Still referenced by commands of this (and previous) frames.
+        for (int i = 0; i < frames; i++)
+        {
+            if (fences[i] != nullptr)
+            {
+                glDeleteSync(fences[i]); //They guard regions of the retired buffer.
+                fences[i] = nullptr;
+            }
+        }
+        create(size);
+        head = 0;
+        ++grows;
+    }
+
+public:
+    //'frame_size' bytes per frame. The label shows up in debuggers and messages.
+    ring_buffer(long long frame_size, const char *label) : label(label)
+    {
+        create(frame_size);
+    }
+
+    ~ring_buffer()
+    {
+        for (int i = 0; i < frames; i++)
+            if (fences[i] != nullptr)
+                glDeleteSync(fences[i]);
+        //The buffers are unmapped when they get deleted.
+    }
+
+    ring_buffer(const ring_buffer &) = delete;
+    ring_buffer &operator=(const ring_buffer &) = delete;
+
+    //Start a frame : Move to the next region and wait until the gpu has finished reading it (normally it has, long ago).
+    void begin_frame()
+    {
+        ++frame_counter;
+        region = (region + 1)%frames;
+        head = 0;
+        used_bytes = 0;
+        wait_ms = 0.0;
+
+        GLsync &fence = fences[region];
+        if (fence != nullptr)
+        {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                ++stalls;
+                auto t0 = std::chrono::steady_clock::now();
+                GLenum status;
+                do
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); //1 ms at a time.
+                while (status == GL_TIMEOUT_EXPIRED);
+                wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                wait_total_ms += wait_ms;
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        //Buffers retired at least 'frames' frames ago are no longer in use (their last fence has been waited on by now).
+        while (!retired.empty() && frame_counter - retired.front().second >= frames)
+            retired.erase(retired.begin());
+    }
+
+    //End a frame, after the last command that reads this frame's data has been issued.
+    void end_frame()
+    {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    //Reserve 'size' bytes in the current frame. 'alignment' must be a power of 2 (e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT).
+    ring_allocation allocate(long long size, long long alignment = 4)
+    {
+        long long offset = (head + alignment - 1) & ~(alignment - 1);
+        if (offset + size > region_size)
+        {
+            grow(size + alignment);
+            offset = 0;
+        }
+        head = offset + size;
+        used_bytes += size;
+        if (used_bytes > peak_bytes)
+            peak_bytes = used_bytes;
+
+        ring_allocation alloc;
+        alloc.offset = region*region_size + offset;
+        alloc.ptr = mapped + alloc.offset;
+        alloc.buffer = buf.get_id();
+        return alloc;
+    }
+
+    unsigned int get_id() const
+    {
+        return buf.get_id();
+    }
+
+    long long frame_capacity() const
+    {
+        return region_size;
+    }
+
+    long long bytes_used() const
+    {
+        return used_bytes;
+    }
+
+    long long bytes_peak() const
+    {
+        return peak_bytes;
+    }
+
+    //Milliseconds spent waiting on the gpu at the last begin_frame() (0 unless the cpu ran 'frames' frames ahead).
+    double last_wait_ms() const
+    {
+        return wait_ms;
+    }
+
+    double total_wait_ms() const
+    {
+        return wait_total_ms;
+    }
+
+    int stall_count() const
+    {
+        return stalls;
+    }
+
+    //Times the buffer grew, to fit a frame (see frame_capacity() for its size now).
+    int grow_count() const
+    {
+        return grows;
+    }
+};
+
+#endif
@@ -7,89 +7,383 @@
 #include<cstdio>
 #include<fstream>
 #include<string>
+#include<vector>
+#include<unordered_map>
+#include<memory>
+#include<algorithm>
+
+#include"trace.h"
 
 class shader
 {
 private:
+    friend class compute_shader; //Shares the source reading and compilation helpers.
+
     unsigned int ID; //Shader program ID. With this, we recognize which shader to use.
 
-public:
-    //Parse and read the vertex and fragment shader source files. Then compile both. Then link.
-    shader(const char *vpath, const char *fpath)
+    std::string vpath, gpath, fpath; //Source files, kept for reloading. gpath is empty if there is no geometry stage.
+    std::vector<std::string> defines; //Injected #defines, kept for reloading.
+    std::vector<std::string> deps; //Every file the program is built from (the source files plus anything they #include).
+
+    //A reload in flight. The old program (ID) keeps rendering until this one has finished linking.
+    unsigned int pending_ID = 0, pending_vshader = 0, pending_gshader = 0, pending_fshader = 0;
+    std::string error_log; //Errors of the last failed reload (empty if it succeeded).
+
+    //Read a shader source file and recursively paste the contents of every '#include "file"' line in its place. Included paths are relative to the
+    //directory of the file that includes them (like in C/C++). The included files must NOT contain a '#version' line, because that is given by the top file only.
+    //Every file read is appended to 'files'. Returns false (after reporting) if a file is missing or malformed.
+    static bool read_source(const std::string &path, std::string &source, std::vector<std::string> &files, int depth = 0)
     {
-        //Read the vertex shader source code from its file.
-        std::ifstream fpvertex(vpath);
-        if (!fpvertex.is_open())
+        if (depth > 16)
         {
-            fprintf(stderr, "Error : '%s' not found. Exiting...\n", vpath);
-            exit(EXIT_FAILURE);
+            fprintf(stderr, "Error : Too deeply nested #include while reading '%s' (circular include?).\n", path.c_str());
+            return false;
         }
 
-        std::string vtemp;
-        vtemp.assign( (std::istreambuf_iterator<char>(fpvertex)), (std::istreambuf_iterator<char>()) );
-        const char *vsource = vtemp.c_str();
-        
-        //Compile the vertex shader and check for errors.
-        unsigned vshader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vshader, 1, &vsource, NULL);
-        glCompileShader(vshader);
-        int success;
-        char infolog[1024];
-        glGetShaderiv(vshader, GL_COMPILE_STATUS, &success);
-        if (!success)
+        std::ifstream fp(path);
+        if (!fp.is_open())
         {
-            glGetShaderInfoLog(vshader, 1024, NULL, infolog);
-            fprintf(stderr, "Error while compiling '%s'.\n", vpath);
-            fprintf(stderr, "%s\n", infolog);
+            fprintf(stderr, "Error : '%s' not found.\n", path.c_str());
+            return false;
         }
-        
-        //Read the fragment shader source code from its file.
-        std::ifstream fpfragment(fpath);
-        if (!fpfragment.is_open())
+        files.push_back(path);
+
+        std::string dir = "";
+        size_t slash = path.find_last_of("/\\");
+        if (slash != std::string::npos)
+            dir = path.substr(0, slash + 1);
+
+        std::string line;
+        while (getline(fp, line))
         {
-            fprintf(stderr, "Error : '%s' not found. Exiting...\n", fpath);
-            exit(EXIT_FAILURE);
+            size_t first = line.find_first_not_of(" \t");
+            if (first != std::string::npos && line.compare(first, 8, "#include") == 0)
+            {
+                size_t q1 = line.find('"', first + 8);
+                size_t q2 = (q1 == std::string::npos) ? std::string::npos : line.find('"', q1 + 1);
+                if (q2 == std::string::npos)
+                {
+                    fprintf(stderr, "Error : Malformed #include in '%s' : %s\n", path.c_str(), line.c_str());
+                    return false;
+                }
+                if (!read_source(dir + line.substr(q1 + 1, q2 - q1 - 1), source, files, depth + 1))
+                    return false;
+            }
+            else
+                source += line + "\n";
         }
+        return true;
+    }
+
+    //Inject '#define ...' lines right after the '#version' line (GLSL requires '#version' to come first). Each entry is either a macro name
+    //(e.g. "LIGHT_SPECULAR") or a name followed by its value (e.g. "POISSON_SAMPLES 4").
+    static std::string inject_defines(const std::string &source, const std::vector<std::string> &defines)
+    {
+        if (defines.empty())
+            return source;
+
+        std::string block;
+        for (const std::string &def : defines)
+            block += "#define " + def + "\n";
+
+        size_t version = source.find("#version");
+        if (version == std::string::npos)
+            return block + source;
+        size_t eol = source.find('\n', version);
+        if (eol == std::string::npos)
+            return source + "\n" + block;
+        return source.substr(0, eol + 1) + block + source.substr(eol + 1);
+    }
 
-        std::string ftemp;
-        ftemp.assign( (std::istreambuf_iterator<char>(fpfragment)), (std::istreambuf_iterator<char>()) );
-        const char *fsource = ftemp.c_str();
-        
-        //Compile the fragment shader and check for errors.
-        unsigned fshader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fshader, 1, &fsource, NULL);
-        glCompileShader(fshader);
-        glGetShaderiv(fshader, GL_COMPILE_STATUS, &success);
+    //Submit 1 shader stage for compilation. The status is NOT queried here, so that drivers with parallel compilation don't have to block.
+    static unsigned int submit_stage(GLenum type, const std::string &source)
+    {
+        const char *csource = source.c_str();
+        unsigned int stage = glCreateShader(type);
+        glShaderSource(stage, 1, &csource, NULL);
+        glCompileShader(stage);
+        return stage;
+    }
+
+    //Append the compile errors of a stage to 'log'. Returns false if the stage failed.
+    static bool stage_status(unsigned int stage, const char *path, std::string &log)
+    {
+        int success;
+        char infolog[1024];
+        glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
         if (!success)
         {
-            glGetShaderInfoLog(fshader, 1024, NULL, infolog);
-            fprintf(stderr, "Error while compiling '%s'.\n", fpath);
-            fprintf(stderr, "%s\n", infolog);
+            glGetShaderInfoLog(stage, 1024, NULL, infolog);
+            log += "Error while compiling '" + std::string(path) + "'.\n" + infolog + "\n";
         }
-        
-        //Handle linking.
-        ID = glCreateProgram();
-        glAttachShader(ID, vshader);
-        glAttachShader(ID, fshader);
-        glLinkProgram(ID);
-        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        return success;
+    }
+
+    //Read, compile and link the sources into a new program, without waiting for the result. Returns 0 if the sources could not be read.
+    unsigned int submit_program(unsigned int &vshader, unsigned int &gshader, unsigned int &fshader)
+    {
+        std::string vsource, gsource, fsource;
+        std::vector<std::string> files;
+        if (!read_source(vpath, vsource, files) || (!gpath.empty() && !read_source(gpath, gsource, files)) || !read_source(fpath, fsource, files))
+            return 0;
+        deps = files;
+
+        vshader = submit_stage(GL_VERTEX_SHADER, inject_defines(vsource, defines));
+        gshader = gpath.empty() ? 0 : submit_stage(GL_GEOMETRY_SHADER, inject_defines(gsource, defines));
+        fshader = submit_stage(GL_FRAGMENT_SHADER, inject_defines(fsource, defines));
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vshader);
+        if (gshader != 0)
+            glAttachShader(program, gshader);
+        glAttachShader(program, fshader);
+        glLinkProgram(program);
+        return program;
+    }
+
+    //Check the result of a submitted program (this blocks until the driver is done). Returns false and fills 'log' if anything failed.
+    //The stages are deleted either way, since a linked program no longer needs them.
+    bool finish_program(unsigned int program, unsigned int vshader, unsigned int gshader, unsigned int fshader, std::string &log)
+    {
+        log.clear();
+        bool ok = stage_status(vshader, vpath.c_str(), log);
+        if (gshader != 0)
+            ok = stage_status(gshader, gpath.c_str(), log) && ok;
+        ok = stage_status(fshader, fpath.c_str(), log) && ok;
+        int success;
+        char infolog[1024];
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
         if (!success)
         {
-            glGetProgramInfoLog(ID, 1024, NULL, infolog);
-            fprintf(stderr, "Error while linking shader program ('%s' || '%s').\n", vpath, fpath);
-            fprintf(stderr, "%s\n", infolog);
+            glGetProgramInfoLog(program, 1024, NULL, infolog);
+            log += "Error while linking shader program ('" + vpath + "' || '" + fpath + "').\n" + infolog + "\n";
+            ok = false;
         }
-        
+
         //We no longer need the vshader and fshader, so let's delete them from now.
-        //We DO need however the ID, which will be kept for deletion in the destructor.
         glDeleteShader(vshader);
+        glDeleteShader(gshader); //Silently ignored if 0.
         glDeleteShader(fshader);
+        return ok;
+    }
+
+    //Sampler and image uniforms (their value is a texture/image unit).
+    static bool is_opaque_type(GLenum type)
+    {
+        switch (type)
+        {
+            case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE: case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW:
+            case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+            case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_SAMPLER_CUBE_SHADOW: case GL_SAMPLER_BUFFER:
+            case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW: case GL_SAMPLER_CUBE_MAP_ARRAY: case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+            case GL_INT_SAMPLER_1D: case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE: case GL_INT_SAMPLER_1D_ARRAY:
+            case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_INT_SAMPLER_BUFFER:
+            case GL_INT_SAMPLER_2D_RECT: case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+            case GL_UNSIGNED_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+            case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+            case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_UNSIGNED_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+            case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+            case GL_IMAGE_1D: case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_2D_RECT: case GL_IMAGE_CUBE: case GL_IMAGE_BUFFER:
+            case GL_IMAGE_1D_ARRAY: case GL_IMAGE_2D_ARRAY: case GL_IMAGE_CUBE_MAP_ARRAY: case GL_IMAGE_2D_MULTISAMPLE: case GL_IMAGE_2D_MULTISAMPLE_ARRAY:
+            case GL_INT_IMAGE_1D: case GL_INT_IMAGE_2D: case GL_INT_IMAGE_3D: case GL_INT_IMAGE_2D_RECT: case GL_INT_IMAGE_CUBE: case GL_INT_IMAGE_BUFFER:
+            case GL_INT_IMAGE_1D_ARRAY: case GL_INT_IMAGE_2D_ARRAY: case GL_INT_IMAGE_CUBE_MAP_ARRAY: case GL_INT_IMAGE_2D_MULTISAMPLE:
+            case GL_INT_IMAGE_2D_MULTISAMPLE_ARRAY:
+            case GL_UNSIGNED_INT_IMAGE_1D: case GL_UNSIGNED_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_3D: case GL_UNSIGNED_INT_IMAGE_2D_RECT:
+            case GL_UNSIGNED_INT_IMAGE_CUBE: case GL_UNSIGNED_INT_IMAGE_BUFFER: case GL_UNSIGNED_INT_IMAGE_1D_ARRAY: case GL_UNSIGNED_INT_IMAGE_2D_ARRAY:
+            case GL_UNSIGNED_INT_IMAGE_CUBE_MAP_ARRAY: case GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE: case GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY:
+                return true;
+            default:
+                return false;
+        }
     }
 
+    //Carry the current uniform values of the old program over to the new one. Uniforms that are set once before the render loop
+    //(colors, samplers, etc...) would otherwise fall back to zero after a reload.
+    static void copy_uniforms(unsigned int from, unsigned int to)
+    {
+        int count = 0;
+        glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+        for (int i = 0; i < count; ++i)
+        {
+            char name[256];
+            int size;
+            GLenum type;
+            glGetActiveUniform(from, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+            std::string base = name;
+            if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+                base.resize(base.size() - 3);
+
+            for (int e = 0; e < size; ++e)
+            {
+                std::string element = (size > 1) ? base + "[" + std::to_string(e) + "]" : std::string(name);
+                int src = glGetUniformLocation(from, element.c_str());
+                int dst = glGetUniformLocation(to, element.c_str());
+                if (src < 0 || dst < 0) //Block members (UBO/SSBO) have no location.
+                    continue;
+
+                float f[16];
+                double d[16];
+                int n[4];
+                unsigned int u[4];
+                switch (type)
+                {
+                    case GL_FLOAT:             glGetUniformfv(from, src, f); glProgramUniform1fv(to, dst, 1, f); break;
+                    case GL_FLOAT_VEC2:        glGetUniformfv(from, src, f); glProgramUniform2fv(to, dst, 1, f); break;
+                    case GL_FLOAT_VEC3:        glGetUniformfv(from, src, f); glProgramUniform3fv(to, dst, 1, f); break;
+                    case GL_FLOAT_VEC4:        glGetUniformfv(from, src, f); glProgramUniform4fv(to, dst, 1, f); break;
+                    case GL_FLOAT_MAT2:        glGetUniformfv(from, src, f); glProgramUniformMatrix2fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT3:        glGetUniformfv(from, src, f); glProgramUniformMatrix3fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT4:        glGetUniformfv(from, src, f); glProgramUniformMatrix4fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT2x3:      glGetUniformfv(from, src, f); glProgramUniformMatrix2x3fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT2x4:      glGetUniformfv(from, src, f); glProgramUniformMatrix2x4fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT3x2:      glGetUniformfv(from, src, f); glProgramUniformMatrix3x2fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT3x4:      glGetUniformfv(from, src, f); glProgramUniformMatrix3x4fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT4x2:      glGetUniformfv(from, src, f); glProgramUniformMatrix4x2fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_FLOAT_MAT4x3:      glGetUniformfv(from, src, f); glProgramUniformMatrix4x3fv(to, dst, 1, GL_FALSE, f); break;
+                    case GL_DOUBLE:            glGetUniformdv(from, src, d); glProgramUniform1dv(to, dst, 1, d); break;
+                    case GL_DOUBLE_VEC2:       glGetUniformdv(from, src, d); glProgramUniform2dv(to, dst, 1, d); break;
+                    case GL_DOUBLE_VEC3:       glGetUniformdv(from, src, d); glProgramUniform3dv(to, dst, 1, d); break;
+                    case GL_DOUBLE_VEC4:       glGetUniformdv(from, src, d); glProgramUniform4dv(to, dst, 1, d); break;
+                    case GL_DOUBLE_MAT2:       glGetUniformdv(from, src, d); glProgramUniformMatrix2dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT3:       glGetUniformdv(from, src, d); glProgramUniformMatrix3dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT4:       glGetUniformdv(from, src, d); glProgramUniformMatrix4dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT2x3:     glGetUniformdv(from, src, d); glProgramUniformMatrix2x3dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT2x4:     glGetUniformdv(from, src, d); glProgramUniformMatrix2x4dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT3x2:     glGetUniformdv(from, src, d); glProgramUniformMatrix3x2dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT3x4:     glGetUniformdv(from, src, d); glProgramUniformMatrix3x4dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT4x2:     glGetUniformdv(from, src, d); glProgramUniformMatrix4x2dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_DOUBLE_MAT4x3:     glGetUniformdv(from, src, d); glProgramUniformMatrix4x3dv(to, dst, 1, GL_FALSE, d); break;
+                    case GL_INT: case GL_BOOL: glGetUniformiv(from, src, n); glProgramUniform1iv(to, dst, 1, n); break; //Bools are set as ints.
+                    case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, src, n); glProgramUniform2iv(to, dst, 1, n); break;
+                    case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, src, n); glProgramUniform3iv(to, dst, 1, n); break;
+                    case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, src, n); glProgramUniform4iv(to, dst, 1, n); break;
+                    case GL_UNSIGNED_INT:      glGetUniformuiv(from, src, u); glProgramUniform1uiv(to, dst, 1, u); break;
+                    case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, src, u); glProgramUniform2uiv(to, dst, 1, u); break;
+                    case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, src, u); glProgramUniform3uiv(to, dst, 1, u); break;
+                    case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, src, u); glProgramUniform4uiv(to, dst, 1, u); break;
+                    default:
+                        if (is_opaque_type(type)) //The texture/image unit.
+                        {
+                            glGetUniformiv(from, src, n);
+                            glProgramUniform1iv(to, dst, 1, n);
+                        }
+                        else
+                            fprintf(stderr, "Warning : Uniform '%s' (type 0x%x) is not carried over to the reloaded shader.\n", element.c_str(), type);
+                        break;
+                }
+            }
+        }
+    }
+
+public:
+    //Parse and read the vertex and fragment shader source files (resolving any #include). Then compile both. Then link.
+    shader(const char *vpath, const char *fpath) : shader(vpath, fpath, {}) {}
+
+    //Same as above, but also inject the given #defines in every stage. This is how we build variants (permutations) of the same source files,
+    //e.g. shader("trans_mvpn.vert", "dir_light.frag", {"LIGHT_AMBIENT", "LIGHT_SPECULAR"}).
+    //An optional geometry stage goes last (so that it can't be mistaken for a list of #defines), e.g. for layered rendering.
+    shader(const char *vpath, const char *fpath, const std::vector<std::string> &defines, const char *gpath = nullptr) :
+        vpath(vpath), gpath(gpath ? gpath : ""), fpath(fpath), defines(defines)
+    {
+        TRACE_SCOPE_DYNAMIC(std::string("compile ") + vpath + " + " + fpath);
+        unsigned int vshader, gshader, fshader;
+        ID = submit_program(vshader, gshader, fshader);
+        if (ID == 0)
+        {
+            fprintf(stderr, "Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+
+        std::string log;
+        if (!finish_program(ID, vshader, gshader, fshader, log))
+            fprintf(stderr, "%s", log.c_str());
+    }
+
+    //The program owns a GL object, so copies would delete it twice.
+    shader(const shader &) = delete;
+    shader &operator=(const shader &) = delete;
+
     //Delete the shader.
     ~shader()
     {
         glDeleteProgram(ID);
+        if (pending_ID != 0)
+        {
+            glDeleteProgram(pending_ID);
+            glDeleteShader(pending_vshader);
+            glDeleteShader(pending_gshader);
+            glDeleteShader(pending_fshader);
+        }
+    }
+
+    //Start rebuilding the program from its source files (e.g. after they were edited). This returns immediately : The old program keeps
+    //being used until poll_reload() finds the new one linked. With GL_KHR/ARB_parallel_shader_compile the driver compiles in the background.
+    void reload()
+    {
+        if (pending_ID != 0) //A newer edit supersedes the one in flight.
+        {
+            glDeleteProgram(pending_ID);
+            glDeleteShader(pending_vshader);
+            glDeleteShader(pending_gshader);
+            glDeleteShader(pending_fshader);
+            pending_ID = 0;
+        }
+        pending_ID = submit_program(pending_vshader, pending_gshader, pending_fshader);
+        if (pending_ID == 0)
+            error_log = "Could not read the sources of '" + vpath + "' || '" + fpath + "'.\n";
+    }
+
+    //Call once per frame. If the reload has finished, swap the new program in (or report the errors and keep the old one).
+    //Returns true if the program was swapped.
+    bool poll_reload()
+    {
+        if (pending_ID == 0)
+            return false;
+
+        //Don't block the frame while the driver is still busy.
+        if (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)
+        {
+            int done = GL_FALSE;
+            glGetProgramiv(pending_ID, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                return false;
+        }
+
+        unsigned int program = pending_ID;
+        pending_ID = 0;
+        if (!finish_program(program, pending_vshader, pending_gshader, pending_fshader, error_log))
+        {
+            fprintf(stderr, "%sKeeping the previous program.\n", error_log.c_str());
+            glDeleteProgram(program);
+            return false;
+        }
+
+        copy_uniforms(ID, program);
+        int current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        bool was_current = ((unsigned int)current == ID); //Some demos call use() only once, before the render loop.
+        glDeleteProgram(ID);
+        ID = program;
+        if (was_current)
+            glUseProgram(ID);
+        return true;
+    }
+
+    //True while a reload is being compiled.
+    bool reload_pending() const
+    {
+        return pending_ID != 0;
+    }
+
+    //Errors of the last reload (empty if it was successful).
+    const std::string &last_error() const
+    {
+        return error_log;
+    }
+
+    //Every file the program depends on (sources and includes), as they were opened.
+    const std::vector<std::string> &dependencies() const
+    {
+        return deps;
     }
     
     //Activate the current shader.
@@ -98,6 +392,12 @@ public:
         glUseProgram(ID);
     }
 
+    //Shader program ID, for raw OpenGL calls (e.g. glProgramUniform*(...)).
+    unsigned int get_id() const
+    {
+        return ID;
+    }
+
     //The following member functions are used to pass uniform variables to the shaders from the main code.
     
     //Pass to the currently active shader 1 int (uniform).
@@ -178,4 +478,218 @@ public:
     }
 };
 
+
+//A compute program, built from 1 source file. #include and injected #defines work like in shader. Dispatch it with dispatch(), after
+//binding its buffers/images and setting its uniforms (e.g. via glProgramUniform*(get_id(), ...)).
+class compute_shader
+{
+private:
+    unsigned int ID;
+
+public:
+    compute_shader(const char *path, const std::vector<std::string> &defines = {})
+    {
+        TRACE_SCOPE_DYNAMIC(std::string("compile ") + path);
+        std::string source;
+        std::vector<std::string> files;
+        if (!shader::read_source(path, source, files))
+        {
+            fprintf(stderr, "Exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+
+        unsigned int stage = shader::submit_stage(GL_COMPUTE_SHADER, shader::inject_defines(source, defines));
+        ID = glCreateProgram();
+        glAttachShader(ID, stage);
+        glLinkProgram(ID);
+
+        std::string log;
+        shader::stage_status(stage, path, log);
+        int success;
+        char infolog[1024];
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(ID, 1024, NULL, infolog);
+            log += "Error while linking compute program ('" + std::string(path) + "').\n" + infolog + "\n";
+        }
+        if (!log.empty())
+            fprintf(stderr, "%s", log.c_str());
+        glDeleteShader(stage);
+    }
+
+    compute_shader(const compute_shader &) = delete;
+    compute_shader &operator=(const compute_shader &) = delete;
+
+    ~compute_shader()
+    {
+        glDeleteProgram(ID);
+    }
+
+    void use()
+    {
+        glUseProgram(ID);
+    }
+
+    unsigned int get_id() const
+    {
+        return ID;
+    }
+
+    //Activate the program and launch the given number of work groups.
+    void dispatch(unsigned int groups_x, unsigned int groups_y = 1, unsigned int groups_z = 1)
+    {
+        glUseProgram(ID);
+        glDispatchCompute(groups_x, groups_y, groups_z);
+    }
+};
+
+//A keyed set of variants (permutations) of the same vertex/fragment source pair. Each axis is a quality/feature knob with a list of choices,
+//and every choice is a list of #defines. E.g. axis 0 : lighting terms {d, ad, ads}, axis 1 : shadow samples {16, 8, 4, 1}. A permutation key
+//is the mixed-radix number of the chosen indices, so 2 axes of 3 and 4 choices give 12 keys. Variants are compiled lazily on first use,
+//or up front via compile_all() (no hitch later on, but longer startup).
+//On top of that, an ordered list of keys (from the most expensive to the cheapest) can be given as quality tiers. Then update_tier() steps
+//down a tier when the frame time exceeds the budget and back up when there is enough headroom.
+class shader_permutations
+{
+private:
+    std::string vpath, fpath;
+    std::vector<std::vector<std::vector<std::string>>> axes; //axes[axis][choice] = list of #defines for that choice.
+    std::unordered_map<unsigned int, std::unique_ptr<shader>> variants; //Compiled programs, by key.
+
+    std::vector<unsigned int> tiers; //Keys, from the most expensive (tier 0) to the cheapest.
+    int tier = 0; //Currently selected tier.
+    int frames_over = 0, frames_under = 0; //Consecutive frames over/under the budget (hysteresis, so that we don't flip every frame).
+
+public:
+    shader_permutations(const char *vpath, const char *fpath) : vpath(vpath), fpath(fpath) {}
+
+    //Add a knob. Returns its axis index. Use an empty list of #defines for the "off" choice.
+    int add_axis(const std::vector<std::vector<std::string>> &choices)
+    {
+        axes.push_back(choices);
+        return (int)axes.size() - 1;
+    }
+
+    //Total number of permutations.
+    unsigned int size() const
+    {
+        unsigned int n = 1;
+        for (const auto &axis : axes)
+            n *= (unsigned int)axis.size();
+        return n;
+    }
+
+    //Build the key of a permutation from 1 choice index per axis (in the order the axes were added).
+    unsigned int key(const std::vector<int> &choices) const
+    {
+        if (choices.size() != axes.size())
+        {
+            fprintf(stderr, "Error : Permutation key needs %d choices, got %d. Exiting...\n", (int)axes.size(), (int)choices.size());
+            exit(EXIT_FAILURE);
+        }
+        unsigned int k = 0, radix = 1;
+        for (size_t i = 0; i < axes.size(); ++i)
+        {
+            k += radix*(unsigned int)choices[i];
+            radix *= (unsigned int)axes[i].size();
+        }
+        return k;
+    }
+
+    //All #defines of a permutation.
+    std::vector<std::string> defines(unsigned int k) const
+    {
+        std::vector<std::string> defs;
+        for (const auto &axis : axes)
+        {
+            const std::vector<std::string> &choice = axis[k % axis.size()];
+            defs.insert(defs.end(), choice.begin(), choice.end());
+            k /= (unsigned int)axis.size();
+        }
+        return defs;
+    }
+
+    //Get the program of a permutation, compiling it now if this is the first time it is requested.
+    shader &get(unsigned int k)
+    {
+        auto it = variants.find(k);
+        if (it == variants.end())
+            it = variants.emplace(k, std::make_unique<shader>(vpath.c_str(), fpath.c_str(), defines(k))).first;
+        return *it->second;
+    }
+
+    //Compile up front the permutations that can be picked : The tiers, or every permutation if no tiers were set.
+    void compile_all()
+    {
+        if (!tiers.empty())
+        {
+            for (unsigned int k : tiers)
+                get(k);
+            return;
+        }
+        for (unsigned int k = 0; k < size(); ++k)
+            get(k);
+    }
+
+    //Set the quality tiers (keys from the most expensive to the cheapest) and start from the best one.
+    void set_tiers(const std::vector<unsigned int> &keys)
+    {
+        tiers = keys;
+        tier = 0;
+        frames_over = frames_under = 0;
+    }
+
+    int get_tier() const
+    {
+        return tier;
+    }
+
+    void set_tier(int t)
+    {
+        if (!tiers.empty())
+            tier = std::max(0, std::min(t, (int)tiers.size() - 1));
+        frames_over = frames_under = 0;
+    }
+
+    int tier_count() const
+    {
+        return (int)tiers.size();
+    }
+
+    //The permutation key of tier 't'.
+    unsigned int tier_key(int t) const
+    {
+        return tiers[t];
+    }
+
+    //Pick a cheaper tier after 'patience' consecutive frames over budget, or a better one after 4*patience frames with at least 30% headroom.
+    //Returns true if the tier changed.
+    bool update_tier(float frame_ms, float budget_ms, int patience = 30)
+    {
+        if (tiers.empty())
+            return false;
+
+        frames_over = (frame_ms > budget_ms) ? frames_over + 1 : 0;
+        frames_under = (frame_ms < 0.7f*budget_ms) ? frames_under + 1 : 0;
+        if (frames_over >= patience && tier < (int)tiers.size() - 1)
+        {
+            set_tier(tier + 1);
+            return true;
+        }
+        if (frames_under >= 4*patience && tier > 0)
+        {
+            set_tier(tier - 1);
+            return true;
+        }
+        return false;
+    }
+
+    //The program of the currently selected tier (or permutation 0 if no tiers were set).
+    shader &active()
+    {
+        return get(tiers.empty() ? 0 : tiers[tier]);
+    }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,251 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<string>
+#include<vector>
+#include<set>
+#include<map>
+#include<thread>
+#include<mutex>
+#include<atomic>
+#include<chrono>
+#include<filesystem>
+
+#ifdef __linux__
+#include<sys/inotify.h>
+#include<poll.h>
+#include<unistd.h>
+#endif
+
+#include"shader.h"
+
+//Shader hot-reload. A background thread watches the source files (and #includes) of the registered shaders. When one is saved, every
+//shader that depends on it is queued for recompilation. On Linux the thread sleeps on inotify, elsewhere it polls the modification times.
+//All OpenGL work happens in update(), on the render thread : Changed shaders start a non-blocking reload and finished reloads are swapped in.
+//The old programs keep rendering until then, and compile errors are only reported (the frame is never disturbed).
+//Construct it after glewInit(), because it asks the driver for background compiler threads (GL_KHR/ARB_parallel_shader_compile) if available.
+class shader_watcher
+{
+private:
+    std::vector<shader*> shaders; //Registered shaders (not owned).
+    std::map<std::string, std::set<shader*>> dependents; //Canonical file path -> shaders built from it.
+
+    std::mutex mtx; //Guards the members below, which are shared with the watcher thread.
+    std::set<std::string> watched_files; //Canonical paths to watch.
+    std::set<std::string> changed_files; //Canonical paths that changed since the last update().
+
+    std::atomic<bool> running;
+    std::thread worker;
+
+    int reloads = 0, failures = 0; //Statistics.
+    std::string last_error;
+    std::string last_changed; //Most recent changed file that shaders depend on.
+
+    static std::string canonical(const std::string &path)
+    {
+        std::error_code ec;
+        std::filesystem::path p = std::filesystem::weakly_canonical(path, ec);
+        return ec ? path : p.string();
+    }
+
+    //Register the dependencies of a shader (again, since a reload may have added or removed #includes).
+    void map_dependencies(shader *shad)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const std::string &dep : shad->dependencies())
+        {
+            std::string file = canonical(dep);
+            dependents[file].insert(shad);
+            watched_files.insert(file);
+        }
+    }
+
+    void mark_changed(const std::string &file)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (watched_files.count(file))
+            changed_files.insert(file);
+    }
+
+#ifdef __linux__
+    //Wait on inotify events of the directories that hold the watched files. Editors often save via rename, hence IN_MOVED_TO/IN_CREATE as well.
+    void watch_loop()
+    {
+        int fd = inotify_init1(IN_NONBLOCK);
+        if (fd < 0)
+        {
+            fprintf(stderr, "Error : inotify_init1() failed, shader hot-reload is disabled.\n");
+            return;
+        }
+
+        std::map<int, std::string> wd_dirs; //Watch descriptor -> directory.
+        std::set<std::string> dirs;
+        alignas(struct inotify_event) char buffer[4096];
+        while (running)
+        {
+            //Watch any directory that appeared since the last iteration.
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                for (const std::string &file : watched_files)
+                {
+                    std::string dir = std::filesystem::path(file).parent_path().string();
+                    if (dirs.insert(dir).second)
+                    {
+                        int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+                        if (wd >= 0)
+                            wd_dirs[wd] = dir;
+                    }
+                }
+            }
+
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) //Time out regularly, so that the destructor can stop us.
+                continue;
+
+            ssize_t len;
+            while ((len = read(fd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + ((struct inotify_event*)ptr)->len)
+                {
+                    const struct inotify_event *event = (const struct inotify_event*)ptr;
+                    if (event->len > 0 && wd_dirs.count(event->wd))
+                        mark_changed(canonical(wd_dirs[event->wd] + "/" + event->name));
+                }
+            }
+        }
+        close(fd);
+    }
+#else
+    //Portable fallback : Compare the modification times twice per second.
+    void watch_loop()
+    {
+        std::map<std::string, std::filesystem::file_time_type> stamps;
+        while (running)
+        {
+            std::set<std::string> files;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                files = watched_files;
+            }
+            for (const std::string &file : files)
+            {
+                std::error_code ec;
+                std::filesystem::file_time_type stamp = std::filesystem::last_write_time(file, ec);
+                if (ec)
+                    continue;
+                auto it = stamps.find(file);
+                if (it != stamps.end() && it->second != stamp)
+                    mark_changed(file);
+                stamps[file] = stamp;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    }
+#endif
+
+public:
+    shader_watcher() : running(true)
+    {
+        //Let the driver compile and link on its own threads, so that glLinkProgram() returns right away.
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        else if (GLEW_ARB_parallel_shader_compile)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+        worker = std::thread(&shader_watcher::watch_loop, this);
+    }
+
+    ~shader_watcher()
+    {
+        running = false;
+        worker.join();
+    }
+
+    shader_watcher(const shader_watcher &) = delete;
+    shader_watcher &operator=(const shader_watcher &) = delete;
+
+    //Watch a shader. It must outlive the watcher (or at least its last update()).
+    void add(shader &shad)
+    {
+        shaders.push_back(&shad);
+        map_dependencies(&shad);
+    }
+
+    //Call once per frame, from the render thread. Returns the number of programs swapped in this frame.
+    int update()
+    {
+        std::set<std::string> changed;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            changed.swap(changed_files);
+        }
+
+        //Start recompiling every shader that depends on a changed file (once, even if several of its files changed).
+        std::set<shader*> queued;
+        for (const std::string &file : changed)
+        {
+            auto it = dependents.find(file);
+            if (it != dependents.end())
+            {
+                last_changed = file;
+                queued.insert(it->second.begin(), it->second.end());
+            }
+        }
+        for (shader *shad : queued)
+        {
+            shad->reload();
+            if (!shad->reload_pending())
+            {
+                ++failures;
+                last_error = shad->last_error();
+            }
+        }
+
+        //Swap in the reloads that have finished.
+        int swapped = 0;
+        for (shader *shad : shaders)
+        {
+            if (!shad->reload_pending())
+                continue;
+            if (shad->poll_reload())
+            {
+                ++swapped;
+                ++reloads;
+                last_error.clear();
+                map_dependencies(shad);
+            }
+            else if (!shad->reload_pending()) //Finished, but failed.
+            {
+                ++failures;
+                last_error = shad->last_error();
+            }
+        }
+        return swapped;
+    }
+
+    int reload_count() const
+    {
+        return reloads;
+    }
+
+    int failure_count() const
+    {
+        return failures;
+    }
+
+    //The most recent changed file that triggered recompiles (empty until then), e.g. for the gui.
+    const std::string &get_last_changed() const
+    {
+        return last_changed;
+    }
+
+    //Errors of the most recent failed reload (empty once a later reload succeeds).
+    const std::string &get_last_error() const
+    {
+        return last_error;
+    }
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include<glm/glm.hpp>
+#include<vector>
+
+//Decides whether a shadow map has to be rendered again. Every frame, feed it everything the map depends on (the light's matrices, the
+//transforms of the casters, ...) between begin() and dirty() : If nothing differs from the last rendered state, the previous depth
+//texture is still valid and the depth pass can be skipped. Comparisons are exact, so only what really stood still counts as unchanged.
+class shadow_cache
+{
+private:
+    std::vector<float> state, rendered_state; //This frame's state and the state the map was last rendered with.
+    bool forced = true; //Render at least once.
+    int rendered = 0, skipped = 0;
+
+public:
+    //Start collecting this frame's state.
+    void begin()
+    {
+        state.clear();
+    }
+
+    void add(const glm::mat4 &m)
+    {
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                state.push_back(m[i][j]);
+    }
+
+    void add(const glm::vec3 &v)
+    {
+        state.push_back(v.x);
+        state.push_back(v.y);
+        state.push_back(v.z);
+    }
+
+    void add(float value)
+    {
+        state.push_back(value);
+    }
+
+    //Render again next time, whatever the state (e.g. the map was resized or its contents were overwritten).
+    void invalidate()
+    {
+        forced = true;
+    }
+
+    //Returns true if the map must be rendered this frame (and remembers the state it will be rendered with).
+    bool dirty()
+    {
+        if (!forced && state == rendered_state)
+        {
+            ++skipped;
+            return false;
+        }
+        rendered_state.swap(state);
+        forced = false;
+        ++rendered;
+        return true;
+    }
+
+    int rendered_count() const
+    {
+        return rendered;
+    }
+
+    int skipped_count() const
+    {
+        return skipped;
+    }
+};
+
+#endif
@@ -0,0 +1,636 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstring>
+#include<cmath>
+#include<string>
+#include<vector>
+#include<thread>
+#include<filesystem>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"texture_upload.h"
+
+//Block compression of 8-bit textures on the cpu, so that they take 1/4 to 1/8 of the memory (and bandwidth) on the gpu, which samples
+//them compressed. Every 4x4 block of texels becomes 8 or 16 bytes :
+//bc1 : rgb, 4 bits per texel (2 rgb565 endpoints and 2-bit indices between them).
+//bc3 : rgba, 8 bits per texel (bc1 for rgb, plus an alpha block with 2 8-bit endpoints and 3-bit indices).
+//bc4 : 1 channel, 4 bits per texel (the alpha block of bc3).
+//bc5 : 2 channels (e.g. normal maps), 8 bits per texel (2 bc4 blocks).
+//bc7 : rgba, 8 bits per texel, in its mode 6 (1 pair of rgba7777+pbit endpoints and 4-bit indices). Much better quality than bc1/bc3 on
+//      smooth gradients, at twice the size of bc1.
+//The endpoints of each block are fit along the principal axis of its colors, and bc1 is refined once by least squares. The blocks of a
+//level are spread over all hardware threads. The result (with its mip chain) can be cached as a DDS file, which image tools also open.
+//Uploads go through the staging ring of texture_upload.h.
+enum bc_format { bc1 = 0, bc3 = 1, bc4 = 2, bc5 = 3, bc7 = 4 };
+
+//Settings of load_texture_2d() (mesh.h), e.g. from the command line of a demo.
+struct texture_compression_settings
+{
+    bool enabled = true; //Block compress the textures (false : Upload them uncompressed).
+    bool prefer_bc7 = false; //bc7 instead of bc1/bc3 for rgb(a) images.
+    std::string cache_dir = "../cache/textures/"; //Where the compressed mip chains are kept ("" : Compress them at every launch).
+};
+
+inline texture_compression_settings texture_compression;
+
+//A compressed mip chain in memory.
+struct bc_texture
+{
+    bc_format format = bc1;
+    int width = 0, height = 0, levels = 0;
+    std::vector<unsigned char> data; //All levels, level 0 first, each a row-major array of blocks.
+    unsigned long long source_size = 0, source_time = 0; //Size and modification time of the image it was made from (0 : Unknown).
+
+    static int block_bytes(bc_format f)
+    {
+        return (f == bc1 || f == bc4) ? 8 : 16;
+    }
+
+    int level_width(int level) const
+    {
+        return std::max(width >> level, 1);
+    }
+
+    int level_height(int level) const
+    {
+        return std::max(height >> level, 1);
+    }
+
+    size_t level_size(int level) const
+    {
+        return (size_t)((level_width(level) + 3)/4)*((level_height(level) + 3)/4)*block_bytes(format);
+    }
+
+    size_t level_offset(int level) const
+    {
+        size_t offset = 0;
+        for (int i = 0; i < level; i++)
+            offset += level_size(i);
+        return offset;
+    }
+};
+
+inline const char *bc_name(bc_format f)
+{
+    static const char *names[] = { "bc1", "bc3", "bc4", "bc5", "bc7" };
+    return names[f];
+}
+
+inline GLenum bc_internal_format(bc_format f)
+{
+    static const GLenum formats[] = { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RED_RGTC1,
+                                      GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_RGBA_BPTC_UNORM };
+    return formats[f];
+}
+
+//The format for an image with 'channels' channels.
+inline bc_format bc_choose_format(int channels, bool prefer_bc7)
+{
+    if (channels == 1)
+        return bc4;
+    if (channels == 2)
+        return bc5;
+    if (prefer_bc7)
+        return bc7;
+    return (channels == 3) ? bc1 : bc3;
+}
+
+//Whether the driver can sample the format (bc4, bc5 and bc7 are core since OpenGL 4.2, bc1 and bc3 need EXT_texture_compression_s3tc).
+inline bool bc_format_supported(bc_format f)
+{
+    int supported = GL_FALSE;
+    glGetInternalformativ(GL_TEXTURE_2D, bc_internal_format(f), GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+    return supported == GL_TRUE;
+}
+
+
+
+//Mean and direction of largest variance of 16 points with 'dims' (3 or 4) components each (power iteration on their covariance matrix).
+inline void bc_principal_axis(const float *points, int dims, float *mean, float *axis)
+{
+    for (int c = 0; c < dims; c++)
+    {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            mean[c] += points[i*dims + c];
+        mean[c] /= 16.0f;
+    }
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < dims; a++)
+            for (int b = 0; b < dims; b++)
+                cov[a][b] += (points[i*dims + a] - mean[a])*(points[i*dims + b] - mean[b]);
+
+    //Start from the channel that varies the most.
+    int widest = 0;
+    for (int c = 1; c < dims; c++)
+        if (cov[c][c] > cov[widest][widest])
+            widest = c;
+    for (int c = 0; c < dims; c++)
+        axis[c] = cov[widest][c];
+    for (int iter = 0; iter < 8; iter++)
+    {
+        float next[4] = {}, largest = 0.0f;
+        for (int a = 0; a < dims; a++)
+        {
+            for (int b = 0; b < dims; b++)
+                next[a] += cov[a][b]*axis[b];
+            largest = std::max(largest, std::fabs(next[a]));
+        }
+        if (largest < 1e-6f)
+            break;
+        for (int c = 0; c < dims; c++)
+            axis[c] = next[c]/largest;
+    }
+    float length = 0.0f;
+    for (int c = 0; c < dims; c++)
+        length += axis[c]*axis[c];
+    length = std::sqrt(length);
+    for (int c = 0; c < dims; c++)
+        axis[c] = (length > 1e-6f) ? axis[c]/length : 1.0f/std::sqrt((float)dims);
+}
+
+//Project the 16 points on the axis through 'mean' and return the 2 extremes, each moved inwards by 'inset' of the range (the extremes
+//are often outliers, and the palette covers the rest of the block better without them).
+inline void bc_axis_endpoints(const float *points, int dims, const float *mean, const float *axis, float inset, float *e0, float *e1)
+{
+    float tmin = 1e30f, tmax = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < dims; c++)
+            t += (points[i*dims + c] - mean[c])*axis[c];
+        tmin = std::min(tmin, t);
+        tmax = std::max(tmax, t);
+    }
+    float d = (tmax - tmin)*inset;
+    tmin += d;
+    tmax -= d;
+    for (int c = 0; c < dims; c++)
+    {
+        e0[c] = std::min(std::max(mean[c] + axis[c]*tmax, 0.0f), 255.0f);
+        e1[c] = std::min(std::max(mean[c] + axis[c]*tmin, 0.0f), 255.0f);
+    }
+}
+
+inline unsigned short bc_pack_565(const float *c)
+{
+    int r = (int)std::lround(c[0]*31.0f/255.0f), g = (int)std::lround(c[1]*63.0f/255.0f), b = (int)std::lround(c[2]*31.0f/255.0f);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+inline void bc_unpack_565(unsigned short v, int *c)
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+//Indices of the 16 colors into the bc1 palette of c0, c1 (4-color mode). Returns the squared error.
+inline int bc1_indices(const float *points, unsigned short c0, unsigned short c1, int *indices)
+{
+    int palette[4][3];
+    bc_unpack_565(c0, palette[0]);
+    bc_unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2*palette[0][c] + palette[1][c])/3;
+        palette[3][c] = (palette[0][c] + 2*palette[1][c])/3;
+    }
+    int error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, best_error = 1 << 30;
+        for (int j = 0; j < 4; j++)
+        {
+            int e = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                int d = (int)points[i*3 + c] - palette[j][c];
+                e += d*d;
+            }
+            if (e < best_error)
+            {
+                best_error = e;
+                best = j;
+            }
+        }
+        indices[i] = best;
+        error += best_error;
+    }
+    return error;
+}
+
+//Encode a block of 16 rgba texels (the alpha is ignored) as bc1 (8 bytes).
+inline void bc1_encode_block(const unsigned char *rgba, unsigned char *out)
+{
+    float points[16*3], mean[4], axis[4], e0[4], e1[4];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            points[i*3 + c] = rgba[i*4 + c];
+    bc_principal_axis(points, 3, mean, axis);
+    bc_axis_endpoints(points, 3, mean, axis, 1.0f/16.0f, e0, e1);
+    unsigned short c0 = bc_pack_565(e0), c1 = bc_pack_565(e1);
+    int indices[16];
+    int error = bc1_indices(points, c0, c1, indices);
+
+    //Refine the endpoints by least squares : Each texel is w*e0 + (1 - w)*e1 with the weight w of its index.
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float a = weights[indices[i]], b = 1.0f - a;
+        aa += a*a;
+        bb += b*b;
+        ab += a*b;
+        for (int c = 0; c < 3; c++)
+        {
+            ax[c] += a*points[i*3 + c];
+            bx[c] += b*points[i*3 + c];
+        }
+    }
+    float det = aa*bb - ab*ab;
+    if (std::fabs(det) > 1e-6f)
+    {
+        float r0[3], r1[3];
+        for (int c = 0; c < 3; c++)
+        {
+            r0[c] = std::min(std::max((ax[c]*bb - bx[c]*ab)/det, 0.0f), 255.0f);
+            r1[c] = std::min(std::max((bx[c]*aa - ax[c]*ab)/det, 0.0f), 255.0f);
+        }
+        unsigned short d0 = bc_pack_565(r0), d1 = bc_pack_565(r1);
+        int refined[16];
+        if (bc1_indices(points, d0, d1, refined) < error)
+        {
+            c0 = d0;
+            c1 = d1;
+            std::copy(refined, refined + 16, indices);
+        }
+    }
+
+    //c0 > c1 selects the 4-color mode. Swapping the endpoints swaps the indices 0 <-> 1 and 2 <-> 3.
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+        for (int i = 0; i < 16; i++)
+            indices[i] ^= 1;
+    }
+    else if (c0 == c1)
+        std::fill(indices, indices + 16, 0);
+    unsigned int bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (unsigned int)indices[i] << (2*i);
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (bits >> (8*i)) & 0xff;
+}
+
+//Encode 1 channel of a block of 16 rgba texels as bc4 (8 bytes), in its 8-value mode (a0 > a1).
+inline void bc4_encode_block(const unsigned char *rgba, int channel, unsigned char *out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        a0 = std::max(a0, (int)rgba[i*4 + channel]);
+        a1 = std::min(a1, (int)rgba[i*4 + channel]);
+    }
+    int palette[8] = { a0, a1 };
+    for (int j = 2; j < 8; j++)
+        palette[j] = ((8 - j)*a0 + (j - 1)*a1 + 3)/7;
+    unsigned long long bits = 0;
+    for (int i = 0; i < 16 && a0 != a1; i++)
+    {
+        int v = rgba[i*4 + channel], best = 0;
+        for (int j = 1; j < 8; j++)
+            if (std::abs(palette[j] - v) < std::abs(palette[best] - v))
+                best = j;
+        bits |= (unsigned long long)best << (3*i);
+    }
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (bits >> (8*i)) & 0xff;
+}
+
+//Encode a block of 16 rgba texels as bc7 mode 6 (16 bytes).
+inline void bc7_encode_block(const unsigned char *rgba, unsigned char *out)
+{
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    float points[16*4], mean[4], axis[4], e[2][4];
+    for (int i = 0; i < 64; i++)
+        points[i] = rgba[i];
+    bc_principal_axis(points, 4, mean, axis);
+    bc_axis_endpoints(points, 4, mean, axis, 1.0f/64.0f, e[0], e[1]);
+
+    //Quantize the endpoints to 7 bits per channel plus a shared lowest bit (pbit), choosing the pbit that fits each endpoint best.
+    int q[2][4], pbit[2], ends[2][4];
+    for (int k = 0; k < 2; k++)
+    {
+        float best_error = 1e30f;
+        for (int p = 0; p < 2; p++)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                candidate[c] = std::min(std::max((int)std::lround((e[k][c] - p)/2.0f), 0), 127);
+                float d = e[k][c] - (float)((candidate[c] << 1) | p);
+                error += d*d;
+            }
+            if (error < best_error)
+            {
+                best_error = error;
+                pbit[k] = p;
+                std::copy(candidate, candidate + 4, q[k]);
+            }
+        }
+        for (int c = 0; c < 4; c++)
+            ends[k][c] = (q[k][c] << 1) | pbit[k];
+    }
+
+    int palette[16][4], indices[16];
+    for (int j = 0; j < 16; j++)
+        for (int c = 0; c < 4; c++)
+            palette[j][c] = ((64 - weights[j])*ends[0][c] + weights[j]*ends[1][c] + 32) >> 6;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, best_error = 1 << 30;
+        for (int j = 0; j < 16; j++)
+        {
+            int error = 0;
+            for (int c = 0; c < 4; c++)
+            {
+                int d = rgba[i*4 + c] - palette[j][c];
+                error += d*d;
+            }
+            if (error < best_error)
+            {
+                best_error = error;
+                best = j;
+            }
+        }
+        indices[i] = best;
+    }
+
+    //The highest bit of the first index is implied 0 : If it is set, swap the endpoints (which mirrors the indices).
+    if (indices[0] & 8)
+    {
+        std::swap(q[0], q[1]);
+        std::swap(pbit[0], pbit[1]);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    //Layout (from the lowest bit) : Mode 6 (0000001), r0 r1 g0 g1 b0 b1 a0 a1 (7 bits each), p0 p1, then the indices (3 bits for the
+    //first, 4 for the rest).
+    std::memset(out, 0, 16);
+    int pos = 0;
+    auto put = [&](unsigned int value, int bits)
+    {
+        for (int b = 0; b < bits; b++, pos++)
+            if ((value >> b) & 1)
+                out[pos >> 3] |= (unsigned char)(1 << (pos & 7));
+    };
+    put(1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        put(q[0][c], 7);
+        put(q[1][c], 7);
+    }
+    put(pbit[0], 1);
+    put(pbit[1], 1);
+    put(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        put(indices[i], 4);
+}
+
+//Encode 1 level (rgba, 'width' x 'height') into 'out', block rows split between 'threads' threads (0 : All hardware threads). Blocks over
+//the edges repeat the last row/column.
+inline void bc_encode_level(const unsigned char *rgba, int width, int height, bc_format format, unsigned char *out, int threads = 0)
+{
+    int blocks_x = (width + 3)/4, blocks_y = (height + 3)/4, block_bytes = bc_texture::block_bytes(format);
+    auto encode_rows = [=](int first, int last)
+    {
+        unsigned char block[64];
+        for (int by = first; by < last; by++)
+        {
+            for (int bx = 0; bx < blocks_x; bx++)
+            {
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                        std::memcpy(block + (y*4 + x)*4, rgba + ((size_t)std::min(by*4 + y, height - 1)*width + std::min(bx*4 + x, width - 1))*4, 4);
+                unsigned char *dst = out + ((size_t)by*blocks_x + bx)*block_bytes;
+                if (format == bc1)
+                    bc1_encode_block(block, dst);
+                else if (format == bc3)
+                {
+                    bc4_encode_block(block, 3, dst);
+                    bc1_encode_block(block, dst + 8);
+                }
+                else if (format == bc4)
+                    bc4_encode_block(block, 0, dst);
+                else if (format == bc5)
+                {
+                    bc4_encode_block(block, 0, dst);
+                    bc4_encode_block(block, 1, dst + 8);
+                }
+                else
+                    bc7_encode_block(block, dst);
+            }
+        }
+    };
+    if (threads <= 0)
+        threads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+    threads = std::min(threads, blocks_y);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.push_back(std::thread(encode_rows, t*blocks_y/threads, (t + 1)*blocks_y/threads));
+    encode_rows(0, blocks_y/threads);
+    for (std::thread &w : workers)
+        w.join();
+}
+
+//The next mip level of an rgba image : Each texel is the average of 2x2 texels (odd sizes drop their last row/column, like the halved size).
+inline void rgba_downsample(const unsigned char *rgba, int width, int height, std::vector<unsigned char> &out)
+{
+    int nw = std::max(width/2, 1), nh = std::max(height/2, 1);
+    out.resize((size_t)nw*nh*4);
+    for (int y = 0; y < nh; y++)
+    {
+        int y0 = std::min(2*y, height - 1), y1 = std::min(2*y + 1, height - 1);
+        for (int x = 0; x < nw; x++)
+        {
+            int x0 = std::min(2*x, width - 1), x1 = std::min(2*x + 1, width - 1);
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = rgba[((size_t)y0*width + x0)*4 + c] + rgba[((size_t)y0*width + x1)*4 + c] +
+                          rgba[((size_t)y1*width + x0)*4 + c] + rgba[((size_t)y1*width + x1)*4 + c];
+                out[((size_t)y*nw + x)*4 + c] = (unsigned char)((sum + 2)/4);
+            }
+        }
+    }
+}
+
+//Compress an image ('channels' 8-bit channels, rows tightly packed) into 'format', with its full mip chain if 'mipmaps'. The levels are
+//box filtered on the cpu, like glGenerateMipmap() would. Images with 1 or 2 channels go to bc4/bc5 (as red/red-green).
+inline bc_texture bc_compress(const unsigned char *pixels, int width, int height, int channels, bc_format format, bool mipmaps)
+{
+    bc_texture t;
+    t.format = format;
+    t.width = width;
+    t.height = height;
+    t.levels = mipmaps ? gl_texture::mip_levels(width, height) : 1;
+    t.data.resize(t.level_offset(t.levels));
+
+    std::vector<unsigned char> level((size_t)width*height*4), next;
+    for (size_t i = 0; i < (size_t)width*height; i++)
+    {
+        const unsigned char *p = pixels + i*channels;
+        unsigned char *q = level.data() + i*4;
+        q[0] = p[0];
+        q[1] = (channels >= 2) ? p[1] : 0;
+        q[2] = (channels >= 3) ? p[2] : 0;
+        q[3] = (channels == 4) ? p[3] : 255;
+    }
+    for (int l = 0; l < t.levels; l++)
+    {
+        int w = t.level_width(l), h = t.level_height(l);
+        bc_encode_level(level.data(), w, h, format, t.data.data() + t.level_offset(l));
+        if (l + 1 == t.levels)
+            break;
+        rgba_downsample(level.data(), w, h, next);
+        level.swap(next);
+    }
+    return t;
+}
+
+
+
+//DDS files with the DX10 header extension (DXGI formats), which is how DirectX tools store block compressed textures.
+inline constexpr unsigned int bc_dxgi_formats[] = { 71, 77, 80, 83, 98 }; //DXGI_FORMAT_BC1/BC3/BC4/BC5/BC7_UNORM.
+
+//Save a compressed mip chain as a DDS file (creating its directory). False on failure.
+inline bool bc_write_dds(const char *path, const bc_texture &t)
+{
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (!dir.empty())
+        std::filesystem::create_directories(dir, ec);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+    unsigned int header[32 + 5] = {};
+    header[0] = 0x20534444; //"DDS ".
+    header[1] = 124; //Size of the header (without the magic).
+    header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; //Caps, height, width, pixel format, mipmap count and linear size are valid.
+    header[3] = t.height;
+    header[4] = t.width;
+    header[5] = (unsigned int)t.level_size(0);
+    header[7] = t.levels;
+    header[8] = (unsigned int)t.source_size; //The reserved fields keep the stamp of the source image (other tools ignore them).
+    header[9] = (unsigned int)(t.source_size >> 32);
+    header[10] = (unsigned int)t.source_time;
+    header[11] = (unsigned int)(t.source_time >> 32);
+    header[19] = 32; //Size of the pixel format.
+    header[20] = 0x4; //It is given by the fourcc...
+    header[21] = 0x30315844; //... "DX10", i.e. by the header extension.
+    header[27] = 0x1000 | ((t.levels > 1) ? 0x400000 | 0x8 : 0); //Texture (with mipmaps).
+    header[32] = bc_dxgi_formats[t.format];
+    header[33] = 3; //2D texture.
+    header[35] = 1; //Array size.
+    bool ok = (fwrite(header, sizeof(header), 1, file) == 1 && fwrite(t.data.data(), 1, t.data.size(), file) == t.data.size());
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        std::filesystem::remove(path, ec);
+    return ok;
+}
+
+//Read the header of a DDS file written by bc_write_dds() (a 2D texture in 1 of the bc formats above) into 't', without the data, and leave
+//'file' at the start of the data. False if it isn't one, or if the data isn't all there.
+inline bool bc_read_dds_header(FILE *file, bc_texture &t)
+{
+    unsigned int header[32 + 5];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != 0x20534444 || header[1] != 124 || header[21] != 0x30315844 ||
+        header[33] != 3 || header[35] != 1 || header[3] == 0 || header[4] == 0)
+        return false;
+    int format = -1;
+    for (int f = 0; f < 5; f++)
+        if (header[32] == bc_dxgi_formats[f])
+            format = f;
+    if (format < 0)
+        return false;
+    t.format = (bc_format)format;
+    t.width = header[4];
+    t.height = header[3];
+    t.levels = std::max((int)header[7], 1);
+    t.source_size = header[8] | ((unsigned long long)header[9] << 32);
+    t.source_time = header[10] | ((unsigned long long)header[11] << 32);
+    if (t.levels > gl_texture::mip_levels(t.width, t.height))
+        return false;
+    long start = ftell(file);
+    fseek(file, 0, SEEK_END);
+    bool complete = (ftell(file) - start == (long)t.level_offset(t.levels));
+    fseek(file, start, SEEK_SET);
+    return complete;
+}
+
+//Load a DDS file written by bc_write_dds() into memory. False if it isn't one, or is truncated.
+inline bool bc_read_dds(const char *path, bc_texture &t)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    bool ok = bc_read_dds_header(file, t);
+    if (ok)
+    {
+        t.data.resize(t.level_offset(t.levels));
+        ok = (fread(t.data.data(), 1, t.data.size(), file) == t.data.size());
+    }
+    fclose(file);
+    return ok;
+}
+
+//A 2D texture with the compressed levels, uploaded as they are (the gpu samples them compressed) through the staging ring (texture_upload.h).
+inline gl_texture bc_upload(const bc_texture &t)
+{
+    gl_texture tex(GL_TEXTURE_2D);
+    GLenum internal_format = bc_internal_format(t.format);
+    tex.storage_2d(t.levels, internal_format, t.width, t.height);
+    for (int l = 0; l < t.levels; l++)
+        texture_uploader::instance().upload_compressed(tex, l, t.level_width(l), t.level_height(l), internal_format, bc_texture::block_bytes(t.format),
+                                                       t.data.data() + t.level_offset(l));
+    return tex;
+}
+
+//The same straight from a DDS file written by bc_write_dds() : The levels are read from the file into the staging ring, never into a copy
+//in memory. 't' gets the format and the size (no data). False if the file isn't valid (then 'tex' is left untouched).
+inline bool bc_load_dds(const char *path, bc_texture &t, gl_texture &tex)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    bool ok = bc_read_dds_header(file, t);
+    if (ok)
+    {
+        gl_texture loaded(GL_TEXTURE_2D);
+        GLenum internal_format = bc_internal_format(t.format);
+        loaded.storage_2d(t.levels, internal_format, t.width, t.height);
+        for (int l = 0; l < t.levels && ok; l++)
+            ok = texture_uploader::instance().upload_compressed(loaded, l, t.level_width(l), t.level_height(l), internal_format,
+                                                                bc_texture::block_bytes(t.format), file);
+        if (ok)
+            tex = std::move(loaded);
+    }
+    fclose(file);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstdlib>
+#include<cstdint>
+#include<vector>
+#include<chrono>
+#include<algorithm>
+
+#include"gl_objects.h"
+
+//Texture uploads through a staging ring of pixel unpack buffers. The ring is 1 buffer, persistently mapped, split in 'slots' slots. An
+//upload is cut in bands of rows that fit in a slot : Each band is written into the mapped memory, its glTexture(Compressed)SubImage
+//call reads it from the buffer (the driver copies it asynchronously, instead of copying the whole image out of client memory inside the
+//call) and a fence marks when the slot may be written again. So a texture of any size passes through 'slots'*'slot_size' bytes of
+//staging memory, and the source can be freed (or never exist : upload_compressed() reads file data straight into the slots).
+//Call release() once the assets of the startup are loaded (at the latest before the context is destroyed) to free the ring. With
+//set_enabled(false) the uploads go directly from client memory (as before), for comparison.
+class texture_uploader
+{
+public:
+    static constexpr int slots = 4;
+    static constexpr long long slot_size = 4 << 20; //[bytes]
+
+private:
+    gl_buffer buf;
+    unsigned char *mapped = nullptr;
+    GLsync fences[slots] = {};
+    int slot = 0;
+    bool enabled = true;
+    std::vector<unsigned char> scratch; //Only without staging, for data read from files.
+
+    //Statistics.
+    long long staged_bytes = 0;
+    double wait_ms = 0.0; //Time spent waiting for slots the gpu still reads.
+
+    texture_uploader() {}
+
+    void create()
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buf = gl_buffer(slots*slot_size, nullptr, flags);
+        glObjectLabel(GL_BUFFER, buf.get_id(), -1, "texture staging");
+        mapped = (unsigned char*)glMapNamedBufferRange(buf.get_id(), 0, slots*slot_size, flags);
+        if (mapped == nullptr)
+        {
+            fprintf(stderr, "Error : Failed to map the texture staging buffer (%lld bytes). Exiting...\n", slots*slot_size);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    //Wait until the gpu has read the current slot (if it was used before).
+    void wait_for_slot()
+    {
+        GLsync &fence = fences[slot];
+        if (fence == nullptr)
+            return;
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {} //1 ms at a time.
+            wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    //Move 'units' units (rows of texels, or of 4x4 blocks) of 'unit_bytes' bytes each through the slots. fill(dst, first, count) writes
+    //the units [first, first + count) to dst and returns false on failure. issue(src, first, count) makes the upload call for them, with
+    //'src' an offset into the bound unpack buffer (or a client pointer, without staging). A unit that doesn't fit in a slot (a row of
+    //over 'slot_size' bytes) can't be staged : Such uploads go through a temporary buffer in client memory, as without staging.
+    template<typename fill_function, typename issue_function>
+    bool stream(int units, long long unit_bytes, fill_function fill, issue_function issue)
+    {
+        int alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        bool ok = true;
+        if (!enabled || unit_bytes > slot_size)
+        {
+            scratch.resize((size_t)units*unit_bytes);
+            ok = fill(scratch.data(), 0, units);
+            if (ok)
+                issue((const void*)scratch.data(), 0, units);
+            scratch = std::vector<unsigned char>();
+        }
+        else
+        {
+            if (mapped == nullptr)
+                create();
+            int per_slot = (int)(slot_size/unit_bytes);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf.get_id());
+            for (int first = 0; first < units && ok; first += per_slot)
+            {
+                int count = std::min(per_slot, units - first);
+                wait_for_slot();
+                ok = fill(mapped + slot*slot_size, first, count);
+                if (ok)
+                {
+                    issue((const void*)(intptr_t)(slot*slot_size), first, count);
+                    staged_bytes += count*unit_bytes;
+                }
+                fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                slot = (slot + 1)%slots;
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        return ok;
+    }
+
+public:
+    texture_uploader(const texture_uploader &) = delete;
+    texture_uploader &operator=(const texture_uploader &) = delete;
+
+    static texture_uploader &instance()
+    {
+        static texture_uploader uploader;
+        return uploader;
+    }
+
+    void set_enabled(bool enable)
+    {
+        enabled = enable;
+    }
+
+    bool is_enabled() const
+    {
+        return enabled;
+    }
+
+    //Upload tightly packed 8-bit pixels ('channels' of them per texel, in 'format') into a level of a 2D texture (layer = 0) or of 1 face
+    //(layer) of a cubemap. Mipmaps can be generated right after : The gpu runs it after the copies.
+    void upload(gl_texture &tex, int layer, int width, int height, GLenum format, int channels, const unsigned char *pixels, int level = 0)
+    {
+        long long row_bytes = (long long)width*channels;
+        if (!enabled)
+        {
+            //Straight from client memory, no copy to a scratch buffer.
+            int alignment;
+            glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            if (tex.get_target() == GL_TEXTURE_2D)
+                glTextureSubImage2D(tex.get_id(), level, 0,0, width,height, format, GL_UNSIGNED_BYTE, pixels);
+            else
+                glTextureSubImage3D(tex.get_id(), level, 0,0,layer, width,height,1, format, GL_UNSIGNED_BYTE, pixels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+            return;
+        }
+        stream(height, row_bytes,
+               [&](unsigned char *dst, int first, int count)
+               {
+                   std::copy(pixels + first*row_bytes, pixels + (first + count)*row_bytes, dst);
+                   return true;
+               },
+               [&](const void *src, int first, int count)
+               {
+                   if (tex.get_target() == GL_TEXTURE_2D)
+                       glTextureSubImage2D(tex.get_id(), level, 0,first, width,count, format, GL_UNSIGNED_BYTE, src);
+                   else
+                       glTextureSubImage3D(tex.get_id(), level, 0,first,layer, width,count,1, format, GL_UNSIGNED_BYTE, src);
+               });
+    }
+
+    //Upload a level of a block compressed 2D texture (4x4 blocks of 'block_bytes' bytes, row major), read from 'file' at its current
+    //position. The data goes from the file straight into the staging memory. False if the file ends too early.
+    bool upload_compressed(gl_texture &tex, int level, int width, int height, GLenum internal_format, int block_bytes, FILE *file)
+    {
+        long long row_bytes = (long long)((width + 3)/4)*block_bytes;
+        return stream((height + 3)/4, row_bytes,
+                      [&](unsigned char *dst, int, int count)
+                      {
+                          return fread(dst, 1, count*row_bytes, file) == (size_t)(count*row_bytes);
+                      },
+                      [&](const void *src, int first, int count)
+                      {
+                          int y = 4*first, rows = std::min(4*count, height - y);
+                          glCompressedTextureSubImage2D(tex.get_id(), level, 0,y, width,rows, internal_format, (GLsizei)(count*row_bytes), src);
+                      });
+    }
+
+    //The same from memory.
+    void upload_compressed(gl_texture &tex, int level, int width, int height, GLenum internal_format, int block_bytes, const unsigned char *blocks)
+    {
+        long long row_bytes = (long long)((width + 3)/4)*block_bytes;
+        if (!enabled)
+        {
+            glCompressedTextureSubImage2D(tex.get_id(), level, 0,0, width,height, internal_format, (GLsizei)(((height + 3)/4)*row_bytes), blocks);
+            return;
+        }
+        stream((height + 3)/4, row_bytes,
+               [&](unsigned char *dst, int first, int count)
+               {
+                   std::copy(blocks + first*row_bytes, blocks + (first + count)*row_bytes, dst);
+                   return true;
+               },
+               [&](const void *src, int first, int count)
+               {
+                   int y = 4*first, rows = std::min(4*count, height - y);
+                   glCompressedTextureSubImage2D(tex.get_id(), level, 0,y, width,rows, internal_format, (GLsizei)(count*row_bytes), src);
+               });
+    }
+
+    //Free the staging buffer (e.g. once the assets of the startup are loaded). It is created again by the next upload.
+    void release()
+    {
+        for (int i = 0; i < slots; i++)
+        {
+            if (fences[i] != nullptr)
+            {
+                glDeleteSync(fences[i]);
+                fences[i] = nullptr;
+            }
+        }
+        buf = gl_buffer();
+        mapped = nullptr;
+        slot = 0;
+    }
+
+    long long bytes_staged() const
+    {
+        return staged_bytes;
+    }
+
+    double total_wait_ms() const
+    {
+        return wait_ms;
+    }
+};
+
+#endif
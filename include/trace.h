@@ -0,0 +1,245 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include<cstdio>
+#include<string>
+#include<vector>
+#include<deque>
+#include<memory>
+#include<mutex>
+#include<atomic>
+#include<chrono>
+#include<algorithm>
+
+//Timeline recorder for offline analysis (hitches in long sessions, what the worker threads were doing meanwhile). Code marks a scope with
+//    TRACE_SCOPE("physics step");
+//and, while tracing is enabled, every run of the scope becomes an event with its start time and duration on the timeline of its thread.
+//write() saves the events in the Chrome trace format (JSON), which chrome://tracing and https://ui.perfetto.dev open.
+//Recording costs 2 clock reads and a few stores : Each thread writes into a buffer of its own (no locks, no atomics read-modify-write, only
+//relaxed atomic stores, which are plain stores on x86/ARM), which is a ring of 'capacity' events. When it is full the oldest events are overwritten, so memory stays bounded and a write() shows the
+//last moments before it. write() may run while the other threads keep recording : It copies each ring and throws away whatever may have
+//been overwritten during the copy.
+//Names are not copied : Pass string literals, or strings from intern() (e.g. file names of assets).
+//The profiler (profiler.h) forwards its scopes here, plus its gpu timestamps on a track of their own ("gpu"), shifted to the cpu clock.
+class trace_recorder
+{
+public:
+    static const int capacity = 1 << 15; //Events per thread (32 bytes each).
+    static const int gpu_track = 1; //Track of the gpu events (instead of the thread that recorded them).
+
+private:
+    struct event
+    {
+        const char *name;
+        long long begin, duration; //[ns] since the recorder's epoch.
+        int track; //0 : The recording thread.
+    };
+
+    //An event in a ring. Its fields are relaxed atomics, because write() may read them while the owner overwrites them.
+    struct event_slot
+    {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<long long> begin{0}, duration{0};
+        std::atomic<int> track{0};
+    };
+
+    struct thread_buffer
+    {
+        std::unique_ptr<event_slot[]> events = std::make_unique<event_slot[]>(capacity);
+        std::atomic<unsigned long long> head{0}; //Events written so far. Only the owning thread writes it.
+        int tid = 0;
+        std::string name;
+    };
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::mutex mtx; //Guards the members below (taken once per thread, at its first event, and by write()).
+    std::vector<std::unique_ptr<thread_buffer>> buffers; //Outlive their threads, so that their events can still be written.
+    std::deque<std::string> interned;
+    int last_written = 0; //Events in the last file written.
+
+    trace_recorder() {}
+
+    thread_buffer &local_buffer()
+    {
+        thread_local thread_buffer *buffer = nullptr;
+        if (buffer == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            buffers.push_back(std::make_unique<thread_buffer>());
+            buffer = buffers.back().get();
+            buffer->tid = (int)buffers.size() + gpu_track;
+            buffer->name = "thread " + std::to_string(buffer->tid);
+        }
+        return *buffer;
+    }
+
+    static void write_escaped(FILE *file, const char *text)
+    {
+        for (const char *c = text; *c != '\0'; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                fputc('\\', file);
+            if ((unsigned char)*c >= 0x20)
+                fputc(*c, file);
+        }
+    }
+
+public:
+    trace_recorder(const trace_recorder &) = delete;
+    trace_recorder &operator=(const trace_recorder &) = delete;
+
+    static trace_recorder &instance()
+    {
+        static trace_recorder recorder;
+        return recorder;
+    }
+
+    void set_enabled(bool enable)
+    {
+        enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    bool is_enabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    //Now, on the recorder's clock [ns].
+    long long now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    //Record a finished scope of the calling thread (or of the gpu, with track = gpu_track).
+    void record(const char *name, long long begin, long long end, int track = 0)
+    {
+        thread_buffer &b = local_buffer();
+        unsigned long long i = b.head.load(std::memory_order_relaxed);
+        event_slot &e = b.events[i & (capacity - 1)];
+        std::atomic_thread_fence(std::memory_order_release); //A write() that sees any of the stores below also sees head == i (its lap check).
+        e.name.store(name, std::memory_order_relaxed);
+        e.begin.store(begin, std::memory_order_relaxed);
+        e.duration.store(end - begin, std::memory_order_relaxed);
+        e.track.store(track, std::memory_order_relaxed);
+        b.head.store(i + 1, std::memory_order_release);
+    }
+
+    //Name of the calling thread's timeline.
+    void set_thread_name(const char *name)
+    {
+        thread_buffer &b = local_buffer();
+        std::lock_guard<std::mutex> lock(mtx);
+        b.name = name;
+    }
+
+    //A copy of 'text' that lives as long as the recorder, for names that aren't literals.
+    const char *intern(const std::string &text)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const std::string &s : interned)
+            if (s == text)
+                return s.c_str();
+        interned.push_back(text);
+        return interned.back().c_str();
+    }
+
+    //Events in the file of the last write().
+    int written_count() const
+    {
+        return last_written;
+    }
+
+    //Write the events in the buffers (the last 'capacity' of every thread) to a Chrome trace JSON file. Returns false on failure.
+    bool write(const char *path)
+    {
+        FILE *file = fopen(path, "w");
+        if (file == NULL)
+        {
+            fprintf(stderr, "Error : Failed to open the trace file '%s'.\n", path);
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"gpu\"}}", gpu_track);
+        int written = 0;
+        std::vector<event> copy;
+        for (const std::unique_ptr<thread_buffer> &b : buffers)
+        {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", b->tid);
+            write_escaped(file, b->name.c_str());
+            fprintf(file, "\"}}");
+
+            unsigned long long end = b->head.load(std::memory_order_acquire);
+            unsigned long long begin = (end > (unsigned long long)capacity) ? end - capacity : 0;
+            //The owner keeps recording meanwhile (a seqlock-like read) : An event may be copied while it is being overwritten (the fields
+            //are atomics, so that is defined, but the copy can mix 2 events). Such events are told by the head read after the copy and
+            //thrown away, so a torn copy is never written out.
+            copy.clear();
+            for (unsigned long long i = begin; i < end; i++)
+            {
+                const event_slot &e = b->events[i & (capacity - 1)];
+                copy.push_back({e.name.load(std::memory_order_relaxed), e.begin.load(std::memory_order_relaxed),
+                                e.duration.load(std::memory_order_relaxed), e.track.load(std::memory_order_relaxed)});
+            }
+            std::atomic_thread_fence(std::memory_order_acquire); //The copy is done before the head is read again.
+            //While head == after, the owner may be writing event 'after', in the slot of event 'after - capacity' : That one and the
+            //older ones can have been overwritten.
+            unsigned long long after = b->head.load(std::memory_order_relaxed);
+            unsigned long long valid = (after >= (unsigned long long)capacity) ? after - capacity + 1 : 0;
+            for (unsigned long long i = std::max(begin, valid); i < end; i++)
+            {
+                const event &e = copy[i - begin];
+                fprintf(file, ",\n{\"name\":\"");
+                write_escaped(file, e.name);
+                fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", (e.track == gpu_track) ? gpu_track : b->tid,
+                        e.begin/1000.0, e.duration/1000.0);
+                ++written;
+            }
+        }
+        fprintf(file, "\n]}\n");
+        if (fclose(file) != 0)
+        {
+            fprintf(stderr, "Error : Failed to write the trace file '%s'.\n", path);
+            return false;
+        }
+        last_written = written;
+        return true;
+    }
+};
+
+//Records its own lifetime on the calling thread's timeline (see TRACE_SCOPE).
+class trace_scope
+{
+private:
+    const char *name;
+    long long begin = -1; //-1 : Tracing was off at the start.
+
+public:
+    trace_scope(const char *name) : name(name)
+    {
+        trace_recorder &r = trace_recorder::instance();
+        if (r.is_enabled())
+            begin = r.now();
+    }
+
+    ~trace_scope()
+    {
+        if (begin >= 0)
+        {
+            trace_recorder &r = trace_recorder::instance();
+            r.record(name, begin, r.now());
+        }
+    }
+
+    trace_scope(const trace_scope &) = delete;
+    trace_scope &operator=(const trace_scope &) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+//For names built at run time (a std::string, e.g. "load " + path). Only interned while tracing is enabled, so use it for rare events.
+#define TRACE_SCOPE_DYNAMIC(text) trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(trace_recorder::instance().is_enabled() ? trace_recorder::instance().intern(text) : "")
+
+#endif
@@ -0,0 +1,654 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include<GL/glew.h>
+#include<cstdio>
+#include<cstdlib>
+#include<cmath>
+#include<string>
+#include<vector>
+#include<deque>
+#include<fstream>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<filesystem>
+#include<algorithm>
+
+#include"gl_objects.h"
+#include"shader.h"
+#include"texture_compression.h"
+#include"trace.h"
+
+//Virtual texturing, for textures far bigger than what should live in video memory (8k-16k albedo/height maps). The texture is baked once
+//into a page file : Its mip pyramid cut in pages of page_size^2 texels, each with a border of 'border' texels copied from its neighbours
+//(so that bilinear filtering never reads across pages), raw rgba8 or bc1. At run time only 2 textures exist, whatever the size of the source :
+//- The page cache, a fixed grid of physical pages.
+//- The indirection texture, 1 texel per page of every level (it has the levels of the pyramid) : Where in the cache that page is, and
+//  its level. A page that isn't in the cache points to its closest resident ancestor, so lookups always find something, only blurrier.
+//  The coarsest page (the whole texture) is always resident.
+//Which pages are needed comes from the feedback pass (virtual_texture_feedback) : The scene is drawn at low resolution, writing the page
+//each pixel needs, and the result is read back a few frames later through pbos. Missing pages (and their ancestors) are queued, coarsest
+//first, and loader threads read them from the page file. update() uploads the loaded pages into free cache slots, or over the least
+//recently used pages that weren't needed in the last feedback. The shaders sample through ../shaders/common/virtual_texture.glsl.
+class virtual_texture
+{
+public:
+    static constexpr int page_size = 128; //Texels per page side, without the border.
+    static constexpr int border = 4; //Texels copied from the neighbouring pages, on each side.
+    static constexpr int padded = page_size + 2*border; //Page side in the file and in the cache. A multiple of 4, for bc1 blocks.
+    static constexpr unsigned int file_magic = 0x46505456; //"VTPF" (little endian).
+    static constexpr unsigned int file_version = 1;
+
+private:
+    struct file_header
+    {
+        unsigned int magic, version;
+        unsigned int size; //Texels per side of level 0.
+        unsigned int page_size, border, levels;
+        unsigned int compressed; //1 : bc1 pages, 0 : rgba8 pages.
+        unsigned int reserved;
+    };
+
+    struct cache_slot
+    {
+        int page = -1; //-1 : Free.
+        long long last_used = -1; //Last feedback that needed the page.
+    };
+
+    struct loaded_page
+    {
+        int page;
+        std::vector<unsigned char> data; //Empty if the read failed.
+    };
+
+    std::string path;
+    int size = 0, levels = 0, pages0 = 0; //Texels and pages per side of level 0, levels of the pyramid.
+    bool compressed = false;
+    long long page_bytes = 0;
+    std::vector<int> level_first; //Index of the first page of each level (levels are stored finest first, pages row by row).
+    int cache_side = 0; //Physical pages per side of the cache.
+
+    gl_texture cache, indirection;
+    std::vector<cache_slot> slots;
+    std::vector<int> page_slot; //Cache slot of every page (-1 : Not resident).
+    std::vector<long long> page_requested; //Last feedback that needed every page.
+    std::vector<unsigned char> page_pending; //Queued or being loaded.
+    std::vector<unsigned char> table; //Indirection texels of every level (rgba8ui), rebuilt when the residency changes.
+    bool table_dirty = true;
+    long long feedback = 0; //Feedbacks received.
+    int max_queue = 256; //Pages waiting to be loaded, at most.
+
+    //Shared with the loader threads.
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::deque<int> queue; //Pages to load, the most urgent first.
+    std::vector<loaded_page> loaded; //Read, waiting for update() to upload them.
+    std::vector<std::thread> loaders;
+    bool stopping = false;
+
+    //Statistics.
+    int uploads_last = 0, evictions = 0, drops = 0, requested_last = 0, missing_last = 0;
+    long long uploads_total = 0;
+
+    int pages_at(int level) const
+    {
+        return std::max(pages0 >> level, 1);
+    }
+
+    int page_index(int level, int x, int y) const
+    {
+        return level_first[level] + y*pages_at(level) + x;
+    }
+
+    long long page_offset(int page) const
+    {
+        return (long long)sizeof(file_header) + page*page_bytes;
+    }
+
+    void load_loop()
+    {
+        std::ifstream file(path, std::ios::binary);
+        while (true)
+        {
+            int page;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                page = queue.front();
+                queue.pop_front();
+            }
+            loaded_page result;
+            result.page = page;
+            {
+                TRACE_SCOPE("load page");
+                result.data.resize(page_bytes);
+                file.seekg(page_offset(page));
+                if (!file.read((char*)result.data.data(), page_bytes))
+                {
+                    file.clear();
+                    result.data.clear();
+                }
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            loaded.push_back(std::move(result));
+        }
+    }
+
+    void upload(int slot, const unsigned char *data)
+    {
+        int x = (slot%cache_side)*padded, y = (slot/cache_side)*padded;
+        if (compressed)
+            glCompressedTextureSubImage2D(cache.get_id(), 0, x,y, padded,padded, bc_internal_format(bc1), (GLsizei)page_bytes, data);
+        else
+            glTextureSubImage2D(cache.get_id(), 0, x,y, padded,padded, GL_RGBA, GL_UNSIGNED_BYTE, data); //Rows of 4*padded bytes, aligned.
+    }
+
+    //A free slot, else the least recently used one that the last feedback didn't need (-1 if all of them are needed). Slot 0 holds the
+    //coarsest page for good.
+    int find_slot() const
+    {
+        int best = -1;
+        for (int s = 1; s < (int)slots.size(); s++)
+        {
+            if (slots[s].page < 0)
+                return s;
+            if (slots[s].last_used < feedback && (best < 0 || slots[s].last_used < slots[best].last_used))
+                best = s;
+        }
+        return best;
+    }
+
+    void rebuild_table()
+    {
+        //Coarsest level first, so that pages that aren't resident can copy the entry of their parent.
+        for (int l = levels - 1; l >= 0; l--)
+        {
+            int n = pages_at(l);
+            for (int y = 0; y < n; y++)
+            {
+                for (int x = 0; x < n; x++)
+                {
+                    int p = page_index(l, x, y), s = page_slot[p];
+                    unsigned char *entry = &table[4*(size_t)p];
+                    if (s >= 0)
+                    {
+                        entry[0] = (unsigned char)(s%cache_side);
+                        entry[1] = (unsigned char)(s/cache_side);
+                        entry[2] = (unsigned char)l;
+                        entry[3] = 255;
+                    }
+                    else
+                        std::copy_n(&table[4*(size_t)page_index(l + 1, x/2, y/2)], 4, entry);
+                }
+            }
+            glTextureSubImage2D(indirection.get_id(), l, 0,0, n,n, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &table[4*(size_t)level_first[l]]);
+        }
+        table_dirty = false;
+    }
+
+public:
+    //Open a page file written by bake(). 'cache_pages' : Physical pages per side of the cache (the cache takes cache_pages^2 pages of
+    //video memory, i.e. 72 KB each in rgba8 and 9 KB in bc1). 'loader_threads' : Threads that read pages from the file.
+    virtual_texture(const char *page_path, int cache_pages = 16, int loader_threads = 2) : path(page_path)
+    {
+        file_header header;
+        std::ifstream file(path, std::ios::binary);
+        if (!file.read((char*)&header, sizeof(header)) || header.magic != file_magic || header.version != file_version ||
+            header.page_size != (unsigned int)page_size || header.border != (unsigned int)border || header.levels == 0)
+        {
+            fprintf(stderr, "Error : '%s' is not a page file of this version (bake it again). Exiting...\n", page_path);
+            exit(EXIT_FAILURE);
+        }
+        size = header.size;
+        levels = header.levels;
+        pages0 = size/page_size;
+        compressed = (header.compressed != 0);
+        page_bytes = compressed ? (long long)(padded/4)*(padded/4)*8 : (long long)padded*padded*4;
+        if (compressed && !bc_format_supported(bc1))
+        {
+            fprintf(stderr, "Error : '%s' has bc1 pages, which the driver can't sample (bake it uncompressed). Exiting...\n", page_path);
+            exit(EXIT_FAILURE);
+        }
+        int total = 0;
+        for (int l = 0; l < levels; l++)
+        {
+            level_first.push_back(total);
+            total += pages_at(l)*pages_at(l);
+        }
+
+        int max_size;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        cache_side = std::max(2, std::min({cache_pages, max_size/padded, 256})); //256 : The indirection stores slots in 8 bits.
+        cache = gl_texture(GL_TEXTURE_2D);
+        cache.storage_2d(1, compressed ? bc_internal_format(bc1) : GL_RGBA8, cache_side*padded, cache_side*padded);
+        cache.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        cache.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        cache.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        cache.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        indirection = gl_texture(GL_TEXTURE_2D);
+        indirection.storage_2d(levels, GL_RGBA8UI, pages0, pages0);
+        indirection.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST); //Integer textures are incomplete with linear filters.
+        indirection.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        slots.resize(cache_side*cache_side);
+        page_slot.assign(total, -1);
+        page_requested.assign(total, -1);
+        page_pending.assign(total, 0);
+        table.resize(4*(size_t)total);
+
+        //The coarsest page, loaded now : It is the fallback of every lookup.
+        std::vector<unsigned char> root(page_bytes);
+        int root_page = total - 1;
+        file.seekg(page_offset(root_page));
+        if (!file.read((char*)root.data(), page_bytes))
+        {
+            fprintf(stderr, "Error : '%s' is truncated. Exiting...\n", page_path);
+            exit(EXIT_FAILURE);
+        }
+        upload(0, root.data());
+        slots[0].page = root_page;
+        page_slot[root_page] = 0;
+        rebuild_table();
+
+        for (int i = 0; i < std::max(loader_threads, 1); i++)
+            loaders.push_back(std::thread(&virtual_texture::load_loop, this));
+    }
+
+    ~virtual_texture()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : loaders)
+            t.join();
+    }
+
+    virtual_texture(const virtual_texture &) = delete;
+    virtual_texture &operator=(const virtual_texture &) = delete;
+
+    //Hand over the pages of 1 feedback, as the feedback shader packs them (x | y << 8 | level << 16 | 255 << 24), without duplicates.
+    //The resident ones (and their ancestors) are marked as used, the missing ones are queued, coarsest first. Queued pages that this
+    //feedback no longer needs are dropped from the queue.
+    void request(const std::vector<unsigned int> &pages)
+    {
+        ++feedback;
+        std::vector<int> missing;
+        for (unsigned int v : pages)
+        {
+            int x = v & 255, y = (v >> 8) & 255, level = (v >> 16) & 255;
+            if (level >= levels || x >= pages_at(level) || y >= pages_at(level))
+                continue;
+            //The page and its ancestors : The fallbacks while it loads, and the coarser level of the trilinear filter.
+            for (int l = level; l < levels; l++, x /= 2, y /= 2)
+            {
+                int p = page_index(l, x, y);
+                if (page_requested[p] == feedback)
+                    break; //So were its ancestors.
+                page_requested[p] = feedback;
+                if (page_slot[p] >= 0)
+                    slots[page_slot[p]].last_used = feedback;
+                else if (!page_pending[p])
+                {
+                    page_pending[p] = 1;
+                    missing.push_back(p);
+                }
+            }
+        }
+        requested_last = (int)pages.size();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        for (int p : queue)
+        {
+            if (page_requested[p] == feedback)
+                missing.push_back(p);
+            else
+                page_pending[p] = 0;
+        }
+        //Coarser levels come later in the file : Descending page indices put them first.
+        std::sort(missing.begin(), missing.end(), [](int a, int b) { return a > b; });
+        for (size_t i = max_queue; i < missing.size(); i++)
+            page_pending[missing[i]] = 0;
+        if ((int)missing.size() > max_queue)
+            missing.resize(max_queue);
+        queue.assign(missing.begin(), missing.end());
+        missing_last = (int)queue.size();
+        wake.notify_all();
+    }
+
+    //Upload the pages the loaders have read, at most 'max_uploads' (to bound the cost of a frame), and update the indirection texture.
+    //Call it once per frame, before drawing with the texture.
+    void update(int max_uploads = 32)
+    {
+        std::vector<loaded_page> done;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            int n = std::min((int)loaded.size(), max_uploads);
+            done.assign(std::make_move_iterator(loaded.begin()), std::make_move_iterator(loaded.begin() + n));
+            loaded.erase(loaded.begin(), loaded.begin() + n);
+        }
+        uploads_last = 0;
+        for (loaded_page &lp : done)
+        {
+            page_pending[lp.page] = 0;
+            if (lp.data.empty())
+            {
+                fprintf(stderr, "Error : Failed to read page %d of '%s'.\n", lp.page, path.c_str());
+                continue;
+            }
+            int s = find_slot();
+            if (s < 0)
+            {
+                ++drops; //The cache is too small for the view. It will be requested again.
+                continue;
+            }
+            if (slots[s].page >= 0)
+            {
+                page_slot[slots[s].page] = -1;
+                ++evictions;
+            }
+            slots[s].page = lp.page;
+            slots[s].last_used = page_requested[lp.page];
+            page_slot[lp.page] = s;
+            upload(s, lp.data.data());
+            table_dirty = true;
+            ++uploads_last;
+        }
+        uploads_total += uploads_last;
+        if (table_dirty)
+            rebuild_table();
+    }
+
+    //Bind the cache and the indirection texture to 2 texture units and set the uniforms of virtual_texture.glsl (the shader must be in use).
+    void bind(shader &s, int cache_unit = 0, int indirection_unit = 1)
+    {
+        cache.bind(cache_unit);
+        indirection.bind(indirection_unit);
+        s.set_int_uniform("vt_cache", cache_unit);
+        s.set_int_uniform("vt_indirection", indirection_unit);
+        s.set_float_uniform("vt_size", (float)size);
+        s.set_int_uniform("vt_levels", levels);
+        s.set_float_uniform("vt_cache_size", (float)(cache_side*padded));
+    }
+
+    //Write a page file from an rgba image of 'image_size' x 'image_size' texels (a power of 2, at least page_size) : Its mip pyramid (box
+    //filtered), every level cut in pages with their borders (wrapping around the edges, for repeating textures), bc1 compressed if
+    //'compress'. The pages of a row are encoded on all hardware threads. Only the baking needs the whole image in memory. False on failure.
+    static bool bake(const char *page_path, const unsigned char *rgba, int image_size, bool compress)
+    {
+        TRACE_SCOPE("bake virtual texture");
+        if (image_size < page_size || (image_size & (image_size - 1)) != 0)
+        {
+            fprintf(stderr, "Error : Virtual textures must be square, with a power of 2 size of at least %d texels.\n", page_size);
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::path dir = std::filesystem::path(page_path).parent_path();
+        if (!dir.empty())
+            std::filesystem::create_directories(dir, ec);
+        std::string temp_path = std::string(page_path) + ".tmp";
+        FILE *file = fopen(temp_path.c_str(), "wb");
+        if (file == NULL)
+        {
+            fprintf(stderr, "Error : Failed to write the page file '%s'.\n", page_path);
+            return false;
+        }
+
+        file_header header = { file_magic, file_version, (unsigned int)image_size, (unsigned int)page_size, (unsigned int)border, 0,
+                               compress ? 1u : 0u, 0 };
+        for (int n = image_size; n >= page_size; n /= 2)
+            ++header.levels;
+        bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+
+        long long bytes = compress ? (long long)(padded/4)*(padded/4)*8 : (long long)padded*padded*4;
+        int threads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<unsigned char> level, next, row;
+        const unsigned char *src = rgba;
+        for (int l = 0, n = image_size; l < (int)header.levels && ok; l++, n /= 2)
+        {
+            int pages = n/page_size;
+            row.resize((size_t)pages*bytes);
+            for (int py = 0; py < pages && ok; py++)
+            {
+                auto encode_pages = [&](int first, int last)
+                {
+                    std::vector<unsigned char> page((size_t)padded*padded*4);
+                    for (int px = first; px < last; px++)
+                    {
+                        for (int y = 0; y < padded; y++)
+                        {
+                            int sy = ((py*page_size - border + y)%n + n)%n;
+                            for (int x = 0; x < padded; x++)
+                            {
+                                int sx = ((px*page_size - border + x)%n + n)%n;
+                                std::copy_n(src + ((size_t)sy*n + sx)*4, 4, &page[((size_t)y*padded + x)*4]);
+                            }
+                        }
+                        unsigned char *dst = row.data() + (size_t)px*bytes;
+                        if (compress)
+                            bc_encode_level(page.data(), padded, padded, bc1, dst, 1);
+                        else
+                            std::copy(page.begin(), page.end(), dst);
+                    }
+                };
+                int t_count = std::min(threads, pages);
+                std::vector<std::thread> workers;
+                for (int t = 1; t < t_count; t++)
+                    workers.push_back(std::thread(encode_pages, t*pages/t_count, (t + 1)*pages/t_count));
+                encode_pages(0, pages/t_count);
+                for (std::thread &w : workers)
+                    w.join();
+                ok = (fwrite(row.data(), 1, row.size(), file) == row.size());
+            }
+            if (n > page_size)
+            {
+                rgba_downsample(src, n, n, next);
+                level.swap(next);
+                src = level.data();
+            }
+        }
+        ok = (fclose(file) == 0) && ok;
+        if (ok)
+            std::filesystem::rename(temp_path, page_path, ec);
+        if (!ok || ec)
+        {
+            fprintf(stderr, "Error : Failed to write the page file '%s'.\n", page_path);
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+    int get_size() const
+    {
+        return size;
+    }
+
+    int level_count() const
+    {
+        return levels;
+    }
+
+    int page_count() const
+    {
+        return (int)page_slot.size();
+    }
+
+    int slot_count() const
+    {
+        return (int)slots.size();
+    }
+
+    int resident_count() const
+    {
+        int n = 0;
+        for (const cache_slot &s : slots)
+            n += (s.page >= 0);
+        return n;
+    }
+
+    //Pages queued by the last feedback, and pages it asked for.
+    int missing_count() const
+    {
+        return missing_last;
+    }
+
+    int requested_count() const
+    {
+        return requested_last;
+    }
+
+    int uploads_last_frame() const
+    {
+        return uploads_last;
+    }
+
+    long long upload_count() const
+    {
+        return uploads_total;
+    }
+
+    int eviction_count() const
+    {
+        return evictions;
+    }
+
+    //Loaded pages that found no slot (every page in the cache was in view) : The cache is too small for the view.
+    int drop_count() const
+    {
+        return drops;
+    }
+
+    bool is_compressed() const
+    {
+        return compressed;
+    }
+
+    //Video memory of the cache plus the indirection texture (fixed), and of the whole texture with its mipmaps in the same format.
+    long long memory_bytes() const
+    {
+        return (long long)slots.size()*page_bytes + 4LL*(long long)page_slot.size();
+    }
+
+    long long full_texture_bytes() const
+    {
+        return (long long)size*size*(compressed ? 1 : 8)/2*4/3; //bc1 : 0.5 byte per texel, rgba8 : 4.
+    }
+
+    unsigned int get_cache_id() const
+    {
+        return cache.get_id();
+    }
+};
+
+
+
+//The feedback pass of virtual textures : Draw the scene between begin() and end() with virtual_texture.frag built with VT_FEEDBACK (after
+//bind()). It renders at 1/scale of the window per side into an rgba8ui target. end() copies the target into a pbo, and hands the pbo
+//copied 'latency' - 1 frames earlier (finished by then, so nothing waits) to the virtual texture.
+class virtual_texture_feedback
+{
+public:
+    static constexpr int scale = 8;
+    static constexpr int latency = 3;
+
+private:
+    gl_framebuffer fbo;
+    gl_texture target;
+    gl_renderbuffer depth;
+    int width = 0, height = 0;
+    gl_buffer pbos[latency];
+    int pbo_texels[latency] = {}; //Texels copied into each pbo (0 : Nothing to read).
+    GLsync fences[latency] = {};
+    int slot = 0;
+    std::vector<unsigned int> pages;
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        target = gl_texture(GL_TEXTURE_2D);
+        target.storage_2d(1, GL_RGBA8UI, width, height);
+        depth = gl_renderbuffer(GL_DEPTH_COMPONENT24, width, height);
+        fbo = gl_framebuffer("virtual texture feedback");
+        fbo.attach(GL_COLOR_ATTACHMENT0, target);
+        fbo.attach(GL_DEPTH_ATTACHMENT, depth);
+        fbo.check();
+        for (int i = 0; i < latency; i++)
+        {
+            pbos[i] = gl_buffer((long long)width*height*4, nullptr, GL_MAP_READ_BIT);
+            pbo_texels[i] = 0;
+            if (fences[i] != nullptr)
+            {
+                glDeleteSync(fences[i]);
+                fences[i] = nullptr;
+            }
+        }
+    }
+
+public:
+    ~virtual_texture_feedback()
+    {
+        for (int i = 0; i < latency; i++)
+            if (fences[i] != nullptr)
+                glDeleteSync(fences[i]);
+    }
+
+    //Bind the feedback target (sized for a 'win_width' x 'win_height' view) and clear it. Leaves its viewport set.
+    void begin(int win_width, int win_height)
+    {
+        int w = std::max(win_width/scale, 1), h = std::max(win_height/scale, 1);
+        if (w != width || h != height)
+            resize(w, h);
+        fbo.bind();
+        glViewport(0,0, width,height);
+        const unsigned int none[4] = {0, 0, 0, 0};
+        glClearBufferuiv(GL_COLOR, 0, none);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    //Set the uniforms of the feedback shader (in use) : The level of detail is that of the full resolution view.
+    void bind(shader &s)
+    {
+        s.set_float_uniform("vt_lod_bias", -std::log2((float)scale));
+    }
+
+    //Queue the copy of this frame's feedback and hand an older one to 'vt'. Binds the default framebuffer (the viewport is the caller's).
+    void end(virtual_texture &vt)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot].get_id());
+        glReadPixels(0,0, width,height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (fences[slot] != nullptr)
+            glDeleteSync(fences[slot]);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pbo_texels[slot] = width*height;
+        slot = (slot + 1)%latency;
+
+        //The oldest copy (the slot that the next frame will overwrite).
+        GLsync &fence = fences[slot];
+        if (fence == nullptr || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return;
+        glDeleteSync(fence);
+        fence = nullptr;
+        TRACE_SCOPE("virtual texture feedback");
+        const unsigned int *texels = (const unsigned int*)glMapNamedBufferRange(pbos[slot].get_id(), 0, (long long)pbo_texels[slot]*4, GL_MAP_READ_BIT);
+        if (texels == nullptr)
+            return;
+        pages.clear();
+        for (int i = 0; i < pbo_texels[slot]; i++)
+            if ((texels[i] >> 24) != 0 && (pages.empty() || pages.back() != texels[i]))
+                pages.push_back(texels[i]);
+        glUnmapNamedBuffer(pbos[slot].get_id());
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+        vt.request(pages);
+    }
+};
+
+#endif
@@ -0,0 +1,37 @@
+//Lights of clustered forward shading (../../include/clustered_lights.h) : The light buffer and the per-cluster light lists written by
+//../compute/cluster_lights.comp, and how a fragment finds its cluster. The uniforms are set by clustered_lights::bind().
+
+#define CLUSTER_GRID uvec3(16, 9, 24) //clustered_lights::grid_x, grid_y, grid_z.
+
+struct light
+{
+    vec4 pos_radius; //World position (xyz), radius of influence (w).
+    vec4 col; //Color times intensity (rgb).
+};
+
+layout(std430, binding = 4) readonly buffer lights
+{
+    light lit[];
+};
+
+layout(std430, binding = 7) readonly buffer cluster_lists
+{
+    uvec2 lists[]; //Offset of every cluster's list in indices[], and its length.
+};
+
+layout(std430, binding = 8) readonly buffer cluster_indices
+{
+    uint indices[];
+};
+
+uniform vec2 cluster_tile_size; //Pixels per tile.
+uniform float cluster_depth_scale, cluster_depth_bias; //Slice of a view depth d : log(d)*scale + bias.
+uniform int light_count;
+
+//Cluster of the fragment at window position 'frag_coord' and view depth 'depth' (distance along the view direction).
+uint get_cluster(vec2 frag_coord, float depth)
+{
+    uvec2 tile = min(uvec2(frag_coord/cluster_tile_size), CLUSTER_GRID.xy - 1u);
+    uint slice = uint(clamp(log(depth)*cluster_depth_scale + cluster_depth_bias, 0.0f, float(CLUSTER_GRID.z - 1u)));
+    return (slice*CLUSTER_GRID.y + tile.y)*CLUSTER_GRID.x + tile.x;
+}
@@ -0,0 +1,59 @@
+//Directional light shading, shared by dir_light*.frag. Configured via #defines (set in the including file or injected by the shader class) :
+//LIGHT_AMBIENT  : add a constant ambient term.
+//LIGHT_SPECULAR : add a specular (shininess) term. Needs the 'cam_pos' uniform.
+//INSTANCE_COLOR : take the mesh color per instance (from the *_instanced.vert shaders) instead of the 'mesh_col' uniform.
+//OVERDRAW       : count the fragments shaded per pixel in the 'overdraw_counts' image (see ../../include/overdraw_counter.h). The depth
+//                 test runs before the shader (early fragment tests), so the fragments that fail it are neither shaded nor counted.
+
+in vec3 frag_pos;
+in vec3 normal;
+
+out vec4 frag_col; //Final color of the fragment after lighting calculations.
+
+
+
+#ifdef INSTANCE_COLOR
+flat in vec3 mesh_col; //Per-instance mesh color, from the *_instanced.vert shaders.
+#else
+uniform vec3 mesh_col; //Mesh color.
+#endif
+uniform vec3 light_dir; //Direction of the light in world coordinates.
+uniform vec3 light_col; //Light color.
+#ifdef LIGHT_SPECULAR
+uniform vec3 cam_pos; //Position of the camera in world coordinates.
+#endif
+#ifdef OVERDRAW
+layout(early_fragment_tests) in;
+layout(binding = 0, r32ui) uniform uimage2D overdraw_counts;
+#endif
+
+void main()
+{
+    float intensity = 0.0f;
+
+#ifdef LIGHT_AMBIENT
+    //Ambient color component.
+    float ambient = 0.15f;
+    intensity += ambient;
+#endif
+
+    //Diffuse color component.
+    vec3 norm = normalize(normal);
+    vec3 light_dir_norm = normalize(light_dir);
+    float diffuse = max(dot(norm, light_dir_norm), 0.0f);
+    intensity += diffuse;
+
+#ifdef LIGHT_SPECULAR
+    //Specular color component (shininess).
+    vec3 view_dir_norm = normalize(cam_pos - frag_pos); //Camera's direction with respect to the fragment.
+    vec3 reflect_dir_norm = reflect(-light_dir_norm, norm); //"Ray's" reflection direction with respect to the fragment.
+    float specular = 0.5f*pow(max(dot(view_dir_norm, reflect_dir_norm), 0.0f), 128);
+    intensity += specular;
+#endif
+
+    frag_col = vec4(intensity*mesh_col*light_col, 1.0f);
+
+#ifdef OVERDRAW
+    imageAtomicAdd(overdraw_counts, ivec2(gl_FragCoord.xy), 1u);
+#endif
+}
@@ -0,0 +1,206 @@
+//Directional light shading with shadow mapping, shared by dir_light*_shadow.frag. Configured via #defines (set in the including file or
+//injected by the shader class) :
+//LIGHT_AMBIENT   : add a constant ambient term (not affected by the shadow).
+//POISSON_SAMPLES : number of shadow map taps for the soft edges (1, 2, 4, 8 or 16). Fewer taps are cheaper but give noisier edges.
+//                  Every tap is a hardware comparison with bilinear filtering (2x2 texels), so 1 tap is already a small pcf. With more than
+//                  4 taps, the 4 outer ones are taken first and if they all agree (fully lit or fully shadowed) the rest are skipped.
+//INSTANCE_COLOR  : take the mesh color per instance (from the *_instanced.vert shaders) instead of the 'mesh_col' uniform.
+//SHADOW_CASCADES : number of cascades of a cascaded shadow map (../../include/cascaded_shadow_map.h). The shadow map is then an array
+//                  texture and each fragment is looked up in the cascade that covers its view depth.
+//SHADOW_DYNAMIC  : (with SHADOW_CASCADES) the casters are split in 2 maps, a cached one with the static casters and one with the moving
+//                  casters only. The nearest of the 2 depths is used.
+//SHADOW_EVSM     : (with SHADOW_CASCADES) the shadow maps hold prefiltered EVSM moments (../../include/evsm_filter.h) instead of depths :
+//                  1 trilinear fetch per fragment, no taps (POISSON_SAMPLES is ignored).
+
+#if defined(SHADOW_EVSM) && !defined(SHADOW_CASCADES)
+#error SHADOW_EVSM needs SHADOW_CASCADES
+#endif
+
+#ifndef POISSON_SAMPLES
+#define POISSON_SAMPLES 16
+#endif
+
+in vec3 frag_pos_world;
+#ifdef SHADOW_CASCADES
+in float view_depth;
+#else
+in vec4 frag_pos_light;
+#endif
+in vec3 normal;
+
+out vec4 frag_col; //Final color of the fragment after lighting calculations.
+
+
+
+#ifdef INSTANCE_COLOR
+flat in vec3 mesh_col; //Per-instance mesh color, from the *_instanced.vert shaders.
+#else
+uniform vec3 mesh_col; //Mesh color.
+#endif
+uniform vec3 light_dir; //Direction of the light in world coordinates.
+uniform vec3 light_col; //Light color.
+#ifdef SHADOW_EVSM
+uniform sampler2DArray sample_shadow; //1 layer of moments per cascade.
+#elif defined(SHADOW_CASCADES)
+uniform sampler2DArrayShadow sample_shadow; //1 depth layer per cascade, sampled with comparison.
+#endif
+#ifdef SHADOW_CASCADES
+uniform mat4 cascade_pv[SHADOW_CASCADES]; //Light's projection*view matrix of every cascade.
+uniform float cascade_splits[SHADOW_CASCADES]; //View depth where every cascade ends.
+uniform bool show_cascades; //Tint the fragments by cascade (debugging).
+#if defined(SHADOW_DYNAMIC) && defined(SHADOW_EVSM)
+uniform sampler2DArray sample_shadow_dynamic; //Same layout, moving casters only.
+#elif defined(SHADOW_DYNAMIC)
+uniform sampler2DArrayShadow sample_shadow_dynamic; //Same layout, moving casters only.
+#endif
+#else
+uniform sampler2DShadow sample_shadow; //Depth image texture, obtained by the other shader. Needs GL_TEXTURE_COMPARE_MODE set.
+#endif
+uniform sampler2D shadow_noise; //(cos, sin) of a random angle per texel, to rotate the Poisson disk per pixel.
+
+#ifdef SHADOW_EVSM
+#include "evsm.glsl"
+#endif
+
+//Predefined Poisson disk sampling offsets, used for smoothing the shadow edges (pcf). Ordered so that every prefix (1, 2, 4, 8 taps)
+//is spread over the whole disk : The first 4 are the outer ring.
+const vec2 poisson_disk[16] = vec2[]( vec2(-0.94201624, -0.39906216), 
+                                      vec2( 0.94558609, -0.76890725), 
+                                      vec2(-0.91588581,  0.45771432), 
+                                      vec2( 0.97484398,  0.75648379), 
+                                      vec2(-0.09418410, -0.92938870), 
+                                      vec2(-0.24188840,  0.99706507), 
+                                      vec2( 0.79197514,  0.19090188), 
+                                      vec2(-0.38277543,  0.27676845), 
+                                      vec2(-0.81544232, -0.87912464), 
+                                      vec2( 0.44323325, -0.97511554), 
+                                      vec2(-0.81409955,  0.91437590), 
+                                      vec2( 0.19984126,  0.78641367), 
+                                      vec2( 0.34495938,  0.29387760), 
+                                      vec2( 0.53742981, -0.47373420), 
+                                      vec2(-0.26496911, -0.41893023), 
+                                      vec2( 0.14383161, -0.14100790)  );
+
+#ifdef SHADOW_CASCADES
+//The first cascade that reaches the fragment's view depth (SHADOW_CASCADES if it is beyond the last one).
+int get_cascade()
+{
+    for (int c = 0; c < SHADOW_CASCADES; ++c)
+        if (view_depth < cascade_splits[c])
+            return c;
+    return SHADOW_CASCADES;
+}
+#endif
+
+#ifndef SHADOW_EVSM
+//1 shadow map tap : The lit fraction (0 to 1) of the 2x2 texels around 'uv', for a fragment at depth 'depth_ref' (light's view).
+float lit_tap(vec2 uv, float depth_ref, float layer)
+{
+#ifdef SHADOW_CASCADES
+    float lit = texture(sample_shadow, vec4(uv, layer, depth_ref));
+#ifdef SHADOW_DYNAMIC
+    lit = min(lit, texture(sample_shadow_dynamic, vec4(uv, layer, depth_ref)));
+#endif
+    return lit;
+#else
+    return texture(sample_shadow, vec3(uv, depth_ref));
+#endif
+}
+#endif
+
+//Algorithm to decide whether the fragment is in shadow or not.
+float get_shadow(vec3 norm, vec3 light_dir_norm)
+{
+#ifdef SHADOW_EVSM
+    //Screen space derivatives for the mipmapped fetch, taken here because they are undefined after the (per fragment) branches below.
+    vec3 world_dx = dFdx(frag_pos_world), world_dy = dFdy(frag_pos_world);
+#endif
+#ifdef SHADOW_CASCADES
+    int cascade = get_cascade();
+    if (cascade == SHADOW_CASCADES)
+        return 0.0f; //Beyond the shadow distance. Fully lit.
+    vec4 frag_pos_light = cascade_pv[cascade]*vec4(frag_pos_world, 1.0f);
+#endif
+    vec3 projected_coords = frag_pos_light.xyz/frag_pos_light.w; //Perspective division to transform each fragment's position (with respect to light) in NDC, i.e. in [-1,1].
+    projected_coords = 0.5f*projected_coords + vec3(0.5f); //Transformation from [-1,1] to [0,1]. This is required to correctly access the shadow map texture, because internally, the UVs range in [0,1].
+    
+    //For any fragment that is outside the orthographic frustum, don't calculate shadow.
+    if (projected_coords.x < 0.0f || projected_coords.x > 1.0f ||
+        projected_coords.y < 0.0f || projected_coords.y > 1.0f ||
+        projected_coords.z > 1.0f)
+    {
+        return 0.0f; //No shadow. Fully lit.
+    }
+
+    //Shadow test + percentage closer filtering (pcf) with Poisson sampling : The shadow map holds the nearest depth (as seen from the light)
+    //at every texel. The hardware compares it to the fragment's depth (projected_coords.z) at each tap, for 4 texels at once, and blends the
+    //results. This algorithm calculates the shadow but has 2 problems : 1) Shadow acne (see below), 2) Sharp shadow edges (see below).
+    //We try to fix the acne via depth bias and the sharp edges via a smoothing algorithm.
+
+    //Shadow acne fix : This is basically an effort to balance shadow acne (self shadowing) and Peter-shitty-Panning. Find your balance.
+    float min_bias = 0.0007f, amplifier = 0.007f;
+    float bias = max(amplifier*(1.0f - max(dot(norm, light_dir_norm), 0.0f)), min_bias);
+    float depth_ref = projected_coords.z - bias;
+#ifdef SHADOW_CASCADES
+    float layer = float(cascade);
+#else
+    float layer = 0.0f;
+#endif
+
+#ifdef SHADOW_EVSM
+    //Prefiltered : The soft edges are already in the moments, 1 trilinear (and anisotropic) fetch does the filtering. No bias is needed,
+    //the minimum variance plays its role.
+    vec2 grad_x = 0.5f*(mat3(cascade_pv[cascade])*world_dx).xy; //The cascades are orthographic, so the uv gradient is linear.
+    vec2 grad_y = 0.5f*(mat3(cascade_pv[cascade])*world_dy).xy;
+    vec3 coords = vec3(projected_coords.xy, layer);
+    float lit = evsm_lit(textureGrad(sample_shadow, coords, grad_x, grad_y), projected_coords.z);
+#ifdef SHADOW_DYNAMIC
+    lit = min(lit, evsm_lit(textureGrad(sample_shadow_dynamic, coords, grad_x, grad_y), projected_coords.z));
+#endif
+    return 1.0f - lit;
+#elif POISSON_SAMPLES == 1
+    return 1.0f - lit_tap(projected_coords.xy, depth_ref, layer); //Bilinear pcf only.
+#else
+    //Rotate the disk by a random angle per pixel (from a tiled noise texture) : Few taps then give noise instead of repeated patterns.
+    vec2 rotation = texelFetch(shadow_noise, ivec2(gl_FragCoord.xy) % textureSize(shadow_noise, 0), 0).xy;
+    mat2 rotate = mat2(rotation.x, rotation.y, -rotation.y, rotation.x);
+    vec2 disk_radius = 1.5f/vec2(textureSize(sample_shadow, 0).xy); //[texels]
+    float lit = 0.0f; //Accumulator.
+    for (int i = 0; i < POISSON_SAMPLES; ++i)
+    {
+#if POISSON_SAMPLES > 4
+        if (i == 4 && (lit == 0.0f || lit == 4.0f))
+            return 1.0f - lit/4.0f; //The outer ring agrees : The fragment is not on a shadow edge.
+#endif
+        lit += lit_tap(projected_coords.xy + disk_radius*(rotate*poisson_disk[i]), depth_ref, layer);
+    }
+    return 1.0f - lit/float(POISSON_SAMPLES); //Return the averaged shadow factor (over the number of samples in the for loop).
+#endif
+}
+
+void main()
+{
+    //Ambient color component.
+#ifdef LIGHT_AMBIENT
+    float ambient = 0.15f;
+#else
+    float ambient = 0.0f;
+#endif
+
+    //Diffuse color component.
+    vec3 norm = normalize(normal);
+    vec3 light_dir_norm = normalize(light_dir);
+    float diffuse = max(dot(norm, light_dir_norm), 0.0f);
+
+    //Shadow color component.
+    float shadow = get_shadow(norm, light_dir_norm);
+
+    frag_col = vec4((ambient + (1.0f - shadow)*diffuse)*mesh_col*light_col, 1.0f);
+#ifdef SHADOW_CASCADES
+    if (show_cascades)
+    {
+        const vec3 tint[5] = vec3[](vec3(1.0f,0.4f,0.4f), vec3(0.4f,1.0f,0.4f), vec3(0.4f,0.4f,1.0f), vec3(1.0f,1.0f,0.4f), vec3(1.0f));
+        frag_col.rgb *= tint[min(get_cascade(), 4)];
+    }
+#endif
+}
@@ -0,0 +1,44 @@
+//Exponential variance shadow maps (EVSM), shared by ../compute/evsm.comp (which writes the moments) and dir_light_shadow.glsl (which
+//reads them). Instead of depths, the map stores the first 2 moments (mean and mean of squares) of 2 exponentially warped depths. Moments,
+//unlike depths, can be blurred and mipmapped like any color, so the soft edges are filtered once per shadow map texel (not per pixel) and
+//1 trilinear fetch per fragment is enough. Chebyshev's inequality then bounds the lit fraction of a fragment from the filtered moments.
+
+//Warping exponents. The largest that keep exp(2*c) within the range of 16 bit floats.
+const vec2 evsm_exponents = vec2(5.54f, 5.54f);
+const float evsm_light_bleeding = 0.2f; //Cut off the tail of the bound, where light leaks through overlapping casters.
+
+//Depth in [0,1] to (positive, negative) warped depth.
+vec2 evsm_warp(float depth)
+{
+    depth = 2.0f*depth - 1.0f;
+    return vec2(exp(evsm_exponents.x*depth), -exp(-evsm_exponents.y*depth));
+}
+
+//The moments of 1 depth sample.
+vec4 evsm_moments(float depth)
+{
+    vec2 warped = evsm_warp(depth);
+    return vec4(warped.x, warped.x*warped.x, warped.y, warped.y*warped.y);
+}
+
+//Upper bound of the probability that a receiver at 'mean' is lit, given the moments of the casters' depth around it.
+float chebyshev_upper_bound(vec2 moments, float mean, float min_variance)
+{
+    if (mean <= moments.x)
+        return 1.0f;
+    float variance = max(moments.y - moments.x*moments.x, min_variance);
+    float d = mean - moments.x;
+    float p_max = variance/(variance + d*d);
+    return clamp((p_max - evsm_light_bleeding)/(1.0f - evsm_light_bleeding), 0.0f, 1.0f);
+}
+
+//Lit fraction (0 to 1) of a fragment at 'depth' (light's view, in [0,1]), from the filtered moments around it.
+float evsm_lit(vec4 moments, float depth)
+{
+    vec2 warped = evsm_warp(depth);
+    vec2 min_variance = 0.0001f*evsm_exponents*warped; //A small depth bias, scaled by the slope of the warp.
+    min_variance *= min_variance;
+    float lit_positive = chebyshev_upper_bound(moments.xy, warped.x, min_variance.x);
+    float lit_negative = chebyshev_upper_bound(moments.zw, warped.y, min_variance.y);
+    return min(lit_positive, lit_negative);
+}
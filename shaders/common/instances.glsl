@@ -0,0 +1,14 @@
+//Per-instance data of the *_instanced.vert shaders, filled by the application with an array of mesh_instance (see ../../include/mesh.h)
+//and bound to shader storage binding 0. Instance i of a glDrawElementsInstanced() call reads inst[gl_InstanceID].
+
+struct instance
+{
+    mat4 model; //Model matrix.
+    mat4 normal; //transpose(inverse(model)), precomputed on the cpu (only the 3x3 part is used).
+    vec4 col; //Color (rgb).
+};
+
+layout(std430, binding = 0) readonly buffer instances
+{
+    instance inst[];
+};
@@ -0,0 +1,70 @@
+//Point light shading, shared by point_light*.frag. Configured via #defines (set in the including file or injected by the shader class) :
+//LIGHT_AMBIENT     : add a constant ambient term.
+//LIGHT_SPECULAR    : add a specular (shininess) term. Needs the 'cam_pos' uniform.
+//LIGHT_ATTENUATION : fade the light with the distance from the source.
+//INSTANCE_COLOR    : take the mesh color per instance (from the *_instanced.vert shaders) instead of the 'mesh_col' uniform.
+//POINT_SHADOW      : shadows from a point shadow map (point_shadow.glsl). The diffuse and specular terms are dimmed by the shadow.
+
+in vec3 frag_pos;
+in vec3 normal;
+
+out vec4 frag_col; //Final color of the fragment after lighting calculations.
+
+
+
+#ifdef INSTANCE_COLOR
+flat in vec3 mesh_col; //Per-instance mesh color, from the *_instanced.vert shaders.
+#else
+uniform vec3 mesh_col; //Mesh color.
+#endif
+uniform vec3 light_pos; //Position of the light in world coordinates.
+uniform vec3 light_col; //Light color.
+#ifdef LIGHT_SPECULAR
+uniform vec3 cam_pos; //Position of the camera in world coordinates.
+#endif
+
+#ifdef POINT_SHADOW
+#include "point_shadow.glsl"
+#endif
+
+void main()
+{
+    float intensity = 0.0f;
+
+#ifdef LIGHT_AMBIENT
+    //Ambient color component.
+    float ambient = 0.15f;
+    intensity += ambient;
+#endif
+
+    //Diffuse color component.
+    vec3 norm = normalize(normal);
+    vec3 light_dir_norm = normalize(light_pos - frag_pos); //Light direction with respect to the fragment.
+    float diffuse = max(dot(norm, light_dir_norm), 0.0f);
+#ifdef POINT_SHADOW
+    float lit = 1.0f - get_point_shadow(norm, light_dir_norm);
+    diffuse *= lit;
+#endif
+    intensity += diffuse;
+
+#ifdef LIGHT_SPECULAR
+    //Specular color component (shininess).
+    vec3 view_dir_norm = normalize(cam_pos - frag_pos); //Camera's direction with respect to the fragment.
+    vec3 reflect_dir_norm = reflect(-light_dir_norm, norm); //"Ray's" reflection direction with respect to the fragment.
+    float specular = 0.5f*pow(max(dot(view_dir_norm, reflect_dir_norm), 0.0f), 128);
+#ifdef POINT_SHADOW
+    specular *= lit;
+#endif
+    intensity += specular;
+#endif
+
+#ifdef LIGHT_ATTENUATION
+    //Attenuation factor.
+    float light_dist = length(light_pos - frag_pos); //Distance between point light source and fragment.
+    float k1 = 1.0f, k2 = 0.09f, k3 = 0.032f; //constant (k1), linear (k2) and quadratic (k3) attenuation parameters
+    float atten_factor = 1.0f/(k1 + k2*light_dist + k3*light_dist*light_dist);
+    intensity *= atten_factor;
+#endif
+
+    frag_col = vec4(intensity*mesh_col*light_col, 1.0f);
+}
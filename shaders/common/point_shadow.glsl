@@ -0,0 +1,40 @@
+//Shadow of a point light from its point shadow map (../../include/point_shadow_map.h), included by point_light.glsl with POINT_SHADOW
+//defined. The cubemap holds the distance from the light over its range, so the fragment's own distance is the comparison reference
+//and the direction from the light is the lookup coordinate. Expects 'frag_pos' and 'light_pos' declared before.
+
+uniform samplerCubeShadow sample_point_shadow; //Sampled with comparison, linear filtering (bilinear pcf per tap).
+uniform float light_range; //Distance stored as 1 in the map.
+uniform float point_shadow_resolution; //Texels per face side.
+
+//4 taps on a square around the lookup direction, in the plane perpendicular to it.
+const vec2 point_shadow_taps[4] = vec2[]( vec2(-0.7f,-0.3f), vec2(0.3f,-0.7f), vec2(0.7f,0.3f), vec2(-0.3f,0.7f) );
+
+//Shadow amount (0 : fully lit, 1 : fully shadowed) of the fragment.
+float get_point_shadow(vec3 norm, vec3 light_dir_norm)
+{
+    vec3 to_frag = frag_pos - light_pos;
+    float dist = length(to_frag);
+    if (dist >= light_range)
+        return 0.0f; //Out of the light's range : Nothing casts a shadow there.
+
+    //A texel of a face covers about 2*dist/resolution at the fragment's distance. Push the fragment off its surface along the normal by
+    //about a texel (more at grazing angles), which removes the acne without the detached shadows of a large depth bias.
+    float texel = 2.0f*dist/point_shadow_resolution;
+    float cos_theta = clamp(dot(norm, light_dir_norm), 0.0f, 1.0f);
+    vec3 offset_pos = frag_pos + norm*texel*(1.0f + 2.0f*sqrt(1.0f - cos_theta*cos_theta));
+    vec3 dir = offset_pos - light_pos;
+    float depth_ref = length(dir)/light_range - 2.0f/65535.0f; //+ 2 steps of a 16 bit depth.
+
+    //Tangent basis around the lookup direction, for the pcf taps (1.5 texels apart).
+    vec3 w = normalize(dir);
+    vec3 t = normalize(cross(w, (abs(w.z) < 0.9f) ? vec3(0.0f,0.0f,1.0f) : vec3(1.0f,0.0f,0.0f)));
+    vec3 b = cross(w, t);
+    float spread = 1.5f*texel;
+    float lit = 0.0f;
+    for (int i = 0; i < 4; i++)
+    {
+        vec3 tap = dir + spread*(point_shadow_taps[i].x*t + point_shadow_taps[i].y*b);
+        lit += texture(sample_point_shadow, vec4(tap, depth_ref));
+    }
+    return 1.0f - 0.25f*lit;
+}
@@ -0,0 +1,51 @@
+//Sampling of a virtual texture (virtual_texture.h). The uniforms are set by virtual_texture::bind() (and vt_lod_bias by
+//virtual_texture_feedback::bind(), 0 otherwise). uv repeats, like a texture with GL_REPEAT.
+
+uniform sampler2D vt_cache; //Physical pages, with their borders.
+uniform usampler2D vt_indirection; //Per page of every level (mip level of the texture) : Cache page (x,y) and level of what is resident.
+uniform float vt_size; //Texels per side of level 0.
+uniform int vt_levels; //Levels of the pyramid (the last one is 1 page).
+uniform float vt_cache_size; //Texels per side of the cache.
+uniform float vt_lod_bias; //Level of detail offset (-log2 of the scale of the feedback target).
+
+const float vt_page_size = 128.0f;
+const float vt_border = 4.0f;
+const float vt_padded = vt_page_size + 2.0f*vt_border;
+
+//Level of detail of the texture at uv, from its screen space derivatives (like the hardware does for mipmaps).
+float vt_lod(vec2 uv)
+{
+    vec2 dx = dFdx(uv*vt_size), dy = dFdy(uv*vt_size);
+    float lod = 0.5f*log2(max(max(dot(dx,dx), dot(dy,dy)), 1e-8f)) + vt_lod_bias;
+    return clamp(lod, 0.0f, float(vt_levels - 1));
+}
+
+//Page (x,y) at 'level' that holds uv.
+uvec2 vt_page(vec2 uv, int level)
+{
+    float pages = max(vt_size/vt_page_size/exp2(float(level)), 1.0f);
+    return uvec2(min(floor(fract(uv)*pages), vec2(pages - 1.0f)));
+}
+
+//Bilinear sample at 'level', or at the finest resident level above it.
+vec4 vt_sample_level(vec2 uv, int level)
+{
+    uvec4 entry = texelFetch(vt_indirection, ivec2(vt_page(uv, level)), level);
+    vec2 t = fract(uv)*vt_size/exp2(float(entry.z)); //Texel coordinates in the resident level.
+    vec2 cache_texel = vec2(entry.xy)*vt_padded + vt_border + mod(t, vt_page_size);
+    return textureLod(vt_cache, cache_texel/vt_cache_size, 0.0f);
+}
+
+//Level that vt_sample_level() actually reads for 'level' (coarser while the page is loading).
+int vt_resident_level(vec2 uv, int level)
+{
+    return int(texelFetch(vt_indirection, ivec2(vt_page(uv, level)), level).z);
+}
+
+//Trilinear sample.
+vec4 vt_sample(vec2 uv)
+{
+    float lod = vt_lod(uv);
+    int level = int(lod);
+    return mix(vt_sample_level(uv, level), vt_sample_level(uv, min(level + 1, vt_levels - 1)), fract(lod));
+}
@@ -1,28 +1,28 @@
 #version 450 core
 
+//1 direction of a separable Gaussian blur : ../../include/image_blur.h runs it horizontally, then vertically on the result, which gives
+//the same (isotropic) blur as a 2D kernel, with 2*n instead of n*n fetches. The weights come folded in pairs : A fetch between 2 texels,
+//at the right spot, returns their weighted sum thanks to bilinear filtering, so a radius of r texels takes about r/2 fetches per side.
+//Offsets are in texels of the target, so the blur is the same at any resolution.
+
+#define MAX_TAPS 17
+
 in vec2 uv;
 out vec4 frag_col;
 
 uniform sampler2D sample_tex;
+uniform vec2 texel_step; //1 target texel along the blur direction, in uv units.
+uniform int tap_count; //Tap 0 is the center, the others are mirrored.
+uniform float tap_weights[MAX_TAPS];
+uniform float tap_offsets[MAX_TAPS]; //[texels]
 
 void main()
 {
-    //Instead of directly sampling the texture bound to texture unit 0 at the specified u,v coordinates
-    //and return the color of the corresponding texel (pixel in the texture), we will 'play' around with
-    //the uv coords: We will sample from slightly distant (offset) uv coords. The coefficients
-    //(0.1945946, 0.1216216f, 0.0540540) reduce the effect of sample contribution (negative and positive)
-    //in accordance to a gaussian function, hence the name 'gaussian blur' we see in many softwares.
-
-    float offset = 1.0f/400.0f; //Play with this value for more/less blur.
-
-    vec3 result = texture(sample_tex, uv).rgb*0.227027f; //Center weight.
-    
-    result += 0.1945946f*texture(sample_tex, uv + vec2(-offset, 0.0f)).rgb;
-    result += 0.1945946f*texture(sample_tex, uv + vec2( offset, 0.0f)).rgb;
-    result += 0.1216216f*texture(sample_tex, uv + vec2(-2.0f*offset, 0.0f)).rgb;
-    result += 0.1216216f*texture(sample_tex, uv + vec2( 2.0f*offset, 0.0f)).rgb;
-    result += 0.0540540f*texture(sample_tex, uv + vec2(-3.0f*offset, 0.0f)).rgb;
-    result += 0.0540540f*texture(sample_tex, uv + vec2( 3.0f*offset, 0.0f)).rgb;
-
+    vec3 result = tap_weights[0]*texture(sample_tex, uv).rgb;
+    for (int i = 1; i < tap_count; ++i)
+    {
+        vec2 offset = tap_offsets[i]*texel_step;
+        result += tap_weights[i]*(texture(sample_tex, uv - offset).rgb + texture(sample_tex, uv + offset).rgb);
+    }
     frag_col = vec4(result, 1.0f);
-}
\ No newline at end of file
+}
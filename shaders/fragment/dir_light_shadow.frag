@@ -0,0 +1,4 @@
+#version 450 core
+
+//Generic variant : the lighting terms are selected by #defines injected from the application (see ../common/dir_light_shadow.glsl).
+#include "../common/dir_light_shadow.glsl"
@@ -0,0 +1,35 @@
+#version 450 core
+
+//Dual Kawase blur (dual filtering) : A chain of half resolution steps down, then back up. Every step is 1 small fixed kernel, but since
+//each one works at a coarser level, the blur radius doubles per step at almost no cost (see ../../include/image_blur.h).
+//default   : Downsample. 5 bilinear fetches (center and 4 diagonal corners) of the larger source.
+//KAWASE_UP : Upsample. 8 bilinear fetches (4 edges and 4 diagonals) of the smaller source.
+
+in vec2 uv;
+out vec4 frag_col;
+
+uniform sampler2D sample_tex;
+uniform float spread; //Kernel size, in source half texels (1 : the classic kernel).
+
+void main()
+{
+    vec2 h = spread*0.5f/vec2(textureSize(sample_tex, 0)); //Half a source texel.
+#ifdef KAWASE_UP
+    vec3 sum = texture(sample_tex, uv + vec2(-2.0f*h.x, 0.0f)).rgb +
+               texture(sample_tex, uv + vec2( 2.0f*h.x, 0.0f)).rgb +
+               texture(sample_tex, uv + vec2(0.0f, -2.0f*h.y)).rgb +
+               texture(sample_tex, uv + vec2(0.0f,  2.0f*h.y)).rgb;
+    sum += 2.0f*(texture(sample_tex, uv + vec2(-h.x, -h.y)).rgb +
+                 texture(sample_tex, uv + vec2( h.x, -h.y)).rgb +
+                 texture(sample_tex, uv + vec2(-h.x,  h.y)).rgb +
+                 texture(sample_tex, uv + vec2( h.x,  h.y)).rgb);
+    frag_col = vec4(sum/12.0f, 1.0f);
+#else
+    vec3 sum = 4.0f*texture(sample_tex, uv).rgb;
+    sum += texture(sample_tex, uv + vec2(-h.x, -h.y)).rgb +
+           texture(sample_tex, uv + vec2( h.x, -h.y)).rgb +
+           texture(sample_tex, uv + vec2(-h.x,  h.y)).rgb +
+           texture(sample_tex, uv + vec2( h.x,  h.y)).rgb;
+    frag_col = vec4(sum/8.0f, 1.0f);
+#endif
+}
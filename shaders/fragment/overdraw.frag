@@ -0,0 +1,24 @@
+#version 450 core
+
+//Heat map of the fragments shaded per pixel, as counted by the lit shaders built with OVERDRAW (see ../../include/overdraw_counter.h) :
+//Black for none, then blue (1), cyan, green, yellow and red ('max_count' or more). Goes with trans_nothing_texture.vert and quadtex.
+
+in vec2 uv;
+out vec4 frag_col;
+
+layout(binding = 0) uniform usampler2D counts;
+uniform int max_count;
+
+void main()
+{
+    uint count = texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r;
+    if (count == 0u)
+    {
+        frag_col = vec4(0.0f,0.0f,0.0f,1.0f);
+        return;
+    }
+    const vec3 ramp[5] = vec3[](vec3(0.0f,0.0f,1.0f), vec3(0.0f,1.0f,1.0f), vec3(0.0f,1.0f,0.0f), vec3(1.0f,1.0f,0.0f), vec3(1.0f,0.0f,0.0f));
+    float t = 4.0f*clamp(float(count - 1u)/float(max(max_count - 1, 1)), 0.0f, 1.0f);
+    int i = min(int(t), 3);
+    frag_col = vec4(mix(ramp[i], ramp[i + 1], t - float(i)), 1.0f);
+}
@@ -0,0 +1,4 @@
+#version 450 core
+
+//Generic variant : the lighting terms are selected by #defines injected from the application (see ../common/point_light.glsl).
+#include "../common/point_light.glsl"
@@ -0,0 +1,64 @@
+#version 450 core
+
+//Many point lights in 1 pass (clustered forward shading, ../../include/clustered_lights.h) : Every light is shaded like in
+//point_light_ads_atten.frag (diffuse, specular, attenuation), times a window that fades it to 0 at its radius of influence, and each
+//fragment only loops over the lights listed for its cluster. With ALL_LIGHTS it loops over every light instead (for comparison).
+//Goes with trans_mvpn.vert.
+
+in vec3 frag_pos;
+in vec3 normal;
+
+out vec4 frag_col;
+
+#include "../common/clustered_lights.glsl"
+
+uniform vec3 mesh_col;
+uniform vec3 cam_pos;
+uniform mat4 view;
+uniform bool show_clusters; //Color by the number of lights in the fragment's cluster (blue : none, red : 128 or more).
+
+//Diffuse + specular of light i, attenuated.
+vec3 shade(uint i, vec3 norm, vec3 view_dir_norm)
+{
+    vec3 to_light = lit[i].pos_radius.xyz - frag_pos;
+    float dist = length(to_light);
+    float radius = lit[i].pos_radius.w;
+    if (dist >= radius)
+        return vec3(0.0f);
+    vec3 light_dir_norm = to_light/dist;
+    float diffuse = max(dot(norm, light_dir_norm), 0.0f);
+    vec3 reflect_dir_norm = reflect(-light_dir_norm, norm);
+    float specular = 0.5f*pow(max(dot(view_dir_norm, reflect_dir_norm), 0.0f), 128);
+    float k1 = 1.0f, k2 = 0.09f, k3 = 0.032f; //constant (k1), linear (k2) and quadratic (k3) attenuation parameters
+    float atten_factor = 1.0f/(k1 + k2*dist + k3*dist*dist);
+    float ratio = dist/radius;
+    float window = clamp(1.0f - ratio*ratio*ratio*ratio, 0.0f, 1.0f);
+    return (diffuse + specular)*atten_factor*window*window*lit[i].col.rgb;
+}
+
+void main()
+{
+    vec3 norm = normalize(normal);
+    vec3 view_dir_norm = normalize(cam_pos - frag_pos);
+    vec3 light = vec3(0.05f); //Ambient.
+
+#ifdef ALL_LIGHTS
+    for (uint i = 0; i < uint(light_count); i++)
+        light += shade(i, norm, view_dir_norm);
+    uint count = uint(light_count);
+#else
+    float depth = -(view*vec4(frag_pos, 1.0f)).z;
+    uint cluster = get_cluster(gl_FragCoord.xy, depth);
+    uvec2 list = lists[cluster];
+    uint count = list.y;
+    for (uint k = 0; k < count; k++)
+        light += shade(indices[list.x + k], norm, view_dir_norm);
+#endif
+
+    frag_col = vec4(light*mesh_col, 1.0f);
+    if (show_clusters)
+    {
+        float heat = clamp(float(count)/128.0f, 0.0f, 1.0f);
+        frag_col.rgb = mix(frag_col.rgb, mix(vec3(0.0f,0.0f,1.0f), vec3(1.0f,0.0f,0.0f), sqrt(heat)), 0.6f);
+    }
+}
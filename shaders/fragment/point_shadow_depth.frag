@@ -0,0 +1,14 @@
+#version 450 core
+
+//Depth of a point shadow map (../../include/point_shadow_map.h) : The distance from the light over its range, instead of the depth of
+//the face's projection. Linear, and the same whichever face the fragment lands on.
+
+in vec3 frag_pos_world;
+
+uniform vec3 light_pos;
+uniform float light_range;
+
+void main()
+{
+    gl_FragDepth = length(frag_pos_world - light_pos)/light_range;
+}
@@ -0,0 +1,37 @@
+#version 450 core
+
+//A mesh textured with a virtual texture (virtual_texture.h). Built with VT_FEEDBACK it's the feedback shader instead : It writes the
+//page (x, y, level, 255) that each fragment needs into the rgba8ui target of virtual_texture_feedback.
+
+in vec2 uv;
+
+#include "../common/virtual_texture.glsl"
+
+#ifdef VT_FEEDBACK
+
+out uvec4 frag_page;
+
+void main()
+{
+    int level = int(vt_lod(uv));
+    frag_page = uvec4(vt_page(uv, level), uint(level), 255u);
+}
+
+#else
+
+out vec4 frag_col;
+
+uniform bool show_levels; //Tint every fragment by the level it reads (red : finest, blue : coarsest).
+
+void main()
+{
+    frag_col = vt_sample(uv);
+    if (show_levels)
+    {
+        float level = float(vt_resident_level(uv, int(vt_lod(uv))))/max(float(vt_levels - 1), 1.0f);
+        frag_col.rgb = mix(frag_col.rgb, mix(vec3(1.0f,0.2f,0.2f), vec3(0.2f,0.2f,1.0f), level), 0.5f);
+    }
+    frag_col.a = 1.0f;
+}
+
+#endif
@@ -1,19 +1,28 @@
 #version 450 core
 
+//DEPTH_ONLY : Positions only, for a depth prepass (e.g. with meshvfn::draw_positions()). gl_Position is invariant, so that the prepass and
+//the color pass compute the very same depth, as the GL_EQUAL depth test of the color pass needs.
+
 layout(location = 0) in vec3 pos;
+#ifndef DEPTH_ONLY
 layout(location = 1) in vec3 norm;
 
 out vec3 frag_pos;
 out vec3 normal;
+#endif
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
+invariant gl_Position;
+
 void main()
 {
+#ifndef DEPTH_ONLY
     frag_pos = vec3(model*vec4(pos,1.0f)); //Fragment's position in world coordinates.
     normal = mat3(transpose(inverse(model)))*norm; //Avoiding non uniform scaling issues.
+#endif
 
     gl_Position = projection*view*model*vec4(pos, 1.0f); //Final vertex position.
 }
\ No newline at end of file
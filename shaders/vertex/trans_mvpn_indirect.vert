@@ -0,0 +1,44 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : enable
+
+//Variant of trans_mvpn_instanced.vert for the render queue (../../include/render_queue.h). Every command of a multi-draw starts at its own
+//instance (its baseInstance), so the per-draw data is at gl_BaseInstance + gl_InstanceID. Without draw parameters, the queue draws the
+//commands 1 by 1 and passes their base instance as a uniform.
+//VISIBLE_LIST : There is 1 more indirection, through the list of visible objects written by the gpu culling (../compute/frustum_cull.comp).
+#include "../common/instances.glsl"
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+
+out vec3 frag_pos;
+out vec3 normal;
+flat out vec3 mesh_col; //Used by the fragment shaders compiled with INSTANCE_COLOR.
+
+uniform mat4 projection;
+uniform mat4 view;
+#ifndef GL_ARB_shader_draw_parameters
+uniform int base_instance;
+#endif
+#ifdef VISIBLE_LIST
+layout(std430, binding = 3) readonly buffer visible_instances
+{
+    uint visible[];
+};
+#endif
+
+void main()
+{
+#ifdef GL_ARB_shader_draw_parameters
+    int i = gl_BaseInstanceARB + gl_InstanceID;
+#else
+    int i = base_instance + gl_InstanceID;
+#endif
+#ifdef VISIBLE_LIST
+    i = int(visible[i]);
+#endif
+    frag_pos = vec3(inst[i].model*vec4(pos,1.0f)); //Fragment's position in world coordinates.
+    normal = mat3(inst[i].normal)*norm;
+    mesh_col = inst[i].col.rgb;
+
+    gl_Position = projection*view*vec4(frag_pos, 1.0f); //Final vertex position.
+}
@@ -0,0 +1,24 @@
+#version 450 core
+
+//Instanced variant of trans_mvpn.vert : model and normal matrices (and color) come from the instance buffer instead of uniforms.
+#include "../common/instances.glsl"
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+
+out vec3 frag_pos;
+out vec3 normal;
+flat out vec3 mesh_col; //Used by the fragment shaders compiled with INSTANCE_COLOR.
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    mat4 model = inst[gl_InstanceID].model;
+    frag_pos = vec3(model*vec4(pos,1.0f)); //Fragment's position in world coordinates.
+    normal = mat3(inst[gl_InstanceID].normal)*norm;
+    mesh_col = inst[gl_InstanceID].col.rgb;
+
+    gl_Position = projection*view*vec4(frag_pos, 1.0f); //Final vertex position.
+}
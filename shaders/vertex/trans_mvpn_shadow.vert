@@ -1,21 +1,34 @@
 #version 450 core
 
+//SHADOW_CASCADES : The fragment shader picks a cascade by view depth and transforms the world position itself, so output that depth
+//instead of the position in the light's (single) frame.
+
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 norm;
 
 out vec3 frag_pos_world;
+#ifdef SHADOW_CASCADES
+out float view_depth; //Distance from the camera, along its view direction.
+#else
 out vec4 frag_pos_light;
+#endif
 out vec3 normal;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+#ifndef SHADOW_CASCADES
 uniform mat4 dir_light_pv; //Light's projection*view matrix.
+#endif
 
 void main()
 {
     frag_pos_world = vec3(model*vec4(pos,1.0f)); //Fragment's position in world coordinates.
+#ifdef SHADOW_CASCADES
+    view_depth = -(view*model*vec4(pos, 1.0f)).z;
+#else
     frag_pos_light = dir_light_pv*model*vec4(pos, 1.0f);
+#endif
     normal = mat3(transpose(inverse(model)))*norm; //Avoiding non uniform scaling issues.
     gl_Position = projection*view*model*vec4(pos, 1.0f); //Final vertex position.
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 450 core
+
+//Instanced variant of trans_mvpn_shadow.vert : model and normal matrices (and color) come from the instance buffer instead of uniforms.
+#include "../common/instances.glsl"
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+
+out vec3 frag_pos_world;
+#ifdef SHADOW_CASCADES
+out float view_depth; //Distance from the camera, along its view direction.
+#else
+out vec4 frag_pos_light;
+#endif
+out vec3 normal;
+flat out vec3 mesh_col; //Used by the fragment shaders compiled with INSTANCE_COLOR.
+
+uniform mat4 projection;
+uniform mat4 view;
+#ifndef SHADOW_CASCADES
+uniform mat4 dir_light_pv; //Light's projection*view matrix.
+#endif
+
+void main()
+{
+    vec4 world_pos = inst[gl_InstanceID].model*vec4(pos, 1.0f);
+    frag_pos_world = vec3(world_pos); //Fragment's position in world coordinates.
+#ifdef SHADOW_CASCADES
+    view_depth = -(view*world_pos).z;
+#else
+    frag_pos_light = dir_light_pv*world_pos;
+#endif
+    normal = mat3(inst[gl_InstanceID].normal)*norm;
+    mesh_col = inst[gl_InstanceID].col.rgb;
+    gl_Position = projection*view*world_pos; //Final vertex position.
+}
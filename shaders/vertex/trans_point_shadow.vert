@@ -0,0 +1,39 @@
+#version 450 core
+
+//Depth pass of a point shadow map (../../include/point_shadow_map.h). With POINT_SHADOW_LAYERED, all 6 faces of the cubemap in 1 pass :
+//Every caster is drawn with 1 instance per face it touches and each instance goes to its face (layer) via gl_Layer. Without it, the
+//single face 'face' (1 pass per face). Goes with point_shadow_depth.frag.
+
+#ifdef POINT_SHADOW_LAYERED
+//gl_Layer in a vertex shader comes from either extension (point_shadow_map::is_layered() checks that 1 of them is there).
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#if !defined(GL_ARB_shader_viewport_layer_array) && !defined(GL_AMD_vertex_shader_layer)
+#error "POINT_SHADOW_LAYERED needs ARB_shader_viewport_layer_array or AMD_vertex_shader_layer"
+#endif
+#endif
+
+layout(location = 0) in vec3 pos;
+
+out vec3 frag_pos_world;
+
+uniform mat4 model;
+uniform mat4 face_pv[6]; //Light's projection*view matrix of every face (+x, -x, +y, -y, +z, -z).
+#ifdef POINT_SHADOW_LAYERED
+uniform int face_list[6]; //Face of every instance.
+#else
+uniform int face;
+#endif
+
+void main()
+{
+    vec4 world = model*vec4(pos, 1.0f);
+    frag_pos_world = world.xyz;
+#ifdef POINT_SHADOW_LAYERED
+    int f = face_list[gl_InstanceID];
+    gl_Layer = f;
+#else
+    int f = face;
+#endif
+    gl_Position = face_pv[f]*world;
+}